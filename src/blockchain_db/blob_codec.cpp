@@ -0,0 +1,194 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdexcept>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#include "blob_codec.h"
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db"
+
+// a single block or transaction is far below this, anything larger is corrupt
+static constexpr const size_t MAX_DECOMPRESSED_SIZE = 128 * 1024 * 1024;
+
+namespace cryptonote
+{
+
+#ifdef HAVE_ZSTD
+namespace
+{
+  // zstd contexts hold sizeable work buffers, so each thread keeps its own
+  struct thread_contexts
+  {
+    ZSTD_CCtx *cctx = NULL;
+    ZSTD_DCtx *dctx = NULL;
+    ~thread_contexts() { ZSTD_freeCCtx(cctx); ZSTD_freeDCtx(dctx); }
+  };
+  thread_local thread_contexts contexts;
+
+  ZSTD_CCtx *get_cctx()
+  {
+    if (!contexts.cctx && !(contexts.cctx = ZSTD_createCCtx()))
+      throw std::runtime_error("Failed to create zstd compression context");
+    return contexts.cctx;
+  }
+
+  ZSTD_DCtx *get_dctx()
+  {
+    if (!contexts.dctx && !(contexts.dctx = ZSTD_createDCtx()))
+      throw std::runtime_error("Failed to create zstd decompression context");
+    return contexts.dctx;
+  }
+}
+
+struct blob_codec::impl
+{
+  ZSTD_CDict *cdict = NULL;
+  ZSTD_DDict *ddict = NULL;
+  ~impl() { ZSTD_freeCDict(cdict); ZSTD_freeDDict(ddict); }
+};
+#else
+struct blob_codec::impl
+{
+};
+#endif
+
+bool blob_codec::is_supported(uint32_t codec_type)
+{
+  switch (codec_type)
+  {
+    case none: return true;
+#ifdef HAVE_ZSTD
+    case zstd: return true;
+#endif
+    default: return false;
+  }
+}
+
+std::string blob_codec::train_dictionary(const std::vector<std::string> &samples, size_t max_size)
+{
+#ifdef HAVE_ZSTD
+  // the trainer needs a fair number of samples, and fails outright with too few
+  if (samples.size() < 64)
+    return std::string();
+  std::string buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const std::string &sample: samples)
+  {
+    buffer += sample;
+    sizes.push_back(sample.size());
+  }
+  std::string dictionary(max_size, '\0');
+  const size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), buffer.data(), sizes.data(), sizes.size());
+  if (ZDICT_isError(size))
+  {
+    MWARNING("Failed to train compression dictionary: " << ZDICT_getErrorName(size));
+    return std::string();
+  }
+  dictionary.resize(size);
+  return dictionary;
+#else
+  return std::string();
+#endif
+}
+
+blob_codec::blob_codec(const std::string &dictionary, int level):
+  m_dictionary(dictionary),
+  m_level(level),
+  m_impl(new impl())
+{
+#ifdef HAVE_ZSTD
+  if (!m_dictionary.empty())
+  {
+    m_impl->cdict = ZSTD_createCDict(m_dictionary.data(), m_dictionary.size(), m_level);
+    m_impl->ddict = ZSTD_createDDict(m_dictionary.data(), m_dictionary.size());
+    if (!m_impl->cdict || !m_impl->ddict)
+      throw std::runtime_error("Failed to load zstd dictionary");
+  }
+#else
+  throw std::runtime_error("This build does not support zstd compression");
+#endif
+}
+
+blob_codec::~blob_codec()
+{
+}
+
+bool blob_codec::compress(const void *data, size_t size, std::string &out) const
+{
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx *cctx = get_cctx();
+  ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, m_level);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+  if (m_impl->cdict)
+    ZSTD_CCtx_refCDict(cctx, m_impl->cdict);
+  out.resize(ZSTD_compressBound(size));
+  const size_t res = ZSTD_compress2(cctx, &out[0], out.size(), data, size);
+  if (ZSTD_isError(res))
+  {
+    MERROR("Failed to compress blob: " << ZSTD_getErrorName(res));
+    return false;
+  }
+  out.resize(res);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool blob_codec::decompress(const void *data, size_t size, std::string &out) const
+{
+#ifdef HAVE_ZSTD
+  const unsigned long long content_size = ZSTD_getFrameContentSize(data, size);
+  if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR || content_size > MAX_DECOMPRESSED_SIZE)
+    return false;
+  out.resize(content_size);
+  size_t res;
+  if (m_impl->ddict)
+    res = ZSTD_decompress_usingDDict(get_dctx(), &out[0], out.size(), data, size, m_impl->ddict);
+  else
+    res = ZSTD_decompressDCtx(get_dctx(), &out[0], out.size(), data, size);
+  if (ZSTD_isError(res) || res != content_size)
+  {
+    MERROR("Failed to decompress blob: " << (ZSTD_isError(res) ? ZSTD_getErrorName(res) : "unexpected size"));
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cryptonote
+{
+  /**
+   * @brief compression for the blobs of a database table
+   *
+   * Wraps zstd, optionally with a dictionary trained on the table's own rows,
+   * which is what makes small records such as a single transaction compress
+   * well. Compressed frames carry their decompressed size and a checksum of
+   * the contents.
+   *
+   * A codec may be used by several threads at once.
+   */
+  class blob_codec
+  {
+  public:
+    enum type: uint32_t
+    {
+      none = 0,
+      zstd = 1,
+    };
+
+    /**
+     * @brief whether this build can read and write the given codec type
+     */
+    static bool is_supported(uint32_t codec_type);
+
+    /**
+     * @brief trains a dictionary on sample blobs
+     *
+     * @return the dictionary, or an empty string if there were not enough samples
+     */
+    static std::string train_dictionary(const std::vector<std::string> &samples, size_t max_size);
+
+    /**
+     * @param dictionary a dictionary from train_dictionary, may be empty
+     * @param level the zstd compression level
+     */
+    blob_codec(const std::string &dictionary, int level);
+    ~blob_codec();
+
+    const std::string &dictionary() const { return m_dictionary; }
+
+    bool compress(const void *data, size_t size, std::string &out) const;
+    bool decompress(const void *data, size_t size, std::string &out) const;
+
+  private:
+    struct impl;
+
+    std::string m_dictionary;
+    int m_level;
+    std::unique_ptr<impl> m_impl;
+  };
+}
@@ -307,7 +307,9 @@ uint64_t BlockchainDB::add_block( const std::pair<block, blobdata>& blck
   TIME_MEASURE_FINISH(time1);
   time_add_block1 += time1;
 
-  m_hardfork->add(blk, prev_height);
+  // a db being written by another one's compact_catch_up has no hard fork object, its versions are copied over
+  if (m_hardfork)
+    m_hardfork->add(blk, prev_height);
 
   ++num_calls;
 
@@ -359,7 +361,9 @@ void BlockchainDB::remove_transaction(const crypto::hash& tx_hash)
 
 block BlockchainDB::get_block_from_height(const uint64_t& height) const
 {
-  blobdata bd = get_block_blob_from_height(height);
+  db_rtxn_guard rtxn_guard(this);
+  blobdata scratch;
+  const blobdata_ref bd = get_block_blob_view_from_height(height, scratch);
   block b;
   if (!parse_and_validate_block_from_blob(bd, b))
     throw DB_ERROR("Failed to parse block from blob retrieved from the db");
@@ -390,8 +394,9 @@ bool BlockchainDB::get_tx(const crypto::hash& h, cryptonote::transaction &tx) co
 
 bool BlockchainDB::get_pruned_tx(const crypto::hash& h, cryptonote::transaction &tx) const
 {
-  blobdata bd;
-  if (!get_pruned_tx_blob(h, bd))
+  db_rtxn_guard rtxn_guard(this);
+  blobdata_ref bd;
+  if (!get_pruned_tx_blob_view(h, bd))
     return false;
   if (!parse_and_validate_tx_base_from_blob(bd, tx))
     throw DB_ERROR("Failed to parse transaction base from blob retrieved from the db");
@@ -445,6 +450,22 @@ void BlockchainDB::show_stats()
     << "*********************************"
     << ENDL
   );
+
+  db_resize_stats rs;
+  if (get_resize_stats(rs))
+  {
+    LOG_PRINT_L1("db map: " << rs.size_used / (1024 * 1024) << "/" << rs.map_size / (1024 * 1024) << " MiB used, growing by "
+        << rs.growth_rate / 1024 << " kiB/s, " << rs.resizes << " resizes (" << rs.resizes_ahead << " ahead of need), txns held off for "
+        << rs.stall_ms << " ms in total, " << rs.max_stall_ms << " ms at most");
+  }
+
+  key_image_filter_stats kif;
+  if (get_key_image_filter_stats(kif))
+  {
+    LOG_PRINT_L1("key image filter: " << kif.entries << " entries, capacity " << kif.capacity << ", " << kif.memory_size / 1024 << " kB, "
+        << kif.lookups << " lookups, " << kif.negatives << " answered by the filter, "
+        << kif.false_positives << " false positives (" << kif.false_positive_rate() * 100.0 << "%)");
+  }
 }
 
 void BlockchainDB::fixup()
@@ -193,6 +193,40 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_RCT_OUTPUT_INDEX 0x20
+#define DBF_KEY_IMAGE_FILTER 0x40
+#define DBF_COMPRESS 0x80
+#define DBF_TXPOOL_IN_MEMORY 0x100
+
+/**
+ * @brief usage figures for the in-memory filter in front of the spent key images
+ */
+struct key_image_filter_stats
+{
+  uint64_t entries;         //!< key images inserted, including popped ones
+  uint64_t capacity;        //!< key images the filter was sized for
+  uint64_t memory_size;     //!< bytes used by the filter
+  uint64_t lookups;         //!< has_key_image calls since the db was opened
+  uint64_t negatives;       //!< lookups answered by the filter alone
+  uint64_t false_positives; //!< lookups the filter passed on which were not spent after all
+
+  //! share of the key images not spent which the filter failed to rule out
+  double false_positive_rate() const { return negatives + false_positives ? false_positives / (double)(negatives + false_positives) : 0.0; }
+};
+
+/**
+ * @brief figures about growing the db's storage
+ */
+struct db_resize_stats
+{
+  uint64_t map_size;        //!< bytes the db can currently grow to
+  uint64_t size_used;       //!< bytes of that in use
+  uint64_t growth_rate;     //!< recent growth, in bytes per second, as sampled by resize_ahead
+  uint64_t resizes;         //!< resizes since the db was opened
+  uint64_t resizes_ahead;   //!< those done by resize_ahead, rather than once space ran short
+  uint64_t stall_ms;        //!< total time new txns were held off for resizes
+  uint64_t max_stall_ms;    //!< longest time new txns were held off for a single resize
+};
 
 /***********************************
  * Exception Definitions
@@ -937,6 +971,24 @@ public:
    */
   virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t& height) const = 0;
 
+  /**
+   * @brief fetch a view of a block blob by height
+   *
+   * Like get_block_blob_from_height, but the returned blob points into the
+   * db's own storage where possible, rather than being copied out. A blob
+   * which is stored compressed is decompressed into scratch instead.
+   *
+   * The caller must hold a read txn (see db_rtxn_guard) for as long as the
+   * view is in use, and the view must not outlive scratch. In a write txn,
+   * the view is also invalidated by the next write.
+   *
+   * @param height the height to look for
+   * @param scratch storage for the blob if it cannot be pointed to directly
+   *
+   * @return a view of the block blob
+   */
+  virtual cryptonote::blobdata_ref get_block_blob_view_from_height(const uint64_t& height, cryptonote::blobdata &scratch) const = 0;
+
   /**
    * @brief fetch a block by height
    *
@@ -1289,6 +1341,19 @@ public:
    */
   virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const = 0;
 
+  /**
+   * @brief fetches a view of the pruned transaction blob with the given hash
+   *
+   * Like get_pruned_tx_blob, but the returned blob points into the db's own
+   * storage, with the same lifetime rules as get_block_blob_view_from_height.
+   *
+   * @param h the hash to look for
+   * @param tx the view of the pruned transaction blob
+   *
+   * @return true iff the transaction was found
+   */
+  virtual bool get_pruned_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx) const = 0;
+
   /**
    * @brief fetches a number of pruned transaction blob from the given hash, in canonical blockchain order
    *
@@ -1342,6 +1407,25 @@ public:
    */
   virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const = 0;
 
+  /**
+   * @brief fetches a view of the prunable transaction blob with the given hash
+   *
+   * Like get_prunable_tx_blob, but the returned blob points into the db's own
+   * storage where possible, with the same lifetime rules and use of scratch
+   * as get_block_blob_view_from_height.
+   *
+   * A full transaction is stored as its pruned and prunable parts, so there
+   * is no single view of it; callers needing one contiguous blob still have
+   * to use get_tx_blob.
+   *
+   * @param h the hash to look for
+   * @param tx the view of the prunable transaction blob
+   * @param scratch storage for the blob if it cannot be pointed to directly
+   *
+   * @return true iff the transaction was found and we have its prunable data
+   */
+  virtual bool get_prunable_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx, cryptonote::blobdata &scratch) const = 0;
+
   /**
    * @brief fetches the prunable transaction hash
    *
@@ -1522,6 +1606,15 @@ public:
    */
   virtual bool has_key_image(const crypto::key_image& img) const = 0;
 
+  /**
+   * @brief get usage figures for the spent key image filter
+   *
+   * @param stats return-by-reference the figures
+   *
+   * @return false if the db keeps no such filter
+   */
+  virtual bool get_key_image_filter_stats(key_image_filter_stats &stats) const { return false; }
+
   /**
    * @brief add a txpool transaction
    *
@@ -1614,6 +1707,29 @@ public:
    */
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) = 0;
 
+  /**
+   * @brief prunes part of the blockchain, to be called until it returns true
+   *
+   * Each call goes through at most max_txes transactions in a single write
+   * transaction, so pruning can be interleaved with adding blocks. Where it
+   * stopped is saved in the db, so pruning picks up from there, also after
+   * a restart.
+   *
+   * @param pruning_seed the seed to use, 0 for default (highly recommended)
+   * @param max_txes the most transactions to go through
+   * @param pruned_bytes return-by-reference the size of the prunable data deleted
+   *
+   * @return true once the whole blockchain is pruned
+   */
+  virtual bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, uint64_t &pruned_bytes) = 0;
+
+  /**
+   * @brief checks whether pruning was started but not finished
+   *
+   * @return true if prune_blockchain_step has more to do
+   */
+  virtual bool is_pruning_in_progress() const = 0;
+
   /**
    * @brief prunes recent blockchain changes as needed, iff pruning is enabled
    * @return success iff true
@@ -1626,6 +1742,62 @@ public:
    */
   virtual bool check_pruning() = 0;
 
+  /**
+   * @brief writes a compacted copy of the db, while the db stays in use
+   *
+   * The copy leaves out free pages, such as those left by pruning and by
+   * pool txes coming and going, and is made from a read snapshot. Blocks
+   * added or popped meanwhile are then replayed onto it. A writer needing
+   * a map resize while the snapshot is being copied waits for the copy,
+   * rather than hold off every reader till it is done.
+   *
+   * @return false if there is not enough free disk space for the copy
+   */
+  virtual bool compact_copy() = 0;
+
+  /**
+   * @brief brings the copy made by compact_copy up to date and swaps it in
+   *
+   * The caller must make sure nothing writes to the db meanwhile; other
+   * readers are held off while the db is reopened on the copy.
+   *
+   * @return the number of bytes freed
+   */
+  virtual uint64_t compact_finish() = 0;
+
+  /**
+   * @brief grows the db ahead of need, going by its recent growth rate
+   *
+   * Meant to be called periodically. Growing may hold off other txns until
+   * the ones in progress are done, so the caller must not have a write txn
+   * open, and should not call this from within one of its read txns. It
+   * does nothing from compact_copy till compact_finish is done.
+   *
+   * @return true if the db was grown
+   */
+  virtual bool resize_ahead() { return false; }
+
+  /**
+   * @brief get figures about growing the db's storage
+   *
+   * @param stats return-by-reference the figures
+   *
+   * @return false if the db does not need to be grown explicitly
+   */
+  virtual bool get_resize_stats(db_resize_stats &stats) const { return false; }
+
+  /**
+   * @brief writes the txpool to disk, if the db keeps it in memory
+   *
+   * With DBF_TXPOOL_IN_MEMORY, the txpool calls only change an in-memory
+   * copy, loaded when the db is opened. This replaces the stored txpool
+   * with that copy, if it changed since. It is also done when closing the db.
+   * Like resize_ahead, the caller must not have a write txn open.
+   *
+   * @return true if the txpool was written
+   */
+  virtual bool store_txpool() { return false; }
+
   /**
    * @brief get the max block size
    */
@@ -1766,6 +1938,50 @@ public:
   virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const = 0;
   virtual bool for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const = 0;
 
+  /**
+   * @brief runs a function over a range of blocks, in parallel
+   *
+   * As for_blocks_range, but the range is split into contiguous shards,
+   * each walked in order on its own thread. All shards read the same
+   * snapshot of the database. The function is called concurrently, with
+   * the index of the shard as its first parameter, so per shard results
+   * can be kept apart and merged in shard order afterwards, which gives
+   * the same order as for_blocks_range.
+   *
+   * @param h1 the start height
+   * @param h2 the end height
+   * @param f the function to run
+   * @param shards the number of shards, 0 for one per core
+   *
+   * @return false if the function returns false for any block, otherwise true
+   */
+  virtual bool for_blocks_range_parallel(uint64_t h1, uint64_t h2, std::function<bool(size_t, uint64_t, const crypto::hash&, const cryptonote::block&)> f, size_t shards = 0) const = 0;
+
+  /**
+   * @brief runs a function over all transactions stored, in parallel
+   *
+   * As for_all_transactions, split into shards as for_blocks_range_parallel.
+   *
+   * @param f the function to run
+   * @param pruned whether to only get pruned tx data, or the whole
+   * @param shards the number of shards, 0 for one per core
+   *
+   * @return false if the function returns false for any transaction, otherwise true
+   */
+  virtual bool for_all_transactions_parallel(std::function<bool(size_t, const crypto::hash&, const cryptonote::transaction&)> f, bool pruned, size_t shards = 0) const = 0;
+
+  /**
+   * @brief runs a function over all outputs stored, in parallel
+   *
+   * As for_all_outputs, split into shards as for_blocks_range_parallel.
+   *
+   * @param f the function to run
+   * @param shards the number of shards, 0 for one per core
+   *
+   * @return false if the function returns false for any output, otherwise true
+   */
+  virtual bool for_all_outputs_parallel(std::function<bool(size_t, uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f, size_t shards = 0) const = 0;
+
   /**
    * @brief runs a function over all alternative blocks stored
    *
@@ -1911,7 +2127,7 @@ private:
   bool active;
 };
 
-class db_rtxn_guard: public db_txn_guard { public: db_rtxn_guard(BlockchainDB *db): db_txn_guard(db, true) {} };
+class db_rtxn_guard: public db_txn_guard { public: db_rtxn_guard(const BlockchainDB *db): db_txn_guard(const_cast<BlockchainDB*>(db), true) {} };
 class db_wtxn_guard: public db_txn_guard { public: db_wtxn_guard(BlockchainDB *db): db_txn_guard(db, false) {} };
 
 BlockchainDB *new_db();
@@ -0,0 +1,224 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include <cstring>
+
+#include "key_image_filter.h"
+#include "file_io_utils.h"
+#include "int-util.h"
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db"
+
+namespace cryptonote
+{
+
+static const char KEY_IMAGE_FILTER_MAGIC[8] = {'K', 'I', 'F', 'I', 'L', 'T', 'E', 'R'};
+static constexpr const uint32_t KEY_IMAGE_FILTER_VERSION = 1;
+
+// File layout: header, num_blocks * 8 little endian words, then cn_fast_hash of everything before it
+#pragma pack(push, 1)
+struct key_image_filter_header
+{
+  char magic[8];
+  uint32_t version;
+  uint64_t seed;
+  uint64_t capacity;
+  uint64_t entries;
+  uint64_t num_blocks;
+  uint64_t height;
+  crypto::hash top_hash;
+};
+#pragma pack(pop)
+
+static inline uint64_t mix64(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+key_image_filter::key_image_filter(uint64_t capacity, uint64_t seed):
+  m_capacity(std::max<uint64_t>(capacity, 1)),
+  m_seed(seed),
+  m_num_blocks((m_capacity * BITS_PER_ENTRY + WORDS_PER_BLOCK * 64 - 1) / (WORDS_PER_BLOCK * 64)),
+  m_blocks(new block[m_num_blocks]()),
+  m_entries(0)
+{
+}
+
+const key_image_filter::block &key_image_filter::get_block(const crypto::key_image &ki, uint64_t &bits) const
+{
+  // key images are points from hash_to_ec, so their bytes are already well
+  // spread, the mixing only makes the layout depend on the seed
+  uint64_t a, b;
+  memcpy(&a, &ki.data[0], sizeof(a));
+  memcpy(&b, &ki.data[8], sizeof(b));
+  bits = mix64(SWAP64LE(b) + m_seed);
+  return m_blocks[mix64(SWAP64LE(a) ^ m_seed) % m_num_blocks];
+}
+
+void key_image_filter::insert(const crypto::key_image &ki)
+{
+  uint64_t bits;
+  block &blk = const_cast<block&>(get_block(ki, bits));
+  for (size_t i = 0; i < WORDS_PER_BLOCK; ++i, bits >>= 6)
+    blk.words[i].fetch_or(1ull << (bits & 63), std::memory_order_release);
+  m_entries.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool key_image_filter::may_contain(const crypto::key_image &ki) const
+{
+  uint64_t bits;
+  const block &blk = get_block(ki, bits);
+  for (size_t i = 0; i < WORDS_PER_BLOCK; ++i, bits >>= 6)
+    if (!(blk.words[i].load(std::memory_order_acquire) & (1ull << (bits & 63))))
+      return false;
+  return true;
+}
+
+bool key_image_filter::store(const std::string &filename, uint64_t height, const crypto::hash &top_hash) const
+{
+  key_image_filter_header header;
+  memcpy(header.magic, KEY_IMAGE_FILTER_MAGIC, sizeof(header.magic));
+  header.version = SWAP32LE(KEY_IMAGE_FILTER_VERSION);
+  header.seed = SWAP64LE(m_seed);
+  header.capacity = SWAP64LE(m_capacity);
+  header.entries = SWAP64LE(entries());
+  header.num_blocks = SWAP64LE(m_num_blocks);
+  header.height = SWAP64LE(height);
+  header.top_hash = top_hash;
+
+  std::string data;
+  data.reserve(sizeof(header) + memory_size() + sizeof(crypto::hash));
+  data.append((const char*)&header, sizeof(header));
+  for (uint64_t n = 0; n < m_num_blocks; ++n)
+  {
+    for (size_t i = 0; i < WORDS_PER_BLOCK; ++i)
+    {
+      const uint64_t word = SWAP64LE(m_blocks[n].words[i].load(std::memory_order_relaxed));
+      data.append((const char*)&word, sizeof(word));
+    }
+  }
+  crypto::hash checksum;
+  crypto::cn_fast_hash(data.data(), data.size(), checksum);
+  data.append((const char*)&checksum, sizeof(checksum));
+
+  // write to a temporary file first, so a crash never leaves a half written filter behind
+  boost::system::error_code ec;
+  const std::string tmp_filename = boost::filesystem::unique_path(filename + ".%%%%-%%%%.tmp", ec).string();
+  if (ec || !epee::file_io_utils::save_string_to_file(tmp_filename, data))
+  {
+    MERROR("Failed to write key image filter to " << tmp_filename);
+    return false;
+  }
+  boost::filesystem::rename(tmp_filename, filename, ec);
+  if (ec)
+  {
+    MERROR("Failed to rename " << tmp_filename << " to " << filename << ": " << ec.message());
+    boost::filesystem::remove(tmp_filename, ec);
+    return false;
+  }
+  MINFO("Saved key image filter with " << entries() << " entries to " << filename);
+  return true;
+}
+
+std::unique_ptr<key_image_filter> key_image_filter::load(const std::string &filename, uint64_t height, const crypto::hash &top_hash)
+{
+  boost::system::error_code ec;
+  if (!boost::filesystem::exists(filename, ec))
+    return nullptr;
+
+  std::string data;
+  if (!epee::file_io_utils::load_file_to_string(filename, data))
+  {
+    MERROR("Failed to read key image filter from " << filename);
+    return nullptr;
+  }
+  key_image_filter_header header;
+  if (data.size() < sizeof(header) + sizeof(crypto::hash))
+  {
+    MERROR("Key image filter " << filename << " is truncated");
+    return nullptr;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  header.version = SWAP32LE(header.version);
+  header.seed = SWAP64LE(header.seed);
+  header.capacity = SWAP64LE(header.capacity);
+  header.entries = SWAP64LE(header.entries);
+  header.num_blocks = SWAP64LE(header.num_blocks);
+  header.height = SWAP64LE(header.height);
+  if (memcmp(header.magic, KEY_IMAGE_FILTER_MAGIC, sizeof(header.magic)) || header.version != KEY_IMAGE_FILTER_VERSION
+      || header.num_blocks == 0 || header.num_blocks > (data.size() - sizeof(header)) / sizeof(block)
+      || header.capacity > header.num_blocks * WORDS_PER_BLOCK * 64 / BITS_PER_ENTRY
+      || data.size() != sizeof(header) + header.num_blocks * sizeof(block) + sizeof(crypto::hash))
+  {
+    MERROR("Key image filter " << filename << " has an unknown format");
+    return nullptr;
+  }
+  if (header.height != height || header.top_hash != top_hash)
+  {
+    MINFO("Key image filter " << filename << " was saved at height " << header.height << ", not " << height << ", ignoring it");
+    return nullptr;
+  }
+  const size_t checksum_offset = data.size() - sizeof(crypto::hash);
+  crypto::hash checksum;
+  crypto::cn_fast_hash(data.data(), checksum_offset, checksum);
+  if (memcmp(&checksum, data.data() + checksum_offset, sizeof(checksum)))
+  {
+    MERROR("Key image filter " << filename << " is corrupt");
+    return nullptr;
+  }
+
+  std::unique_ptr<key_image_filter> filter(new key_image_filter(header.capacity, header.seed));
+  if (filter->m_num_blocks != header.num_blocks)
+  {
+    MERROR("Key image filter " << filename << " has an unknown format");
+    return nullptr;
+  }
+  const char *ptr = data.data() + sizeof(header);
+  for (uint64_t n = 0; n < filter->m_num_blocks; ++n)
+  {
+    for (size_t i = 0; i < WORDS_PER_BLOCK; ++i, ptr += sizeof(uint64_t))
+    {
+      uint64_t word;
+      memcpy(&word, ptr, sizeof(word));
+      filter->m_blocks[n].words[i].store(SWAP64LE(word), std::memory_order_relaxed);
+    }
+  }
+  filter->m_entries.store(header.entries, std::memory_order_relaxed);
+  MINFO("Loaded key image filter with " << header.entries << " entries from " << filename);
+  return filter;
+}
+
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief an in-memory Bloom filter over the spent key images
+   *
+   * A split block Bloom filter: each key image sets one bit in each of the
+   * eight words of a single 64 byte block, so a lookup only touches that block.
+   * It answers either "not spent" for sure or "maybe spent", in which case the
+   * database has to be asked.
+   *
+   * Inserts and lookups may run concurrently. There is no removal, a key image
+   * which is popped off the chain just stays in as a false positive until the
+   * filter is rebuilt.
+   */
+  class key_image_filter
+  {
+  public:
+    /**
+     * @param capacity the number of key images the filter is sized for
+     * @param seed mixed into the bit selection, so the layout differs between instances
+     */
+    key_image_filter(uint64_t capacity, uint64_t seed);
+
+    void insert(const crypto::key_image &ki);
+    bool may_contain(const crypto::key_image &ki) const;
+
+    uint64_t capacity() const { return m_capacity; }
+    uint64_t entries() const { return m_entries.load(std::memory_order_relaxed); }
+    uint64_t memory_size() const { return m_num_blocks * sizeof(block); }
+
+    /**
+     * @brief saves the filter along with the chain state it matches
+     *
+     * @return false if the file could not be written
+     */
+    bool store(const std::string &filename, uint64_t height, const crypto::hash &top_hash) const;
+
+    /**
+     * @brief loads a filter saved by store
+     *
+     * @return the filter, or null if the file is missing, corrupt, or saved for another height or top block
+     */
+    static std::unique_ptr<key_image_filter> load(const std::string &filename, uint64_t height, const crypto::hash &top_hash);
+
+  private:
+    static constexpr const size_t WORDS_PER_BLOCK = 8;
+    static constexpr const uint64_t BITS_PER_ENTRY = 12;
+    struct block { std::atomic<uint64_t> words[WORDS_PER_BLOCK]; };
+
+    const block &get_block(const crypto::key_image &ki, uint64_t &bits) const;
+
+    uint64_t m_capacity;
+    uint64_t m_seed;
+    uint64_t m_num_blocks;
+    std::unique_ptr<block[]> m_blocks;
+    std::atomic<uint64_t> m_entries;
+  };
+}
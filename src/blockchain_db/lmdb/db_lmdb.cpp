@@ -30,10 +30,18 @@
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 #include <boost/circular_buffer.hpp>
+#include <boost/thread/barrier.hpp>
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "string_tools.h"
+#include "misc_language.h"
 #include "file_io_utils.h"
 #include "common/util.h"
 #include "common/pruning.h"
@@ -132,6 +140,59 @@ private:
   std::unique_ptr<char[]> data;
 };
 
+// compact_copy has lmdb write the copy into a pipe, which it drains into the file.
+// Closing the read end makes the copy fail at its next write, ending its read txn,
+// which closing the file under lmdb could not do safely
+class copy_pipe
+{
+public:
+  copy_pipe()
+  {
+#ifdef _WIN32
+    if (!CreatePipe(&m_read, &m_write, NULL, 1 << 20))
+      throw0(cryptonote::DB_ERROR("Failed to create a pipe for the compacted copy"));
+#else
+    int fds[2];
+    if (pipe(fds))
+      throw0(cryptonote::DB_ERROR("Failed to create a pipe for the compacted copy"));
+    m_read = fds[0];
+    m_write = fds[1];
+#endif
+  }
+  ~copy_pipe() { close_read(); close_write(); }
+
+  mdb_filehandle_t write_handle() const { return m_write; }
+
+  // bytes read, 0 once the write end is closed and drained, or -1 on error
+  int64_t read(char *buf, size_t size)
+  {
+#ifdef _WIN32
+    DWORD len;
+    if (!ReadFile(m_read, buf, size, &len, NULL))
+      return GetLastError() == ERROR_BROKEN_PIPE ? 0 : -1;
+    return len;
+#else
+    ssize_t len;
+    do
+      len = ::read(m_read, buf, size);
+    while (len < 0 && errno == EINTR);
+    return len;
+#endif
+  }
+
+  void close_read() { close(m_read); }
+  void close_write() { close(m_write); }
+
+private:
+#ifdef _WIN32
+  static void close(HANDLE &h) { if (h != INVALID_HANDLE_VALUE) CloseHandle(h); h = INVALID_HANDLE_VALUE; }
+  HANDLE m_read, m_write;
+#else
+  static void close(int &fd) { if (fd >= 0) ::close(fd); fd = -1; }
+  int m_read, m_write;
+#endif
+};
+
 }
 
 namespace cryptonote
@@ -196,6 +257,7 @@ namespace
  *
  * output_txs       output ID    {txn hash, local index}
  * output_amounts   amount       [{amount output index, metadata}...]
+ * rct_outputs      amount 0 output index  {metadata}
  *
  * spent_keys       input hash   -
  *
@@ -211,6 +273,16 @@ namespace
  * (DUPFIXED saves 8 bytes per record.)
  *
  * The output_amounts table doesn't use a dummy key, but uses DUPSORT.
+ *
+ * rct_outputs is optional (DBF_RCT_OUTPUT_INDEX): it duplicates the amount 0
+ * entries of output_amounts in a plain integer keyed table, which is appended
+ * to in order and so packs densely, making ring member lookups cheaper than
+ * searching the amount 0 duplicates.
+ *
+ * blocks and txs_prunable may be compressed (DBF_COMPRESS), each with a
+ * zstd dictionary trained on its own rows. Their codec, dictionary, and how
+ * far the rows written before compression was enabled have been converted
+ * are kept in properties.
  */
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
@@ -226,6 +298,7 @@ const char* const LMDB_TX_OUTPUTS = "tx_outputs";
 
 const char* const LMDB_OUTPUT_TXS = "output_txs";
 const char* const LMDB_OUTPUT_AMOUNTS = "output_amounts";
+const char* const LMDB_RCT_OUTPUTS = "rct_outputs";
 const char* const LMDB_SPENT_KEYS = "spent_keys";
 
 const char* const LMDB_TXPOOL_META = "txpool_meta";
@@ -238,6 +311,20 @@ const char* const LMDB_HF_VERSIONS = "hf_versions";
 
 const char* const LMDB_PROPERTIES = "properties";
 
+const char* const compressed_table_names[] = { LMDB_BLOCKS, LMDB_TXS_PRUNABLE };
+const char* const compression_info_keys[] = { "compression_blocks", "compression_txs_prunable" };
+const char* const compression_dict_keys[] = { "compression_dict_blocks", "compression_dict_txs_prunable" };
+
+constexpr int32_t COMPRESSION_LEVEL = 3;
+constexpr size_t COMPRESSION_DICTIONARY_SIZE = 112640;
+constexpr size_t COMPRESSION_DICTIONARY_SAMPLES = 4096;
+constexpr size_t COMPRESSION_BATCH_BYTES = 64 * 1024 * 1024;
+constexpr uint64_t COMPACT_MAP_HEADROOM = 1ull << 30; // growth compact_copy makes room for below RESIZE_PERCENT, a resize aborts the copy
+constexpr unsigned int COMPACT_RESIZE_TRIES = 600; // times compact_copy waits 100 ms for a write txn to end before making that room
+// resize_ahead keeps at least this much of the map free, or this many seconds of growth at the recent rate
+constexpr uint64_t RESIZE_AHEAD_MIN_HEADROOM = 1ull << 30;
+constexpr uint64_t RESIZE_AHEAD_SECONDS = 15 * 60;
+
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
@@ -351,8 +438,15 @@ typedef struct outtx {
     uint64_t local_index;
 } outtx;
 
+typedef struct table_compression_info {
+    uint32_t codec;
+    int32_t level;
+    uint64_t compressed_below;
+} table_compression_info;
+
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
+thread_local unsigned mdb_txn_safe::creation_gate_depth = 0;
 
 mdb_threadinfo::~mdb_threadinfo()
 {
@@ -369,6 +463,11 @@ mdb_txn_safe::mdb_txn_safe(const bool check) : m_txn(NULL), m_tinfo(NULL), m_che
 {
   if (check)
   {
+    if (creation_gate_depth)
+    {
+      num_active_txns++;
+      return;
+    }
     while (creation_gate.test_and_set());
     num_active_txns++;
     creation_gate.clear();
@@ -447,7 +546,8 @@ uint64_t mdb_txn_safe::num_active_tx() const
 
 void mdb_txn_safe::prevent_new_txns()
 {
-  while (creation_gate.test_and_set());
+  if (creation_gate_depth++ == 0)
+    while (creation_gate.test_and_set());
 }
 
 void mdb_txn_safe::wait_no_active_txns()
@@ -457,7 +557,8 @@ void mdb_txn_safe::wait_no_active_txns()
 
 void mdb_txn_safe::allow_new_txns()
 {
-  creation_gate.clear();
+  if (--creation_gate_depth == 0)
+    creation_gate.clear();
 }
 
 void mdb_txn_safe::increment_txns(int i)
@@ -542,7 +643,8 @@ inline int lmdb_txn_renew(MDB_txn *txn)
 
 inline void BlockchainLMDB::check_open() const
 {
-  if (!m_open)
+  // while compact_finish reopens the db, callers wait at the txn gate instead
+  if (!m_open && !m_compact_swapping)
     throw0(DB_ERROR("DB operation attempted on a not-open DB instance"));
 }
 
@@ -589,7 +691,23 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
 
   new_mapsize += (new_mapsize % mst.ms_psize);
 
-  mdb_txn_safe::prevent_new_txns();
+  TIME_MEASURE_START(stall);
+  // the gate would hold every reader off till the compacted copy's read txn ends,
+  // hours on a big db, so the copy is aborted, which ends its txn within a write
+  while (1)
+  {
+    if (m_compact_copying)
+    {
+      MGINFO("Aborting the compacted copy of the db to resize it");
+      m_compact_abort = true;
+      while (m_compact_copying)
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+    }
+    mdb_txn_safe::prevent_new_txns();
+    if (!m_compact_copying)
+      break;
+    mdb_txn_safe::allow_new_txns();
+  }
 
   if (m_write_txn != nullptr)
   {
@@ -609,9 +727,16 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to set new mapsize: ", result).c_str()));
 
-  MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
-
   mdb_txn_safe::allow_new_txns();
+  TIME_MEASURE_FINISH(stall);
+
+  ++m_resizes;
+  m_resize_stall_ms += stall;
+  if (stall > m_resize_max_stall_ms)
+    m_resize_max_stall_ms = stall;
+
+  MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB"
+      << ", txns held off for " << stall << " ms");
 }
 
 // threshold_size is used for batch transactions
@@ -662,6 +787,75 @@ bool BlockchainLMDB::need_resize(uint64_t threshold_size) const
 #endif
 }
 
+void BlockchainLMDB::get_map_usage(uint64_t &map_size, uint64_t &size_used) const
+{
+  MDB_envinfo mei;
+  mdb_env_info(m_env, &mei);
+  MDB_stat mst;
+  mdb_env_stat(m_env, &mst);
+  map_size = mei.me_mapsize;
+  size_used = mst.ms_psize * mei.me_last_pgno;
+}
+
+bool BlockchainLMDB::resize_ahead()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+#if defined(ENABLE_AUTO_RESIZE)
+  if (is_read_only())
+    return false;
+  if (m_write_txn)
+    throw0(DB_ERROR("resize_ahead called with a write txn in progress"));
+  // the caller holds the blockchain locks, which must not wait on a compaction's copy
+  if (m_compacting)
+    return false;
+
+  uint64_t map_size, size_used;
+  get_map_usage(map_size, size_used);
+
+  // smooth the rate over a few samples, so one burst does not grow the map a lot
+  const uint64_t now = epee::misc_utils::get_tick_count();
+  if (m_growth_sample_time && now > m_growth_sample_time)
+  {
+    const uint64_t rate = size_used > m_growth_sample_size_used ? (size_used - m_growth_sample_size_used) * 1000 / (now - m_growth_sample_time) : 0;
+    m_growth_rate = m_growth_rate ? (m_growth_rate + rate) / 2 : rate;
+  }
+  m_growth_sample_time = now;
+  m_growth_sample_size_used = size_used;
+
+  // grow to twice the headroom, so at a steady rate this runs once per RESIZE_AHEAD_SECONDS
+  const uint64_t headroom = std::max<uint64_t>(RESIZE_AHEAD_MIN_HEADROOM, m_growth_rate * RESIZE_AHEAD_SECONDS);
+  const uint64_t free_size = map_size - size_used;
+  if (free_size >= headroom)
+    return false;
+
+  MINFO("Growing LMDB map ahead of need: " << free_size / (1024 * 1024) << " MiB free, growing by " << m_growth_rate / 1024 << " kiB/s");
+  const uint64_t resizes = m_resizes;
+  do_resize(2 * headroom - free_size);
+  if (m_resizes == resizes)
+    return false;
+  ++m_resizes_ahead;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool BlockchainLMDB::get_resize_stats(db_resize_stats &stats) const
+{
+#if defined(ENABLE_AUTO_RESIZE)
+  get_map_usage(stats.map_size, stats.size_used);
+  stats.growth_rate = m_growth_rate;
+  stats.resizes = m_resizes;
+  stats.resizes_ahead = m_resizes_ahead;
+  stats.stall_ms = m_resize_stall_ms;
+  stats.max_stall_ms = m_resize_max_stall_ms;
+  return true;
+#else
+  return false;
+#endif
+}
+
 void BlockchainLMDB::check_and_resize_for_batch(uint64_t batch_num_blocks, uint64_t batch_bytes)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -765,6 +959,15 @@ estim:
   if (batch_fudge_factor < 5000.0)
     batch_fudge_factor = 5000.0;
   threshold_size = avg_block_size * db_expand_factor * batch_fudge_factor;
+
+  // block weights say little about how much the db grows per block, eg with
+  // many outputs per tx, so also go by what recent batches actually took
+  const uint64_t observed_size = m_batch_growth_per_block * batch_safety_factor * batch_num_blocks;
+  if (observed_size > threshold_size)
+  {
+    MDEBUG("recent batches grew the db by " << (uint64_t)m_batch_growth_per_block << " bytes per block, using " << observed_size << " instead of estimate " << threshold_size);
+    threshold_size = observed_size;
+  }
   return threshold_size;
 }
 
@@ -806,7 +1009,9 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
 
   // this call to mdb_cursor_put will change height()
   cryptonote::blobdata block_blob(block_to_blob(blk));
-  MDB_val_sized(blob, block_blob);
+  MDB_val_sized(raw_blob, block_blob);
+  std::string compressed_blob;
+  MDB_val blob = encode_blob(COMPRESSED_BLOCKS, m_height, raw_blob, compressed_blob);
   result = mdb_cursor_put(m_cur_blocks, &key, &blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block blob to db transaction: ", result).c_str()));
@@ -944,7 +1149,8 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
 
-  MDB_val prunable_blob = {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)};
+  std::string compressed_blob;
+  MDB_val prunable_blob = encode_blob(COMPRESSED_TXS_PRUNABLE, tx_id, {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)}, compressed_blob);
   result = mdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add prunable tx blob to db transaction: ", result).c_str()));
@@ -1110,6 +1316,15 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   if ((result = mdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
       throw0(DB_ERROR(lmdb_error("Failed to add output pubkey to db transaction: ", result).c_str()));
 
+  if (tx_output.amount == 0 && m_rct_output_index)
+  {
+    CURSOR(rct_outputs)
+    MDB_val_set(k, ok.amount_index);
+    MDB_val_set(v, ok.data);
+    if ((result = mdb_cursor_put(m_cur_rct_outputs, &k, &v, MDB_APPEND)))
+      throw0(DB_ERROR(lmdb_error("Failed to add rct output to db transaction: ", result).c_str()));
+  }
+
   return ok.amount_index;
 }
 
@@ -1195,6 +1410,19 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   result = mdb_cursor_del(m_cur_output_amounts, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting amount for output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
+
+  // rct_outputs may still be being built, in which case it only holds a prefix
+  // of the outputs, which must stay consistent too
+  if (amount == 0 && m_rct_outputs != 0)
+  {
+    CURSOR(rct_outputs)
+    MDB_val_set(kr, out_index);
+    result = mdb_cursor_get(m_cur_rct_outputs, &kr, NULL, MDB_SET);
+    if (result == 0)
+      result = mdb_cursor_del(m_cur_rct_outputs, 0);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error(std::string("Error deleting rct output ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
+  }
 }
 
 void BlockchainLMDB::prune_outputs(uint64_t amount)
@@ -1266,6 +1494,17 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
     else
       throw1(DB_ERROR(lmdb_error("Error adding spent key image to db transaction: ", result).c_str()));
   }
+
+  // bits set for a txn which is later aborted only make for false positives
+  if (m_key_image_filter)
+  {
+    m_key_image_filter->insert(k_image);
+    if (m_key_image_filter->entries() > m_key_image_filter->capacity())
+    {
+      MINFO("Key image filter is full, rebuilding it with room for twice as many key images");
+      std::atomic_store(&m_key_image_filter, make_key_image_filter(*m_write_txn, m_key_image_filter->entries() * 2));
+    }
+  }
 }
 
 void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
@@ -1313,8 +1552,31 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_write_txn = nullptr;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_rct_output_index = false;
+  m_key_image_filter_lookups = 0;
+  m_key_image_filter_negatives = 0;
+  m_key_image_filter_false_positives = 0;
+  for (table_compression &tc: m_compression)
+    tc.compressed_below = 0;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_batch_growth_per_block = 0;
+  m_batch_start_size_used = 0;
+  m_batch_start_height = 0;
+  m_growth_sample_time = 0;
+  m_growth_sample_size_used = 0;
+  m_growth_rate = 0;
+  m_resizes = 0;
+  m_resizes_ahead = 0;
+  m_resize_stall_ms = 0;
+  m_resize_max_stall_ms = 0;
+  m_db_flags = 0;
+  m_env_generation = 0;
+  m_compact_swapping = false;
+  m_compacting = false;
+  m_compact_copying = false;
+  m_compact_abort = false;
+  m_txpool_mem_dirty = false;
 
   // reset may also need changing when initialize things here
 
@@ -1355,6 +1617,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   }
 
   m_folder = filename;
+  m_db_flags = db_flags;
+  ++m_env_generation;
 
 #ifdef __OpenBSD__
   if ((mdb_flags & MDB_WRITEMAP) == 0) {
@@ -1475,6 +1739,53 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
       throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_starting_heights: ", result).c_str()));
   }
 
+  // rct_outputs is kept in sync only by writers which asked for it: others drop it,
+  // since they would let it go stale, and readers only use it if it is complete
+  bool build_rct_outputs = false;
+  m_rct_outputs = 0;
+  m_rct_output_index = false;
+  if ((db_flags & DBF_RCT_OUTPUT_INDEX) && !(mdb_flags & MDB_RDONLY))
+  {
+    lmdb_db_open(txn, LMDB_RCT_OUTPUTS, MDB_INTEGERKEY | MDB_CREATE, m_rct_outputs, "Failed to open db handle for m_rct_outputs");
+    build_rct_outputs = true;
+  }
+  else if ((result = mdb_dbi_open(txn, LMDB_RCT_OUTPUTS, MDB_INTEGERKEY, &m_rct_outputs)) == 0)
+  {
+    if (mdb_flags & MDB_RDONLY)
+    {
+      MDB_stat rct_stats;
+      if ((result = mdb_stat(txn, m_rct_outputs, &rct_stats)))
+        throw0(DB_ERROR(lmdb_error("Failed to query m_rct_outputs: ", result).c_str()));
+      MDB_cursor *c_amounts;
+      if ((result = mdb_cursor_open(txn, m_output_amounts, &c_amounts)))
+        throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+      const uint64_t amount = 0;
+      MDB_val_set(k, amount);
+      MDB_val v;
+      mdb_size_t num_rct_outputs = 0;
+      if (mdb_cursor_get(c_amounts, &k, &v, MDB_SET) == 0)
+        mdb_cursor_count(c_amounts, &num_rct_outputs);
+      mdb_cursor_close(c_amounts);
+      m_rct_output_index = rct_stats.ms_entries == num_rct_outputs;
+      if (!m_rct_output_index)
+        m_rct_outputs = 0;
+    }
+    else
+    {
+      MINFO("Dropping rct output index");
+      if ((result = mdb_drop(txn, m_rct_outputs, 1)))
+        throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_outputs: ", result).c_str()));
+      m_rct_outputs = 0;
+    }
+  }
+  else if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to open db handle for m_rct_outputs: ", result).c_str()));
+  else
+    m_rct_outputs = 0;
+
+  // a compressed table cannot be read, nor written to, without its codec
+  load_table_compression(txn);
+
   // get and keep current height
   MDB_stat db_stats;
   if ((result = mdb_stat(txn, m_blocks, &db_stats)))
@@ -1559,6 +1870,26 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   txn.commit();
 
   m_open = true;
+
+  if (db_flags & DBF_COMPRESS)
+  {
+    if (mdb_flags & MDB_RDONLY)
+      MWARNING("Database is read only, not compressing it");
+    else if (!blob_codec::is_supported(blob_codec::zstd))
+      MWARNING("This build does not support compression, not compressing the database");
+    else
+    {
+      compress_table(COMPRESSED_BLOCKS);
+      compress_table(COMPRESSED_TXS_PRUNABLE);
+    }
+  }
+
+  if (build_rct_outputs)
+    build_rct_output_index();
+  if (db_flags & DBF_KEY_IMAGE_FILTER)
+    open_key_image_filter();
+  if (db_flags & DBF_TXPOOL_IN_MEMORY)
+    load_txpool();
   // from here, init should be finished
 }
 
@@ -1570,12 +1901,68 @@ void BlockchainLMDB::close()
     LOG_PRINT_L3("close() first calling batch_abort() due to active batch transaction");
     BlockchainLMDB::batch_abort();
   }
+  if (m_txpool_mem)
+  {
+    // when swapping in a compacted copy, the pool was already copied into it
+    if (!m_compact_swapping)
+    {
+      try
+      {
+        store_txpool();
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to store the in-memory txpool: " << e.what());
+      }
+    }
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    m_txpool_mem.reset();
+    m_txpool_mem_dirty = false;
+  }
   BlockchainLMDB::sync();
+
+  db_resize_stats rs;
+  if (get_resize_stats(rs) && rs.resizes > 0)
+    MINFO("LMDB map resized " << rs.resizes << " times, " << rs.resizes_ahead << " of them ahead of need, holding off txns for "
+        << rs.stall_ms << " ms in total, " << rs.max_stall_ms << " ms at most");
+
+  key_image_filter_stats kif;
+  if (get_key_image_filter_stats(kif))
+  {
+    MINFO("Key image filter answered " << kif.negatives << "/" << kif.lookups << " lookups, with a false positive rate of "
+        << kif.false_positive_rate() * 100.0 << "%, using " << kif.memory_size / 1024 << " kB");
+    if (!is_read_only())
+    {
+      m_key_image_filter->store(get_key_image_filter_filename(), height(), top_block_hash());
+    }
+  }
+
+  if (m_compact_db)
+    discard_compact_copy();
+
   m_tinfo.reset();
 
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
   m_open = false;
+  m_rct_outputs = 0;
+  m_rct_output_index = false;
+  for (table_compression &tc: m_compression)
+  {
+    tc.codec.reset();
+    tc.compressed_below = 0;
+  }
+  std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>());
+  m_key_image_filter_lookups = 0;
+  m_key_image_filter_negatives = 0;
+  m_key_image_filter_false_positives = 0;
+  m_batch_growth_per_block = 0;
+  m_growth_sample_time = 0;
+  m_growth_rate = 0;
+  m_resizes = 0;
+  m_resizes_ahead = 0;
+  m_resize_stall_ms = 0;
+  m_resize_max_stall_ms = 0;
 }
 
 void BlockchainLMDB::sync()
@@ -1631,6 +2018,9 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_amounts, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_amounts: ", result).c_str()));
+  if (m_rct_outputs)
+    if (auto result = mdb_drop(txn, m_rct_outputs, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_outputs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_spent_keys, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_spent_keys: ", result).c_str()));
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
@@ -1645,9 +2035,22 @@ void BlockchainLMDB::reset()
   if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
     throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
 
+  // the compressed tables are empty now, so all of their rows will be compressed
+  for (int table = 0; table < NUM_COMPRESSED_TABLES; ++table)
+  {
+    if (m_compression[table].codec)
+    {
+      m_compression[table].compressed_below = std::numeric_limits<uint64_t>::max();
+      store_table_compression(txn, (compressed_table)table);
+    }
+  }
+
   txn.commit();
   m_cum_size = 0;
   m_cum_count = 0;
+
+  if (m_key_image_filter)
+    std::atomic_store(&m_key_image_filter, std::make_shared<key_image_filter>(m_key_image_filter->capacity(), crypto::rand<uint64_t>()));
 }
 
 std::vector<std::string> BlockchainLMDB::get_filenames() const
@@ -1729,10 +2132,97 @@ void BlockchainLMDB::unlock()
       auto_txn.commit(); \
   } while(0)
 
+void BlockchainLMDB::load_txpool()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  std::unique_ptr<std::unordered_map<crypto::hash, txpool_mem_tx>> txpool(new std::unordered_map<crypto::hash, txpool_mem_tx>());
+  for_all_txpool_txes([&txpool](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd) {
+    txpool->emplace(txid, txpool_mem_tx{meta, std::make_shared<const cryptonote::blobdata>(bd->data(), bd->size())});
+    return true;
+  }, true, relay_category::all);
+  MINFO("Keeping the txpool in memory, " << txpool->size() << " txes loaded");
+
+  std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+  m_txpool_mem = std::move(txpool);
+  m_txpool_mem_dirty = false;
+}
+
+bool BlockchainLMDB::store_txpool()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_txpool_mem || is_read_only())
+    return false;
+  if (m_write_txn)
+    throw0(DB_ERROR("store_txpool called with a write txn in progress"));
+
+  // the caller holds the txpool and blockchain locks, which must not wait on a
+  // compaction to resize the map: the pool stays dirty, and is stored next time
+  const bool resize = need_resize();
+  if (resize && m_compacting)
+    return false;
+
+  // blobs are shared, so copying is cheap, and the pool is not held up while writing
+  std::vector<std::pair<crypto::hash, txpool_mem_tx>> txes;
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    if (!m_txpool_mem_dirty)
+      return false;
+    txes.assign(m_txpool_mem->begin(), m_txpool_mem->end());
+    m_txpool_mem_dirty = false;
+  }
+
+  try
+  {
+    if (resize)
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    mdb_txn_safe txn;
+    if (auto result = lmdb_txn_begin(m_env, NULL, 0, txn))
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    if (auto result = mdb_drop(txn, m_txpool_meta, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_txpool_meta: ", result).c_str()));
+    if (auto result = mdb_drop(txn, m_txpool_blob, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_txpool_blob: ", result).c_str()));
+    for (const auto &e: txes)
+    {
+      MDB_val k = {sizeof(e.first), (void *)&e.first};
+      MDB_val v = {sizeof(e.second.meta), (void *)&e.second.meta};
+      if (auto result = mdb_put(txn, m_txpool_meta, &k, &v, 0))
+        throw0(DB_ERROR(lmdb_error("Error adding txpool tx metadata to db transaction: ", result).c_str()));
+      MDB_val b = {e.second.blob->size(), (void *)e.second.blob->data()};
+      if (auto result = mdb_put(txn, m_txpool_blob, &k, &b, 0))
+        throw0(DB_ERROR(lmdb_error("Error adding txpool tx blob to db transaction: ", result).c_str()));
+    }
+    txn.commit();
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    m_txpool_mem_dirty = true;
+    throw;
+  }
+  MDEBUG("Stored the in-memory txpool, " << txes.size() << " txes");
+  return true;
+}
+
 void BlockchainLMDB::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata_ref &blob, const txpool_tx_meta_t &meta)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
+
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    if (!m_txpool_mem->emplace(txid, txpool_mem_tx{meta, std::make_shared<const cryptonote::blobdata>(blob.data(), blob.size())}).second)
+      throw1(DB_ERROR("Attempting to add txpool tx metadata that's already in the db"));
+    m_txpool_mem_dirty = true;
+    return;
+  }
+
   mdb_txn_cursors *m_cursors = &m_wcursors;
 
   CURSOR(txpool_meta)
@@ -1759,6 +2249,18 @@ void BlockchainLMDB::update_txpool_tx(const crypto::hash &txid, const txpool_tx_
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
+
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    const auto it = m_txpool_mem->find(txid);
+    if (it == m_txpool_mem->end())
+      throw1(DB_ERROR("Error finding txpool tx meta to update"));
+    it->second.meta = meta;
+    m_txpool_mem_dirty = true;
+    return;
+  }
+
   mdb_txn_cursors *m_cursors = &m_wcursors;
 
   CURSOR(txpool_meta)
@@ -1786,6 +2288,17 @@ uint64_t BlockchainLMDB::get_txpool_tx_count(relay_category category) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    if (category == relay_category::all)
+      return m_txpool_mem->size();
+    return std::count_if(m_txpool_mem->begin(), m_txpool_mem->end(), [category](const std::pair<const crypto::hash, txpool_mem_tx> &e) {
+      return e.second.meta.matches(category);
+    });
+  }
+
+
   int result;
   uint64_t num_entries = 0;
 
@@ -1831,6 +2344,14 @@ bool BlockchainLMDB::txpool_has_tx(const crypto::hash& txid, relay_category tx_c
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    const auto it = m_txpool_mem->find(txid);
+    return it != m_txpool_mem->end() && (tx_category == relay_category::all || it->second.meta.matches(tx_category));
+  }
+
+
   TXN_PREFIX_RDONLY();
   RCURSOR(txpool_meta)
 
@@ -1856,6 +2377,15 @@ void BlockchainLMDB::remove_txpool_tx(const crypto::hash& txid)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
+
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    if (m_txpool_mem->erase(txid))
+      m_txpool_mem_dirty = true;
+    return;
+  }
+
   mdb_txn_cursors *m_cursors = &m_wcursors;
 
   CURSOR(txpool_meta)
@@ -1887,6 +2417,17 @@ bool BlockchainLMDB::get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    const auto it = m_txpool_mem->find(txid);
+    if (it == m_txpool_mem->end())
+      return false;
+    meta = it->second.meta;
+    return true;
+  }
+
+
   TXN_PREFIX_RDONLY();
   RCURSOR(txpool_meta)
 
@@ -1908,6 +2449,17 @@ bool BlockchainLMDB::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::bl
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_txpool_mem)
+  {
+    std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+    const auto it = m_txpool_mem->find(txid);
+    if (it == m_txpool_mem->end() || (tx_category != relay_category::all && !it->second.meta.matches(tx_category)))
+      return false;
+    bd = *it->second.blob;
+    return true;
+  }
+
+
   TXN_PREFIX_RDONLY();
   RCURSOR(txpool_blob)
 
@@ -1983,7 +2535,7 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
 
 enum { prune_mode_prune, prune_mode_update, prune_mode_check };
 
-bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
+bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed, size_t max_txes, uint64_t *pruned_bytes)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   const uint32_t log_stripes = tools::get_pruning_log_stripes(pruning_seed);
@@ -2013,6 +2565,10 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
   MDB_val v;
   result = mdb_get(txn, m_properties, &k, &v);
   bool prune_tip_table = false;
+  // the full pass over tx_indices saves the next tx hash it is to look at, so it can resume
+  MDB_val_str(k_progress, "pruning_progress");
+  crypto::hash progress = crypto::null_hash;
+  bool resume = false;
   if (result == MDB_NOTFOUND)
   {
     // not pruned yet
@@ -2032,6 +2588,10 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     if (result)
       throw0(DB_ERROR("Failed to save pruning seed"));
     prune_tip_table = false;
+    MDB_val_set(v_progress, progress);
+    result = mdb_put(txn, m_properties, &k_progress, &v_progress, 0);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
   }
   else if (result == 0)
   {
@@ -2047,6 +2607,20 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       throw0(DB_ERROR("Blockchain already pruned with different base"));
     pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
     prune_tip_table = (mode == prune_mode_update);
+    if (mode == prune_mode_prune)
+    {
+      MDB_val v_progress;
+      result = mdb_get(txn, m_properties, &k_progress, &v_progress);
+      if (result == 0)
+      {
+        if (v_progress.mv_size != sizeof(progress))
+          throw0(DB_ERROR("Failed to retrieve pruning progress: unexpected value size"));
+        memcpy(&progress, v_progress.mv_data, sizeof(progress));
+        resume = true;
+      }
+      else if (result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning progress: ", result).c_str()));
+    }
   }
   else
   {
@@ -2055,6 +2629,8 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
 
   if (mode == prune_mode_check)
     MINFO("Checking blockchain pruning...");
+  else if (resume)
+    MDEBUG("Resuming blockchain pruning from tx " << progress);
   else
     MINFO("Pruning blockchain...");
 
@@ -2069,6 +2645,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_tip: ", result).c_str()));
   const uint64_t blockchain_height = height();
+  bool complete = true;
 
   if (prune_tip_table)
   {
@@ -2138,6 +2715,13 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
     MDB_cursor_op op = MDB_FIRST;
+    if (resume)
+    {
+      // the tx it stopped at may have been popped since, in which case we carry on from the next one
+      k = zerokval;
+      v = {sizeof(progress), (void*)&progress};
+      op = MDB_GET_BOTH_RANGE;
+    }
     while (1)
     {
       int ret = mdb_cursor_get(c_tx_indices, &k, &v, op);
@@ -2147,6 +2731,13 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
 
+      if (max_txes && n_total_records >= max_txes && mode == prune_mode_prune)
+      {
+        memcpy(&progress, v.mv_data, sizeof(progress));
+        complete = false;
+        break;
+      }
+
       ++n_total_records;
       //const txindex *ti = (const txindex *)v.mv_data;
       txindex ti;
@@ -2218,6 +2809,14 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       if (mode != prune_mode_check && commit_counter >= 4096)
       {
         MDEBUG("Committing txn at checkpoint...");
+        if (mode == prune_mode_prune)
+        {
+          // this tx is done already, but going through it again is harmless
+          MDB_val_set(v_progress, ti.key);
+          result = mdb_put(txn, m_properties, &k_progress, &v_progress, 0);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+        }
         txn.commit();
         result = mdb_txn_begin(m_env, NULL, 0, txn);
         if (result)
@@ -2244,6 +2843,19 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       }
     }
     mdb_cursor_close(c_tx_indices);
+
+    if (mode == prune_mode_prune)
+    {
+      if (complete)
+        result = mdb_del(txn, m_properties, &k_progress, NULL);
+      else
+      {
+        MDB_val_set(v_progress, progress);
+        result = mdb_put(txn, m_properties, &k_progress, &v_progress, 0);
+      }
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+    }
   }
 
   if ((result = mdb_stat(txn, m_txs_prunable, &db_stats)))
@@ -2259,11 +2871,18 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
 
   TIME_MEASURE_FINISH(t);
 
-  MINFO((mode == prune_mode_check ? "Checked" : "Pruned") << " blockchain in " <<
+  if (pruned_bytes)
+    *pruned_bytes = n_bytes;
+  std::stringstream ss;
+  ss << (mode == prune_mode_check ? "Checked" : "Pruned") << (complete ? " blockchain in " : " part of the blockchain in ") <<
       t << " ms: " << (n_bytes/1024.0f/1024.0f) << " MB (" << db_bytes/1024.0f/1024.0f << " MB) pruned in " <<
       n_pruned_records << " records (" << pages0 - pages1 << "/" << pages0 << " " << db_stats.ms_psize << " byte pages), " <<
-      n_prunable_records << "/" << n_total_records << " pruned records");
-  return true;
+      n_prunable_records << "/" << n_total_records << " pruned records";
+  if (complete)
+    MINFO(ss.str());
+  else
+    MDEBUG(ss.str());
+  return complete;
 }
 
 bool BlockchainLMDB::prune_blockchain(uint32_t pruning_seed)
@@ -2271,6 +2890,29 @@ bool BlockchainLMDB::prune_blockchain(uint32_t pruning_seed)
   return prune_worker(prune_mode_prune, pruning_seed);
 }
 
+bool BlockchainLMDB::prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, uint64_t &pruned_bytes)
+{
+  return prune_worker(prune_mode_prune, pruning_seed, max_txes, &pruned_bytes);
+}
+
+bool BlockchainLMDB::is_pruning_in_progress() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(properties)
+  MDB_val_str(k, "pruning_progress");
+  MDB_val v;
+  int result = mdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning progress: ", result).c_str()));
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
 bool BlockchainLMDB::update_pruning()
 {
   return prune_worker(prune_mode_update, 0);
@@ -2281,10 +2923,337 @@ bool BlockchainLMDB::check_pruning()
   return prune_worker(prune_mode_check, 0);
 }
 
-bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category category) const
+std::string BlockchainLMDB::get_compact_folder() const
+{
+  boost::filesystem::path path(m_folder);
+  if (path.filename() == ".")
+    path = path.parent_path();
+  return (path.parent_path() / (path.filename().string() + ".compact")).string();
+}
+
+void BlockchainLMDB::discard_compact_copy()
+{
+  if (m_compact_db)
+  {
+    m_compact_db->close();
+    m_compact_db.reset();
+  }
+  m_compacting = false;
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(get_compact_folder(), ec);
+  if (ec)
+    MWARNING("Failed to remove " << get_compact_folder() << ": " << ec.message());
+}
+
+bool BlockchainLMDB::compact_copy()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
+  if (is_read_only())
+    throw0(DB_ERROR("Cannot compact a read only db"));
+
+  discard_compact_copy();
+  m_compacting = true;
+  const std::string folder = get_compact_folder();
+
+  try
+  {
+    boost::filesystem::create_directories(folder);
+
+    MDB_envinfo mei;
+    MDB_stat mst;
+    mdb_env_info(m_env, &mei);
+    mdb_env_stat(m_env, &mst);
+    const uint64_t used_size = (mei.me_last_pgno + 1) * mst.ms_psize;
+    const boost::filesystem::space_info si = boost::filesystem::space(folder);
+    if (si.available < used_size)
+    {
+      MERROR("Not enough free space to compact the blockchain: " << used_size / (1024 * 1024) << " MB may be needed in " << folder
+          << ", " << si.available / (1024 * 1024) << " MB are available");
+      discard_compact_copy();
+      return false;
+    }
+
+    // a resize aborts the copy, so make room for what is written meanwhile without
+    // crossing the resize threshold. A write txn in progress may need new read txns
+    // before it ends, so it cannot be waited for at the gate: retry once it is done instead
+    if (used_size + COMPACT_MAP_HEADROOM > mei.me_mapsize * RESIZE_PERCENT)
+    {
+      for (unsigned int tries = 0; ; ++tries)
+      {
+        mdb_txn_safe::prevent_new_txns();
+        if (!m_write_txn && !m_batch_active)
+          break;
+        mdb_txn_safe::allow_new_txns();
+        if (tries == COMPACT_RESIZE_TRIES)
+          throw0(DB_ERROR("Failed to make room in the db for the compaction: a write txn is in progress"));
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+      }
+      epee::misc_utils::auto_scope_leave_caller gate_opener = epee::misc_utils::create_scope_leave_handler([](){ mdb_txn_safe::allow_new_txns(); });
+      mdb_txn_safe::wait_no_active_txns();
+      mdb_env_info(m_env, &mei);
+      const uint64_t size_used = mei.me_last_pgno * mst.ms_psize;
+      uint64_t new_mapsize = (size_used + COMPACT_MAP_HEADROOM) / RESIZE_PERCENT;
+      new_mapsize += mst.ms_psize - new_mapsize % mst.ms_psize;
+      if (new_mapsize > mei.me_mapsize)
+      {
+        if (int result = mdb_env_set_mapsize(m_env, new_mapsize))
+          throw0(DB_ERROR(lmdb_error("Failed to set new mapsize: ", result).c_str()));
+        MGINFO("LMDB Mapsize increased for the compaction." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
+      }
+    }
+
+    MGINFO("Writing a compacted copy of the blockchain to " << folder << ", up to " << used_size / (1024 * 1024) << " MB");
+    std::ofstream file((boost::filesystem::path(folder) / CRYPTONOTE_BLOCKCHAINDATA_FILENAME).string(), std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw0(DB_ERROR(std::string("Failed to create the compacted copy in ").append(folder).c_str()));
+    copy_pipe pipe;
+    m_compact_abort = false;
+    // set before the copy's txn goes through the gate, so do_resize sees it once past the gate
+    m_compact_copying = true;
+    epee::misc_utils::auto_scope_leave_caller copied = epee::misc_utils::create_scope_leave_handler([this](){ m_compact_copying = false; });
+    bool complete = false;
+    boost::thread drain([this, &pipe, &file, &complete]() {
+      std::unique_ptr<char[]> buf(new char[1 << 20]);
+      while (!m_compact_abort)
+      {
+        const int64_t len = pipe.read(buf.get(), 1 << 20);
+        if (len <= 0)
+        {
+          complete = len == 0;
+          break;
+        }
+        if (!file.write(buf.get(), len))
+          break;
+      }
+      pipe.close_read();
+    });
+    int result;
+    {
+      // counted as an active txn, as the copy runs in a read txn of its own
+      mdb_txn_safe copy_txn;
+      result = mdb_env_copyfd2(m_env, pipe.write_handle(), MDB_CP_COMPACT);
+    }
+    pipe.close_write();
+    drain.join();
+    file.close();
+    if (m_compact_abort)
+    {
+      MGINFO("The db had to be resized while writing the compacted copy, aborted it");
+      discard_compact_copy();
+      return false;
+    }
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to copy the db: ", result).c_str()));
+    if (!complete || !file)
+      throw0(DB_ERROR(std::string("Failed to write the compacted copy to ").append(folder).c_str()));
+  }
+  catch (...)
+  {
+    discard_compact_copy();
+    throw;
+  }
+
+  try
+  {
+    // the copy is only written by compact_catch_up, so it needs no key image filter
+    m_compact_db.reset(new BlockchainLMDB(false));
+    m_compact_db->open(folder, m_db_flags & ~(DBF_KEY_IMAGE_FILTER | DBF_TXPOOL_IN_MEMORY));
+    compact_catch_up();
+  }
+  catch (...)
+  {
+    discard_compact_copy();
+    throw;
+  }
+  return true;
+}
+
+void BlockchainLMDB::compact_catch_up()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  BlockchainLMDB &copy = *m_compact_db;
+  uint64_t added = 0, popped = 0;
+  while (1)
+  {
+    const uint64_t copy_height = copy.height();
+    const crypto::hash copy_top = copy.top_block_hash();
+    bool pop = false;
+    std::pair<block, blobdata> bl;
+    size_t weight;
+    uint64_t long_term_weight, coins_generated;
+    difficulty_type cumulative_difficulty;
+    uint8_t hf_version;
+    std::vector<std::pair<transaction, blobdata>> txs;
+    {
+      // the read txn must end before writing to the copy, which may resize
+      db_rtxn_guard rtxn_guard(this);
+      const uint64_t blockchain_height = height();
+      if (copy_height > blockchain_height || get_block_hash_from_height(copy_height - 1) != copy_top)
+      {
+        pop = true;
+      }
+      else if (copy_height == blockchain_height)
+      {
+        break;
+      }
+      else
+      {
+        bl.second = get_block_blob_from_height(copy_height);
+        if (!parse_and_validate_block_from_blob(bl.second, bl.first))
+          throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
+        weight = get_block_weight(copy_height);
+        long_term_weight = get_block_long_term_weight(copy_height);
+        cumulative_difficulty = get_block_cumulative_difficulty(copy_height);
+        coins_generated = get_block_already_generated_coins(copy_height);
+        hf_version = get_hard_fork_version(copy_height);
+        txs.resize(bl.first.tx_hashes.size());
+        for (size_t i = 0; i < txs.size(); ++i)
+        {
+          if (!get_tx_blob(bl.first.tx_hashes[i], txs[i].second) || !parse_and_validate_tx_from_blob(txs[i].second, txs[i].first))
+            throw0(DB_ERROR(("Failed to get tx " + epee::string_tools::pod_to_hex(bl.first.tx_hashes[i]) + " from the db").c_str()));
+        }
+      }
+    }
+
+    if (pop)
+    {
+      block b;
+      std::vector<transaction> popped_txs;
+      copy.pop_block(b, popped_txs);
+      ++popped;
+      continue;
+    }
+
+    copy.block_wtxn_start();
+    try
+    {
+      copy.add_block(bl, weight, long_term_weight, cumulative_difficulty, coins_generated, txs);
+      copy.set_hard_fork_version(copy_height, hf_version);
+      copy.block_wtxn_stop();
+    }
+    catch (...)
+    {
+      copy.block_wtxn_abort();
+      throw;
+    }
+    ++added;
+  }
+  if (added || popped)
+    MINFO("Compacted copy caught up: " << popped << " blocks popped, " << added << " blocks added");
+}
+
+uint64_t BlockchainLMDB::compact_finish()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_compact_db)
+    throw0(DB_ERROR("compact_finish called without compact_copy"));
+  if (m_write_txn || m_batch_active)
+    throw0(DB_ERROR("compact_finish called with a write txn in progress"));
+
+  try
+  {
+    compact_catch_up();
+
+    // pool txes and alt blocks come and go without a trace, so copy them whole
+    std::vector<std::tuple<crypto::hash, txpool_tx_meta_t, blobdata>> pool_txes;
+    for_all_txpool_txes([&pool_txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd) {
+      pool_txes.emplace_back(txid, meta, blobdata(bd->data(), bd->size()));
+      return true;
+    }, true, relay_category::all);
+    std::vector<std::tuple<crypto::hash, alt_block_data_t, blobdata>> alt_blocks;
+    for_all_alt_blocks([&alt_blocks](const crypto::hash &blkid, const alt_block_data_t &data, const cryptonote::blobdata_ref *bd) {
+      alt_blocks.emplace_back(blkid, data, blobdata(bd->data(), bd->size()));
+      return true;
+    }, true);
+    std::vector<crypto::hash> stale_pool_txes;
+    m_compact_db->for_all_txpool_txes([&stale_pool_txes](const crypto::hash &txid, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*) {
+      stale_pool_txes.push_back(txid);
+      return true;
+    }, false, relay_category::all);
+
+    m_compact_db->drop_alt_blocks();
+    m_compact_db->block_wtxn_start();
+    try
+    {
+      for (const crypto::hash &txid: stale_pool_txes)
+        m_compact_db->remove_txpool_tx(txid);
+      for (const auto &e: pool_txes)
+        m_compact_db->add_txpool_tx(std::get<0>(e), blobdata_ref(std::get<2>(e)), std::get<1>(e));
+      for (const auto &e: alt_blocks)
+        m_compact_db->add_alt_block(std::get<0>(e), std::get<1>(e), blobdata_ref(std::get<2>(e)));
+      m_compact_db->block_wtxn_stop();
+    }
+    catch (...)
+    {
+      m_compact_db->block_wtxn_abort();
+      throw;
+    }
+    m_compact_db->close();
+    m_compact_db.reset();
+  }
+  catch (...)
+  {
+    discard_compact_copy();
+    throw;
+  }
+  m_compacting = false;
+
+  const boost::filesystem::path folder(m_folder);
+  const boost::filesystem::path compact_folder(get_compact_folder());
+  uint64_t old_size = 0, new_size = 0;
+  epee::file_io_utils::get_file_size((folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME).string(), old_size);
+  epee::file_io_utils::get_file_size((compact_folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME).string(), new_size);
+
+  // the readers which do not go through the caller's locks are held off
+  // at the gate while the files are swapped, this thread can still use txns
+  mdb_txn_safe::prevent_new_txns();
+  epee::misc_utils::auto_scope_leave_caller gate_opener = epee::misc_utils::create_scope_leave_handler([](){ mdb_txn_safe::allow_new_txns(); });
+  mdb_txn_safe::wait_no_active_txns();
+
+  const int db_flags = m_db_flags;
+  m_compact_swapping = true;
+  epee::misc_utils::auto_scope_leave_caller swapped = epee::misc_utils::create_scope_leave_handler([this](){ m_compact_swapping = false; });
+  close();
+  // the rename replaces data.mdb at once, a crash leaves either the old db or the caught up copy
+  boost::filesystem::rename(compact_folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME, folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
+  open(folder.string(), db_flags);
+
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(compact_folder, ec);
+
+  MGINFO("Blockchain compacted from " << old_size / (1024 * 1024) << " MB to " << new_size / (1024 * 1024) << " MB");
+  return old_size > new_size ? old_size - new_size : 0;
+}
+
+bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category category) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (m_txpool_mem)
+  {
+    // f may call back into the db, so it runs on a copy
+    std::vector<std::pair<crypto::hash, txpool_mem_tx>> txes;
+    {
+      std::lock_guard<std::mutex> lock(m_txpool_mem_lock);
+      txes.reserve(m_txpool_mem->size());
+      for (const auto &e: *m_txpool_mem)
+        if (e.second.meta.matches(category))
+          txes.push_back(e);
+    }
+    for (const auto &e: txes)
+    {
+      cryptonote::blobdata_ref bd;
+      if (include_blob)
+        bd = cryptonote::blobdata_ref(*e.second.blob);
+      if (!f(e.first, e.second.meta, &bd))
+        return false;
+    }
+    return true;
+  }
+
 
   TXN_PREFIX_RDONLY();
   RCURSOR(txpool_meta);
@@ -2460,13 +3429,47 @@ cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t&
     throw0(DB_ERROR("Error attempting to retrieve a block from the db"));
 
   blobdata bd;
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  const blobdata_ref blob = decode_blob(COMPRESSED_BLOCKS, height, result, bd);
+  if (blob.data() != bd.data())
+    bd.assign(blob.data(), blob.size());
 
   TXN_POSTFIX_RDONLY();
 
   return bd;
 }
 
+// Views point into the txn's pages, so they would dangle as soon as a txn
+// started just for the lookup ends: the caller has to be holding one.
+#define TXN_PREFIX_VIEW() \
+  TXN_PREFIX_RDONLY(); \
+  if (my_rtxn) \
+    throw0(DB_ERROR((std::string("A read txn must be held to get a blob view in ") + __FUNCTION__).c_str()))
+
+blobdata_ref BlockchainLMDB::get_block_blob_view_from_height(const uint64_t& height, blobdata &scratch) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_VIEW();
+  RCURSOR(blocks);
+
+  MDB_val_copy<uint64_t> key(height);
+  MDB_val result;
+  auto get_result = mdb_cursor_get(m_cur_blocks, &key, &result, MDB_SET);
+  if (get_result == MDB_NOTFOUND)
+  {
+    throw0(BLOCK_DNE(std::string("Attempt to get block from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block not in db").c_str()));
+  }
+  else if (get_result)
+    throw0(DB_ERROR("Error attempting to retrieve a block from the db"));
+
+  const blobdata_ref blob = decode_blob(COMPRESSED_BLOCKS, height, result, scratch);
+
+  TXN_POSTFIX_RDONLY();
+
+  return blob;
+}
+
 uint64_t BlockchainLMDB::get_block_timestamp(const uint64_t& height) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3048,11 +4051,13 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
 
   MDB_val_set(v, h);
   MDB_val result0, result1;
+  uint64_t tx_id = 0;
   auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     txindex *tip = (txindex *)v.mv_data;
-    MDB_val_set(val_tx_id, tip->data.tx_id);
+    tx_id = tip->data.tx_id;
+    MDB_val_set(val_tx_id, tx_id);
     get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result0, MDB_SET);
     if (get_result == 0)
     {
@@ -3064,8 +4069,10 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
+  blobdata prunable;
+  const blobdata_ref prunable_blob = decode_blob(COMPRESSED_TXS_PRUNABLE, tx_id, result1, prunable);
   bd.assign(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
-  bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
+  bd.append(prunable_blob.data(), prunable_blob.size());
 
   TXN_POSTFIX_RDONLY();
 
@@ -3102,6 +4109,36 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   return true;
 }
 
+bool BlockchainLMDB::get_pruned_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_VIEW();
+  RCURSOR(tx_indices);
+  RCURSOR(txs_pruned);
+
+  MDB_val_set(v, h);
+  MDB_val result;
+  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == 0)
+  {
+    txindex *tip = (txindex *)v.mv_data;
+    MDB_val_set(val_tx_id, tip->data.tx_id);
+    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
+  }
+  if (get_result == MDB_NOTFOUND)
+    return false;
+  else if (get_result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
+
+  tx = blobdata_ref(reinterpret_cast<const char*>(result.mv_data), result.mv_size);
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
 bool BlockchainLMDB::get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3165,6 +4202,7 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_block_cou
   MDB_val_copy<uint64_t> key(start_height);
   MDB_val v, val_tx_id;
   uint64_t tx_id = ~0;
+  cryptonote::blobdata prunable;
   for (uint64_t h = start_height; h < blockchain_height && blocks.size() < max_block_count && (size < max_size || blocks.size() < min_block_count); ++h)
   {
     MDB_cursor_op op = h == start_height ? MDB_SET : MDB_NEXT;
@@ -3177,8 +4215,10 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_block_cou
     blocks.resize(blocks.size() + 1);
     auto &current_block = blocks.back();
 
-    current_block.first.first.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
-    size += v.mv_size;
+    const blobdata_ref block_blob = decode_blob(COMPRESSED_BLOCKS, h, v, current_block.first.first);
+    if (block_blob.data() != current_block.first.first.data())
+      current_block.first.first.assign(block_blob.data(), block_blob.size());
+    size += block_blob.size();
 
     cryptonote::block b;
     if (!parse_and_validate_block_from_blob(current_block.first.first, b))
@@ -3231,7 +4271,8 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_block_cou
         result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
         if (result)
           throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
-        tx_blob.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+        const blobdata_ref prunable_blob = decode_blob(COMPRESSED_TXS_PRUNABLE, *(const uint64_t*)val_tx_id.mv_data, v, prunable);
+        tx_blob.append(prunable_blob.data(), prunable_blob.size());
       }
       current_block.second.push_back(std::make_pair(tx_hash, std::move(tx_blob)));
       size += current_block.second.back().second.size();
@@ -3257,11 +4298,13 @@ bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blo
 
   MDB_val_set(v, h);
   MDB_val result;
+  uint64_t tx_id = 0;
   auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     const txindex *tip = (const txindex *)v.mv_data;
-    MDB_val_set(val_tx_id, tip->data.tx_id);
+    tx_id = tip->data.tx_id;
+    MDB_val_set(val_tx_id, tx_id);
     get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
@@ -3269,7 +4312,41 @@ bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blo
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  const blobdata_ref blob = decode_blob(COMPRESSED_TXS_PRUNABLE, tx_id, result, bd);
+  if (blob.data() != bd.data())
+    bd.assign(blob.data(), blob.size());
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
+bool BlockchainLMDB::get_prunable_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx, cryptonote::blobdata &scratch) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_VIEW();
+  RCURSOR(tx_indices);
+  RCURSOR(txs_prunable);
+
+  MDB_val_set(v, h);
+  MDB_val result;
+  uint64_t tx_id = 0;
+  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == 0)
+  {
+    const txindex *tip = (const txindex *)v.mv_data;
+    tx_id = tip->data.tx_id;
+    MDB_val_set(val_tx_id, tx_id);
+    get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
+  }
+  if (get_result == MDB_NOTFOUND)
+    return false;
+  else if (get_result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
+
+  tx = decode_blob(COMPRESSED_TXS_PRUNABLE, tx_id, result, scratch);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3391,10 +4468,22 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
 
   TXN_PREFIX_RDONLY();
   RCURSOR(output_amounts);
+  const bool use_rct_index = amount == 0 && m_rct_output_index;
+  if (use_rct_index)
+  {
+    RCURSOR(rct_outputs);
+  }
 
   MDB_val_set(k, amount);
   MDB_val_set(v, index);
-  auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+  int get_result;
+  if (use_rct_index)
+  {
+    MDB_val_set(ki, index);
+    get_result = mdb_cursor_get(m_cur_rct_outputs, &ki, &v, MDB_SET);
+  }
+  else
+    get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE(std::string("Attempting to get output pubkey by index, but key does not exist: amount " +
         std::to_string(amount) + ", index " + std::to_string(index)).c_str()));
@@ -3402,7 +4491,11 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
     throw0(DB_ERROR("Error attempting to retrieve an output pubkey from the db"));
 
   output_data_t ret;
-  if (amount == 0)
+  if (use_rct_index)
+  {
+    ret = *(const output_data_t *)v.mv_data;
+  }
+  else if (amount == 0)
   {
     const outkey *okp = (const outkey *)v.mv_data;
     ret = okp->data;
@@ -3502,6 +4595,17 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  const std::shared_ptr<const key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (filter)
+  {
+    m_key_image_filter_lookups.fetch_add(1, std::memory_order_relaxed);
+    if (!filter->may_contain(img))
+    {
+      m_key_image_filter_negatives.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+
   bool ret;
 
   TXN_PREFIX_RDONLY();
@@ -3511,9 +4615,26 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   ret = (mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
 
   TXN_POSTFIX_RDONLY();
+
+  if (filter && !ret)
+    m_key_image_filter_false_positives.fetch_add(1, std::memory_order_relaxed);
   return ret;
 }
 
+bool BlockchainLMDB::get_key_image_filter_stats(key_image_filter_stats &stats) const
+{
+  const std::shared_ptr<const key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (!filter)
+    return false;
+  stats.entries = filter->entries();
+  stats.capacity = filter->capacity();
+  stats.memory_size = filter->memory_size();
+  stats.lookups = m_key_image_filter_lookups.load(std::memory_order_relaxed);
+  stats.negatives = m_key_image_filter_negatives.load(std::memory_order_relaxed);
+  stats.false_positives = m_key_image_filter_false_positives.load(std::memory_order_relaxed);
+  return true;
+}
+
 bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3557,6 +4678,7 @@ bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, st
 
   MDB_val k;
   MDB_val v;
+  blobdata buffer;
   bool fret = true;
 
   MDB_cursor_op op;
@@ -3577,7 +4699,7 @@ bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, st
     if (ret)
       throw0(DB_ERROR("Failed to enumerate blocks"));
     uint64_t height = *(const uint64_t*)k.mv_data;
-    blobdata_ref bd{reinterpret_cast<char*>(v.mv_data), v.mv_size};
+    const blobdata_ref bd = decode_blob(COMPRESSED_BLOCKS, height, v, buffer);
     block b;
     if (!parse_and_validate_block_from_blob(bd, b))
       throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
@@ -3609,6 +4731,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
 
   MDB_val k;
   MDB_val v;
+  blobdata buffer;
   bool fret = true;
 
   MDB_cursor_op op = MDB_FIRST;
@@ -3645,7 +4768,8 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
       ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
-      bd.append(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+      const blobdata_ref prunable_blob = decode_blob(COMPRESSED_TXS_PRUNABLE, ti->data.tx_id, v, buffer);
+      bd.append(prunable_blob.data(), prunable_blob.size());
       if (!parse_and_validate_tx_from_blob(bd, tx))
         throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
     }
@@ -3735,6 +4859,303 @@ bool BlockchainLMDB::for_all_outputs(uint64_t amount, const std::function<bool(u
   return fret;
 }
 
+bool BlockchainLMDB::run_sharded(size_t shards, const std::function<bool(size_t shard, MDB_txn *txn, const std::atomic<bool> &stop)> &f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  std::vector<mdb_size_t> txn_ids(shards);
+  std::vector<char> txn_ok(shards), results(shards, 1);
+  std::vector<std::exception_ptr> errors(shards);
+  std::atomic<bool> stop(false);
+  boost::barrier barrier(shards);
+
+  // the shards' txns are counted up front, all at once: a shard waiting at the creation
+  // gate while the others hold theirs at the barrier would never let a resize through
+  std::vector<std::unique_ptr<mdb_txn_safe>> txns(shards);
+  mdb_txn_safe::prevent_new_txns();
+  for (std::unique_ptr<mdb_txn_safe> &txn: txns)
+    txn.reset(new mdb_txn_safe());
+  mdb_txn_safe::allow_new_txns();
+
+  auto run = [&](size_t shard)
+  {
+    mdb_txn_safe &txn = *txns[shard];
+    // read txns belong to the thread which started them, and a commit landing while
+    // the shards start theirs would leave them on different snapshots: start over then
+    while (1)
+    {
+      int result = lmdb_txn_begin(m_env, NULL, MDB_RDONLY, txn);
+      txn_ok[shard] = result == 0;
+      txn_ids[shard] = result ? 0 : mdb_txn_id(txn);
+      if (result)
+        errors[shard] = std::make_exception_ptr(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+      barrier.wait();
+      const bool all_ok = std::all_of(txn_ok.begin(), txn_ok.end(), [](char ok) { return ok; });
+      const bool same_snapshot = std::all_of(txn_ids.begin(), txn_ids.end(), [&](mdb_size_t id) { return id == txn_ids[0]; });
+      barrier.wait();
+      if (all_ok && same_snapshot)
+        break;
+      if (result == 0)
+        txn.abort();
+      if (!all_ok)
+        return;
+    }
+
+    try
+    {
+      results[shard] = f(shard, txn, stop);
+    }
+    catch (...)
+    {
+      errors[shard] = std::current_exception();
+    }
+    if (!results[shard] || errors[shard])
+      stop = true;
+    txn.abort();
+  };
+
+  boost::thread::attributes attrs;
+  attrs.set_stack_size(THREAD_STACK_SIZE);
+  std::vector<boost::thread> threads;
+  threads.reserve(shards);
+  for (size_t shard = 0; shard < shards; ++shard)
+    threads.emplace_back(attrs, std::bind(run, shard));
+  for (boost::thread &thread: threads)
+    thread.join();
+
+  for (const std::exception_ptr &e: errors)
+    if (e)
+      std::rethrow_exception(e);
+  return std::all_of(results.begin(), results.end(), [](char r) { return r; });
+}
+
+static size_t get_num_shards(size_t shards)
+{
+  // each shard takes a reader slot, of which there are 126 by default
+  return std::max<size_t>(1, std::min<size_t>(shards ? shards : tools::get_max_concurrency(), 64));
+}
+
+bool BlockchainLMDB::for_blocks_range_parallel(uint64_t h1, uint64_t h2, std::function<bool(size_t, uint64_t, const crypto::hash&, const cryptonote::block&)> f, size_t shards) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  shards = get_num_shards(shards);
+
+  return run_sharded(shards, [&](size_t shard, MDB_txn *txn, const std::atomic<bool> &stop)
+  {
+    int result;
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_blocks, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+    if (db_stats.ms_entries == 0 || h1 > h2)
+      return true;
+    const uint64_t last = std::min<uint64_t>(h2, db_stats.ms_entries - 1);
+    if (h1 > last)
+      return true;
+    const uint64_t count = last - h1 + 1;
+    const uint64_t begin = h1 + count * shard / shards;
+    const uint64_t end = h1 + count * (shard + 1) / shards;
+
+    MDB_cursor *cur_blocks;
+    if ((result = mdb_cursor_open(txn, m_blocks, &cur_blocks)))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+    std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> cursor_closer(cur_blocks, &mdb_cursor_close);
+
+    blobdata buffer;
+    MDB_val_copy<uint64_t> k(begin);
+    MDB_val v;
+    MDB_cursor_op op = MDB_SET;
+    for (uint64_t height = begin; height < end && !stop; ++height)
+    {
+      result = mdb_cursor_get(cur_blocks, &k, &v, op);
+      op = MDB_NEXT;
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate blocks: ", result).c_str()));
+      const blobdata_ref bd = decode_blob(COMPRESSED_BLOCKS, height, v, buffer);
+      block b;
+      if (!parse_and_validate_block_from_blob(bd, b))
+        throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
+      crypto::hash hash;
+      if (!get_block_hash(b, hash))
+        throw0(DB_ERROR("Failed to get block hash from blob retrieved from the db"));
+      if (!f(shard, height, hash, b))
+        return false;
+    }
+    return true;
+  });
+}
+
+bool BlockchainLMDB::for_all_transactions_parallel(std::function<bool(size_t, const crypto::hash&, const cryptonote::transaction&)> f, bool pruned, size_t shards) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  shards = get_num_shards(shards);
+
+  return run_sharded(shards, [&](size_t shard, MDB_txn *txn, const std::atomic<bool> &stop)
+  {
+    // tx hashes are uniformly distributed, so shards are even ranges of the
+    // most significant word as compare_hash32 sees it
+    auto get_bound = [shards](size_t shard) {
+      crypto::hash bound = crypto::null_hash;
+      const uint32_t top = (uint64_t)shard * 0x100000000ull / shards;
+      memcpy(bound.data + 28, &top, sizeof(top));
+      return bound;
+    };
+    const crypto::hash begin = get_bound(shard);
+    const crypto::hash end = get_bound(shard + 1);
+    const bool last_shard = shard + 1 == shards;
+
+    int result;
+    MDB_cursor *cur_tx_indices, *cur_txs_pruned, *cur_txs_prunable;
+    if ((result = mdb_cursor_open(txn, m_tx_indices, &cur_tx_indices)))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+    std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> tx_indices_closer(cur_tx_indices, &mdb_cursor_close);
+    if ((result = mdb_cursor_open(txn, m_txs_pruned, &cur_txs_pruned)))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+    std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> txs_pruned_closer(cur_txs_pruned, &mdb_cursor_close);
+    if ((result = mdb_cursor_open(txn, m_txs_prunable, &cur_txs_prunable)))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+    std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> txs_prunable_closer(cur_txs_prunable, &mdb_cursor_close);
+
+    blobdata buffer;
+    MDB_val k;
+    MDB_val v = {sizeof(begin), (void*)&begin};
+    MDB_cursor_op op = MDB_GET_BOTH_RANGE;
+    while (!stop)
+    {
+      k = zerokval;
+      result = mdb_cursor_get(cur_tx_indices, &k, &v, op);
+      op = MDB_NEXT_DUP;
+      if (result == MDB_NOTFOUND)
+        break;
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", result).c_str()));
+
+      const txindex *ti = (const txindex *)v.mv_data;
+      const MDB_val key = {sizeof(ti->key), (void*)&ti->key};
+      const MDB_val end_key = {sizeof(end), (void*)&end};
+      if (!last_shard && compare_hash32(&key, &end_key) >= 0)
+        break;
+      const crypto::hash hash = ti->key;
+      k.mv_data = (void *)&ti->data.tx_id;
+      k.mv_size = sizeof(ti->data.tx_id);
+
+      MDB_val vp;
+      result = mdb_cursor_get(cur_txs_pruned, &k, &vp, MDB_SET);
+      if (result == MDB_NOTFOUND)
+        break;
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", result).c_str()));
+      transaction tx;
+      if (pruned)
+      {
+        blobdata_ref bd{reinterpret_cast<char*>(vp.mv_data), vp.mv_size};
+        if (!parse_and_validate_tx_base_from_blob(bd, tx))
+          throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+      }
+      else
+      {
+        blobdata bd;
+        bd.assign(reinterpret_cast<char*>(vp.mv_data), vp.mv_size);
+        result = mdb_cursor_get(cur_txs_prunable, &k, &vp, MDB_SET);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", result).c_str()));
+        const blobdata_ref prunable_blob = decode_blob(COMPRESSED_TXS_PRUNABLE, ti->data.tx_id, vp, buffer);
+        bd.append(prunable_blob.data(), prunable_blob.size());
+        if (!parse_and_validate_tx_from_blob(bd, tx))
+          throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+      }
+      if (!f(shard, hash, tx))
+        return false;
+    }
+    return true;
+  });
+}
+
+bool BlockchainLMDB::for_all_outputs_parallel(std::function<bool(size_t, uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f, size_t shards) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  shards = get_num_shards(shards);
+
+  return run_sharded(shards, [&](size_t shard, MDB_txn *txn, const std::atomic<bool> &stop)
+  {
+    int result;
+    MDB_cursor *cur_output_amounts, *cur_output_txs;
+    if ((result = mdb_cursor_open(txn, m_output_amounts, &cur_output_amounts)))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+    std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> output_amounts_closer(cur_output_amounts, &mdb_cursor_close);
+    if ((result = mdb_cursor_open(txn, m_output_txs, &cur_output_txs)))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+    std::unique_ptr<MDB_cursor, decltype(&mdb_cursor_close)> output_txs_closer(cur_output_txs, &mdb_cursor_close);
+
+    // most outputs are amount 0, so shards are cut at (amount, amount index) positions,
+    // found from the number of outputs of each amount
+    MDB_val k, v;
+    std::vector<std::pair<uint64_t, mdb_size_t>> amounts;
+    uint64_t total = 0;
+    result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_FIRST);
+    while (result == 0)
+    {
+      mdb_size_t count;
+      if ((result = mdb_cursor_count(cur_output_amounts, &count)))
+        throw0(DB_ERROR(lmdb_error("Failed to count outputs: ", result).c_str()));
+      amounts.emplace_back(*(const uint64_t*)k.mv_data, count);
+      total += count;
+      result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_NEXT_NODUP);
+    }
+    if (result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", result).c_str()));
+    if (total == 0)
+      return true;
+
+    auto get_bound = [&](size_t shard) {
+      uint64_t position = total * shard / shards;
+      for (const auto &a: amounts)
+      {
+        if (position < a.second)
+          return std::make_pair(a.first, (uint64_t)position);
+        position -= a.second;
+      }
+      return std::make_pair(std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint64_t>::max());
+    };
+    const std::pair<uint64_t, uint64_t> begin = get_bound(shard);
+    const std::pair<uint64_t, uint64_t> end = get_bound(shard + 1);
+    if (begin == end)
+      return true;
+
+    MDB_val_copy<uint64_t> begin_amount(begin.first);
+    k = begin_amount;
+    uint64_t begin_index = begin.second;
+    v = MDB_val{sizeof(begin_index), (void*)&begin_index};
+    result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_GET_BOTH_RANGE);
+    if (result == MDB_NOTFOUND)
+    {
+      // indices may have gaps where outputs were pruned, the shard may start on the next amount
+      k = begin_amount;
+      if ((result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_SET)) == 0)
+        result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_NEXT_NODUP);
+    }
+    while (result == 0 && !stop)
+    {
+      const uint64_t amount = *(const uint64_t*)k.mv_data;
+      const outkey *ok = (const outkey *)v.mv_data;
+      if (std::make_pair(amount, ok->amount_index) >= end)
+        break;
+
+      MDB_val_set(vo, ok->output_id);
+      if ((result = mdb_cursor_get(cur_output_txs, (MDB_val *)&zerokval, &vo, MDB_GET_BOTH)))
+        throw1(OUTPUT_DNE(lmdb_error("Failed to get tx for output: ", result).c_str()));
+      const outtx *ot = (const outtx *)vo.mv_data;
+      if (!f(shard, amount, ot->tx_hash, ok->data.height, ot->local_index))
+        return false;
+
+      result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_NEXT);
+    }
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", result).c_str()));
+    return true;
+  });
+}
+
 // batch_num_blocks: (optional) Used to check if resize needed before batch transaction starts.
 bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes)
 {
@@ -3751,6 +5172,9 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes
 
   m_writer = boost::this_thread::get_id();
   check_and_resize_for_batch(batch_num_blocks, batch_bytes);
+  uint64_t map_size;
+  get_map_usage(map_size, m_batch_start_size_used);
+  m_batch_start_height = height();
 
   m_write_batch_txn = new mdb_txn_safe();
 
@@ -3842,6 +5266,14 @@ void BlockchainLMDB::batch_stop()
     cleanup_batch();
     throw;
   }
+  const uint64_t batch_height = height();
+  uint64_t map_size, size_used;
+  get_map_usage(map_size, size_used);
+  if (batch_height > m_batch_start_height && size_used > m_batch_start_size_used)
+  {
+    const double growth_per_block = (size_used - m_batch_start_size_used) / (double)(batch_height - m_batch_start_height);
+    m_batch_growth_per_block = m_batch_growth_per_block > 0 ? (m_batch_growth_per_block + growth_per_block) / 2 : growth_per_block;
+  }
   LOG_PRINT_L3("batch transaction: end");
 }
 
@@ -3892,12 +5324,13 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
   /* Check for existing info and force reset if env doesn't match -
    * only happens if env was opened/closed multiple times in same process
    */
-  if (!(tinfo = m_tinfo.get()) || mdb_txn_env(tinfo->m_ti_rtxn) != m_env)
+  if (!(tinfo = m_tinfo.get()) || mdb_txn_env(tinfo->m_ti_rtxn) != m_env || tinfo->m_ti_env_generation != m_env_generation)
   {
     tinfo = new mdb_threadinfo;
     m_tinfo.reset(tinfo);
     memset(&tinfo->m_ti_rcursors, 0, sizeof(tinfo->m_ti_rcursors));
     memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
+    tinfo->m_ti_env_generation = m_env_generation;
     if (auto mdb_res = lmdb_txn_begin(m_env, NULL, MDB_RDONLY, &tinfo->m_ti_rtxn))
       throw0(DB_ERROR_TXN_START(lmdb_error("Failed to create a read transaction for the db: ", mdb_res).c_str()));
     ret = true;
@@ -4106,14 +5539,33 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
+  if (m_rct_output_index)
+  {
+    RCURSOR(rct_outputs);
+  }
 
+  bool rct_cursor_valid = false;
   for (size_t i = 0; i < offsets.size(); ++i)
   {
     const uint64_t amount = amounts.size() == 1 ? amounts[0] : amounts[i];
+    const bool use_rct_index = amount == 0 && m_rct_output_index;
     MDB_val_set(k, amount);
     MDB_val_set(v, offsets[i]);
 
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+    int get_result;
+    if (use_rct_index)
+    {
+      // offsets are often sorted (always when scanning incoming blocks), step through runs
+      const bool next = rct_cursor_valid && i > 0 && offsets[i] == offsets[i - 1] + 1;
+      MDB_val_set(ki, offsets[i]);
+      get_result = mdb_cursor_get(m_cur_rct_outputs, &ki, &v, next ? MDB_NEXT : MDB_SET);
+      rct_cursor_valid = get_result == 0;
+    }
+    else
+    {
+      get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+      rct_cursor_valid = false;
+    }
     if (get_result == MDB_NOTFOUND)
     {
       if (allow_partial)
@@ -4126,7 +5578,11 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
     else if (get_result)
       throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
 
-    if (amount == 0)
+    if (use_rct_index)
+    {
+      outputs.push_back(*(const output_data_t *)v.mv_data);
+    }
+    else if (amount == 0)
     {
       const outkey *okp = (const outkey *)v.mv_data;
       outputs.push_back(okp->data);
@@ -4539,6 +5995,344 @@ void BlockchainLMDB::fixup()
 
 #define LOGIF(y)    if (ELPP->vRegistry()->allowed(y, "global"))
 
+void BlockchainLMDB::build_rct_output_index()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_cursor *c_amounts, *c_rct;
+  const uint64_t amount = 0;
+  MDB_val_set(k, amount);
+  MDB_val v;
+
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, m_rct_outputs, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_rct_outputs: ", result).c_str()));
+  uint64_t i = db_stats.ms_entries;
+
+  if ((result = mdb_cursor_open(txn, m_output_amounts, &c_amounts)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+  mdb_size_t num_rct_outputs = 0;
+  result = mdb_cursor_get(c_amounts, &k, &v, MDB_SET);
+  if (result == 0)
+    mdb_cursor_count(c_amounts, &num_rct_outputs);
+  else if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to get rct outputs: ", result).c_str()));
+
+  if (i > num_rct_outputs)
+  {
+    MWARNING("rct output index is ahead of the outputs, rebuilding it");
+    if ((result = mdb_drop(txn, m_rct_outputs, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_outputs: ", result).c_str()));
+    i = 0;
+  }
+  if (i < num_rct_outputs)
+    MGINFO_YELLOW("Building rct output index - this may take a while: " << i << "/" << num_rct_outputs);
+
+  while (i < num_rct_outputs)
+  {
+    // the records are appended in order, so we pick up after the last one
+    MDB_val_set(vi, i);
+    result = mdb_cursor_get(c_amounts, &k, &vi, MDB_GET_BOTH);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to get rct output: ", result).c_str()));
+    if ((result = mdb_cursor_open(txn, m_rct_outputs, &c_rct)))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for rct_outputs: ", result).c_str()));
+
+    const uint64_t end = std::min<uint64_t>(i + 100000, num_rct_outputs);
+    for (; i < end; ++i)
+    {
+      const outkey *okp = (const outkey *)vi.mv_data;
+      if (okp->amount_index != i)
+        throw0(DB_ERROR("Unexpected amount index in output_amounts"));
+      MDB_val_set(kr, i);
+      MDB_val vr = {sizeof(okp->data), (void*)&okp->data};
+      if ((result = mdb_cursor_put(c_rct, &kr, &vr, MDB_APPEND)))
+        throw0(DB_ERROR(lmdb_error("Failed to add rct output: ", result).c_str()));
+      if (i + 1 < end && (result = mdb_cursor_get(c_amounts, &k, &vi, MDB_NEXT_DUP)))
+        throw0(DB_ERROR(lmdb_error("Failed to get rct output: ", result).c_str()));
+    }
+
+    txn.commit();
+    LOGIF(el::Level::Info) {
+      std::cout << i << " / " << num_rct_outputs << "  \r" << std::flush;
+    }
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    if ((result = mdb_cursor_open(txn, m_output_amounts, &c_amounts)))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+  }
+  txn.commit();
+
+  m_rct_output_index = true;
+}
+
+std::shared_ptr<key_image_filter> BlockchainLMDB::make_key_image_filter(MDB_txn *txn, uint64_t min_capacity) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  MDB_cursor *c_spent_keys;
+  MDB_val k = zerokval, v;
+
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, m_spent_keys, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+
+  // leave room to grow, so the filter does not need rebuilding every few blocks
+  static constexpr const uint64_t min_key_image_filter_capacity = 1 << 20;
+  const uint64_t capacity = std::max<uint64_t>(std::max<uint64_t>(db_stats.ms_entries * 2, min_capacity), min_key_image_filter_capacity);
+  std::shared_ptr<key_image_filter> filter = std::make_shared<key_image_filter>(capacity, crypto::rand<uint64_t>());
+
+  if ((result = mdb_cursor_open(txn, m_spent_keys, &c_spent_keys)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for spent_keys: ", result).c_str()));
+  // spent_keys is DUPFIXED, so the key images come a page at a time
+  result = mdb_cursor_get(c_spent_keys, &k, &v, MDB_FIRST);
+  if (result == 0)
+    result = mdb_cursor_get(c_spent_keys, &k, &v, MDB_GET_MULTIPLE);
+  while (result == 0)
+  {
+    const crypto::key_image *kis = (const crypto::key_image*)v.mv_data;
+    for (size_t i = 0; i < v.mv_size / sizeof(crypto::key_image); ++i)
+      filter->insert(kis[i]);
+    result = mdb_cursor_get(c_spent_keys, &k, &v, MDB_NEXT_MULTIPLE);
+  }
+  mdb_cursor_close(c_spent_keys);
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate key images: ", result).c_str()));
+
+  MINFO("Built key image filter over " << filter->entries() << " key images, using " << filter->memory_size() / 1024 << " kB");
+  return filter;
+}
+
+void BlockchainLMDB::open_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  std::shared_ptr<key_image_filter> filter(key_image_filter::load(get_key_image_filter_filename(), height(), top_block_hash()));
+  if (!filter)
+  {
+    MGINFO("Building key image filter");
+    mdb_txn_safe txn(false);
+    if (auto result = mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    filter = make_key_image_filter(txn, 0);
+    txn.commit();
+  }
+  std::atomic_store(&m_key_image_filter, filter);
+}
+
+std::string BlockchainLMDB::get_key_image_filter_filename() const
+{
+  return (boost::filesystem::path(m_folder) / "key_images.filter").string();
+}
+
+void BlockchainLMDB::load_table_compression(MDB_txn *txn)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  for (int table = 0; table < NUM_COMPRESSED_TABLES; ++table)
+  {
+    table_compression &tc = m_compression[table];
+    tc.codec.reset();
+    tc.compressed_below = 0;
+
+    MDB_val_str(k, compression_info_keys[table]);
+    MDB_val v;
+    int result = mdb_get(txn, m_properties, &k, &v);
+    if (result == MDB_NOTFOUND)
+      continue;
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve table compression info: ", result).c_str()));
+    if (v.mv_size != sizeof(table_compression_info))
+      throw0(DB_ERROR("Invalid table compression info"));
+    const table_compression_info info = *(const table_compression_info*)v.mv_data;
+    if (!blob_codec::is_supported(info.codec))
+      throw0(DB_ERROR((std::string("The ") + compressed_table_names[table] + " table is compressed with a codec this build does not support, rebuild with zstd").c_str()));
+
+    std::string dictionary;
+    MDB_val_str(kd, compression_dict_keys[table]);
+    result = mdb_get(txn, m_properties, &kd, &v);
+    if (result == 0)
+      dictionary.assign((const char*)v.mv_data, v.mv_size);
+    else if (result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve compression dictionary: ", result).c_str()));
+
+    tc.codec.reset(new blob_codec(dictionary, info.level));
+    tc.compressed_below = info.compressed_below;
+  }
+}
+
+void BlockchainLMDB::store_table_compression(MDB_txn *txn, compressed_table table) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const table_compression &tc = m_compression[table];
+  table_compression_info info;
+  info.codec = blob_codec::zstd;
+  info.level = COMPRESSION_LEVEL;
+  info.compressed_below = tc.compressed_below;
+
+  int result;
+  MDB_val_str(k, compression_info_keys[table]);
+  MDB_val v = {sizeof(info), (void*)&info};
+  if ((result = mdb_put(txn, m_properties, &k, &v, 0)))
+    throw0(DB_ERROR(lmdb_error("Failed to save table compression info: ", result).c_str()));
+  MDB_val_str(kd, compression_dict_keys[table]);
+  if (tc.codec->dictionary().empty())
+    result = mdb_del(txn, m_properties, &kd, NULL);
+  else
+  {
+    MDB_val vd = {tc.codec->dictionary().size(), (void*)tc.codec->dictionary().data()};
+    result = mdb_put(txn, m_properties, &kd, &vd, 0);
+  }
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to save compression dictionary: ", result).c_str()));
+}
+
+void BlockchainLMDB::compress_table(compressed_table table)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  table_compression &tc = m_compression[table];
+  if (tc.codec && tc.compressed_below == std::numeric_limits<uint64_t>::max())
+    return;
+
+  const MDB_dbi dbi = table == COMPRESSED_BLOCKS ? m_blocks : m_txs_prunable;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_cursor *cursor;
+  MDB_val k, v;
+
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, dbi, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query table to compress: ", result).c_str()));
+
+  if (!tc.codec)
+  {
+    // train the dictionary on rows from all over the table, the kind of data changes over time
+    std::vector<std::string> samples;
+    size_t sampled_bytes = 0;
+    const uint64_t stride = std::max<uint64_t>(db_stats.ms_entries / COMPRESSION_DICTIONARY_SAMPLES, 1);
+    uint64_t next_key;
+    if ((result = mdb_cursor_open(txn, dbi, &cursor)))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for the table to compress: ", result).c_str()));
+    result = mdb_cursor_get(cursor, &k, &v, MDB_FIRST);
+    while (result == 0 && samples.size() < COMPRESSION_DICTIONARY_SAMPLES && sampled_bytes < COMPRESSION_DICTIONARY_SIZE * 100)
+    {
+      samples.emplace_back((const char*)v.mv_data, v.mv_size);
+      sampled_bytes += v.mv_size;
+      next_key = *(const uint64_t*)k.mv_data + stride;
+      k = MDB_val{sizeof(next_key), (void*)&next_key};
+      result = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+    }
+    mdb_cursor_close(cursor);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to sample the table to compress: ", result).c_str()));
+
+    // a table is only compressed once it can be trained on, small rows gain little without a dictionary
+    const std::string dictionary = blob_codec::train_dictionary(samples, COMPRESSION_DICTIONARY_SIZE);
+    if (dictionary.empty())
+    {
+      MINFO("Too few rows in " << compressed_table_names[table] << " to train a compression dictionary, leaving it uncompressed for now");
+      txn.abort();
+      return;
+    }
+    tc.codec.reset(new blob_codec(dictionary, COMPRESSION_LEVEL));
+    tc.compressed_below = 0;
+    store_table_compression(txn, table);
+    MINFO("Compressing " << compressed_table_names[table] << " with a " << tc.codec->dictionary().size() << " byte dictionary trained on " << samples.size() << " rows");
+  }
+
+  if (db_stats.ms_entries > 0)
+    MGINFO_YELLOW("Compressing " << compressed_table_names[table] << " - this may take a while");
+
+  uint64_t rows = 0, bytes_in = 0, bytes_out = 0;
+  std::string buffer;
+  while (tc.compressed_below != std::numeric_limits<uint64_t>::max())
+  {
+    // the rows are rewritten in key order, so we pick up after the last batch
+    if ((result = mdb_cursor_open(txn, dbi, &cursor)))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for the table to compress: ", result).c_str()));
+    uint64_t key = tc.compressed_below;
+    k = MDB_val{sizeof(key), (void*)&key};
+    result = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+    uint64_t compressed_below = std::numeric_limits<uint64_t>::max();
+    size_t batch_bytes = 0;
+    while (result == 0)
+    {
+      key = *(const uint64_t*)k.mv_data;
+      if (batch_bytes >= COMPRESSION_BATCH_BYTES)
+      {
+        compressed_below = key;
+        break;
+      }
+      if (!tc.codec->compress(v.mv_data, v.mv_size, buffer))
+        throw0(DB_ERROR("Failed to compress blob"));
+      batch_bytes += v.mv_size;
+      bytes_in += v.mv_size;
+      bytes_out += buffer.size();
+      ++rows;
+      MDB_val_set(kc, key);
+      MDB_val vc = {buffer.size(), (void*)buffer.data()};
+      if ((result = mdb_cursor_put(cursor, &kc, &vc, MDB_CURRENT)))
+        throw0(DB_ERROR(lmdb_error("Failed to write compressed blob: ", result).c_str()));
+      result = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+    }
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to read the table to compress: ", result).c_str()));
+
+    tc.compressed_below = compressed_below;
+    store_table_compression(txn, table);
+    txn.commit();
+    LOGIF(el::Level::Info) {
+      std::cout << rows << " / " << db_stats.ms_entries << "  \r" << std::flush;
+    }
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  }
+  txn.commit();
+
+  if (rows > 0)
+    MGINFO("Compressed " << rows << " rows of " << compressed_table_names[table] << " from " << bytes_in / 1024 << " kB to " << bytes_out / 1024 << " kB");
+}
+
+MDB_val BlockchainLMDB::encode_blob(compressed_table table, uint64_t key, const MDB_val &v, std::string &buffer) const
+{
+  const table_compression &tc = m_compression[table];
+  if (!tc.codec || key >= tc.compressed_below)
+    return v;
+  if (!tc.codec->compress(v.mv_data, v.mv_size, buffer))
+    throw0(DB_ERROR("Failed to compress blob"));
+  return MDB_val{buffer.size(), (void*)buffer.data()};
+}
+
+blobdata_ref BlockchainLMDB::decode_blob(compressed_table table, uint64_t key, const MDB_val &v, blobdata &buffer) const
+{
+  const table_compression &tc = m_compression[table];
+  if (!tc.codec || key >= tc.compressed_below)
+    return blobdata_ref{(const char*)v.mv_data, v.mv_size};
+  if (!tc.codec->decompress(v.mv_data, v.mv_size, buffer))
+    throw0(DB_ERROR("Failed to decompress blob retrieved from the db"));
+  return blobdata_ref{buffer.data(), buffer.size()};
+}
+
 void BlockchainLMDB::migrate_0_1()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
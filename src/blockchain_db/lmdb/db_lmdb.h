@@ -27,8 +27,13 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
+#include "blockchain_db/blob_codec.h"
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/key_image_filter.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
@@ -53,6 +58,7 @@ typedef struct mdb_txn_cursors
 
   MDB_cursor *m_txc_output_txs;
   MDB_cursor *m_txc_output_amounts;
+  MDB_cursor *m_txc_rct_outputs;
 
   MDB_cursor *m_txc_txs;
   MDB_cursor *m_txc_txs_pruned;
@@ -79,6 +85,7 @@ typedef struct mdb_txn_cursors
 #define m_cur_block_info	m_cursors->m_txc_block_info
 #define m_cur_output_txs	m_cursors->m_txc_output_txs
 #define m_cur_output_amounts	m_cursors->m_txc_output_amounts
+#define m_cur_rct_outputs	m_cursors->m_txc_rct_outputs
 #define m_cur_txs	m_cursors->m_txc_txs
 #define m_cur_txs_pruned	m_cursors->m_txc_txs_pruned
 #define m_cur_txs_prunable	m_cursors->m_txc_txs_prunable
@@ -101,6 +108,7 @@ typedef struct mdb_rflags
   bool m_rf_block_info;
   bool m_rf_output_txs;
   bool m_rf_output_amounts;
+  bool m_rf_rct_outputs;
   bool m_rf_txs;
   bool m_rf_txs_pruned;
   bool m_rf_txs_prunable;
@@ -121,6 +129,7 @@ typedef struct mdb_threadinfo
   MDB_txn *m_ti_rtxn;	// per-thread read txn
   mdb_txn_cursors m_ti_rcursors;	// per-thread read cursors
   mdb_rflags m_ti_rflags;	// per-thread read state
+  uint64_t m_ti_env_generation;	// generation of the env m_ti_rtxn was made for
 
   ~mdb_threadinfo();
 } mdb_threadinfo;
@@ -164,6 +173,8 @@ struct mdb_txn_safe
 
   // could use a mutex here, but this should be sufficient.
   static std::atomic_flag creation_gate;
+  // how many times this thread took the gate, it can still make txns
+  static thread_local unsigned creation_gate_depth;
 };
 
 
@@ -216,6 +227,8 @@ public:
 
   virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t& height) const;
 
+  virtual cryptonote::blobdata_ref get_block_blob_view_from_height(const uint64_t& height, cryptonote::blobdata &scratch) const;
+
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const;
 
   virtual uint64_t get_block_timestamp(const uint64_t& height) const;
@@ -257,9 +270,11 @@ public:
 
   virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
   virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_pruned_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx) const;
   virtual bool get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const;
   virtual bool get_blocks_from(uint64_t start_height, size_t min_block_count, size_t max_block_count, size_t max_tx_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const;
   virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_prunable_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx, cryptonote::blobdata &scratch) const;
   virtual bool get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const;
 
   virtual uint64_t get_tx_count() const;
@@ -284,6 +299,8 @@ public:
 
   virtual bool has_key_image(const crypto::key_image& img) const;
 
+  virtual bool get_key_image_filter_stats(key_image_filter_stats &stats) const;
+
   virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata_ref &blob, const txpool_tx_meta_t& meta);
   virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t& meta);
   virtual uint64_t get_txpool_tx_count(relay_category category = relay_category::broadcasted) const;
@@ -294,9 +311,19 @@ public:
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
   virtual uint32_t get_blockchain_pruning_seed() const;
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
+  virtual bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, uint64_t &pruned_bytes);
+  virtual bool is_pruning_in_progress() const;
   virtual bool update_pruning();
   virtual bool check_pruning();
 
+  virtual bool compact_copy();
+  virtual uint64_t compact_finish();
+
+  virtual bool resize_ahead();
+  virtual bool get_resize_stats(db_resize_stats &stats) const;
+
+  virtual bool store_txpool();
+
   virtual void add_alt_block(const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata_ref &blob);
   virtual bool get_alt_block(const crypto::hash &blkid, alt_block_data_t *data, cryptonote::blobdata *blob);
   virtual void remove_alt_block(const crypto::hash &blkid);
@@ -310,6 +337,9 @@ public:
   virtual bool for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>, bool pruned) const;
   virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const;
   virtual bool for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const;
+  virtual bool for_blocks_range_parallel(uint64_t h1, uint64_t h2, std::function<bool(size_t, uint64_t, const crypto::hash&, const cryptonote::block&)> f, size_t shards = 0) const;
+  virtual bool for_all_transactions_parallel(std::function<bool(size_t, const crypto::hash&, const cryptonote::transaction&)> f, bool pruned, size_t shards = 0) const;
+  virtual bool for_all_outputs_parallel(std::function<bool(size_t, uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f, size_t shards = 0) const;
   virtual bool for_all_alt_blocks(std::function<bool(const crypto::hash &blkid, const alt_block_data_t &data, const cryptonote::blobdata_ref *blob)> f, bool include_blob = false) const;
 
   virtual uint64_t add_block( const std::pair<block, blobdata>& blk
@@ -362,6 +392,7 @@ private:
   void do_resize(uint64_t size_increase=0);
 
   bool need_resize(uint64_t threshold_size=0) const;
+  void get_map_usage(uint64_t &map_size, uint64_t &size_used) const;
   void check_and_resize_for_batch(uint64_t batch_num_blocks, uint64_t batch_bytes);
   uint64_t get_estimated_batch_size(uint64_t batch_num_blocks, uint64_t batch_bytes) const;
 
@@ -411,7 +442,7 @@ private:
 
   inline void check_open() const;
 
-  bool prune_worker(int mode, uint32_t pruning_seed);
+  bool prune_worker(int mode, uint32_t pruning_seed, size_t max_txes = 0, uint64_t *pruned_bytes = NULL);
 
   virtual bool is_read_only() const;
 
@@ -425,6 +456,54 @@ private:
   // fix up anything that may be wrong due to past bugs
   virtual void fixup();
 
+  // fill the rct_outputs side table from output_amounts, resuming where it stops
+  void build_rct_output_index();
+
+  // fill a key image filter from spent_keys as seen by txn
+  std::shared_ptr<key_image_filter> make_key_image_filter(MDB_txn *txn, uint64_t min_capacity) const;
+
+  // load the key image filter saved by close, or build it if it does not match the db
+  void open_key_image_filter();
+
+  std::string get_key_image_filter_filename() const;
+
+  // fill m_txpool_mem from the txpool tables
+  void load_txpool();
+
+  enum compressed_table
+  {
+    COMPRESSED_BLOCKS,
+    COMPRESSED_TXS_PRUNABLE,
+    NUM_COMPRESSED_TABLES
+  };
+
+  // read the codec of each compressible table from the properties
+  void load_table_compression(MDB_txn *txn);
+
+  void store_table_compression(MDB_txn *txn, compressed_table table) const;
+
+  // give a table a codec if it has none, and compress the rows written before, resuming where it stops
+  void compress_table(compressed_table table);
+
+  // the value to store for a row, compressed into buffer if the table's codec covers that key
+  MDB_val encode_blob(compressed_table table, uint64_t key, const MDB_val &v, std::string &buffer) const;
+
+  // the contents of a stored row, decompressed into buffer if the table's codec covers that key
+  blobdata_ref decode_blob(compressed_table table, uint64_t key, const MDB_val &v, blobdata &buffer) const;
+
+  // run f on its own thread for each shard, each with a read txn on the same snapshot, and stop them all
+  // as soon as one returns false; exceptions are passed on to the caller
+  bool run_sharded(size_t shards, const std::function<bool(size_t shard, MDB_txn *txn, const std::atomic<bool> &stop)> &f) const;
+
+  // where compact_copy writes the copy: next to the db, as open refuses a folder inside one
+  std::string get_compact_folder() const;
+
+  // bring the copy made by compact_copy up to the blocks in the db, popping what was reorganized away
+  void compact_catch_up();
+
+  // close and delete the copy made by compact_copy, if any
+  void discard_compact_copy();
+
   // migrate from older DB version to current
   void migrate(const uint32_t oldversion);
 
@@ -462,6 +541,7 @@ private:
 
   MDB_dbi m_output_txs;
   MDB_dbi m_output_amounts;
+  MDB_dbi m_rct_outputs; // 0 when the optional rct output index is not open
 
   MDB_dbi m_spent_keys;
 
@@ -477,13 +557,58 @@ private:
 
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
+  double m_batch_growth_per_block; // map growth per block seen over recent batches, also used in batch size estimation
+  uint64_t m_batch_start_size_used;
+  uint64_t m_batch_start_height;
+
+  uint64_t m_growth_sample_time; // when resize_ahead last sampled size_used, in ms
+  uint64_t m_growth_sample_size_used;
+  std::atomic<uint64_t> m_growth_rate; // bytes per second
+  std::atomic<uint64_t> m_resizes;
+  std::atomic<uint64_t> m_resizes_ahead;
+  std::atomic<uint64_t> m_resize_stall_ms;
+  std::atomic<uint64_t> m_resize_max_stall_ms;
   std::string m_folder;
+  int m_db_flags; // as passed to open
+  uint64_t m_env_generation; // bumped by open, so per-thread read txns of a closed env are not reused
   mdb_txn_safe* m_write_txn; // may point to either a short-lived txn or a batch txn
   mdb_txn_safe* m_write_batch_txn; // persist batch txn outside of BlockchainLMDB
   boost::thread::id m_writer;
 
   bool m_batch_transactions; // support for batch transactions
   bool m_batch_active; // whether batch transaction is in progress
+  bool m_rct_output_index; // whether rct_outputs is present and in sync with output_amounts
+
+  // null unless opened with DBF_KEY_IMAGE_FILTER, replaced with std::atomic_store as it grows
+  std::shared_ptr<key_image_filter> m_key_image_filter;
+  mutable std::atomic<uint64_t> m_key_image_filter_lookups;
+  mutable std::atomic<uint64_t> m_key_image_filter_negatives;
+  mutable std::atomic<uint64_t> m_key_image_filter_false_positives;
+
+  // the txpool, if opened with DBF_TXPOOL_IN_MEMORY, its tables are then only written by store_txpool
+  struct txpool_mem_tx
+  {
+    txpool_tx_meta_t meta;
+    std::shared_ptr<const cryptonote::blobdata> blob; // shared, so for_all_txpool_txes can copy cheaply
+  };
+  std::unique_ptr<std::unordered_map<crypto::hash, txpool_mem_tx>> m_txpool_mem; // null unless DBF_TXPOOL_IN_MEMORY
+  mutable std::mutex m_txpool_mem_lock;
+  bool m_txpool_mem_dirty; // changed since loaded or stored, guarded by m_txpool_mem_lock
+
+  // rows of a table with a codec are compressed if their key is below compressed_below,
+  // which only stops short of the end while compress_table has not finished
+  struct table_compression
+  {
+    std::unique_ptr<blob_codec> codec;
+    uint64_t compressed_below;
+  };
+  table_compression m_compression[NUM_COMPRESSED_TABLES];
+
+  std::unique_ptr<BlockchainLMDB> m_compact_db; // the copy made by compact_copy, till compact_finish
+  std::atomic<bool> m_compact_swapping; // compact_finish is reopening the db
+  std::atomic<bool> m_compacting; // from compact_copy till compact_finish is done
+  std::atomic<bool> m_compact_copying; // compact_copy is writing the copy, resizes abort it
+  std::atomic<bool> m_compact_abort; // set by a resize to make compact_copy give up
 
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
@@ -66,12 +66,15 @@ public:
   virtual void drop_hard_fork_info() override {}
   virtual bool block_exists(const crypto::hash& h, uint64_t *height) const override { return false; }
   virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t& height) const override { return cryptonote::t_serializable_object_to_blob(get_block_from_height(height)); }
+  virtual cryptonote::blobdata_ref get_block_blob_view_from_height(const uint64_t& height, cryptonote::blobdata &scratch) const override { scratch = get_block_blob_from_height(height); return scratch; }
   virtual cryptonote::blobdata get_block_blob(const crypto::hash& h) const override { return cryptonote::blobdata(); }
   virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override { return false; }
   virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override { return false; }
+  virtual bool get_pruned_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx) const override { return false; }
   virtual bool get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const override { return false; }
   virtual bool get_blocks_from(uint64_t start_height, size_t min_block_count, size_t max_block_count, size_t max_tx_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const override { return false; }
   virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override { return false; }
+  virtual bool get_prunable_tx_blob_view(const crypto::hash& h, cryptonote::blobdata_ref &tx, cryptonote::blobdata &scratch) const override { return false; }
   virtual bool get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const override { return false; }
   virtual uint64_t get_block_height(const crypto::hash& h) const override { return 0; }
   virtual cryptonote::block_header get_block_header(const crypto::hash& h) const override { return cryptonote::block_header(); }
@@ -123,6 +126,9 @@ public:
   virtual bool for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>, bool pruned) const override { return true; }
   virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const override { return true; }
   virtual bool for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const override { return true; }
+  virtual bool for_blocks_range_parallel(uint64_t h1, uint64_t h2, std::function<bool(size_t, uint64_t, const crypto::hash&, const cryptonote::block&)> f, size_t shards = 0) const override { return true; }
+  virtual bool for_all_transactions_parallel(std::function<bool(size_t, const crypto::hash&, const cryptonote::transaction&)> f, bool pruned, size_t shards = 0) const override { return true; }
+  virtual bool for_all_outputs_parallel(std::function<bool(size_t, uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f, size_t shards = 0) const override { return true; }
   virtual bool is_read_only() const override { return false; }
   virtual std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff, uint64_t min_count) const override { return std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>>(); }
   virtual bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const override { return false; }
@@ -153,8 +159,12 @@ public:
 
   virtual uint32_t get_blockchain_pruning_seed() const override { return 0; }
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) override { return true; }
+  virtual bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, uint64_t &pruned_bytes) override { return true; }
+  virtual bool is_pruning_in_progress() const override { return false; }
   virtual bool update_pruning() override { return true; }
   virtual bool check_pruning() override { return true; }
+  virtual bool compact_copy() override { return false; }
+  virtual uint64_t compact_finish() override { return 0; }
   virtual void prune_outputs(uint64_t amount) override {}
 
   virtual uint64_t get_max_block_size() override { return 100000000; }
@@ -190,10 +190,12 @@ int main(int argc, char* argv[])
   std::map<uint64_t, uint64_t> known_spent_outputs;
   if (input.empty())
   {
-    std::map<uint64_t, std::pair<uint64_t, uint64_t>> outputs;
+    // counts are kept per shard, and summed once all are done
+    std::vector<std::map<uint64_t, std::pair<uint64_t, uint64_t>>> shard_outputs(tools::get_max_concurrency());
 
     LOG_PRINT_L0("Scanning for known spent data...");
-    db->for_all_transactions([&](const crypto::hash &txid, const cryptonote::transaction &tx){
+    db->for_all_transactions_parallel([&](size_t shard, const crypto::hash &txid, const cryptonote::transaction &tx){
+      std::map<uint64_t, std::pair<uint64_t, uint64_t>> &outputs = shard_outputs[shard];
       const bool miner_tx = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
       for (const auto &in: tx.vin)
       {
@@ -219,11 +221,14 @@ int main(int argc, char* argv[])
         outputs[amount].first++;
       }
       return true;
-    }, true);
+    }, true, shard_outputs.size());
 
-    for (const auto &i: outputs)
+    for (const auto &outputs: shard_outputs)
     {
-      known_spent_outputs[i.first] = i.second.second;
+      for (const auto &i: outputs)
+      {
+        known_spent_outputs[i.first] += i.second.second;
+      }
     }
   }
   else
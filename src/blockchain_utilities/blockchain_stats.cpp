@@ -64,9 +64,22 @@ static boost::multiprecision::uint128_t totdiff, mindiff, maxdiff;
 static uint32_t minins = MAX_INOUT, maxins;
 static uint32_t minouts = MAX_INOUT, maxouts;
 static uint32_t minrings = MAX_RINGS, maxrings;
-static uint32_t io, tottxs;
+static uint32_t tottxs;
 static uint32_t txhr[24];
 
+#define BLOCK_CHUNK_SIZE	10000
+
+struct block_stats
+{
+  uint64_t timestamp = 0;
+  uint64_t size = 0;
+  uint32_t txs = 0;
+  uint64_t coinbase_amount = 0;
+  uint64_t tx_fee_amount = 0;
+  difficulty_type diff = 0;
+  std::vector<uint32_t> ins, outs, rings;
+};
+
 static void doprint()
 {
   char timebuf[64];
@@ -282,101 +295,120 @@ plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, ''
   }
   std::cout << ENDL;
 
-  for (h = block_start; h < block_stop; ++h)
+  // blocks and their txes are read and parsed in parallel a chunk at a time,
+  // then tallied in height order as before
+  std::vector<block_stats> chunk;
+  for (h = block_start; h < block_stop && !stop_requested; )
   {
-    cryptonote::blobdata bd = db->get_block_blob_from_height(h);
-    cryptonote::block blk;
-    if (!cryptonote::parse_and_validate_block_from_blob(bd, blk))
-    {
-      LOG_PRINT_L0("Bad block from db");
-      return 1;
-    }
-    time_t tt = blk.timestamp;
-    epee::misc_utils::get_gmt_time(tt, currtm);
-    if (!prevtm.tm_year)
-      prevtm = currtm;
-    // catch change of day
-    if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
-    {
-      // check for timestamp fudging around month ends
-      if (!(prevtm.tm_mday == 1 && currtm.tm_mday > 27))
-        doprint();
-    }
-    currsz += bd.size();
-    uint64_t coinbase_amount;
-    uint64_t tx_fee_amount = 0;
-    for (const auto& tx_id : blk.tx_hashes)
+    const uint64_t chunk_start = h;
+    const uint64_t chunk_stop = std::min<uint64_t>(block_stop, chunk_start + BLOCK_CHUNK_SIZE);
+    chunk.clear();
+    chunk.resize(chunk_stop - chunk_start);
+    // the callback reads txes through its thread's own txn, so each shard takes two reader slots
+    const bool ok = db->for_blocks_range_parallel(chunk_start, chunk_stop - 1, [&](size_t shard, uint64_t height, const crypto::hash &hash, const cryptonote::block &blk)
     {
-      if (tx_id == crypto::null_hash)
+      block_stats &bs = chunk[height - chunk_start];
+      bs.timestamp = blk.timestamp;
+      bs.size = cryptonote::block_to_blob(blk).size();
+      cryptonote::blobdata bd;
+      for (const auto& tx_id : blk.tx_hashes)
       {
-        throw std::runtime_error("Aborting: tx == null_hash");
+        if (tx_id == crypto::null_hash)
+        {
+          throw std::runtime_error("Aborting: tx == null_hash");
+        }
+        if (!db->get_pruned_tx_blob(tx_id, bd))
+        {
+          throw std::runtime_error("Aborting: tx not found");
+        }
+        transaction tx;
+        if (!parse_and_validate_tx_base_from_blob(bd, tx))
+        {
+          throw std::runtime_error("Bad txn from db");
+        }
+        bs.size += bd.size();
+        if (db->get_prunable_tx_blob(tx_id, bd))
+          bs.size += bd.size();
+        if (do_fees || do_emission)
+          bs.tx_fee_amount += get_tx_fee(tx);
+        if (do_inputs)
+          bs.ins.push_back(tx.vin.size());
+        if (do_ringsize)
+          bs.rings.push_back(boost::get<cryptonote::txin_to_key>(tx.vin[0]).key_offsets.size());
+        if (do_outputs)
+          bs.outs.push_back(tx.vout.size());
+        bs.txs++;
       }
-      if (!db->get_pruned_tx_blob(tx_id, bd))
-      {
-        throw std::runtime_error("Aborting: tx not found");
-      }
-      transaction tx;
-      if (!parse_and_validate_tx_base_from_blob(bd, tx))
+      if (do_diff)
+        bs.diff = db->get_block_difficulty(height);
+      if (do_emission)
+        bs.coinbase_amount = get_outs_money_amount(blk.miner_tx);
+      return !stop_requested;
+    }, std::max<size_t>(1, tools::get_max_concurrency() / 2));
+    if (!ok)
+      break;
+
+    for (; h < chunk_stop; ++h)
+    {
+      const block_stats &bs = chunk[h - chunk_start];
+      time_t tt = bs.timestamp;
+      epee::misc_utils::get_gmt_time(tt, currtm);
+      if (!prevtm.tm_year)
+        prevtm = currtm;
+      // catch change of day
+      if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
       {
-        LOG_PRINT_L0("Bad txn from db");
-        return 1;
-      }
-      currsz += bd.size();
-      if (db->get_prunable_tx_blob(tx_id, bd))
-        currsz += bd.size();
-      currtxs++;
-      if (do_fees || do_emission) {
-        tx_fee_amount += get_tx_fee(tx);
+        // check for timestamp fudging around month ends
+        if (!(prevtm.tm_mday == 1 && currtm.tm_mday > 27))
+          doprint();
       }
+      currsz += bs.size;
+      currtxs += bs.txs;
+      tottxs += bs.txs;
       if (do_hours)
-        txhr[currtm.tm_hour]++;
-      if (do_inputs) {
-        io = tx.vin.size();
+        txhr[currtm.tm_hour] += bs.txs;
+      for (uint32_t io: bs.ins)
+      {
         if (io < minins)
           minins = io;
         else if (io > maxins)
           maxins = io;
         totins += io;
       }
-      if (do_ringsize) {
-        const cryptonote::txin_to_key& tx_in_to_key
-                       = boost::get<cryptonote::txin_to_key>(tx.vin[0]);
-        io = tx_in_to_key.key_offsets.size();
+      for (uint32_t io: bs.rings)
+      {
         if (io < minrings)
           minrings = io;
         else if (io > maxrings)
           maxrings = io;
         totrings += io;
       }
-      if (do_outputs) {
-        io = tx.vout.size();
+      for (uint32_t io: bs.outs)
+      {
         if (io < minouts)
           minouts = io;
         else if (io > maxouts)
           maxouts = io;
         totouts += io;
       }
-      tottxs++;
-    }
-    if (do_diff) {
-      difficulty_type diff = db->get_block_difficulty(h);
-      if (!mindiff || diff < mindiff)
-        mindiff = diff;
-      if (diff > maxdiff)
-        maxdiff = diff;
-      totdiff += diff;
-    }
-    if (do_emission) {
-      coinbase_amount = get_outs_money_amount(blk.miner_tx);
-      emission += coinbase_amount - tx_fee_amount;
-    }
-    if (do_fees) {
-      fees += tx_fee_amount;
-    }
-    currblks++;
+      if (do_diff) {
+        if (!mindiff || bs.diff < mindiff)
+          mindiff = bs.diff;
+        if (bs.diff > maxdiff)
+          maxdiff = bs.diff;
+        totdiff += bs.diff;
+      }
+      if (do_emission) {
+        emission += bs.coinbase_amount - bs.tx_fee_amount;
+      }
+      if (do_fees) {
+        fees += bs.tx_fee_amount;
+      }
+      currblks++;
 
-    if (stop_requested)
-      break;
+      if (stop_requested)
+        break;
+    }
   }
   if (currblks)
     doprint();
@@ -76,6 +76,12 @@ struct reference
   reference(uint64_t h, uint64_t rs, uint64_t p): height(h), ring_size(rs), position(p) {}
 };
 
+struct usage_shard
+{
+  std::vector<output_data> created;
+  std::unordered_map<output_data, std::list<reference>> references;
+};
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -185,20 +191,23 @@ int main(int argc, char* argv[])
   std::unordered_map<uint64_t,uint64_t> indices;
 
   LOG_PRINT_L0("Reading blockchain from " << input);
-  core_storage->for_all_transactions([&](const crypto::hash &hash, const cryptonote::transaction &tx)->bool
+  // each shard records the outputs it creates and the references it sees, and the
+  // shards are merged in order, which is the order the sequential walk sees the txes in.
+  // The callback looks up tx heights through its thread's own txn, so each shard
+  // takes two reader slots
+  std::vector<usage_shard> shards(std::max<size_t>(1, tools::get_max_concurrency() / 2));
+  core_storage->get_db().for_all_transactions_parallel([&](size_t shard, const crypto::hash &hash, const cryptonote::transaction &tx)->bool
   {
+    usage_shard &us = shards[shard];
     const bool coinbase = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
     const uint64_t height = core_storage->get_db().get_tx_block_height(hash);
 
-    // create new outputs
+    // create new outputs, numbered when merging
     for (const auto &out: tx.vout)
     {
       if (opt_rct_only && out.amount)
         continue;
-      indices[out.amount]++;
-      output_data od(out.amount, indices[out.amount], coinbase, height);
-      auto itb = outputs.emplace(od, std::list<reference>());
-      itb.first->first.info(coinbase, height);
+      us.created.emplace_back(out.amount, 0, coinbase, height);
     }
 
     for (const auto &in: tx.vin)
@@ -213,11 +222,32 @@ int main(int argc, char* argv[])
       for (size_t n = 0; n < txin.key_offsets.size(); ++n)
       {
         output_data od(txin.amount, absolute[n], coinbase, height);
-        outputs[od].push_back(reference(height, txin.key_offsets.size(), n));
+        us.references[od].push_back(reference(height, txin.key_offsets.size(), n));
       }
     }
     return true;
-  }, true);
+  }, true, shards.size());
+
+  for (usage_shard &us: shards)
+  {
+    for (const output_data &created: us.created)
+    {
+      indices[created.amount]++;
+      output_data od(created.amount, indices[created.amount], created.coinbase, created.height);
+      auto itb = outputs.emplace(od, std::list<reference>());
+      itb.first->first.info(created.coinbase, created.height);
+    }
+    us.created.clear();
+  }
+  for (usage_shard &us: shards)
+  {
+    for (auto &ref: us.references)
+    {
+      std::list<reference> &refs = outputs.emplace(ref.first, std::list<reference>()).first->second;
+      refs.splice(refs.end(), ref.second);
+    }
+    us.references.clear();
+  }
 
   std::unordered_map<uint64_t, uint64_t> counts;
   size_t total = 0;
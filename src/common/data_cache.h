@@ -31,7 +31,10 @@
 #pragma once 
 
 #include <unordered_set>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace tools
 {
@@ -62,4 +65,107 @@ namespace tools
     T buf[MAX_SIZE] = {};
     size_t counter = 0;
   };
+
+  // Same FIFO eviction as data_cache, but with a capacity set at runtime and values spread
+  // over independently locked stripes, so concurrent lookups of different values rarely contend.
+  // Eviction is per stripe, so the oldest value overall is not necessarily the first to go.
+  template<typename T, typename Hash = std::hash<T>>
+  class striped_data_cache
+  {
+  public:
+    explicit striped_data_cache(size_t max_size, size_t num_stripes = 16):
+      stripes(num_stripes ? num_stripes : 1)
+    {
+      for (auto &s: stripes)
+        s.reset(new stripe());
+      set_max_size(max_size);
+    }
+
+    // Changes the capacity, dropping everything cached so far
+    void set_max_size(size_t max_size)
+    {
+      const size_t stripe_size = (max_size + stripes.size() - 1) / stripes.size();
+      for (auto &s: stripes)
+      {
+        std::lock_guard<std::mutex> lock(s->m);
+        s->data.clear();
+        s->buf.clear();
+        s->buf.shrink_to_fit();
+        s->max_size = stripe_size;
+        s->counter = 0;
+      }
+    }
+
+    size_t max_size() const
+    {
+      return stripes.size() * stripes[0]->max_size;
+    }
+
+    void add(const T& value)
+    {
+      stripe &s = get_stripe(value);
+      std::lock_guard<std::mutex> lock(s.m);
+      if (s.max_size == 0 || !s.data.insert(value).second)
+        return;
+      if (s.buf.size() < s.max_size)
+      {
+        s.buf.push_back(value);
+        return;
+      }
+      T& old_value = s.buf[s.counter++ % s.max_size];
+      s.data.erase(old_value);
+      old_value = value;
+    }
+
+    bool has(const T& value) const
+    {
+      const stripe &s = get_stripe(value);
+      std::lock_guard<std::mutex> lock(s.m);
+      return (s.data.find(value) != s.data.end());
+    }
+
+    size_t size() const
+    {
+      size_t n = 0;
+      for (const auto &s: stripes)
+      {
+        std::lock_guard<std::mutex> lock(s->m);
+        n += s->data.size();
+      }
+      return n;
+    }
+
+    // Appends all cached values, oldest first within each stripe, so that adding them back
+    // in order to an empty cache of the same size gives the same contents
+    void get_all(std::vector<T>& values) const
+    {
+      for (const auto &s: stripes)
+      {
+        std::lock_guard<std::mutex> lock(s->m);
+        const size_t n = s->buf.size();
+        const size_t start = n < s->max_size ? 0 : s->counter % s->max_size;
+        for (size_t i = 0; i < n; ++i)
+          values.push_back(s->buf[(start + i) % n]);
+      }
+    }
+
+  private:
+    struct stripe
+    {
+      mutable std::mutex m;
+      std::unordered_set<T, Hash> data;
+      std::vector<T> buf;
+      size_t max_size = 0;
+      size_t counter = 0;
+    };
+
+    stripe& get_stripe(const T& value) const
+    {
+      // mix the hash a bit, the unordered_set in each stripe uses the same low bits
+      const size_t h = Hash()(value);
+      return *stripes[(h ^ (h >> 17) ^ (h >> 31)) % stripes.size()];
+    }
+
+    std::vector<std::unique_ptr<stripe>> stripes;
+  };
 }
@@ -0,0 +1,860 @@
+// Copyright (c) 2014-2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/*
+ * Byte-oriented group operations with a 64-bit backend.
+ *
+ * Field elements are held in five 51-bit limbs and multiplied with 64x64->128 bit products,
+ * which takes about half the work of the portable radix 2^25.5 code in crypto-ops.c. The
+ * scalar recodings and point formulas are the same as in crypto-ops.c, so results are bit
+ * identical, including for out of range scalars. The backend is picked at runtime, and
+ * MONERO_USE_FE51=0 falls back to the portable code.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crypto-ops.h"
+
+#if defined(__SIZEOF_INT128__)
+#define HAVE_FE51
+#endif
+
+#ifdef HAVE_FE51
+
+typedef unsigned __int128 fe51_uint128;
+typedef uint64_t fe51[5];
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+} ge51_p2;
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+  fe51 T;
+} ge51_p3;
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+  fe51 T;
+} ge51_p1p1;
+
+typedef struct {
+  fe51 yplusx;
+  fe51 yminusx;
+  fe51 xy2d;
+} ge51_precomp;
+
+typedef struct {
+  fe51 YplusX;
+  fe51 YminusX;
+  fe51 Z;
+  fe51 T2d;
+} ge51_cached;
+
+#define FE51_MASK ((uint64_t) 0x7ffffffffffff)
+
+static const fe51 fe51_d = { 0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029, 0x739c663a03cbb, 0x52036cee2b6ff };
+static const fe51 fe51_d2 = { 0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977, 0x2406d9dc56dff };
+static const fe51 fe51_sqrtm1 = { 0x61b274a0ea0b0, 0x0d5a5fc8f189d, 0x7ef5e9cbd0c60, 0x78595a6804c9e, 0x2b8324804fc1d };
+
+/* B, 3B, 5B, ..., 15B, as ge_Bi */
+static const ge51_precomp ge51_Bi[8] = {
+  { { 0x493c6f58c3b85, 0x0df7181c325f7, 0x0f50b0b3e4cb7, 0x5329385a44c32, 0x07cf9d3a33d4b },
+    { 0x03905d740913e, 0x0ba2817d673a2, 0x23e2827f4e67c, 0x133d2e0c21a34, 0x44fd2f9298f81 },
+    { 0x11205877aaa68, 0x479955893d579, 0x50d66309b67a0, 0x2d42d0dbee5ee, 0x6f117b689f0c6 } },
+  { { 0x5b0a84cee9730, 0x61d10c97155e4, 0x4059cc8096a10, 0x47a608da8014f, 0x7a164e1b9a80f },
+    { 0x11fe8a4fcd265, 0x7bcb8374faacc, 0x52f5af4ef4d4f, 0x5314098f98d10, 0x2ab91587555bd },
+    { 0x6933f0dd0d889, 0x44386bb4c4295, 0x3cb6d3162508c, 0x26368b872a2c6, 0x5a2826af12b9b } },
+  { { 0x2bc4408a5bb33, 0x078ebdda05442, 0x2ffb112354123, 0x375ee8df5862d, 0x2945ccf146e20 },
+    { 0x182c3a447d6ba, 0x22964e536eff2, 0x192821f540053, 0x2f9f19e788e5c, 0x154a7e73eb1b5 },
+    { 0x3dbf1812a8285, 0x0fa17ba3f9797, 0x6f69cb49c3820, 0x34d5a0db3858d, 0x43aabe696b3bb } },
+  { { 0x25cd0944ea3bf, 0x75673b81a4d63, 0x150b925d1c0d4, 0x13f38d9294114, 0x461bea69283c9 },
+    { 0x72c9aaa3221b1, 0x267774474f74d, 0x064b0e9b28085, 0x3f04ef53b27c9, 0x1d6edd5d2e531 },
+    { 0x36dc801b8b3a2, 0x0e0a7d4935e30, 0x1deb7cecc0d7d, 0x053a94e20dd2c, 0x7a9fbb1c6a0f9 } },
+  { { 0x6678aa6a8632f, 0x5ea3788d8b365, 0x21bd6d6994279, 0x7ace75919e4e3, 0x34b9ed338add7 },
+    { 0x6217e039d8064, 0x6dea408337e6d, 0x57ac112628206, 0x647cb65e30473, 0x49c05a51fadc9 },
+    { 0x4e8bf9045af1b, 0x514e33a45e0d6, 0x7533c5b8bfe0f, 0x583557b7e14c9, 0x73c172021b008 } },
+  { { 0x700848a802ade, 0x1e04605c4e5f7, 0x5c0d01b9767fb, 0x7d7889f42388b, 0x4275aae2546d8 },
+    { 0x75b0249864348, 0x52ee11070262b, 0x237ae54fb5acd, 0x3bfd1d03aaab5, 0x18ab598029d5c },
+    { 0x32cc5fd6089e9, 0x426505c949b05, 0x46a18880c7ad2, 0x4a4221888ccda, 0x3dc65522b53df } },
+  { { 0x0c222a2007f6d, 0x356b79bdb77ee, 0x41ee81efe12ce, 0x120a9bd07097d, 0x234fd7eec346f },
+    { 0x7013b327fbf93, 0x1336eeded6a0d, 0x2b565a2bbf3af, 0x253ce89591955, 0x0267882d17602 },
+    { 0x0a119732ea378, 0x63bf1ba8e2a6c, 0x69f94cc90df9a, 0x431d1779bfc48, 0x497ba6fdaa097 } },
+  { { 0x6cc0313cfeaa0, 0x1a313848da499, 0x7cb534219230a, 0x39596dedefd60, 0x61e22917f12de },
+    { 0x3cd86468ccf0b, 0x48553221ac081, 0x6c9464b4e0a6e, 0x75fba84180403, 0x43b5cd4218d05 },
+    { 0x2762f9bd0b516, 0x1c6e7fbddcbb3, 0x75909c3ace2bd, 0x42101972d3ec9, 0x511d61210ae4d } }
+};
+
+/*
+ * Limb bounds: fe51_mul, fe51_sq and fe51_sub return limbs below 2^51 + 2^15, fe51_add does
+ * not carry, so its outputs stay below 2^52.1 when fed with those. Multiplication accepts limbs
+ * up to 2^54, which covers every sum used below.
+ */
+
+static inline uint64_t load_8(const unsigned char *in) {
+  uint64_t result = 0;
+  int i;
+  for (i = 7; i >= 0; --i) {
+    result = (result << 8) | in[i];
+  }
+  return result;
+}
+
+static inline void store_8(unsigned char *out, uint64_t in) {
+  int i;
+  for (i = 0; i < 8; ++i) {
+    out[i] = (unsigned char) in;
+    in >>= 8;
+  }
+}
+
+static inline void fe51_0(fe51 h) {
+  h[0] = h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+static inline void fe51_1(fe51 h) {
+  h[0] = 1;
+  h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+static inline void fe51_copy(fe51 h, const fe51 f) {
+  memcpy(h, f, sizeof(fe51));
+}
+
+static inline void fe51_add(fe51 h, const fe51 f, const fe51 g) {
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+}
+
+/* h = f - g, adding 4p first so limbs stay positive for g below 2^53 */
+static inline void fe51_sub(fe51 h, const fe51 f, const fe51 g) {
+  uint64_t h0 = f[0] + 0x1fffffffffffb4 - g[0];
+  uint64_t h1 = f[1] + 0x1ffffffffffffc - g[1];
+  uint64_t h2 = f[2] + 0x1ffffffffffffc - g[2];
+  uint64_t h3 = f[3] + 0x1ffffffffffffc - g[3];
+  uint64_t h4 = f[4] + 0x1ffffffffffffc - g[4];
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h2 += h1 >> 51; h1 &= FE51_MASK;
+  h3 += h2 >> 51; h2 &= FE51_MASK;
+  h4 += h3 >> 51; h3 &= FE51_MASK;
+  h0 += 19 * (h4 >> 51); h4 &= FE51_MASK;
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+static inline void fe51_neg(fe51 h, const fe51 f) {
+  static const fe51 zero = { 0, 0, 0, 0, 0 };
+  fe51_sub(h, zero, f);
+}
+
+static inline void fe51_reduce128(fe51 h, fe51_uint128 r0, fe51_uint128 r1, fe51_uint128 r2, fe51_uint128 r3, fe51_uint128 r4) {
+  uint64_t h0, h1, h2, h3, h4, c;
+  r1 += (uint64_t) (r0 >> 51); h0 = (uint64_t) r0 & FE51_MASK;
+  r2 += (uint64_t) (r1 >> 51); h1 = (uint64_t) r1 & FE51_MASK;
+  r3 += (uint64_t) (r2 >> 51); h2 = (uint64_t) r2 & FE51_MASK;
+  r4 += (uint64_t) (r3 >> 51); h3 = (uint64_t) r3 & FE51_MASK;
+  c = (uint64_t) (r4 >> 51); h4 = (uint64_t) r4 & FE51_MASK;
+  h0 += c * 19;
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+static void fe51_mul(fe51 h, const fe51 f, const fe51 g) {
+  const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  const uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+  fe51_uint128 r0, r1, r2, r3, r4;
+
+  r0 = (fe51_uint128) f0 * g0 + (fe51_uint128) f1 * g4_19 + (fe51_uint128) f2 * g3_19 + (fe51_uint128) f3 * g2_19 + (fe51_uint128) f4 * g1_19;
+  r1 = (fe51_uint128) f0 * g1 + (fe51_uint128) f1 * g0 + (fe51_uint128) f2 * g4_19 + (fe51_uint128) f3 * g3_19 + (fe51_uint128) f4 * g2_19;
+  r2 = (fe51_uint128) f0 * g2 + (fe51_uint128) f1 * g1 + (fe51_uint128) f2 * g0 + (fe51_uint128) f3 * g4_19 + (fe51_uint128) f4 * g3_19;
+  r3 = (fe51_uint128) f0 * g3 + (fe51_uint128) f1 * g2 + (fe51_uint128) f2 * g1 + (fe51_uint128) f3 * g0 + (fe51_uint128) f4 * g4_19;
+  r4 = (fe51_uint128) f0 * g4 + (fe51_uint128) f1 * g3 + (fe51_uint128) f2 * g2 + (fe51_uint128) f3 * g1 + (fe51_uint128) f4 * g0;
+
+  fe51_reduce128(h, r0, r1, r2, r3, r4);
+}
+
+static void fe51_sq(fe51 h, const fe51 f) {
+  const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3;
+  const uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+  fe51_uint128 r0, r1, r2, r3, r4;
+
+  r0 = (fe51_uint128) f0 * f0 + (fe51_uint128) f1_2 * f4_19 + (fe51_uint128) f2_2 * f3_19;
+  r1 = (fe51_uint128) f0_2 * f1 + (fe51_uint128) f2_2 * f4_19 + (fe51_uint128) f3 * f3_19;
+  r2 = (fe51_uint128) f0_2 * f2 + (fe51_uint128) f1 * f1 + (fe51_uint128) f3_2 * f4_19;
+  r3 = (fe51_uint128) f0_2 * f3 + (fe51_uint128) f1_2 * f2 + (fe51_uint128) f4 * f4_19;
+  r4 = (fe51_uint128) f0_2 * f4 + (fe51_uint128) f1_2 * f3 + (fe51_uint128) f2 * f2;
+
+  fe51_reduce128(h, r0, r1, r2, r3, r4);
+}
+
+static void fe51_sqn(fe51 h, const fe51 f, int n) {
+  fe51_sq(h, f);
+  while (--n > 0) {
+    fe51_sq(h, h);
+  }
+}
+
+/* Loads the low 255 bits, like fe_frombytes */
+static void fe51_frombytes(fe51 h, const unsigned char *s) {
+  h[0] = load_8(s) & FE51_MASK;
+  h[1] = (load_8(s + 6) >> 3) & FE51_MASK;
+  h[2] = (load_8(s + 12) >> 6) & FE51_MASK;
+  h[3] = (load_8(s + 19) >> 1) & FE51_MASK;
+  h[4] = (load_8(s + 24) >> 12) & FE51_MASK;
+}
+
+/* Fully reduces mod p, like fe_tobytes */
+static void fe51_tobytes(unsigned char *s, const fe51 f) {
+  uint64_t t[5];
+  int pass;
+  memcpy(t, f, sizeof(t));
+
+  for (pass = 0; pass < 2; ++pass) {
+    t[1] += t[0] >> 51; t[0] &= FE51_MASK;
+    t[2] += t[1] >> 51; t[1] &= FE51_MASK;
+    t[3] += t[2] >> 51; t[2] &= FE51_MASK;
+    t[4] += t[3] >> 51; t[3] &= FE51_MASK;
+    t[0] += 19 * (t[4] >> 51); t[4] &= FE51_MASK;
+  }
+
+  /* t is now below 2^255 + 2^14; adding 19 carries into bit 255 iff t >= p */
+  t[0] += 19;
+  t[1] += t[0] >> 51; t[0] &= FE51_MASK;
+  t[2] += t[1] >> 51; t[1] &= FE51_MASK;
+  t[3] += t[2] >> 51; t[2] &= FE51_MASK;
+  t[4] += t[3] >> 51; t[3] &= FE51_MASK;
+  t[0] += 19 * (t[4] >> 51); t[4] &= FE51_MASK;
+
+  /* t is (value + 19) mod 2^255 with the reduction applied; take off the 19 again mod 2^255 */
+  t[0] += 0x8000000000000 - 19;
+  t[1] += 0x8000000000000 - 1;
+  t[2] += 0x8000000000000 - 1;
+  t[3] += 0x8000000000000 - 1;
+  t[4] += 0x8000000000000 - 1;
+  t[1] += t[0] >> 51; t[0] &= FE51_MASK;
+  t[2] += t[1] >> 51; t[1] &= FE51_MASK;
+  t[3] += t[2] >> 51; t[2] &= FE51_MASK;
+  t[4] += t[3] >> 51; t[3] &= FE51_MASK;
+  t[4] &= FE51_MASK;
+
+  store_8(s, t[0] | (t[1] << 51));
+  store_8(s + 8, (t[1] >> 13) | (t[2] << 38));
+  store_8(s + 16, (t[2] >> 26) | (t[3] << 25));
+  store_8(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static int fe51_isnegative(const fe51 f) {
+  unsigned char s[32];
+  fe51_tobytes(s, f);
+  return s[0] & 1;
+}
+
+static int fe51_isnonzero(const fe51 f) {
+  unsigned char s[32];
+  unsigned char r = 0;
+  int i;
+  fe51_tobytes(s, f);
+  for (i = 0; i < 32; ++i) {
+    r |= s[i];
+  }
+  return r != 0;
+}
+
+/* Same addition chain as fe_invert: z^(p-2) */
+static void fe51_invert(fe51 out, const fe51 z) {
+  fe51 t0, t1, t2, t3;
+  fe51_sq(t0, z);
+  fe51_sqn(t1, t0, 2);
+  fe51_mul(t1, z, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t2, t0);
+  fe51_mul(t1, t1, t2);
+  fe51_sqn(t2, t1, 5);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t2, t1, 10);
+  fe51_mul(t2, t2, t1);
+  fe51_sqn(t3, t2, 20);
+  fe51_mul(t2, t3, t2);
+  fe51_sqn(t2, t2, 10);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t2, t1, 50);
+  fe51_mul(t2, t2, t1);
+  fe51_sqn(t3, t2, 100);
+  fe51_mul(t2, t3, t2);
+  fe51_sqn(t2, t2, 50);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t1, t1, 5);
+  fe51_mul(out, t1, t0);
+}
+
+/* z^((p-5)/8) */
+static void fe51_pow22523(fe51 out, const fe51 z) {
+  fe51 t0, t1, t2;
+  fe51_sq(t0, z);
+  fe51_sqn(t1, t0, 2);
+  fe51_mul(t1, z, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t0, t0);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t1, t0, 5);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t1, t0, 10);
+  fe51_mul(t1, t1, t0);
+  fe51_sqn(t2, t1, 20);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t1, t1, 10);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t1, t0, 50);
+  fe51_mul(t1, t1, t0);
+  fe51_sqn(t2, t1, 100);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t1, t1, 50);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t0, t0, 2);
+  fe51_mul(out, t0, z);
+}
+
+/* Same acceptance rules as ge_frombytes_vartime */
+static int ge51_frombytes_vartime(ge51_p3 *h, const unsigned char *s) {
+  fe51 u, v, v3, vxx, check;
+
+  fe51_frombytes(h->Y, s);
+
+  /* Validate the number to be canonical */
+  if (h->Y[4] == FE51_MASK && h->Y[3] == FE51_MASK && h->Y[2] == FE51_MASK && h->Y[1] == FE51_MASK && h->Y[0] >= FE51_MASK - 18) {
+    return -1;
+  }
+
+  fe51_1(h->Z);
+  fe51_sq(u, h->Y);
+  fe51_mul(v, u, fe51_d);
+  fe51_sub(u, u, h->Z);       /* u = y^2-1 */
+  fe51_add(v, v, h->Z);       /* v = dy^2+1 */
+
+  /* x = uv^3(uv^7)^((q-5)/8) */
+  fe51_sq(v3, v);
+  fe51_mul(v3, v3, v);        /* v3 = v^3 */
+  fe51_sq(h->X, v3);
+  fe51_mul(h->X, h->X, v);
+  fe51_mul(h->X, h->X, u);    /* x = uv^7 */
+  fe51_pow22523(h->X, h->X);
+  fe51_mul(h->X, h->X, v3);
+  fe51_mul(h->X, h->X, u);
+
+  fe51_sq(vxx, h->X);
+  fe51_mul(vxx, vxx, v);
+  fe51_sub(check, vxx, u);    /* vx^2-u */
+  if (fe51_isnonzero(check)) {
+    fe51_add(check, vxx, u);  /* vx^2+u */
+    if (fe51_isnonzero(check)) {
+      return -1;
+    }
+    fe51_mul(h->X, h->X, fe51_sqrtm1);
+  }
+
+  if (fe51_isnegative(h->X) != (s[31] >> 7)) {
+    /* If x = 0, the sign must be positive */
+    if (!fe51_isnonzero(h->X)) {
+      return -1;
+    }
+    fe51_neg(h->X, h->X);
+  }
+
+  fe51_mul(h->T, h->X, h->Y);
+  return 0;
+}
+
+static void ge51_tobytes(unsigned char *s, const ge51_p2 *h) {
+  fe51 recip, x, y;
+  fe51_invert(recip, h->Z);
+  fe51_mul(x, h->X, recip);
+  fe51_mul(y, h->Y, recip);
+  fe51_tobytes(s, y);
+  s[31] ^= fe51_isnegative(x) << 7;
+}
+
+static void ge51_p2_0(ge51_p2 *h) {
+  fe51_0(h->X);
+  fe51_1(h->Y);
+  fe51_1(h->Z);
+}
+
+static void ge51_p1p1_to_p2(ge51_p2 *r, const ge51_p1p1 *p) {
+  fe51_mul(r->X, p->X, p->T);
+  fe51_mul(r->Y, p->Y, p->Z);
+  fe51_mul(r->Z, p->Z, p->T);
+}
+
+static void ge51_p1p1_to_p3(ge51_p3 *r, const ge51_p1p1 *p) {
+  fe51_mul(r->X, p->X, p->T);
+  fe51_mul(r->Y, p->Y, p->Z);
+  fe51_mul(r->Z, p->Z, p->T);
+  fe51_mul(r->T, p->X, p->Y);
+}
+
+static void ge51_p2_dbl(ge51_p1p1 *r, const ge51_p2 *p) {
+  fe51 t0;
+  fe51_sq(r->X, p->X);
+  fe51_sq(r->Z, p->Y);
+  fe51_sq(r->T, p->Z);
+  fe51_add(r->T, r->T, r->T);
+  fe51_add(r->Y, p->X, p->Y);
+  fe51_sq(t0, r->Y);
+  fe51_add(r->Y, r->Z, r->X);
+  fe51_sub(r->Z, r->Z, r->X);
+  fe51_sub(r->X, t0, r->Y);
+  fe51_sub(r->T, r->T, r->Z);
+}
+
+static void ge51_p3_dbl(ge51_p1p1 *r, const ge51_p3 *p) {
+  ge51_p2 q;
+  fe51_copy(q.X, p->X);
+  fe51_copy(q.Y, p->Y);
+  fe51_copy(q.Z, p->Z);
+  ge51_p2_dbl(r, &q);
+}
+
+static void ge51_p3_to_cached(ge51_cached *r, const ge51_p3 *p) {
+  fe51_add(r->YplusX, p->Y, p->X);
+  fe51_sub(r->YminusX, p->Y, p->X);
+  fe51_copy(r->Z, p->Z);
+  fe51_mul(r->T2d, p->T, fe51_d2);
+}
+
+static void ge51_add(ge51_p1p1 *r, const ge51_p3 *p, const ge51_cached *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->YplusX);
+  fe51_mul(r->Y, r->Y, q->YminusX);
+  fe51_mul(r->T, q->T2d, p->T);
+  fe51_mul(r->X, p->Z, q->Z);
+  fe51_add(t0, r->X, r->X);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_add(r->Z, t0, r->T);
+  fe51_sub(r->T, t0, r->T);
+}
+
+static void ge51_sub(ge51_p1p1 *r, const ge51_p3 *p, const ge51_cached *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->YminusX);
+  fe51_mul(r->Y, r->Y, q->YplusX);
+  fe51_mul(r->T, q->T2d, p->T);
+  fe51_mul(r->X, p->Z, q->Z);
+  fe51_add(t0, r->X, r->X);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_sub(r->Z, t0, r->T);
+  fe51_add(r->T, t0, r->T);
+}
+
+static void ge51_madd(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->yplusx);
+  fe51_mul(r->Y, r->Y, q->yminusx);
+  fe51_mul(r->T, q->xy2d, p->T);
+  fe51_add(t0, p->Z, p->Z);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_add(r->Z, t0, r->T);
+  fe51_sub(r->T, t0, r->T);
+}
+
+static void ge51_msub(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->yminusx);
+  fe51_mul(r->Y, r->Y, q->yplusx);
+  fe51_mul(r->T, q->xy2d, p->T);
+  fe51_add(t0, p->Z, p->Z);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_sub(r->Z, t0, r->T);
+  fe51_add(r->T, t0, r->T);
+}
+
+static void fe51_cmov(fe51 f, const fe51 g, unsigned char b) {
+  const uint64_t mask = (uint64_t) 0 - b;
+  f[0] ^= mask & (f[0] ^ g[0]);
+  f[1] ^= mask & (f[1] ^ g[1]);
+  f[2] ^= mask & (f[2] ^ g[2]);
+  f[3] ^= mask & (f[3] ^ g[3]);
+  f[4] ^= mask & (f[4] ^ g[4]);
+}
+
+static void ge51_cached_0(ge51_cached *r) {
+  fe51_1(r->YplusX);
+  fe51_1(r->YminusX);
+  fe51_1(r->Z);
+  fe51_0(r->T2d);
+}
+
+static void ge51_cached_cmov(ge51_cached *t, const ge51_cached *u, unsigned char b) {
+  fe51_cmov(t->YplusX, u->YplusX, b);
+  fe51_cmov(t->YminusX, u->YminusX, b);
+  fe51_cmov(t->Z, u->Z, b);
+  fe51_cmov(t->T2d, u->T2d, b);
+}
+
+static unsigned char equal(signed char b, signed char c) {
+  unsigned char ub = b;
+  unsigned char uc = c;
+  unsigned char x = ub ^ uc; /* 0: yes; 1..255: no */
+  uint32_t y = x; /* 0: yes; 1..255: no */
+  y -= 1; /* 4294967295: yes; 0..254: no */
+  y >>= 31; /* 1: yes; 0: no */
+  return y;
+}
+
+static unsigned char negative(signed char b) {
+  unsigned long long x = b; /* 18446744073709551361..18446744073709551615: yes; 0..255: no */
+  x >>= 63; /* 1: yes; 0: no */
+  return x;
+}
+
+/* Same recoding as slide in crypto-ops.c */
+static void slide(signed char *r, const unsigned char *a) {
+  int i;
+  int b;
+  int k;
+
+  for (i = 0; i < 256; ++i) {
+    r[i] = 1 & (a[i >> 3] >> (i & 7));
+  }
+
+  for (i = 0; i < 256; ++i) {
+    if (r[i]) {
+      for (b = 1; b <= 6 && i + b < 256; ++b) {
+        if (r[i + b]) {
+          if (r[i] + (r[i + b] << b) <= 15) {
+            r[i] += r[i + b] << b; r[i + b] = 0;
+          } else if (r[i] - (r[i + b] << b) >= -15) {
+            r[i] -= r[i + b] << b;
+            for (k = i + b; k < 256; ++k) {
+              if (!r[k]) {
+                r[k] = 1;
+                break;
+              }
+              r[k] = 0;
+            }
+          } else
+            break;
+        }
+      }
+    }
+  }
+}
+
+/* Constant time, same recoding and table lookups as ge_scalarmult */
+static void ge51_scalarmult(ge51_p2 *r, const unsigned char *a, const ge51_p3 *A) {
+  signed char e[64];
+  int carry, carry2, i;
+  ge51_cached Ai[8]; /* 1 * A, 2 * A, ..., 8 * A */
+  ge51_p1p1 t;
+  ge51_p3 u;
+
+  carry = 0; /* 0..1 */
+  for (i = 0; i < 31; i++) {
+    carry += a[i]; /* 0..256 */
+    carry2 = (carry + 8) >> 4; /* 0..16 */
+    e[2 * i] = carry - (carry2 << 4); /* -8..7 */
+    carry = (carry2 + 8) >> 4; /* 0..1 */
+    e[2 * i + 1] = carry2 - (carry << 4); /* -8..7 */
+  }
+  carry += a[31]; /* 0..128 */
+  carry2 = (carry + 8) >> 4; /* 0..8 */
+  e[62] = carry - (carry2 << 4); /* -8..7 */
+  e[63] = carry2; /* 0..8 */
+
+  ge51_p3_to_cached(&Ai[0], A);
+  for (i = 0; i < 7; i++) {
+    ge51_add(&t, A, &Ai[i]);
+    ge51_p1p1_to_p3(&u, &t);
+    ge51_p3_to_cached(&Ai[i + 1], &u);
+  }
+
+  ge51_p2_0(r);
+  for (i = 63; i >= 0; i--) {
+    signed char b = e[i];
+    unsigned char bnegative = negative(b);
+    unsigned char babs = b - (((-bnegative) & b) << 1);
+    ge51_cached cur, minuscur;
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p2(r, &t);
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p2(r, &t);
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p2(r, &t);
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p3(&u, &t);
+    ge51_cached_0(&cur);
+    ge51_cached_cmov(&cur, &Ai[0], equal(babs, 1));
+    ge51_cached_cmov(&cur, &Ai[1], equal(babs, 2));
+    ge51_cached_cmov(&cur, &Ai[2], equal(babs, 3));
+    ge51_cached_cmov(&cur, &Ai[3], equal(babs, 4));
+    ge51_cached_cmov(&cur, &Ai[4], equal(babs, 5));
+    ge51_cached_cmov(&cur, &Ai[5], equal(babs, 6));
+    ge51_cached_cmov(&cur, &Ai[6], equal(babs, 7));
+    ge51_cached_cmov(&cur, &Ai[7], equal(babs, 8));
+    fe51_copy(minuscur.YplusX, cur.YminusX);
+    fe51_copy(minuscur.YminusX, cur.YplusX);
+    fe51_copy(minuscur.Z, cur.Z);
+    fe51_neg(minuscur.T2d, cur.T2d);
+    ge51_cached_cmov(&cur, &minuscur, bnegative);
+    ge51_add(&t, &u, &cur);
+    ge51_p1p1_to_p2(r, &t);
+  }
+}
+
+/* Same recoding and table layout as ge_double_scalarmult_base_vartime */
+static void ge51_double_scalarmult_base_vartime(ge51_p2 *r, const unsigned char *a, const ge51_p3 *A, const unsigned char *b) {
+  signed char aslide[256];
+  signed char bslide[256];
+  ge51_cached Ai[8]; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+  ge51_p1p1 t;
+  ge51_p3 u, A2;
+  int i;
+
+  slide(aslide, a);
+  slide(bslide, b);
+
+  ge51_p3_to_cached(&Ai[0], A);
+  ge51_p3_dbl(&t, A); ge51_p1p1_to_p3(&A2, &t);
+  for (i = 0; i < 7; i++) {
+    ge51_add(&t, &A2, &Ai[i]); ge51_p1p1_to_p3(&u, &t); ge51_p3_to_cached(&Ai[i + 1], &u);
+  }
+
+  ge51_p2_0(r);
+
+  for (i = 255; i >= 0; --i) {
+    if (aslide[i] || bslide[i]) break;
+  }
+
+  for (; i >= 0; --i) {
+    ge51_p2_dbl(&t, r);
+
+    if (aslide[i] > 0) {
+      ge51_p1p1_to_p3(&u, &t);
+      ge51_add(&t, &u, &Ai[aslide[i]/2]);
+    } else if (aslide[i] < 0) {
+      ge51_p1p1_to_p3(&u, &t);
+      ge51_sub(&t, &u, &Ai[(-aslide[i])/2]);
+    }
+
+    if (bslide[i] > 0) {
+      ge51_p1p1_to_p3(&u, &t);
+      ge51_madd(&t, &u, &ge51_Bi[bslide[i]/2]);
+    } else if (bslide[i] < 0) {
+      ge51_p1p1_to_p3(&u, &t);
+      ge51_msub(&t, &u, &ge51_Bi[(-bslide[i])/2]);
+    }
+
+    ge51_p1p1_to_p2(r, &t);
+  }
+}
+
+static void ge51_scalarmult_p2(ge51_p2 *r, const unsigned char *a, const ge51_p3 *A, int mul8) {
+  ge51_p1p1 t;
+  ge51_scalarmult(r, a, A);
+  if (mul8) {
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p2(r, &t);
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p2(r, &t);
+    ge51_p2_dbl(&t, r);
+    ge51_p1p1_to_p2(r, &t);
+  }
+}
+
+/* Encodes n points sharing a single field inversion (Montgomery's trick); the Z are never zero */
+static void ge51_tobytes_batch(unsigned char *s, const ge51_p2 *h, fe51 *scratch, size_t n) {
+  fe51 inv, recip, x, y;
+  size_t i;
+
+  fe51_copy(scratch[0], h[0].Z);
+  for (i = 1; i < n; ++i) {
+    fe51_mul(scratch[i], scratch[i - 1], h[i].Z);
+  }
+  fe51_invert(inv, scratch[n - 1]);
+  for (i = n; i-- > 0; ) {
+    if (i > 0) {
+      fe51_mul(recip, inv, scratch[i - 1]);
+      fe51_mul(inv, inv, h[i].Z);
+    } else {
+      fe51_copy(recip, inv);
+    }
+    fe51_mul(x, h[i].X, recip);
+    fe51_mul(y, h[i].Y, recip);
+    fe51_tobytes(s + 32 * i, y);
+    s[32 * i + 31] ^= fe51_isnegative(x) << 7;
+  }
+}
+
+static int use_fe51(void)
+{
+  static int use = -1;
+
+  if (use != -1)
+    return use;
+
+  const char *env = getenv("MONERO_USE_FE51");
+  if (!env) {
+    use = 1;
+  }
+  else if (!strcmp(env, "0") || !strcmp(env, "no")) {
+    use = 0;
+  }
+  else {
+    use = 1;
+  }
+  return use;
+}
+
+#endif
+
+int ge_scalarmult_tobytes(unsigned char *r, const unsigned char *a, const unsigned char *A, int mul8) {
+#ifdef HAVE_FE51
+  if (use_fe51()) {
+    ge51_p3 point;
+    ge51_p2 point2;
+    if (ge51_frombytes_vartime(&point, A) != 0) {
+      return -1;
+    }
+    ge51_scalarmult_p2(&point2, a, &point, mul8);
+    ge51_tobytes(r, &point2);
+    return 0;
+  }
+#endif
+  {
+    ge_p3 point;
+    ge_p2 point2;
+    ge_p1p1 point3;
+    if (ge_frombytes_vartime(&point, A) != 0) {
+      return -1;
+    }
+    ge_scalarmult(&point2, a, &point);
+    if (mul8) {
+      ge_mul8(&point3, &point2);
+      ge_p1p1_to_p2(&point2, &point3);
+    }
+    ge_tobytes(r, &point2);
+    return 0;
+  }
+}
+
+int ge_double_scalarmult_base_vartime_tobytes(unsigned char *r, const unsigned char *a, const unsigned char *A, const unsigned char *b) {
+#ifdef HAVE_FE51
+  if (use_fe51()) {
+    ge51_p3 point;
+    ge51_p2 point2;
+    if (ge51_frombytes_vartime(&point, A) != 0) {
+      return -1;
+    }
+    ge51_double_scalarmult_base_vartime(&point2, a, &point, b);
+    ge51_tobytes(r, &point2);
+    return 0;
+  }
+#endif
+  {
+    ge_p3 point;
+    ge_p2 point2;
+    if (ge_frombytes_vartime(&point, A) != 0) {
+      return -1;
+    }
+    ge_double_scalarmult_base_vartime(&point2, a, &point, b);
+    ge_tobytes(r, &point2);
+    return 0;
+  }
+}
+
+void ge_scalarmult_tobytes_batch(unsigned char *r, const unsigned char *a, const unsigned char *A, size_t n, int mul8, unsigned char *valid) {
+  size_t i;
+#ifdef HAVE_FE51
+  if (use_fe51() && n > 1) {
+    ge51_p2 *points = (ge51_p2*) malloc(n * sizeof(ge51_p2));
+    fe51 *scratch = (fe51*) malloc(n * sizeof(fe51));
+    if (points && scratch) {
+      for (i = 0; i < n; ++i) {
+        ge51_p3 point;
+        valid[i] = ge51_frombytes_vartime(&point, A + 32 * i) == 0;
+        if (valid[i]) {
+          ge51_scalarmult_p2(&points[i], a, &point, mul8);
+        } else {
+          /* keep the running product invertible */
+          ge51_p2_0(&points[i]);
+        }
+      }
+      ge51_tobytes_batch(r, points, scratch, n);
+      for (i = 0; i < n; ++i) {
+        if (!valid[i]) {
+          memset(r + 32 * i, 0, 32);
+        }
+      }
+      memset(points, 0, n * sizeof(ge51_p2));
+      free(points);
+      free(scratch);
+      return;
+    }
+    free(points);
+    free(scratch);
+  }
+#endif
+  for (i = 0; i < n; ++i) {
+    valid[i] = ge_scalarmult_tobytes(r + 32 * i, a, A + 32 * i, mul8) == 0;
+    if (!valid[i]) {
+      memset(r + 32 * i, 0, 32);
+    }
+  }
+}
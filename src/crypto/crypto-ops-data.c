@@ -28,6 +28,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "crypto-ops.h"
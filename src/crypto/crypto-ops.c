@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "warnings.h"
@@ -30,6 +30,8 @@
 
 #pragma once
 
+#include <stddef.h>
+
 /* From fe.h */
 
 typedef int32_t fe[10];
@@ -135,6 +137,11 @@ void ge_triple_scalarmult_precomp_vartime(ge_p2 *, const unsigned char *, const
 void ge_double_scalarmult_precomp_vartime2(ge_p2 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
 void ge_double_scalarmult_precomp_vartime2_p3(ge_p3 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
 void ge_mul8(ge_p1p1 *, const ge_p2 *);
+
+/* From crypto-ops-64.c: decode, multiply and encode in one go, on the fastest available backend */
+int ge_scalarmult_tobytes(unsigned char *, const unsigned char *, const unsigned char *, int);
+int ge_double_scalarmult_base_vartime_tobytes(unsigned char *, const unsigned char *, const unsigned char *, const unsigned char *);
+void ge_scalarmult_tobytes_batch(unsigned char *, const unsigned char *, const unsigned char *, size_t, int, unsigned char *);
 extern const fe fe_ma2;
 extern const fe fe_ma;
 extern const fe fe_fffb1;
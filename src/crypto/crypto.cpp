@@ -188,18 +188,18 @@ namespace crypto {
   }
 
   bool crypto_ops::generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
-    ge_p3 point;
-    ge_p2 point2;
-    ge_p1p1 point3;
     assert(sc_check(&key2) == 0);
-    if (ge_frombytes_vartime(&point, &key1) != 0) {
-      return false;
-    }
-    ge_scalarmult(&point2, &unwrap(key2), &point);
-    ge_mul8(&point3, &point2);
-    ge_p1p1_to_p2(&point2, &point3);
-    ge_tobytes(&derivation, &point2);
-    return true;
+    return ge_scalarmult_tobytes(&derivation, &unwrap(key2), &key1, 1) == 0;
+  }
+
+  void crypto_ops::generate_key_derivations(const std::vector<public_key> &keys1, const secret_key &key2, std::vector<key_derivation> &derivations, std::vector<uint8_t> &valid) {
+    static_assert(sizeof(public_key) == 32 && sizeof(key_derivation) == 32, "Unexpected key sizes");
+    assert(sc_check(&key2) == 0);
+    derivations.resize(keys1.size());
+    valid.resize(keys1.size());
+    if (keys1.empty())
+      return;
+    ge_scalarmult_tobytes_batch(&derivations[0], &unwrap(key2), &keys1[0], keys1.size(), 1, valid.data());
   }
 
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
@@ -317,21 +317,17 @@ namespace crypto {
   }
 
   bool crypto_ops::check_signature(const hash &prefix_hash, const public_key &pub, const signature &sig) {
-    ge_p2 tmp2;
-    ge_p3 tmp3;
     ec_scalar c;
     s_comm buf;
     assert(check_key(pub));
     buf.h = prefix_hash;
     buf.key = pub;
-    if (ge_frombytes_vartime(&tmp3, &pub) != 0) {
+    if (sc_check(&sig.c) != 0 || sc_check(&sig.r) != 0 || !sc_isnonzero(&sig.c)) {
       return false;
     }
-    if (sc_check(&sig.c) != 0 || sc_check(&sig.r) != 0 || !sc_isnonzero(&sig.c)) {
+    if (ge_double_scalarmult_base_vartime_tobytes(&buf.comm, &sig.c, &pub, &sig.r) != 0) {
       return false;
     }
-    ge_double_scalarmult_base_vartime(&tmp2, &sig.c, &tmp3, &sig.r);
-    ge_tobytes(&buf.comm, &tmp2);
     static const ec_point infinity = {{ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
     if (memcmp(&buf.comm, &infinity, 32) == 0)
       return false;
@@ -773,4 +769,28 @@ POP_WARNINGS
     static_assert(sizeof(crypto::view_tag) <= sizeof(view_tag_full), "view tag should not be larger than hash result");
     memcpy(&view_tag, &view_tag_full, sizeof(crypto::view_tag));
   }
+
+  void crypto_ops::derive_view_tags(const key_derivation &derivation, size_t first_output_index, size_t count, view_tag *view_tags) {
+    #pragma pack(push, 1)
+    struct {
+      char salt[8]; // view tag domain-separator
+      key_derivation derivation;
+      char output_index[(sizeof(size_t) * 8 + 6) / 7];
+    } buf;
+    #pragma pack(pop)
+
+    // the salt and derivation are shared by all outputs, only the varint index changes
+    memcpy(buf.salt, "view_tag", 8); // leave off null terminator
+    buf.derivation = derivation;
+    hash view_tag_full;
+    for (size_t i = 0; i < count; ++i)
+    {
+      char *end = buf.output_index;
+      tools::write_varint(end, first_output_index + i);
+      assert(end <= buf.output_index + sizeof buf.output_index);
+      cn_fast_hash(&buf, end - reinterpret_cast<char *>(&buf), view_tag_full);
+      memcpy(&view_tags[i], &view_tag_full, sizeof(crypto::view_tag));
+    }
+    memwipe(&buf, sizeof(buf));
+  }
 }
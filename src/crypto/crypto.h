@@ -127,6 +127,8 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static void generate_key_derivations(const std::vector<public_key> &, const secret_key &, std::vector<key_derivation> &, std::vector<uint8_t> &);
+    friend void generate_key_derivations(const std::vector<public_key> &, const secret_key &, std::vector<key_derivation> &, std::vector<uint8_t> &);
     static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
@@ -157,6 +159,8 @@ namespace crypto {
       const public_key *const *, std::size_t, const signature *);
     static void derive_view_tag(const key_derivation &, std::size_t, view_tag &);
     friend void derive_view_tag(const key_derivation &, std::size_t, view_tag &);
+    static void derive_view_tags(const key_derivation &, std::size_t, std::size_t, view_tag *);
+    friend void derive_view_tags(const key_derivation &, std::size_t, std::size_t, view_tag *);
   };
 
   void generate_random_bytes_thread_safe(size_t N, uint8_t *bytes);
@@ -232,6 +236,12 @@ namespace crypto {
   inline bool generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
     return crypto_ops::generate_key_derivation(key1, key2, derivation);
   }
+  /* As generate_key_derivation, for many public keys with one secret key, sharing the cost of point compression.
+   * valid[i] is set when keys1[i] is a valid point; derivations[i] is only meaningful then.
+   */
+  inline void generate_key_derivations(const std::vector<public_key> &keys1, const secret_key &key2, std::vector<key_derivation> &derivations, std::vector<uint8_t> &valid) {
+    crypto_ops::generate_key_derivations(keys1, key2, derivations, valid);
+  }
   inline bool derive_public_key(const key_derivation &derivation, std::size_t output_index,
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
@@ -313,6 +323,13 @@ namespace crypto {
     crypto_ops::derive_view_tag(derivation, output_index, vt);
   }
 
+  /* Derive the view tags of count consecutive outputs starting at first_output_index, all sharing
+   * the same derivation. Equivalent to calling derive_view_tag for each index in turn.
+   */
+  inline void derive_view_tags(const key_derivation &derivation, std::size_t first_output_index, std::size_t count, view_tag *vts) {
+    crypto_ops::derive_view_tags(derivation, first_output_index, count, vts);
+  }
+
   inline std::ostream &operator <<(std::ostream &o, const crypto::public_key &v) {
     epee::to_hex::formatted(o, epee::as_byte_span(v)); return o;
   }
@@ -99,7 +99,12 @@ uint64_t rx_seedheight(const uint64_t height);
 void rx_seedheights(const uint64_t height, uint64_t *seed_height, uint64_t *next_height);
 
 void rx_set_main_seedhash(const char *seedhash, size_t max_dataset_init_threads);
+void rx_prepare_next_seedhash(const char *seedhash, size_t max_dataset_init_threads);
+size_t rx_dataset_file_header_size(void);
+void rx_make_dataset_file_header(const char *seedhash, const void *data, uint64_t item_count, void *header);
+int rx_check_dataset_file(const void *header, const void *data, uint64_t item_count, const char *seedhash);
 void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash);
+void rx_slow_hash_batch(const char *seedhash, size_t count, const void *const *data, const size_t *lengths, char *result_hashes, uint64_t *elapsed_us);
 
 void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads);
 uint32_t rx_get_miner_thread(void);
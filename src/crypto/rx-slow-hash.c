@@ -35,6 +35,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <errno.h>
+#include <time.h>
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "randomx.h"
 #include "c_threads.h"
@@ -287,6 +295,7 @@ static void rx_init_light_vm(randomx_flags flags, randomx_vm** vm, randomx_cache
 }
 
 typedef struct seedinfo {
+  randomx_dataset *si_dataset;
   randomx_cache *si_cache;
   unsigned long si_start;
   unsigned long si_count;
@@ -294,14 +303,11 @@ typedef struct seedinfo {
 
 static CTHR_THREAD_RTYPE rx_seedthread(void *arg) {
   seedinfo *si = arg;
-  randomx_init_dataset(main_dataset, si->si_cache, si->si_start, si->si_count);
+  randomx_init_dataset(si->si_dataset, si->si_cache, si->si_start, si->si_count);
   CTHR_THREAD_RETURN;
 }
 
-static void rx_init_dataset(size_t max_threads) {
-  if (!main_dataset) {
-    return;
-  }
+static void rx_compute_dataset(randomx_dataset *dataset, randomx_cache *cache, size_t max_threads) {
 
   // leave 2 CPU cores for other tasks
   const size_t num_threads = (max_threads < 4) ? 1 : (max_threads - 2);
@@ -313,33 +319,284 @@ static void rx_init_dataset(size_t max_threads) {
 
   const size_t n1 = num_threads - 1;
   for (size_t i = 0; i < n1; ++i) {
-    si[i].si_cache = main_cache;
+    si[i].si_dataset = dataset;
+    si[i].si_cache = cache;
     si[i].si_start = start;
     si[i].si_count = delta;
     start += delta;
   }
 
-  si[n1].si_cache = main_cache;
+  si[n1].si_dataset = dataset;
+  si[n1].si_cache = cache;
   si[n1].si_start = start;
   si[n1].si_count = randomx_dataset_item_count() - start;
 
   CTHR_THREAD_TYPE *st = malloc(num_threads * sizeof(CTHR_THREAD_TYPE));
   if (!st) local_abort("Couldn't allocate RandomX mining threadlist");
 
-  CTHR_RWLOCK_LOCK_READ(main_cache_lock);
   for (size_t i = 0; i < n1; ++i) {
     if (!CTHR_THREAD_CREATE(st[i], rx_seedthread, &si[i])) {
       local_abort("Couldn't start RandomX seed thread");
     }
   }
-  randomx_init_dataset(main_dataset, si[n1].si_cache, si[n1].si_start, si[n1].si_count);
+  randomx_init_dataset(dataset, si[n1].si_cache, si[n1].si_start, si[n1].si_count);
   for (size_t i = 0; i < n1; ++i) CTHR_THREAD_JOIN(st[i]);
-  CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
 
   free(st);
   free(si);
+}
+
+/* On-disk dataset cache, enabled by pointing MONERO_RANDOMX_DATASET_CACHE at a directory.
+ * Each file holds the dataset for one seed hash, so restarts and epoch switches to a seed
+ * prepared in advance (see rx_prepare_next_seedhash) only need to read it back.
+ * Files are trusted no more than needed: on load, the whole payload must match the hash
+ * stored in the header, and a sample of items is recomputed from the cache and compared.
+ * Any mismatch falls back to computing the whole dataset.
+ */
+#define RX_DATASET_FILE_MAGIC	"RXDATSET"
+#define RX_DATASET_FILE_VERSION	2
+#define RX_DATASET_CHECK_ITEMS	32
+
+typedef struct rx_dataset_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t item_size;
+  uint64_t item_count;
+  char seedhash[HASH_SIZE];
+  char data_hash[HASH_SIZE];
+} rx_dataset_file_header;
+
+static const char *dataset_cache_dir(void) {
+  static int checked = 0;
+  static const char *dir = NULL;
+  if (!checked) {
+    dir = getenv("MONERO_RANDOMX_DATASET_CACHE");
+    if (dir && !*dir)
+      dir = NULL;
+    checked = 1;
+  }
+  return dir;
+}
+
+static int dataset_cache_filename(const char *seedhash, char *filename, size_t len) {
+  char hex[HASH_SIZE * 2 + 1];
+  hash2hex(seedhash, hex);
+  const int n = snprintf(filename, len, "%s/rx-dataset-%s.bin", dataset_cache_dir(), hex);
+  return n > 0 && (size_t)n < len;
+}
+
+size_t rx_dataset_file_header_size(void) {
+  return sizeof(rx_dataset_file_header);
+}
+
+void rx_make_dataset_file_header(const char *seedhash, const void *data, uint64_t item_count, void *header) {
+  rx_dataset_file_header *h = header;
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, RX_DATASET_FILE_MAGIC, sizeof(h->magic));
+  h->version = RX_DATASET_FILE_VERSION;
+  h->item_size = RANDOMX_DATASET_ITEM_SIZE;
+  h->item_count = item_count;
+  memcpy(h->seedhash, seedhash, HASH_SIZE);
+  cn_fast_hash(data, (size_t)item_count * RANDOMX_DATASET_ITEM_SIZE, h->data_hash);
+}
+
+int rx_check_dataset_file(const void *header, const void *data, uint64_t item_count, const char *seedhash) {
+  rx_dataset_file_header h;
+  memcpy(&h, header, sizeof(h));
+  if (memcmp(h.magic, RX_DATASET_FILE_MAGIC, sizeof(h.magic)) || h.version != RX_DATASET_FILE_VERSION
+      || h.item_size != RANDOMX_DATASET_ITEM_SIZE || h.item_count != item_count || memcmp(h.seedhash, seedhash, HASH_SIZE))
+    return 0;
+  char data_hash[HASH_SIZE];
+  cn_fast_hash(data, (size_t)item_count * RANDOMX_DATASET_ITEM_SIZE, data_hash);
+  return memcmp(data_hash, h.data_hash, HASH_SIZE) == 0;
+}
+
+// Recomputes a sample of items from the cache and checks they match what was loaded
+static int rx_check_dataset(randomx_dataset *dataset, randomx_cache *cache) {
+  unsigned char *mem = randomx_get_dataset_memory(dataset);
+  const uint64_t item_count = randomx_dataset_item_count();
+  uint64_t x = ((uint64_t)time(NULL) << 32) ^ (uintptr_t)mem ^ 0x9e3779b97f4a7c15ull;
+  for (int i = 0; i < RX_DATASET_CHECK_ITEMS; ++i) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    const uint64_t item = i == 0 ? 0 : i == 1 ? item_count - 1 : x % item_count;
+    unsigned char loaded[RANDOMX_DATASET_ITEM_SIZE];
+    memcpy(loaded, mem + item * RANDOMX_DATASET_ITEM_SIZE, sizeof(loaded));
+    randomx_init_dataset(dataset, cache, item, 1);
+    if (memcmp(loaded, mem + item * RANDOMX_DATASET_ITEM_SIZE, sizeof(loaded)))
+      return 0;
+  }
+  return 1;
+}
+
+static int rx_load_dataset(randomx_dataset *dataset, randomx_cache *cache, const char *seedhash) {
+  char filename[PATH_MAX];
+  if (!dataset_cache_dir() || !dataset_cache_filename(seedhash, filename, sizeof(filename)))
+    return 0;
+
+  const uint64_t item_count = randomx_dataset_item_count();
+  const size_t data_size = (size_t)item_count * RANDOMX_DATASET_ITEM_SIZE;
+  unsigned char *mem = randomx_get_dataset_memory(dataset);
+  rx_dataset_file_header header;
+  int ok = 0;
+
+#ifndef _WIN32
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (uint64_t)st.st_size == sizeof(header) + data_size) {
+    void *map = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // only succeeds if the cache directory is on hugetlbfs
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_HUGETLB, fd, 0);
+#endif
+    if (map == MAP_FAILED) {
+      int map_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+      map_flags |= MAP_POPULATE;
+#endif
+      map = mmap(NULL, st.st_size, PROT_READ, map_flags, fd, 0);
+    }
+    if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+      memcpy(&header, map, sizeof(header));
+      memcpy(mem, (const unsigned char*)map + sizeof(header), data_size);
+      ok = 1;
+      munmap(map, st.st_size);
+    }
+  }
+  close(fd);
+#else
+  FILE *f = fopen(filename, "rb");
+  if (!f)
+    return 0;
+  ok = fread(&header, sizeof(header), 1, f) == 1 && fread(mem, 1, data_size, f) == data_size && fgetc(f) == EOF;
+  fclose(f);
+#endif
+
+  // checked on the copy that will be used, not on the file
+  if (ok && !rx_check_dataset_file(&header, mem, item_count, seedhash)) {
+    merror(RX_LOGCAT, "RandomX dataset file %s is corrupt or stale, ignoring it", filename);
+    ok = 0;
+  }
+  if (ok && !rx_check_dataset(dataset, cache)) {
+    merror(RX_LOGCAT, "RandomX dataset file %s does not match its seed hash, ignoring it", filename);
+    ok = 0;
+  }
+  if (!ok) {
+    mwarning(RX_LOGCAT, "Failed to load RandomX dataset from %s", filename);
+    remove(filename);
+    return 0;
+  }
+  minfo(RX_LOGCAT, "RandomX dataset loaded from %s", filename);
+  return 1;
+}
+
+static void rx_store_dataset(randomx_dataset *dataset, const char *seedhash) {
+  char filename[PATH_MAX], tmp_filename[PATH_MAX + 32];
+  if (!dataset_cache_dir() || !dataset_cache_filename(seedhash, filename, sizeof(filename)))
+    return;
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.%lu.tmp", filename, (unsigned long)getpid());
+
+  const uint64_t item_count = randomx_dataset_item_count();
+  const size_t data_size = (size_t)item_count * RANDOMX_DATASET_ITEM_SIZE;
+  rx_dataset_file_header header;
+  rx_make_dataset_file_header(seedhash, randomx_get_dataset_memory(dataset), item_count, &header);
+
+  FILE *f = fopen(tmp_filename, "wb");
+  if (!f) {
+    mwarning(RX_LOGCAT, "Failed to create RandomX dataset file %s: %s", tmp_filename, strerror(errno));
+    return;
+  }
+  int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  ok = ok && fwrite(randomx_get_dataset_memory(dataset), 1, data_size, f) == data_size;
+  ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+  remove(filename);
+#endif
+  if (!ok || rename(tmp_filename, filename) != 0) {
+    mwarning(RX_LOGCAT, "Failed to write RandomX dataset file %s", filename);
+    remove(tmp_filename);
+    return;
+  }
+  minfo(RX_LOGCAT, "RandomX dataset saved to %s", filename);
+}
+
+static CTHR_RWLOCK_TYPE next_seedhash_lock = CTHR_RWLOCK_INIT;
+static char next_seedhash[HASH_SIZE];
+static int next_seedhash_set = 0;
+static int next_dataset_busy = 0;
+
+// Removes dataset files for seeds other than the main and next ones
+static void rx_prune_dataset_cache(void) {
+#ifndef _WIN32
+  const char *dir = dataset_cache_dir();
+  if (!dir)
+    return;
+  char keep[2][sizeof("rx-dataset-.bin") + HASH_SIZE * 2];
+  char hex[HASH_SIZE * 2 + 1];
+  keep[0][0] = keep[1][0] = '\0';
+  if (main_seedhash_set) {
+    hash2hex(main_seedhash, hex);
+    snprintf(keep[0], sizeof(keep[0]), "rx-dataset-%s.bin", hex);
+  }
+  CTHR_RWLOCK_LOCK_WRITE(next_seedhash_lock);
+  if (next_seedhash_set && is_main(next_seedhash) && !next_dataset_busy)
+    next_seedhash_set = 0; // the next seed is now the main one
+  if (next_seedhash_set) {
+    hash2hex(next_seedhash, hex);
+    snprintf(keep[1], sizeof(keep[1]), "rx-dataset-%s.bin", hex);
+  }
+  CTHR_RWLOCK_UNLOCK_WRITE(next_seedhash_lock);
+
+  DIR *d = opendir(dir);
+  if (!d)
+    return;
+  struct dirent *e;
+  while ((e = readdir(d))) {
+    const size_t len = strlen(e->d_name);
+    if (len != sizeof(keep[0]) - 1 || strncmp(e->d_name, "rx-dataset-", 11) || strcmp(e->d_name + len - 4, ".bin"))
+      continue;
+    if (!strcmp(e->d_name, keep[0]) || !strcmp(e->d_name, keep[1]))
+      continue;
+    char filename[PATH_MAX];
+    if (snprintf(filename, sizeof(filename), "%s/%s", dir, e->d_name) < (int)sizeof(filename)) {
+      minfo(RX_LOGCAT, "Removing stale RandomX dataset file %s", filename);
+      remove(filename);
+    }
+  }
+  closedir(d);
+#endif
+}
+
+// Returns 1 if the dataset was computed rather than loaded, and should be stored once unlocked
+static int rx_init_dataset(size_t max_threads) {
+  if (!main_dataset) {
+    return 0;
+  }
+
+  CTHR_RWLOCK_LOCK_READ(main_cache_lock);
+  const int loaded = main_seedhash_set && rx_load_dataset(main_dataset, main_cache, main_seedhash);
+  if (!loaded)
+    rx_compute_dataset(main_dataset, main_cache, max_threads);
+  CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
 
   minfo(RX_LOGCAT, "RandomX dataset initialized");
+  if (loaded)
+    rx_prune_dataset_cache();
+  return !loaded && main_seedhash_set && dataset_cache_dir();
+}
+
+// Called without main_dataset_lock held, hashing can go on while the dataset is written out
+static void rx_store_main_dataset(const char *seedhash) {
+  CTHR_RWLOCK_LOCK_READ(main_dataset_lock);
+  if (main_dataset && is_main(seedhash)) {
+    rx_store_dataset(main_dataset, seedhash);
+    rx_prune_dataset_cache();
+  }
+  CTHR_RWLOCK_UNLOCK_READ(main_dataset_lock);
 }
 
 typedef struct thread_info {
@@ -377,10 +634,13 @@ static CTHR_THREAD_RTYPE rx_set_main_seedhash_thread(void *arg) {
   CTHR_RWLOCK_UNLOCK_WRITE(main_cache_lock);
 
   // From this point, rx_slow_hash can calculate hashes in light mode, but dataset is not initialized yet
-  rx_init_dataset(info->max_threads);
+  const int store = rx_init_dataset(info->max_threads);
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
 
+  if (store)
+    rx_store_main_dataset(info->seedhash);
+
   free(info);
   CTHR_THREAD_RETURN;
 }
@@ -405,6 +665,67 @@ void rx_set_main_seedhash(const char *seedhash, size_t max_dataset_init_threads)
   CTHR_THREAD_CLOSE(t);
 }
 
+static CTHR_THREAD_RTYPE rx_prepare_next_seedhash_thread(void *arg) {
+  thread_info* info = arg;
+
+  char filename[PATH_MAX];
+  if (dataset_cache_filename(info->seedhash, filename, sizeof(filename)) && access(filename, F_OK) != 0) {
+    char buf[HASH_SIZE * 2 + 1];
+    hash2hex(info->seedhash, buf);
+    minfo(RX_LOGCAT, "RandomX preparing dataset for next seed hash %s", buf);
+
+    const randomx_flags flags = enabled_flags() & ~disabled_flags();
+    randomx_cache *cache = NULL;
+    randomx_dataset *dataset = NULL;
+    rx_alloc_cache(flags, &cache);
+    rx_alloc_dataset(flags, &dataset, 1);
+    if (dataset) {
+      randomx_init_cache(cache, info->seedhash, HASH_SIZE);
+      rx_compute_dataset(dataset, cache, info->max_threads);
+      rx_store_dataset(dataset, info->seedhash);
+      randomx_release_dataset(dataset);
+    }
+    randomx_release_cache(cache);
+  }
+
+  CTHR_RWLOCK_LOCK_WRITE(next_seedhash_lock);
+  next_dataset_busy = 0;
+  CTHR_RWLOCK_UNLOCK_WRITE(next_seedhash_lock);
+
+  free(info);
+  CTHR_THREAD_RETURN;
+}
+
+void rx_prepare_next_seedhash(const char *seedhash, size_t max_dataset_init_threads) {
+  // Only useful when datasets are in use and can be handed over through the dataset cache
+  if (!dataset_cache_dir() || !main_dataset || is_main(seedhash)) {
+    return;
+  }
+
+  CTHR_RWLOCK_LOCK_WRITE(next_seedhash_lock);
+  if (next_dataset_busy || (next_seedhash_set && memcmp(seedhash, next_seedhash, HASH_SIZE) == 0)) {
+    CTHR_RWLOCK_UNLOCK_WRITE(next_seedhash_lock);
+    return;
+  }
+  memcpy(next_seedhash, seedhash, HASH_SIZE);
+  next_seedhash_set = 1;
+  next_dataset_busy = 1;
+  CTHR_RWLOCK_UNLOCK_WRITE(next_seedhash_lock);
+
+  thread_info* info = malloc(sizeof(thread_info));
+  if (!info) local_abort("Couldn't allocate RandomX mining threadinfo");
+
+  memcpy(info->seedhash, seedhash, HASH_SIZE);
+  // stay in the background, the current dataset is still in use until the switch
+  info->max_threads = max_dataset_init_threads / 2;
+
+  CTHR_THREAD_TYPE t;
+  if (!CTHR_THREAD_CREATE(t, rx_prepare_next_seedhash_thread, info)) {
+    local_abort("Couldn't start RandomX seed thread");
+  }
+  CTHR_THREAD_CLOSE(t);
+}
+
 void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash) {
   const randomx_flags flags = enabled_flags() & ~disabled_flags();
   int success = 0;
@@ -487,6 +808,144 @@ void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *r
   CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
 }
 
+/* VMs for rx_slow_hash_batch. Unlike the thread local ones used by rx_slow_hash, these are not
+ * tied to a thread, so they survive the end of a verification job and are shared by whichever
+ * threadpool threads pick up the next one. Full VMs all use main_dataset, which is reinitialized
+ * in place on seed changes, and light VMs get pointed at the right cache when borrowed.
+ */
+typedef struct rx_vm_node {
+  randomx_vm *vm;
+  struct rx_vm_node *next;
+} rx_vm_node;
+
+static CTHR_RWLOCK_TYPE vm_pool_lock = CTHR_RWLOCK_INIT;
+static rx_vm_node *full_vm_pool = NULL;
+static rx_vm_node *light_vm_pool = NULL;
+
+static rx_vm_node *rx_vm_pool_get(rx_vm_node **pool) {
+  CTHR_RWLOCK_LOCK_WRITE(vm_pool_lock);
+  rx_vm_node *node = *pool;
+  if (node)
+    *pool = node->next;
+  CTHR_RWLOCK_UNLOCK_WRITE(vm_pool_lock);
+  if (!node) {
+    node = calloc(1, sizeof(rx_vm_node));
+    if (!node) local_abort("Couldn't allocate RandomX VM pool entry");
+  }
+  return node;
+}
+
+static void rx_vm_pool_put(rx_vm_node **pool, rx_vm_node *node) {
+  if (!node->vm) {
+    free(node);
+    return;
+  }
+  CTHR_RWLOCK_LOCK_WRITE(vm_pool_lock);
+  node->next = *pool;
+  *pool = node;
+  CTHR_RWLOCK_UNLOCK_WRITE(vm_pool_lock);
+}
+
+static uint64_t rx_now_us(void) {
+#ifdef _WIN32
+  LARGE_INTEGER count, freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return count.QuadPart / freq.QuadPart * 1000000 + count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+#endif
+}
+
+static void rx_hash_all(randomx_vm *vm, size_t count, const void *const *data, const size_t *lengths, char *result_hashes, uint64_t *elapsed_us) {
+  for (size_t i = 0; i < count; ++i) {
+    const uint64_t start = elapsed_us ? rx_now_us() : 0;
+    randomx_calculate_hash(vm, data[i], lengths[i], result_hashes + i * HASH_SIZE);
+    if (elapsed_us)
+      elapsed_us[i] = rx_now_us() - start;
+  }
+}
+
+void rx_slow_hash_batch(const char *seedhash, size_t count, const void *const *data, const size_t *lengths, char *result_hashes, uint64_t *elapsed_us) {
+  const randomx_flags flags = enabled_flags() & ~disabled_flags();
+
+  if (count == 0) {
+    return;
+  }
+
+  // Same order of preference as rx_slow_hash: full VM on the main dataset, light VM on the main
+  // cache while the dataset is being built, then light VM on the secondary cache
+  if (is_main(seedhash)) {
+    if (main_dataset && CTHR_RWLOCK_TRYLOCK_READ(main_dataset_lock)) {
+      int done = 0;
+      if (is_main(seedhash)) {
+        rx_vm_node *node = rx_vm_pool_get(&full_vm_pool);
+        rx_init_full_vm(flags, &node->vm);
+        if (node->vm) {
+          rx_hash_all(node->vm, count, data, lengths, result_hashes, elapsed_us);
+          done = 1;
+        }
+        rx_vm_pool_put(&full_vm_pool, node);
+      }
+      CTHR_RWLOCK_UNLOCK_READ(main_dataset_lock);
+      if (done) {
+        return;
+      }
+    }
+
+    CTHR_RWLOCK_LOCK_READ(main_cache_lock);
+    if (is_main(seedhash)) {
+      rx_vm_node *node = rx_vm_pool_get(&light_vm_pool);
+      rx_init_light_vm(flags, &node->vm, main_cache);
+      rx_hash_all(node->vm, count, data, lengths, result_hashes, elapsed_us);
+      rx_vm_pool_put(&light_vm_pool, node);
+      CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
+      return;
+    }
+    CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
+  }
+
+  // Switch the secondary cache to this seed once for the whole batch, then hash in parallel with
+  // other batches for the same seed. If another seed took over meanwhile, hash under the write lock
+  // like the slowest path of rx_slow_hash so two seeds can't keep evicting each other.
+  for (int attempt = 0; ; ++attempt) {
+    CTHR_RWLOCK_LOCK_READ(secondary_cache_lock);
+    if (is_secondary(seedhash)) {
+      rx_vm_node *node = rx_vm_pool_get(&light_vm_pool);
+      rx_init_light_vm(flags, &node->vm, secondary_cache);
+      rx_hash_all(node->vm, count, data, lengths, result_hashes, elapsed_us);
+      rx_vm_pool_put(&light_vm_pool, node);
+      CTHR_RWLOCK_UNLOCK_READ(secondary_cache_lock);
+      return;
+    }
+    CTHR_RWLOCK_UNLOCK_READ(secondary_cache_lock);
+
+    CTHR_RWLOCK_LOCK_WRITE(secondary_cache_lock);
+    if (!is_secondary(seedhash)) {
+      char buf[HASH_SIZE * 2 + 1];
+      hash2hex(seedhash, buf);
+      minfo(RX_LOGCAT, "RandomX new secondary seed hash is %s", buf);
+
+      rx_alloc_cache(flags, &secondary_cache);
+      randomx_init_cache(secondary_cache, seedhash, HASH_SIZE);
+      minfo(RX_LOGCAT, "RandomX secondary cache updated");
+      memcpy(secondary_seedhash, seedhash, HASH_SIZE);
+      secondary_seedhash_set = 1;
+    }
+    if (attempt > 0) {
+      rx_vm_node *node = rx_vm_pool_get(&light_vm_pool);
+      rx_init_light_vm(flags, &node->vm, secondary_cache);
+      rx_hash_all(node->vm, count, data, lengths, result_hashes, elapsed_us);
+      rx_vm_pool_put(&light_vm_pool, node);
+      CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
+      return;
+    }
+    CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
+  }
+}
+
 void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads) {
   miner_thread = value;
 
@@ -499,9 +958,14 @@ void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads) {
 
   const randomx_flags flags = enabled_flags() & ~disabled_flags();
   rx_alloc_dataset(flags, &main_dataset, 1);
-  rx_init_dataset(max_dataset_init_threads);
+  const int store = rx_init_dataset(max_dataset_init_threads);
+  char seedhash[HASH_SIZE];
+  memcpy(seedhash, main_seedhash, HASH_SIZE);
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
+
+  if (store)
+    rx_store_main_dataset(seedhash);
 }
 
 uint32_t rx_get_miner_thread() {
@@ -1096,6 +1096,96 @@ namespace cryptonote
     return boost::none;
   }
   //---------------------------------------------------------------
+  void get_output_scan_data(const transaction& tx, size_t n_outs, output_scan_data& data)
+  {
+    n_outs = std::min(n_outs, tx.vout.size());
+    data.keys.resize(n_outs);
+    data.view_tags.resize(n_outs);
+    data.has_key.resize(n_outs);
+    data.has_view_tag.resize(n_outs);
+    data.all_view_tags = true;
+    for (size_t i = 0; i < n_outs; ++i)
+    {
+      const tx_out &o = tx.vout[i];
+      data.has_key[i] = get_output_public_key(o, data.keys[i]);
+      const boost::optional<crypto::view_tag> view_tag_opt = get_output_view_tag(o);
+      data.has_view_tag[i] = !!view_tag_opt;
+      if (view_tag_opt)
+        data.view_tags[i] = *view_tag_opt;
+      else
+        data.all_view_tags = false;
+    }
+  }
+  //---------------------------------------------------------------
+  void scan_outputs_to_acc(const std::unordered_map<crypto::public_key, subaddress_index>& subaddresses, const output_scan_data& data, const crypto::key_derivation& derivation, const std::vector<crypto::key_derivation>& additional_derivations, hw::device &hwdev, std::vector<boost::optional<subaddress_receive_info>>& received)
+  {
+    const size_t n_outs = data.keys.size();
+    CHECK_AND_ASSERT_THROW_MES(received.size() >= n_outs, "received array too small");
+
+    // derive the view tags of all outputs for the shared tx pubkey in one go
+    std::vector<crypto::view_tag> derived_view_tags;
+    bool derived = false;
+    if (data.all_view_tags && n_outs > 0)
+    {
+      derived_view_tags.resize(n_outs);
+      derived = hwdev.derive_view_tags(derivation, 0, n_outs, derived_view_tags.data());
+      if (!derived)
+        MERROR("Failed to derive view tags");
+    }
+
+    crypto::public_key subaddress_spendkey;
+    for (size_t i = 0; i < n_outs; ++i)
+    {
+      if (!data.has_key[i])
+        continue;
+      received[i] = boost::none;
+      const boost::optional<crypto::view_tag> view_tag_opt = data.has_view_tag[i] ? boost::optional<crypto::view_tag>(data.view_tags[i]) : boost::none;
+
+      // try the shared tx pubkey
+      bool can_be_to_acc;
+      if (derived)
+        can_be_to_acc = data.view_tags[i] == derived_view_tags[i];
+      else if (data.all_view_tags)
+        can_be_to_acc = false; // view tag derivation failed, as in out_can_be_to_acc
+      else
+        can_be_to_acc = out_can_be_to_acc(view_tag_opt, derivation, i, &hwdev);
+      if (can_be_to_acc)
+      {
+        if (!hwdev.derive_subaddress_public_key(data.keys[i], derivation, i, subaddress_spendkey))
+        {
+          MERROR("Failed to derive subaddress public key");
+          continue;
+        }
+        auto found = subaddresses.find(subaddress_spendkey);
+        if (found != subaddresses.end())
+        {
+          received[i] = subaddress_receive_info{ found->second, derivation };
+          continue;
+        }
+      }
+
+      // try additional tx pubkeys if available
+      if (additional_derivations.empty())
+        continue;
+      if (i >= additional_derivations.size())
+      {
+        MERROR("wrong number of additional derivations");
+        continue;
+      }
+      if (out_can_be_to_acc(view_tag_opt, additional_derivations[i], i, &hwdev))
+      {
+        if (!hwdev.derive_subaddress_public_key(data.keys[i], additional_derivations[i], i, subaddress_spendkey))
+        {
+          MERROR("Failed to derive subaddress public key");
+          continue;
+        }
+        auto found = subaddresses.find(subaddress_spendkey);
+        if (found != subaddresses.end())
+          received[i] = subaddress_receive_info{ found->second, additional_derivations[i] };
+      }
+    }
+  }
+  //---------------------------------------------------------------
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
@@ -99,6 +99,21 @@ namespace cryptonote
     crypto::key_derivation derivation;
   };
   boost::optional<subaddress_receive_info> is_out_to_acc_precomp(const std::unordered_map<crypto::public_key, subaddress_index>& subaddresses, const crypto::public_key& out_key, const crypto::key_derivation& derivation, const std::vector<crypto::key_derivation>& additional_derivations, size_t output_index, hw::device &hwdev, const boost::optional<crypto::view_tag>& view_tag_opt = boost::optional<crypto::view_tag>());
+  // Output keys and view tags of a tx laid out contiguously, so that scanning for several
+  // derivations does not need to walk the tx_out variants each time
+  struct output_scan_data
+  {
+    std::vector<crypto::public_key> keys;
+    std::vector<crypto::view_tag> view_tags;
+    std::vector<uint8_t> has_key;
+    std::vector<uint8_t> has_view_tag;
+    bool all_view_tags;
+  };
+  void get_output_scan_data(const transaction& tx, size_t n_outs, output_scan_data& data);
+  // Equivalent to calling is_out_to_acc_precomp on every output with a key, storing the result in received[i].
+  // View tags are derived for all outputs up front, and only outputs whose tag matches get the full
+  // derive_subaddress_public_key and subaddress lookup. Entries for outputs without a key are left untouched.
+  void scan_outputs_to_acc(const std::unordered_map<crypto::public_key, subaddress_index>& subaddresses, const output_scan_data& data, const crypto::key_derivation& derivation, const std::vector<crypto::key_derivation>& additional_derivations, hw::device &hwdev, std::vector<boost::optional<subaddress_receive_info>>& received);
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, const std::vector<crypto::public_key>& additional_tx_public_keys, std::vector<size_t>& outs, uint64_t& money_transfered);
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered);
   bool get_tx_fee(const transaction& tx, uint64_t & fee);
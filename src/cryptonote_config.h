@@ -214,6 +214,7 @@
 #define CRYPTONOTE_PRUNING_STRIPE_SIZE          4096 // the smaller, the smoother the increase
 #define CRYPTONOTE_PRUNING_LOG_STRIPES          3 // the higher, the more space saved
 #define CRYPTONOTE_PRUNING_TIP_BLOCKS           5500 // the smaller, the more space saved
+#define CRYPTONOTE_PRUNING_STEP_TXES            1000 // txes per write txn when pruning in the background
 
 #define RPC_CREDITS_PER_HASH_SCALE ((float)(1<<24))
 
@@ -97,12 +97,14 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
-  m_btc_valid(false),
   m_batch_success(true),
   m_prepare_height(0),
   m_rct_ver_cache()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
+
+  // a reorg notifies from the split height, so this drops every block that was replaced
+  m_block_notifiers.push_back([this](uint64_t height, epee::span<const block>) { m_hot_blocks.invalidate(height); });
 }
 //------------------------------------------------------------------
 Blockchain::~Blockchain()
@@ -466,6 +468,10 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
       rx_set_main_seedhash(seedhash.data, tools::get_max_concurrency());
   }
 
+  // a bad cache file only costs re-verification, so carry on without it
+  if (!m_rct_ver_cache_filename.empty() && !m_rct_ver_cache.load(m_rct_ver_cache_filename))
+    MWARNING("Ignoring RCT verification cache file " << m_rct_ver_cache_filename);
+
   return true;
 }
 //------------------------------------------------------------------
@@ -520,6 +526,10 @@ bool Blockchain::deinit()
   m_async_pool.join_all();
   m_async_service.stop();
 
+  if (m_hot_blocks.get_hits() || m_hot_blocks.get_misses())
+    MINFO("Hot block cache: " << m_hot_blocks.get_hits() << " hits, " << m_hot_blocks.get_misses() << " misses");
+  m_hot_blocks.clear();
+
   // as this should be called if handling a SIGSEGV, need to check
   // if m_db is a NULL pointer (and thus may have caused the illegal
   // memory operation), otherwise we may cause a loop.
@@ -529,6 +539,11 @@ bool Blockchain::deinit()
     {
       m_db->close();
       MTRACE("Local blockchain read/write activity stopped successfully");
+
+      // only saved on a clean shutdown: when crashing, memory may be corrupt, and the
+      // file's checksum would vouch for whatever got written
+      if (!m_rct_ver_cache_filename.empty())
+        m_rct_ver_cache.store(m_rct_ver_cache_filename);
     }
   }
   catch (const std::exception& e)
@@ -622,6 +637,9 @@ block Blockchain::pop_block_from_blockchain()
     throw;
   }
 
+  // rollbacks and pop_blocks do not go through the block notifiers
+  m_hot_blocks.invalidate(m_db->height());
+
   // make sure the hard fork object updates its current version
   m_hardfork->on_block_popped(1);
 
@@ -660,6 +678,7 @@ block Blockchain::pop_block_from_blockchain()
 
   m_blocks_longhash_table.clear();
   m_scan_table.clear();
+  m_blocks_rct_ver_table.clear();
   m_blocks_txs_check.clear();
 
   uint64_t top_block_height;
@@ -1648,31 +1667,12 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
 
   seed_hash = crypto::null_hash;
 
+  if (!from_block && get_cached_block_template(b, miner_address, ex_nonce, diffic, height, expected_reward, seed_height, seed_hash))
+    return true;
+
   m_tx_pool.lock();
   const auto unlock_guard = epee::misc_utils::create_scope_leave_handler([&]() { m_tx_pool.unlock(); });
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  if (m_btc_valid && !from_block) {
-    // The pool cookie is atomic. The lack of locking is OK, as if it changes
-    // just as we compare it, we'll just use a slightly old template, but
-    // this would be the case anyway if we'd lock, and the change happened
-    // just after the block template was created
-    if (!memcmp(&miner_address, &m_btc_address, sizeof(cryptonote::account_public_address)) && m_btc_nonce == ex_nonce
-      && m_btc_pool_cookie == m_tx_pool.cookie() && m_btc.prev_id == get_tail_id()) {
-      MDEBUG("Using cached template");
-      const uint64_t now = time(NULL);
-      if (m_btc.timestamp < now) // ensures it can't get below the median of the last few blocks
-        m_btc.timestamp = now;
-      b = m_btc;
-      diffic = m_btc_difficulty;
-      height = m_btc_height;
-      expected_reward = m_btc_expected_reward;
-      seed_height = m_btc_seed_height;
-      seed_hash = m_btc_seed_hash;
-      return true;
-    }
-    MDEBUG("Not using cached template: address " << (!memcmp(&miner_address, &m_btc_address, sizeof(cryptonote::account_public_address))) << ", nonce " << (m_btc_nonce == ex_nonce) << ", cookie " << (m_btc_pool_cookie == m_tx_pool.cookie()) << ", from_block " << (!!from_block));
-    invalidate_block_template_cache();
-  }
 
   if (from_block)
   {
@@ -2155,39 +2155,42 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     bei.cumulative_difficulty += current_diff;
 
     bei.block_cumulative_weight = cryptonote::get_transaction_weight(b.miner_tx);
-    for (const crypto::hash &txid: b.tx_hashes)
     {
-      cryptonote::tx_memory_pool::tx_details td;
-      cryptonote::blobdata blob;
-      if (m_tx_pool.have_tx(txid, relay_category::legacy))
+      db_rtxn_guard rtxn_guard(m_db);
+      for (const crypto::hash &txid: b.tx_hashes)
       {
-        if (m_tx_pool.get_transaction_info(txid, td, true/*include_sensitive_data*/))
+        cryptonote::tx_memory_pool::tx_details td;
+        cryptonote::blobdata_ref blob;
+        if (m_tx_pool.have_tx(txid, relay_category::legacy))
         {
-          bei.block_cumulative_weight += td.weight;
+          if (m_tx_pool.get_transaction_info(txid, td, true/*include_sensitive_data*/))
+          {
+            bei.block_cumulative_weight += td.weight;
+          }
+          else
+          {
+            MERROR_VER("Transaction is in the txpool, but metadata not found");
+            bvc.m_verifivation_failed = true;
+            return false;
+          }
         }
-        else
+        else if (m_db->get_pruned_tx_blob_view(txid, blob))
         {
-          MERROR_VER("Transaction is in the txpool, but metadata not found");
-          bvc.m_verifivation_failed = true;
-          return false;
+          cryptonote::transaction tx;
+          if (!cryptonote::parse_and_validate_tx_base_from_blob(blob, tx))
+          {
+            MERROR_VER("Block with id: " << epee::string_tools::pod_to_hex(id) << " (as alternative) refers to unparsable transaction hash " << txid << ".");
+            bvc.m_verifivation_failed = true;
+            return false;
+          }
+          bei.block_cumulative_weight += cryptonote::get_pruned_transaction_weight(tx);
         }
-      }
-      else if (m_db->get_pruned_tx_blob(txid, blob))
-      {
-        cryptonote::transaction tx;
-        if (!cryptonote::parse_and_validate_tx_base_from_blob(blob, tx))
+        else
         {
-          MERROR_VER("Block with id: " << epee::string_tools::pod_to_hex(id) << " (as alternative) refers to unparsable transaction hash " << txid << ".");
-          bvc.m_verifivation_failed = true;
-          return false;
+          // we can't determine the block weight, set it to 0 and break out of the loop
+          bei.block_cumulative_weight = 0;
+          break;
         }
-        bei.block_cumulative_weight += cryptonote::get_pruned_transaction_weight(tx);
-      }
-      else
-      {
-        // we can't determine the block weight, set it to 0 and break out of the loop
-        bei.block_cumulative_weight = 0;
-        break;
       }
     }
 
@@ -2771,18 +2774,23 @@ bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
+  // the pruned part is a single value, so it can be parsed in place
+  cryptonote::blobdata tx;
   reserve_container(txs, txs_ids.size());
   for (const auto& tx_hash : txs_ids)
   {
     try
     {
-      cryptonote::blobdata tx;
-      bool res = pruned ? m_db->get_pruned_tx_blob(tx_hash, tx) : m_db->get_tx_blob(tx_hash, tx);
+      cryptonote::blobdata_ref tx_view;
+      bool res = pruned ? m_db->get_pruned_tx_blob_view(tx_hash, tx_view) : m_db->get_tx_blob(tx_hash, tx);
       if (res)
       {
+        if (!pruned)
+          tx_view = tx;
         txs.push_back(transaction());
-        res = pruned ? parse_and_validate_tx_base_from_blob(tx, txs.back()) : parse_and_validate_tx_from_blob(tx, txs.back());
+        res = pruned ? parse_and_validate_tx_base_from_blob(tx_view, txs.back()) : parse_and_validate_tx_from_blob(tx_view, txs.back());
         if (!res)
         {
           LOG_ERROR("Invalid transaction");
@@ -2888,12 +2896,51 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
   db_rtxn_guard rtxn_guard(m_db);
   total_height = get_current_blockchain_height();
   blocks.reserve(std::min(std::min(max_block_count, (size_t)10000), (size_t)(total_height - start_height)));
+  if (m_hot_blocks.get_max_size() > 0 && start_height + HOT_BLOCK_CACHE_DEPTH >= total_height)
+    return get_hot_blocks_from(start_height, max_block_count, max_tx_count, blocks, pruned, get_miner_tx_hash);
   CHECK_AND_ASSERT_MES(m_db->get_blocks_from(start_height, 3, max_block_count, max_tx_count, FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE, blocks, pruned, true, get_miner_tx_hash),
       false, "Error getting blocks");
 
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::get_hot_blocks_from(uint64_t start_height, size_t max_block_count, size_t max_tx_count, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, bool pruned, bool get_miner_tx_hash) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  static const size_t min_block_count = 3;
+  const uint64_t blockchain_height = m_db->height();
+  uint64_t size = 0;
+  size_t num_txes = 0;
+  for (uint64_t h = start_height; h < blockchain_height && blocks.size() < max_block_count && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || blocks.size() < min_block_count); ++h)
+  {
+    hot_block_cache::entry_ptr e = m_hot_blocks.get(h, pruned);
+    if (!e)
+    {
+      std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > db_blocks;
+      CHECK_AND_ASSERT_MES(m_db->get_blocks_from(h, 1, 1, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), db_blocks, pruned, true, true) && db_blocks.size() == 1,
+          false, "Error getting block at height " << h);
+      std::shared_ptr<hot_block_cache::entry> ne = std::make_shared<hot_block_cache::entry>();
+      ne->block = std::move(db_blocks[0].first.first);
+      ne->miner_tx_hash = db_blocks[0].first.second;
+      ne->txs = std::move(db_blocks[0].second);
+      ne->size = ne->block.size();
+      for (const auto &tx: ne->txs)
+        ne->size += tx.second.size();
+      m_hot_blocks.put(h, pruned, ne);
+      e = std::move(ne);
+    }
+
+    blocks.emplace_back(std::make_pair(e->block, get_miner_tx_hash ? e->miner_tx_hash : crypto::null_hash), e->txs);
+    size += e->size;
+    num_txes += e->txs.size();
+    if (blocks.size() >= min_block_count && num_txes >= max_tx_count)
+      break;
+  }
+  return true;
+}
+//------------------------------------------------------------------
 bool Blockchain::add_block_as_invalid(const block& bl, const crypto::hash& h)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -3687,7 +3734,10 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
     case rct::RCTTypeCLSAG:
     case rct::RCTTypeBulletproofPlus:
     {
-      if (!ver_rct_non_semantics_simple_cached(tx, pubkeys, m_rct_ver_cache, RCT_CACHE_TYPE))
+      // ring signatures may already have been verified as a batch by prepare_handle_incoming_blocks
+      const bool batch_verified = !m_blocks_rct_ver_table.empty() &&
+          m_blocks_rct_ver_table.find(calc_tx_mixring_hash(tx, pubkeys)) != m_blocks_rct_ver_table.end();
+      if (!batch_verified && !ver_rct_non_semantics_simple_cached(tx, pubkeys, m_rct_ver_cache, RCT_CACHE_TYPE))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
@@ -4648,7 +4698,9 @@ leave:
     notifier(new_height - 1, {std::addressof(bl), 1});
 
   if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
+  {
     rx_set_main_seedhash(seedhash.data, tools::get_max_concurrency());
+  }
 
   return true;
 }
@@ -4662,6 +4714,53 @@ bool Blockchain::prune_blockchain(uint32_t pruning_seed)
   return m_db->prune_blockchain(pruning_seed);
 }
 //------------------------------------------------------------------
+bool Blockchain::prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, uint64_t &pruned_bytes, bool &done)
+{
+  m_tx_pool.lock();
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  // the lock is held for the whole of a span being added, leave it be till it is done
+  if (!m_blockchain_lock.tryLock())
+    return false;
+  epee::misc_utils::auto_scope_leave_caller blockchain_unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_blockchain_lock.unlock();});
+
+  done = m_db->prune_blockchain_step(pruning_seed, max_txes, pruned_bytes);
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::compact_blockchain(uint64_t &freed_bytes)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if (!m_db->compact_copy())
+    return false;
+
+  m_tx_pool.lock();
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  freed_bytes = m_db->compact_finish();
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::resize_db_ahead()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  m_tx_pool.lock();
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  return m_db->resize_ahead();
+}
+//------------------------------------------------------------------
+bool Blockchain::store_txpool()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  m_tx_pool.lock();
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  return m_db->store_txpool();
+}
+//------------------------------------------------------------------
 bool Blockchain::update_blockchain_pruning()
 {
   m_tx_pool.lock();
@@ -4894,18 +4993,24 @@ void Blockchain::set_enforce_dns_checkpoints(bool enforce_checkpoints)
 }
 
 //------------------------------------------------------------------
-void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map) const
+void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map, std::vector<uint64_t> &elapsed_us) const
 {
   TIME_MEASURE_START(t);
   slow_hash_allocate_state();
 
-  for (const auto & block : blocks)
+  // hash in small batches so cancellation is still noticed quickly
+  static constexpr const size_t BATCH_SIZE = 16;
+  std::vector<crypto::hash> pows;
+  std::vector<uint64_t> times;
+  for (size_t i = 0; i < blocks.size(); i += BATCH_SIZE)
   {
     if (m_cancel)
        break;
-    crypto::hash id = get_block_hash(block);
-    crypto::hash pow = get_block_longhash(this, block, height++, 0);
-    map.emplace(id, pow);
+    const size_t n = std::min(BATCH_SIZE, blocks.size() - i);
+    get_block_longhashes(this, {blocks.data() + i, n}, height + i, pows, &times);
+    for (size_t k = 0; k < n; ++k)
+      map.emplace(get_block_hash(blocks[i + k]), pows[k]);
+    elapsed_us.insert(elapsed_us.end(), times.begin(), times.end());
   }
 
   slow_hash_free_state();
@@ -4972,6 +5077,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   TIME_MEASURE_FINISH(t1);
   m_blocks_longhash_table.clear();
   m_scan_table.clear();
+  m_blocks_rct_ver_table.clear();
   m_blocks_txs_check.clear();
 
   // when we're well clear of the precomputed hashes, free the memory
@@ -5266,15 +5372,32 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       m_prepare_height = height;
       m_prepare_nblocks = blocks_entry.size();
       m_prepare_blocks = &blocks;
-      for (unsigned int i = 0; i < threads; i++)
+
+      // Give each thread blocks of a single seed, shared out in proportion to the number of
+      // blocks per seed, so that threads on different seeds do not evict each other's cache
+      // at a seed epoch boundary
+      std::vector<std::pair<uint64_t, size_t>> chunks;
+      const uint64_t end_height = height + blocks.size();
+      while (thread_height < end_height)
       {
-        unsigned nblocks = batches;
-        if (i < extra)
-          ++nblocks;
-        if (nblocks == 0)
-          break;
-        tpool.submit(&waiter, boost::bind(&Blockchain::block_longhash_worker, this, thread_height, epee::span<const block>(&blocks[thread_height - height], nblocks), std::ref(maps[i])), true);
-        thread_height += nblocks;
+        uint64_t segment_end = thread_height + 1;
+        while (segment_end < end_height && crypto::rx_seedheight(segment_end) == crypto::rx_seedheight(thread_height))
+          ++segment_end;
+        const size_t segment_size = segment_end - thread_height;
+        const size_t segment_threads = std::max<size_t>(1, std::min<size_t>(segment_size, (threads * segment_size + blocks.size() / 2) / blocks.size()));
+        for (size_t i = 0; i < segment_threads; ++i)
+        {
+          const size_t nblocks = segment_size / segment_threads + (i < segment_size % segment_threads ? 1 : 0);
+          chunks.push_back(std::make_pair(thread_height, nblocks));
+          thread_height += nblocks;
+        }
+      }
+
+      maps.resize(chunks.size());
+      std::vector<std::vector<uint64_t>> timings(chunks.size());
+      for (size_t i = 0; i < chunks.size(); i++)
+      {
+        tpool.submit(&waiter, boost::bind(&Blockchain::block_longhash_worker, this, chunks[i].first, epee::span<const block>(&blocks[chunks[i].first - height], chunks[i].second), std::ref(maps[i]), std::ref(timings[i])), true);
       }
 
       if (!waiter.wait())
@@ -5288,6 +5411,26 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       {
         m_blocks_longhash_table.insert(map.begin(), map.end());
       }
+
+      if (m_show_time_stats)
+      {
+        uint64_t total_us = 0, max_us = 0, n = 0;
+        for (const auto &t: timings)
+        {
+          for (uint64_t us: t)
+          {
+            total_us += us;
+            max_us = std::max(max_us, us);
+          }
+          n += t.size();
+        }
+        if (n > 0)
+          MINFO("PoW for " << n << " blocks from height " << height << " in " << chunks.size() << " jobs: "
+              << total_us / n << " us/block average, " << max_us << " us max, " << total_us / 1000 << " ms total");
+      }
+      for (size_t i = 0; i < chunks.size(); ++i)
+        for (size_t k = 0; k < timings[i].size(); ++k)
+          MTRACE("PoW for block " << chunks[i].first + k << ": " << timings[i][k] << " us");
     }
   }
 
@@ -5304,6 +5447,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   m_fake_pow_calc_time = 0;
 
   m_scan_table.clear();
+  m_blocks_rct_ver_table.clear();
 
   TIME_MEASURE_FINISH(prepare);
   m_fake_pow_calc_time = prepare / blocks_entry.size();
@@ -5410,17 +5554,37 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   if (!m_db->can_thread_bulk_indices())
     threads = 1;
 
-  if (threads > 1 && amounts.size() > 1)
+  if (threads > 1)
   {
-    tools::threadpool::waiter waiter(tpool);
-
+    // RCT inputs all use amount 0, so large offset lists are split in chunks
+    // rather than leaving a single thread to look them all up
+    static const size_t min_scan_chunk = 256;
+    struct scan_chunk { uint64_t amount; std::vector<uint64_t> offsets; std::vector<output_data_t> outputs; };
+    std::vector<scan_chunk> chunks;
     for (size_t i = 0; i < amounts.size(); i++)
     {
-      uint64_t amount = amounts[i];
-      tpool.submit(&waiter, boost::bind(&Blockchain::output_scan_worker, this, amount, std::cref(offset_map[amount]), std::ref(tx_map[amount])), true);
+      const std::vector<uint64_t> &offsets = offset_map[amounts[i]];
+      const size_t n_chunks = std::max<size_t>(1, std::min<size_t>(threads, offsets.size() / min_scan_chunk));
+      for (size_t c = 0; c < n_chunks; ++c)
+        chunks.push_back({amounts[i], std::vector<uint64_t>(offsets.begin() + offsets.size() * c / n_chunks, offsets.begin() + offsets.size() * (c + 1) / n_chunks), {}});
     }
+
+    tools::threadpool::waiter waiter(tpool);
+    for (scan_chunk &chunk: chunks)
+      tpool.submit(&waiter, boost::bind(&Blockchain::output_scan_worker, this, chunk.amount, std::cref(chunk.offsets), std::ref(chunk.outputs)), true);
     if (!waiter.wait())
       return false;
+
+    // results may be partial, in which case only the prefix found is kept
+    std::map<uint64_t, bool> truncated;
+    for (scan_chunk &chunk: chunks)
+    {
+      if (truncated[chunk.amount])
+        continue;
+      std::vector<output_data_t> &outputs = tx_map[chunk.amount];
+      outputs.insert(outputs.end(), chunk.outputs.begin(), chunk.outputs.end());
+      truncated[chunk.amount] = chunk.outputs.size() < chunk.offsets.size();
+    }
   }
   else
   {
@@ -5456,21 +5620,13 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
         auto needed_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
 
         std::vector<output_data_t> outputs;
+        const std::vector<uint64_t> &offsets_found = offset_map[in_to_key.amount];
         for (const uint64_t & offset_needed : needed_offsets)
         {
-          size_t pos = 0;
-          bool found = false;
-
-          for (const uint64_t &offset_found : offset_map[in_to_key.amount])
-          {
-            if (offset_needed == offset_found)
-            {
-              found = true;
-              break;
-            }
-
-            ++pos;
-          }
+          // offset_map is sorted above
+          const auto it = std::lower_bound(offsets_found.begin(), offsets_found.end(), offset_needed);
+          const bool found = it != offsets_found.end() && *it == offset_needed;
+          const size_t pos = it - offsets_found.begin();
 
           if (found && pos < tx_map[in_to_key.amount].size())
             outputs.push_back(tx_map[in_to_key.amount].at(pos));
@@ -5491,9 +5647,182 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       MDEBUG("Prepare scantable took: " << scantable << " ms");
   }
 
+  if (total_txs > 0)
+  {
+    TIME_MEASURE_START(rctver);
+    prepare_rct_ver_table(blocks_entry);
+    TIME_MEASURE_FINISH(rctver);
+    if(m_show_time_stats)
+      MDEBUG("Prepare ring signatures took: " << rctver << " ms, " << m_blocks_rct_ver_table.size() << "/" << total_txs << " txes verified");
+  }
+
   return true;
 }
 
+//------------------------------------------------------------------
+// Verifies the ring signatures of the RCT transactions in a span of incoming
+// blocks as one batch, using the output keys already gathered in m_scan_table.
+// The tx+mixring hashes of the ones which pass go to m_blocks_rct_ver_table, so
+// check_tx_inputs can skip them. Everything else, including failures, is left
+// for check_tx_inputs to verify on its own, which will find the bad input.
+void Blockchain::prepare_rct_ver_table(const std::vector<block_complete_entry> &blocks_entry)
+{
+  // large enough to keep all threads busy, small enough to bound memory use on large spans
+  static constexpr const size_t RCT_VER_BATCH_TXES = 256;
+
+  std::vector<transaction> txs;
+  std::vector<rct::ctkeyM> mix_rings;
+  std::vector<crypto::hash> verified;
+  txs.reserve(RCT_VER_BATCH_TXES);
+  mix_rings.reserve(RCT_VER_BATCH_TXES);
+
+  const auto verify_batch = [&]()
+  {
+    if (txs.empty())
+      return;
+    if (!ver_rct_non_semantics_simple_batch(txs, mix_rings, verified))
+      MDEBUG("Some ring signatures failed batch verification, they will be checked one by one");
+    m_blocks_rct_ver_table.insert(verified.begin(), verified.end());
+    txs.clear();
+    mix_rings.clear();
+  };
+
+  for (const auto &entry : blocks_entry)
+  {
+    for (const auto &tx_blob : entry.txs)
+    {
+      if (m_cancel)
+        return;
+
+      txs.emplace_back();
+      transaction &tx = txs.back();
+      // parse errors are reported later, when the block is actually added
+      if (!parse_and_validate_tx_from_blob(tx_blob.blob, tx) || tx.version < 2 || tx.pruned)
+      {
+        txs.pop_back();
+        continue;
+      }
+
+      switch (tx.rct_signatures.type)
+      {
+      case rct::RCTTypeSimple:
+      case rct::RCTTypeSimpleBulletproof:
+      case rct::RCTTypeBulletproof:
+      case rct::RCTTypeBulletproof2:
+      case rct::RCTTypeCLSAG:
+      case rct::RCTTypeBulletproofPlus:
+        break;
+      default:
+        txs.pop_back();
+        continue;
+      }
+
+      // only txes whose whole mixring was found in the db can be batched, the
+      // ones spending outputs created earlier in this span are checked later
+      const auto its = m_scan_table.find(get_transaction_prefix_hash(tx));
+      bool complete = its != m_scan_table.end();
+      rct::ctkeyM mix_ring(tx.vin.size());
+      for (size_t n = 0; complete && n < tx.vin.size(); ++n)
+      {
+        if (tx.vin[n].type() != typeid(txin_to_key))
+        {
+          complete = false;
+          break;
+        }
+        const txin_to_key &in_to_key = boost::get<txin_to_key>(tx.vin[n]);
+        const auto it = its->second.find(in_to_key.k_image);
+        if (it == its->second.end() || it->second.size() != in_to_key.key_offsets.size())
+        {
+          complete = false;
+          break;
+        }
+        mix_ring[n].reserve(it->second.size());
+        for (const output_data_t &output : it->second)
+          mix_ring[n].push_back(rct::ctkey({rct::pk2rct(output.pubkey), output.commitment}));
+      }
+      if (!complete)
+      {
+        txs.pop_back();
+        continue;
+      }
+
+      mix_rings.push_back(std::move(mix_ring));
+      if (txs.size() >= RCT_VER_BATCH_TXES)
+        verify_batch();
+    }
+  }
+  verify_batch();
+}
+
+// Verifies the ring signatures of incoming pool transactions as one batch,
+// without the blockchain lock, reading their rings from the db. The ones which
+// pass go to m_rct_ver_cache, keyed on the tx and its ring, so check_tx_inputs
+// finds them there once it runs under the lock. Since the key includes the
+// ring, a reorg in between cannot make a stale result match.
+void Blockchain::prepare_rct_ver_cache(const std::vector<const transaction*> &txes)
+{
+  // only this type is looked up in the cache, see check_tx_inputs
+  static constexpr const std::uint8_t RCT_CACHE_TYPE = rct::RCTTypeBulletproofPlus;
+
+  std::vector<transaction> txs;
+  std::vector<rct::ctkeyM> mix_rings;
+  std::vector<crypto::hash> verified;
+  txs.reserve(txes.size());
+  mix_rings.reserve(txes.size());
+
+  try
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    std::vector<output_data_t> outputs;
+    for (const transaction *ptx : txes)
+    {
+      const transaction &tx = *ptx;
+      if (tx.version != 2 || tx.pruned || tx.rct_signatures.type != RCT_CACHE_TYPE)
+        continue;
+
+      // txes spending outputs not in the db yet are left for check_tx_inputs
+      bool complete = true;
+      rct::ctkeyM mix_ring(tx.vin.size());
+      for (size_t n = 0; complete && n < tx.vin.size(); ++n)
+      {
+        if (tx.vin[n].type() != typeid(txin_to_key))
+        {
+          complete = false;
+          break;
+        }
+        const txin_to_key &in_to_key = boost::get<txin_to_key>(tx.vin[n]);
+        const std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+        m_db->get_output_key(epee::span<const uint64_t>(&in_to_key.amount, 1), absolute_offsets, outputs, true);
+        if (outputs.size() != absolute_offsets.size())
+        {
+          complete = false;
+          break;
+        }
+        mix_ring[n].reserve(outputs.size());
+        for (const output_data_t &output : outputs)
+          mix_ring[n].push_back(rct::ctkey({rct::pk2rct(output.pubkey), output.commitment}));
+      }
+      if (!complete || m_rct_ver_cache.has(calc_tx_mixring_hash(tx, mix_ring)))
+        continue;
+
+      txs.push_back(tx);
+      mix_rings.push_back(std::move(mix_ring));
+    }
+  }
+  catch (const std::exception &e)
+  {
+    MDEBUG("Failed to gather rings for ring signature pre-verification: " << e.what());
+    return;
+  }
+
+  if (txs.empty())
+    return;
+  if (!ver_rct_non_semantics_simple_batch(txs, mix_rings, verified))
+    MDEBUG("Some ring signatures failed batch pre-verification, they will be checked one by one");
+  for (const crypto::hash &h : verified)
+    m_rct_ver_cache.add(h);
+}
+
 void Blockchain::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
 {
   m_db->add_txpool_tx(txid, blob, meta);
@@ -5553,6 +5882,17 @@ void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint
   m_max_prepare_blocks_threads = maxthreads;
 }
 
+void Blockchain::set_rct_ver_cache_options(size_t max_size, const std::string &filename)
+{
+  m_rct_ver_cache.set_max_size(max_size);
+  m_rct_ver_cache_filename = filename;
+}
+
+void Blockchain::set_hot_block_cache_size(size_t max_size)
+{
+  m_hot_blocks.set_max_size(max_size);
+}
+
 void Blockchain::add_block_notify(BlockNotifyCallback&& notify)
 {
   if (notify)
@@ -5805,22 +6145,46 @@ bool Blockchain::for_all_outputs(uint64_t amount, std::function<bool(uint64_t he
 void Blockchain::invalidate_block_template_cache()
 {
   MDEBUG("Invalidating block template cache");
-  m_btc_valid = false;
+  std::atomic_store(&m_btc, std::shared_ptr<const block_template_cache>());
 }
 
 void Blockchain::cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t height, uint64_t expected_reward, uint64_t seed_height, const crypto::hash &seed_hash, uint64_t pool_cookie)
 {
   MDEBUG("Setting block template cache");
-  m_btc = b;
-  m_btc_address = address;
-  m_btc_nonce = nonce;
-  m_btc_difficulty = diff;
-  m_btc_height = height;
-  m_btc_expected_reward = expected_reward;
-  m_btc_seed_hash = seed_hash;
-  m_btc_seed_height = seed_height;
-  m_btc_pool_cookie = pool_cookie;
-  m_btc_valid = true;
+  std::atomic_store(&m_btc, std::make_shared<const block_template_cache>(block_template_cache{
+    b, address, nonce, diff, height, pool_cookie, expected_reward, seed_hash, seed_height}));
+}
+
+bool Blockchain::get_cached_block_template(block &b, const cryptonote::account_public_address &address, const blobdata &nonce, difficulty_type &diff, uint64_t &height, uint64_t &expected_reward, uint64_t &seed_height, crypto::hash &seed_hash) const
+{
+  const std::shared_ptr<const block_template_cache> btc = std::atomic_load(&m_btc);
+  if (!btc)
+    return false;
+
+  // The pool cookie is atomic. The lack of locking is OK, as if it changes
+  // just as we compare it, we'll just use a slightly old template, but
+  // this would be the case anyway if we'd lock, and the change happened
+  // just after the block template was created
+  const bool same_address = !memcmp(&address, &btc->address, sizeof(cryptonote::account_public_address));
+  const bool same_nonce = btc->nonce == nonce;
+  const bool same_cookie = btc->pool_cookie == m_tx_pool.cookie();
+  if (!same_address || !same_nonce || !same_cookie || btc->b.prev_id != get_tail_id())
+  {
+    MDEBUG("Not using cached template: address " << same_address << ", nonce " << same_nonce << ", cookie " << same_cookie);
+    return false;
+  }
+
+  MDEBUG("Using cached template");
+  b = btc->b;
+  const uint64_t now = time(NULL);
+  if (b.timestamp < now) // ensures it can't get below the median of the last few blocks
+    b.timestamp = now;
+  diff = btc->difficulty;
+  height = btc->height;
+  expected_reward = btc->expected_reward;
+  seed_height = btc->seed_height;
+  seed_hash = btc->seed_hash;
+  return true;
 }
 
 void Blockchain::send_miner_notifications(uint64_t height, const crypto::hash &seed_hash, const crypto::hash &prev_id, uint64_t already_generated_coins)
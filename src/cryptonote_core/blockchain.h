@@ -43,6 +43,7 @@
 #include <boost/multi_index/member.hpp>
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -58,6 +59,7 @@
 #include "cryptonote_basic/difficulty.h"
 #include "cryptonote_tx_utils.h"
 #include "tx_verification_utils.h"
+#include "hot_block_cache.h"
 #include "cryptonote_basic/verification_context.h"
 #include "crypto/hash.h"
 #include "checkpoints/checkpoints.h"
@@ -822,6 +824,21 @@ namespace cryptonote
     void set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold,
         blockchain_db_sync_mode sync_mode, bool fast_sync);
 
+    /**
+     * @brief sets the RCT verification cache options
+     *
+     * @param max_size max number of verified tx+mixring hashes to remember
+     * @param filename if not empty, the cache is loaded from this file by init() and saved to it by deinit() once the db closed cleanly
+     */
+    void set_rct_ver_cache_options(size_t max_size, const std::string &filename);
+
+    /**
+     * @brief sets the byte budget of the cache of recent blocks served by find_blockchain_supplement
+     *
+     * @param max_size max bytes of block and tx blobs to keep, 0 to disable the cache
+     */
+    void set_hot_block_cache_size(size_t max_size);
+
     /**
      * @brief sets a block notify object to call for every new block
      *
@@ -1043,9 +1060,33 @@ namespace cryptonote
      * @param height the height of the first block
      * @param blocks the blocks to be hashed
      * @param map return-by-reference the hashes for each block
+     * @param elapsed_us return-by-reference the time spent hashing each block, in order
      */
     void block_longhash_worker(uint64_t height, const epee::span<const block> &blocks,
-        std::unordered_map<crypto::hash, crypto::hash> &map) const;
+        std::unordered_map<crypto::hash, crypto::hash> &map, std::vector<uint64_t> &elapsed_us) const;
+
+    /**
+     * @brief verifies the ring signatures of a set of incoming blocks as a batch
+     *
+     * Uses the output keys gathered in the scan table, so must be called once it
+     * is complete. Transactions which verify are recorded so check_tx_inputs does
+     * not verify them again, others are left for check_tx_inputs.
+     *
+     * @param blocks_entry the blocks being prepared
+     */
+    void prepare_rct_ver_table(const std::vector<block_complete_entry> &blocks_entry);
+
+    /**
+     * @brief verifies the ring signatures of a set of incoming pool transactions as a batch
+     *
+     * Does not take the blockchain lock, so it can run before the transactions are
+     * added to the pool. Transactions which verify are recorded in the RCT verification
+     * cache, where check_tx_inputs will find them. Nothing is reported for the others,
+     * check_tx_inputs will verify them again.
+     *
+     * @param txes the transactions to verify
+     */
+    void prepare_rct_ver_cache(const std::vector<const transaction*> &txes);
 
     /**
      * @brief returns a set of known alternate chains
@@ -1070,6 +1111,49 @@ namespace cryptonote
     bool prune_blockchain(uint32_t pruning_seed = 0);
     bool update_blockchain_pruning();
     bool check_blockchain_pruning();
+    bool is_pruning_in_progress() const { return m_db->is_pruning_in_progress(); }
+
+    /**
+     * @brief prunes part of the blockchain, unless blocks are being added
+     *
+     * @param pruning_seed the seed to use to prune the chain (0 for default, highly recommended)
+     * @param max_txes the most transactions to go through
+     * @param pruned_bytes return-by-reference the size of the prunable data deleted
+     * @param done return-by-reference whether the whole blockchain is pruned now
+     *
+     * @return false if the blockchain was busy, and nothing was done
+     */
+    bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, uint64_t &pruned_bytes, bool &done);
+
+    /**
+     * @brief rewrites the database without its free pages, and switches to the new file
+     *
+     * Blocks and txes keep being added while the database is copied; they
+     * are held off while the copy catches up with them and is swapped in.
+     *
+     * @param freed_bytes return-by-reference how much smaller the database file is now
+     *
+     * @return false if there is not enough free disk space for the copy
+     */
+    bool compact_blockchain(uint64_t &freed_bytes);
+
+    /**
+     * @brief grows the database ahead of need, see BlockchainDB::resize_ahead
+     *
+     * Waits for the current batch of blocks to be stored first, so the
+     * resize does not hold off the next one.
+     *
+     * @return true if the database was grown
+     */
+    bool resize_db_ahead();
+
+    /**
+     * @brief writes the txpool to disk, if the database keeps it in memory,
+     * see BlockchainDB::store_txpool
+     *
+     * @return true if the txpool was written
+     */
+    bool store_txpool();
 
     void lock();
     void unlock();
@@ -1155,6 +1239,7 @@ namespace cryptonote
     // metadata containers
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
+    std::unordered_set<crypto::hash> m_blocks_rct_ver_table;
 
     // Keccak hashes for each block and for fast pow checking
     std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
@@ -1204,17 +1289,21 @@ namespace cryptonote
 
     std::atomic<bool> m_cancel;
 
-    // block template cache
-    block m_btc;
-    account_public_address m_btc_address;
-    blobdata m_btc_nonce;
-    difficulty_type m_btc_difficulty;
-    uint64_t m_btc_height;
-    uint64_t m_btc_pool_cookie;
-    uint64_t m_btc_expected_reward;
-    crypto::hash m_btc_seed_hash;
-    uint64_t m_btc_seed_height;
-    bool m_btc_valid;
+    // block template cache, swapped with std::atomic_store so it can be
+    // served without taking the txpool or blockchain locks
+    struct block_template_cache
+    {
+      block b;
+      account_public_address address;
+      blobdata nonce;
+      difficulty_type difficulty;
+      uint64_t height;
+      uint64_t pool_cookie;
+      uint64_t expected_reward;
+      crypto::hash seed_hash;
+      uint64_t seed_height;
+    };
+    std::shared_ptr<const block_template_cache> m_btc;
 
 
     bool m_batch_success;
@@ -1234,6 +1323,10 @@ namespace cryptonote
 
     // cache for verifying transaction RCT non semantics
     mutable rct_ver_cache_t m_rct_ver_cache;
+    std::string m_rct_ver_cache_filename;
+
+    // recent blocks as returned by get_blocks_from, for wallets and peers asking for the tip
+    mutable hot_block_cache m_hot_blocks;
 
     /**
      * @brief collects the keys for all outputs being "spent" as an input
@@ -1323,6 +1416,14 @@ namespace cryptonote
      */
     block pop_block_from_blockchain();
 
+    /**
+     * @brief get_blocks_from for the top of the chain, going through m_hot_blocks
+     *
+     * Same limits and output as BlockchainDB::get_blocks_from with a min_block_count
+     * of 3, skip_coinbase and FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE.
+     */
+    bool get_hot_blocks_from(uint64_t start_height, size_t max_block_count, size_t max_tx_count, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, bool pruned, bool get_miner_tx_hash) const;
+
     /**
      * @brief validate and add a new block to the end of the blockchain
      *
@@ -1599,6 +1700,16 @@ namespace cryptonote
      */
     void cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t height, uint64_t expected_reward, uint64_t seed_height, const crypto::hash &seed_hash, uint64_t pool_cookie);
 
+    /**
+     * @brief fills in the cached block template if it matches the request
+     *
+     * Takes no locks: the pool cookie is atomic and the cache is swapped out
+     * whole, so at worst a template that just went stale is returned.
+     *
+     * @return true if the cached template was used, false otherwise
+     */
+    bool get_cached_block_template(block &b, const cryptonote::account_public_address &address, const blobdata &nonce, difficulty_type &diff, uint64_t &height, uint64_t &expected_reward, uint64_t &seed_height, crypto::hash &seed_hash) const;
+
     /**
      * @brief sends new block notifications to ZMQ `miner_data` subscribers
      *
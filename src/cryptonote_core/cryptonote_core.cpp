@@ -34,6 +34,7 @@
 #include "string_tools.h"
 using namespace epee;
 
+#include <mutex>
 #include <unordered_set>
 #include "cryptonote_core.h"
 #include "common/util.h"
@@ -226,6 +227,51 @@ namespace cryptonote
   , "Keep alternative blocks on restart"
   , false
   };
+  static const command_line::arg_descriptor<size_t> arg_rct_ver_cache_size  = {
+    "rct-ver-cache-size"
+  , "Number of verified ring signatures to remember, so transactions already verified in the pool are not verified again when mined."
+  , RCT_VER_CACHE_SIZE
+  };
+  static const command_line::arg_descriptor<bool> arg_persist_rct_ver_cache  = {
+    "persist-rct-ver-cache"
+  , "Save the ring signature verification cache in the data directory on exit and load it on startup."
+  , false
+  };
+  static const command_line::arg_descriptor<size_t> arg_block_cache_size  = {
+    "block-cache-size"
+  , "Max MB of recent blocks kept in memory to answer wallets and syncing peers, 0 to disable."
+  , HOT_BLOCK_CACHE_SIZE / (1024 * 1024)
+  };
+  static const command_line::arg_descriptor<bool> arg_db_rct_output_index  = {
+    "db-rct-output-index"
+  , "Keep a dense copy of RingCT output keys and commitments in the database, to speed up ring member lookups. Built on first use."
+  , false
+  };
+  static const command_line::arg_descriptor<uint64_t> arg_prune_blockchain_rate  = {
+    "prune-blockchain-rate"
+  , "Limit background pruning to deleting this many kB of prunable data per second, 0 for no limit."
+  , 0
+  };
+  static const command_line::arg_descriptor<bool> arg_db_key_image_filter  = {
+    "db-key-image-filter"
+  , "Keep an in-memory filter over the spent key images, so most lookups of unspent key images do not need to go to the database. Uses about 1.5 bytes per key image."
+  , false
+  };
+  static const command_line::arg_descriptor<bool> arg_db_compress  = {
+    "db-compress"
+  , "Compress the stored blocks and prunable transaction data with zstd, using dictionaries trained on the existing data. Existing data is converted on first use, and stays compressed without this option."
+  , false
+  };
+  static const command_line::arg_descriptor<bool> arg_db_txpool_in_memory  = {
+    "db-txpool-in-memory"
+  , "Keep the txpool in memory rather than writing each change to the database. It is written to the database every ten minutes, and on exit. Changes since the last write are lost on a crash."
+  , false
+  };
+  static const command_line::arg_descriptor<bool> arg_pipeline_block_import  = {
+    "pipeline-block-import"
+  , "While a span of synced blocks is added and committed, verify the RCT semantics of the next queued span in the background."
+  , false
+  };
 
   //-----------------------------------------------------------------------------------------------
   core::core(i_cryptonote_protocol* pprotocol):
@@ -314,6 +360,7 @@ namespace cryptonote
   {
     m_miner.stop();
     m_blockchain_storage.cancel();
+    m_pruning_thread.interrupt();
 
     tools::download_async_handle handle;
     {
@@ -353,9 +400,18 @@ namespace cryptonote
     command_line::add_arg(desc, arg_max_txpool_weight);
     command_line::add_arg(desc, arg_block_notify);
     command_line::add_arg(desc, arg_prune_blockchain);
+    command_line::add_arg(desc, arg_prune_blockchain_rate);
     command_line::add_arg(desc, arg_reorg_notify);
     command_line::add_arg(desc, arg_block_rate_notify);
     command_line::add_arg(desc, arg_keep_alt_blocks);
+    command_line::add_arg(desc, arg_rct_ver_cache_size);
+    command_line::add_arg(desc, arg_persist_rct_ver_cache);
+    command_line::add_arg(desc, arg_block_cache_size);
+    command_line::add_arg(desc, arg_db_rct_output_index);
+    command_line::add_arg(desc, arg_db_key_image_filter);
+    command_line::add_arg(desc, arg_db_compress);
+    command_line::add_arg(desc, arg_db_txpool_in_memory);
+    command_line::add_arg(desc, arg_pipeline_block_import);
 
     miner::init_options(desc);
     BlockchainDB::init_options(desc);
@@ -394,6 +450,8 @@ namespace cryptonote
     test_drop_download_height(command_line::get_arg(vm, arg_test_drop_download_height));
     m_fluffy_blocks_enabled = !get_arg(vm, arg_no_fluffy_blocks);
     m_offline = get_arg(vm, arg_offline);
+    m_pipeline_block_import = get_arg(vm, arg_pipeline_block_import);
+    m_prune_blockchain_rate = get_arg(vm, arg_prune_blockchain_rate);
     m_disable_dns_checkpoints = get_arg(vm, arg_disable_dns_checkpoints);
 
     if (!command_line::is_arg_defaulted(vm, arg_fluffy_blocks))
@@ -453,6 +511,16 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  fee_histogram core::get_txpool_fee_histogram(bool include_sensitive_txes) const
+  {
+    return m_mempool.get_fee_histogram(include_sensitive_txes);
+  }
+  //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_txpool_fee_per_byte_for_weight_ahead(uint64_t weight) const
+  {
+    return m_mempool.get_fee_per_byte_for_weight_ahead(weight);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_transactions(const std::vector<crypto::hash>& txs_ids, std::vector<transaction>& txs, std::vector<crypto::hash>& missed_txs, bool pruned) const
   {
     return m_blockchain_storage.get_transactions(txs_ids, txs, missed_txs, pruned);
@@ -489,6 +557,13 @@ namespace cryptonote
     size_t max_txpool_weight = command_line::get_arg(vm, arg_max_txpool_weight);
     bool prune_blockchain = command_line::get_arg(vm, arg_prune_blockchain);
     bool keep_alt_blocks = command_line::get_arg(vm, arg_keep_alt_blocks);
+    size_t rct_ver_cache_size = command_line::get_arg(vm, arg_rct_ver_cache_size);
+    bool persist_rct_ver_cache = command_line::get_arg(vm, arg_persist_rct_ver_cache);
+    size_t block_cache_size = command_line::get_arg(vm, arg_block_cache_size);
+    bool db_rct_output_index = command_line::get_arg(vm, arg_db_rct_output_index);
+    bool db_key_image_filter = command_line::get_arg(vm, arg_db_key_image_filter);
+    bool db_compress = command_line::get_arg(vm, arg_db_compress);
+    bool db_txpool_in_memory = command_line::get_arg(vm, arg_db_txpool_in_memory);
     bool keep_fakechain = command_line::get_arg(vm, arg_keep_fakechain);
 
     boost::filesystem::path folder(m_config_folder);
@@ -515,6 +590,8 @@ namespace cryptonote
     // folder might not be a directory, etc, etc
     catch (...) { }
 
+    const std::string rct_ver_cache_filename = persist_rct_ver_cache ? (folder / "rct_ver_cache.bin").string() : std::string();
+
     std::unique_ptr<BlockchainDB> db(new_db());
     if (db == NULL)
     {
@@ -617,6 +694,14 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_rct_output_index)
+        db_flags |= DBF_RCT_OUTPUT_INDEX;
+      if (db_key_image_filter)
+        db_flags |= DBF_KEY_IMAGE_FILTER;
+      if (db_compress)
+        db_flags |= DBF_COMPRESS;
+      if (db_txpool_in_memory)
+        db_flags |= DBF_TXPOOL_IN_MEMORY;
 
       db->open(filename, db_flags);
       if(!db->m_open)
@@ -630,6 +715,8 @@ namespace cryptonote
 
     m_blockchain_storage.set_user_options(blocks_threads,
         sync_on_blocks, sync_threshold, sync_mode, fast_sync);
+    m_blockchain_storage.set_rct_ver_cache_options(rct_ver_cache_size, rct_ver_cache_filename);
+    m_blockchain_storage.set_hot_block_cache_size(block_cache_size * 1024 * 1024);
 
     try
     {
@@ -725,13 +812,20 @@ namespace cryptonote
     if (!keep_alt_blocks && !m_blockchain_storage.get_db().is_read_only())
       m_blockchain_storage.get_db().drop_alt_blocks();
 
-    if (prune_blockchain)
+    // a pruning which was interrupted is resumed even if not asked to prune now,
+    // as the blockchain already claims to be pruned
+    if (!m_blockchain_storage.get_db().is_read_only() && m_blockchain_storage.is_pruning_in_progress())
+    {
+      MGINFO("Resuming blockchain pruning...");
+      CHECK_AND_ASSERT_MES(start_background_pruning(0), false, "Failed to prune blockchain");
+    }
+    else if (prune_blockchain)
     {
       // display a message if the blockchain is not pruned yet
       if (!m_blockchain_storage.get_blockchain_pruning_seed())
       {
         MGINFO("Pruning blockchain...");
-        CHECK_AND_ASSERT_MES(m_blockchain_storage.prune_blockchain(), false, "Failed to prune blockchain");
+        CHECK_AND_ASSERT_MES(start_background_pruning(0), false, "Failed to prune blockchain");
       }
       else
       {
@@ -756,6 +850,15 @@ namespace cryptonote
     bool core::deinit()
   {
     m_miner.stop();
+    wait_rct_lookahead();
+    m_pruning_thread.interrupt();
+    if (m_pruning_thread.joinable())
+      m_pruning_thread.join();
+    if (m_compaction_thread.joinable())
+    {
+      MGINFO("Waiting for the blockchain compaction to finish");
+      m_compaction_thread.join();
+    }
     m_mempool.deinit();
     m_blockchain_storage.deinit();
     return true;
@@ -875,26 +978,6 @@ namespace cryptonote
     bad_semantics_txes_lock.unlock();
   }
   //-----------------------------------------------------------------------------------------------
-  static bool is_canonical_bulletproof_layout(const std::vector<rct::Bulletproof> &proofs)
-  {
-    if (proofs.size() != 1)
-      return false;
-    const size_t sz = proofs[0].V.size();
-    if (sz == 0 || sz > BULLETPROOF_MAX_OUTPUTS)
-      return false;
-    return true;
-  }
-  //-----------------------------------------------------------------------------------------------
-  static bool is_canonical_bulletproof_plus_layout(const std::vector<rct::BulletproofPlus> &proofs)
-  {
-    if (proofs.size() != 1)
-      return false;
-    const size_t sz = proofs[0].V.size();
-    if (sz == 0 || sz > BULLETPROOF_PLUS_MAX_OUTPUTS)
-      return false;
-    return true;
-  }
-  //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block)
   {
     bool ret = true;
@@ -905,6 +988,7 @@ namespace cryptonote
     }
 
     std::vector<const rct::rctSig*> rvv;
+    std::vector<size_t> rvv_tx_info_index;
     for (size_t n = 0; n < tx_info.size(); ++n)
     {
       if (!check_tx_semantic(*tx_info[n].tx, keeped_by_block))
@@ -917,6 +1001,9 @@ namespace cryptonote
 
       if (tx_info[n].tx->version < 2)
         continue;
+      // already verified along with the rest of the incoming blocks by prepare_rct_semantics
+      if (keeped_by_block && m_rct_semantics_verified_txes.find(tx_info[n].tx_hash) != m_rct_semantics_verified_txes.end())
+        continue;
       const rct::rctSig &rv = tx_info[n].tx->rct_signatures;
       switch (rv.type) {
         case rct::RCTTypeNull:
@@ -960,6 +1047,7 @@ namespace cryptonote
             break;
           }
           rvv.push_back(&rv); // delayed batch verification
+          rvv_tx_info_index.push_back(n);
           break;
         case rct::RCTTypeBulletproofPlus:
           if (!is_canonical_bulletproof_plus_layout(rv.p.bulletproofs_plus))
@@ -971,6 +1059,7 @@ namespace cryptonote
             break;
           }
           rvv.push_back(&rv); // delayed batch verification
+          rvv_tx_info_index.push_back(n);
           break;
         default:
           MERROR_VER("Unknown rct type: " << rv.type);
@@ -980,29 +1069,85 @@ namespace cryptonote
           break;
       }
     }
-    if (!rvv.empty() && !rct::verRctSemanticsSimple(rvv))
+    std::deque<bool> rvv_results;
+    if (!rvv.empty() && !rct::verRctSemanticsSimple(rvv, rvv_results))
     {
-      LOG_PRINT_L1("One transaction among this group has bad semantics, verifying one at a time");
+      LOG_PRINT_L1("One transaction among this group has bad semantics");
       ret = false;
-      const bool assumed_bad = rvv.size() == 1; // if there's only one tx, it must be the bad one
-      for (size_t n = 0; n < tx_info.size(); ++n)
+      for (size_t i = 0; i < rvv.size(); ++i)
       {
-        if (!tx_info[n].result)
-          continue;
-        if (tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof && tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof2 && tx_info[n].tx->rct_signatures.type != rct::RCTTypeCLSAG && tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproofPlus)
+        if (rvv_results[i])
           continue;
-        if (assumed_bad || !rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures))
-        {
-          set_semantics_failed(tx_info[n].tx_hash);
-          tx_info[n].tvc.m_verifivation_failed = true;
-          tx_info[n].result = false;
-        }
+        const size_t n = rvv_tx_info_index[i];
+        set_semantics_failed(tx_info[n].tx_hash);
+        tx_info[n].tvc.m_verifivation_failed = true;
+        tx_info[n].result = false;
       }
     }
 
     return ret;
   }
   //-----------------------------------------------------------------------------------------------
+  void core::prepare_rct_semantics(const std::vector<block_complete_entry> &blocks_entry)
+  {
+    m_rct_semantics_verified_txes.clear();
+
+    // whatever the lookahead got through is only reused for the txes of these
+    // blocks, anything else it verified belonged to a span we did not get to
+    std::unordered_set<crypto::hash> lookahead_verified_txes;
+    wait_rct_lookahead();
+    lookahead_verified_txes.swap(m_rct_lookahead_verified_txes);
+    m_rct_lookahead_blocks.clear();
+
+    if (blocks_entry.empty())
+      return;
+    const uint64_t last_height = m_blockchain_storage.get_current_blockchain_height() + blocks_entry.size() - 1;
+    if (m_blockchain_storage.is_within_compiled_block_hash_area(last_height))
+      return;
+
+    const size_t reused = ver_rct_semantics_blocks(blocks_entry, lookahead_verified_txes, m_rct_semantics_verified_txes);
+    MDEBUG("Verified RCT semantics of " << m_rct_semantics_verified_txes.size() << " txes, " << reused << " of them by the lookahead");
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::pipeline_next_span(uint64_t start_height, std::vector<block_complete_entry> blocks_entry)
+  {
+    if (!m_pipeline_block_import || blocks_entry.empty())
+      return;
+    wait_rct_lookahead();
+    m_rct_lookahead_verified_txes.clear();
+    m_rct_lookahead_blocks.clear();
+    if (m_blockchain_storage.is_within_compiled_block_hash_area(start_height + blocks_entry.size() - 1))
+      return;
+
+    m_rct_lookahead_blocks = std::move(blocks_entry);
+    try
+    {
+      m_rct_lookahead_thread = boost::thread([this]() {
+        try
+        {
+          ver_rct_semantics_blocks(m_rct_lookahead_blocks, std::unordered_set<crypto::hash>(), m_rct_lookahead_verified_txes);
+          MDEBUG("Lookahead verified RCT semantics of " << m_rct_lookahead_verified_txes.size() << " txes");
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Exception in RCT semantics lookahead: " << e.what());
+          m_rct_lookahead_verified_txes.clear();
+        }
+      });
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to start RCT semantics lookahead: " << e.what());
+      m_rct_lookahead_blocks.clear();
+    }
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::wait_rct_lookahead()
+  {
+    if (m_rct_lookahead_thread.joinable())
+      m_rct_lookahead_thread.join();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_txs(const epee::span<const tx_blob_entry> tx_blobs, epee::span<tx_verification_context> tvc, relay_method tx_relay, bool relayed)
   {
     TRY_ENTRY();
@@ -1015,7 +1160,12 @@ namespace cryptonote
 
     std::vector<txpool_event> results(tx_blobs.size());
 
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    // Txes relayed on their own are parsed and verified concurrently, only adding
+    // them to the pool is serialized. Txes from blocks use m_rct_semantics_verified_txes,
+    // which is guarded by the lock, so they take it for the whole batch.
+    std::unique_lock<epee::critical_section> incoming_tx_lock(m_incoming_tx_lock, std::defer_lock);
+    if (tx_relay == relay_method::block)
+      incoming_tx_lock.lock();
 
     tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
     tools::threadpool::waiter waiter(tpool);
@@ -1080,6 +1230,23 @@ namespace cryptonote
     if (!tx_info.empty())
       handle_incoming_tx_accumulated_batch(tx_info, tx_relay == relay_method::block);
 
+    if (tx_relay != relay_method::block)
+    {
+      // verify ring signatures ahead, so check_tx_inputs finds them in the RCT verification
+      // cache and holds the blockchain lock for less time. Txes conflicting with the pool
+      // are left out, they would be rejected anyway.
+      std::vector<const transaction*> ring_txes;
+      ring_txes.reserve(tx_info.size());
+      for (const tx_verification_batch_info &info : tx_info)
+      {
+        if (info.result && !m_mempool.have_tx_keyimges_as_spent(*info.tx, info.tx_hash))
+          ring_txes.push_back(info.tx);
+      }
+      if (!ring_txes.empty())
+        m_blockchain_storage.prepare_rct_ver_cache(ring_txes);
+      incoming_tx_lock.lock();
+    }
+
     bool valid_events = false;
     bool ok = true;
     it = tx_blobs.begin();
@@ -1629,6 +1796,9 @@ namespace cryptonote
       cleanup_handle_incoming_blocks(false);
       return false;
     }
+    // an empty set of parsed blocks means they are not going to be added as a span
+    if (!blocks.empty())
+      prepare_rct_semantics(blocks_entry);
     return true;
   }
 
@@ -1640,6 +1810,15 @@ namespace cryptonote
       success = m_blockchain_storage.cleanup_handle_incoming_blocks(force_sync);
     }
     catch (...) {}
+    m_rct_semantics_verified_txes.clear();
+    if (!success)
+    {
+      // nothing the lookahead found depends on the chain state, but the span
+      // it was working on will be fetched again, so start from scratch
+      wait_rct_lookahead();
+      m_rct_lookahead_verified_txes.clear();
+      m_rct_lookahead_blocks.clear();
+    }
     m_incoming_tx_lock.unlock();
     return success;
   }
@@ -1905,6 +2084,9 @@ namespace cryptonote
     relay_txpool_transactions(); // txpool handles periodic DB checking
     m_check_updates_interval.do_call(boost::bind(&core::check_updates, this));
     m_check_disk_space_interval.do_call(boost::bind(&core::check_disk_space, this));
+    m_db_resize_interval.do_call(boost::bind(&core::resize_db_ahead, this));
+    m_txpool_store_interval.do_call(boost::bind(&core::store_txpool, this));
+    m_rx_prepare_interval.do_call(boost::bind(&core::prepare_next_rx_dataset, this));
     m_block_rate_interval.do_call(boost::bind(&core::check_block_rate, this));
     m_blockchain_pruning_interval.do_call(boost::bind(&core::update_blockchain_pruning, this));
     m_diff_recalc_interval.do_call(boost::bind(&core::recalculate_difficulties, this));
@@ -2063,6 +2245,64 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::store_txpool()
+  {
+    try
+    {
+      m_blockchain_storage.store_txpool();
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to store the txpool: " << e.what());
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::prepare_next_rx_dataset()
+  {
+    // a second dataset takes GBs of memory and a while of all-core CPU to build: only
+    // worth it once synchronized, and only handed over through the dataset cache, so
+    // MONERO_RANDOMX_DATASET_CACHE must be set (see rx-slow-hash.c). Pool nodes serving
+    // templates to external miners need it as much as the built-in miner does
+    const char *dataset_cache = getenv("MONERO_RANDOMX_DATASET_CACHE");
+    if (!is_synchronized() || !dataset_cache || !*dataset_cache)
+      return true;
+    if (m_blockchain_storage.get_current_hard_fork_version() < RX_BLOCK_VERSION)
+      return true;
+
+    // once the next seed block is known, get its dataset ready ahead of the switch
+    const uint64_t height = m_blockchain_storage.get_current_blockchain_height();
+    uint64_t seed_height, next_height;
+    crypto::rx_seedheights(height, &seed_height, &next_height);
+    if (next_height != seed_height && next_height < height)
+    {
+      const crypto::hash next_seedhash = m_blockchain_storage.get_block_id_by_height(next_height);
+      crypto::rx_prepare_next_seedhash(next_seedhash.data, tools::get_max_concurrency());
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::resize_db_ahead()
+  {
+    try
+    {
+      if (m_blockchain_storage.resize_db_ahead())
+      {
+        db_resize_stats stats;
+        if (m_blockchain_storage.get_db().get_resize_stats(stats))
+          MINFO("Database grown to " << stats.map_size / (1024 * 1024) << " MiB, resized " << stats.resizes << " times ("
+              << stats.resizes_ahead << " ahead of need), txns held off for " << stats.stall_ms << " ms in total");
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to grow the database: " << e.what());
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::check_disk_space()
   {
     uint64_t free_space = get_free_space();
@@ -2180,6 +2420,39 @@ namespace cryptonote
     return m_blockchain_storage.check_blockchain_pruning();
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::compact_blockchain()
+  {
+    boost::lock_guard<boost::mutex> lock(m_pruning_mutex);
+    if (m_compaction_thread.joinable())
+    {
+      if (!m_compaction_thread.try_join_for(boost::chrono::milliseconds(0)))
+        return true;
+    }
+    // the copy would not see the pruning done meanwhile
+    if (m_pruning_thread.joinable() && !m_pruning_thread.try_join_for(boost::chrono::milliseconds(0)))
+    {
+      MERROR("Cannot compact the blockchain while it is being pruned");
+      return false;
+    }
+
+    m_compaction_thread = boost::thread([this]() {
+      MGINFO("Compacting the blockchain in the background");
+      try
+      {
+        uint64_t freed_bytes = 0;
+        if (m_blockchain_storage.compact_blockchain(freed_bytes))
+          MGINFO("Blockchain compacted, " << freed_bytes / (1024 * 1024) << " MB freed");
+        else
+          MERROR("Failed to compact the blockchain");
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to compact the blockchain: " << e.what());
+      }
+    });
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   void core::set_target_blockchain_height(uint64_t target_blockchain_height)
   {
     m_target_blockchain_height = target_blockchain_height;
@@ -2209,7 +2482,84 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::prune_blockchain(uint32_t pruning_seed)
   {
-    return get_blockchain_storage().prune_blockchain(pruning_seed);
+    return start_background_pruning(pruning_seed);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::start_background_pruning(uint32_t pruning_seed)
+  {
+    boost::lock_guard<boost::mutex> lock(m_pruning_mutex);
+    if (m_pruning_thread.joinable())
+    {
+      if (!m_pruning_thread.try_join_for(boost::chrono::milliseconds(0)))
+        return true;
+    }
+    if (m_compaction_thread.joinable() && !m_compaction_thread.try_join_for(boost::chrono::milliseconds(0)))
+    {
+      MERROR("Cannot prune the blockchain while it is being compacted");
+      return false;
+    }
+
+    // the first step saves the pruning seed, so the blockchain is known to be pruned from now on
+    uint64_t pruned_bytes = 0;
+    bool done = false;
+    try
+    {
+      while (!m_blockchain_storage.prune_blockchain_step(pruning_seed, CRYPTONOTE_PRUNING_STEP_TXES, pruned_bytes, done))
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to prune blockchain: " << e.what());
+      return false;
+    }
+    if (done)
+      return true;
+
+    m_pruning_thread = boost::thread([this]() { background_pruning(); });
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::background_pruning()
+  {
+    MGINFO("Pruning blockchain in the background" <<
+        (m_prune_blockchain_rate ? " at up to " + std::to_string(m_prune_blockchain_rate) + " kB/s" : std::string()));
+    try
+    {
+      while (1)
+      {
+        const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+        uint64_t pruned_bytes = 0;
+        bool done = false;
+        if (!m_blockchain_storage.prune_blockchain_step(0, CRYPTONOTE_PRUNING_STEP_TXES, pruned_bytes, done))
+        {
+          // blocks are being added, they come first
+          boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+          continue;
+        }
+        if (done)
+          break;
+        if (m_prune_blockchain_rate)
+        {
+          const boost::chrono::microseconds budget(pruned_bytes * 1000 / m_prune_blockchain_rate);
+          const boost::chrono::steady_clock::duration elapsed = boost::chrono::steady_clock::now() - start;
+          if (elapsed < budget)
+            boost::this_thread::sleep_for(budget - elapsed);
+        }
+        else
+        {
+          boost::this_thread::interruption_point();
+        }
+      }
+      MGINFO("Blockchain pruning done");
+    }
+    catch (const boost::thread_interrupted &)
+    {
+      MINFO("Background pruning stopped, it will resume on restart");
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Background pruning failed, it will resume on restart: " << e.what());
+    }
   }
   //-----------------------------------------------------------------------------------------------
   bool core::is_within_compiled_block_hash_area(uint64_t height) const
@@ -35,6 +35,7 @@
 #include <boost/function.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "cryptonote_basic/fwd.h"
 #include "cryptonote_core/i_core_events.h"
@@ -194,6 +195,21 @@ namespace cryptonote
       * @note see Blockchain::cleanup_handle_incoming_blocks
       */
      bool cleanup_handle_incoming_blocks(bool force_sync = false);
+
+     /**
+      * @brief starts verifying the next queued span while the current one is committed
+      *
+      * Only done with --pipeline-block-import. The RCT semantics of the span's
+      * txes are checked on a background thread, so the work overlaps committing
+      * the current span, and the next prepare_handle_incoming_blocks picks up the
+      * results for the txes it gets again. Must be called once the current span's
+      * blocks are added, so it does not compete with their input checks for the
+      * threadpool, and before cleanup_handle_incoming_blocks.
+      *
+      * @param start_height the height of the first block of the span
+      * @param blocks_entry the blocks of the span
+      */
+     void pipeline_next_span(uint64_t start_height, std::vector<block_complete_entry> blocks_entry);
      	     	
      /**
       * @brief check the size of a block against the current maximum
@@ -500,6 +516,20 @@ namespace cryptonote
       * @note see tx_memory_pool::get_txpool_backlog
       */
      bool get_txpool_backlog(std::vector<tx_backlog_entry>& backlog, bool include_sensitive_txes = false) const;
+
+     /**
+      * @copydoc tx_memory_pool::get_fee_histogram
+      *
+      * @note see tx_memory_pool::get_fee_histogram
+      */
+     fee_histogram get_txpool_fee_histogram(bool include_sensitive_txes = false) const;
+
+     /**
+      * @copydoc tx_memory_pool::get_fee_per_byte_for_weight_ahead
+      *
+      * @note see tx_memory_pool::get_fee_per_byte_for_weight_ahead
+      */
+     uint64_t get_txpool_fee_per_byte_for_weight_ahead(uint64_t weight) const;
      
      /**
       * @copydoc tx_memory_pool::get_transactions
@@ -664,6 +694,13 @@ namespace cryptonote
       */
      const Blockchain& get_blockchain_storage()const{return m_blockchain_storage;}
 
+     /**
+      * @brief gets the tx_memory_pool instance
+      *
+      * @return a reference to the tx_memory_pool instance
+      */
+     tx_memory_pool& get_pool(){return m_mempool;}
+
      /**
       * @brief gets addy
       *
@@ -872,6 +909,9 @@ namespace cryptonote
      /**
       * @brief prune the blockchain
       *
+      * The pruning seed is saved right away, the rest of the pruning is done
+      * in the background, see start_background_pruning.
+      *
       * @param pruning_seed the seed to use to prune the chain (0 for default, highly recommended)
       *
       * @return true iff success
@@ -892,6 +932,16 @@ namespace cryptonote
       */
      bool check_blockchain_pruning();
 
+     /**
+      * @brief rewrites the blockchain database without its free pages, on a background thread
+      *
+      * The daemon keeps running meanwhile, see Blockchain::compact_blockchain.
+      * Does nothing if it is already running.
+      *
+      * @return false if the blockchain is being pruned in the background
+      */
+     bool compact_blockchain();
+
      /**
       * @brief checks whether a given block height is included in the precompiled block hash area
       *
@@ -1012,6 +1062,40 @@ namespace cryptonote
      struct tx_verification_batch_info { const cryptonote::transaction *tx; crypto::hash tx_hash; tx_verification_context &tvc; bool &result; };
      bool handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block);
 
+     /**
+      * @brief verifies the RCT semantics of all transactions in a set of incoming blocks at once
+      *
+      * Range proofs from the whole set are batched together rather than block by
+      * block. Transactions which pass are remembered until cleanup_handle_incoming_blocks,
+      * so handle_incoming_tx_accumulated_batch does not check them again.
+      *
+      * @param blocks_entry the blocks being prepared
+      */
+     void prepare_rct_semantics(const std::vector<block_complete_entry> &blocks_entry);
+
+     /**
+      * @brief waits for the background verification started by pipeline_next_span, if any
+      */
+     void wait_rct_lookahead();
+
+     /**
+      * @brief prunes the blockchain a few transactions at a time on a background thread
+      *
+      * The first step is done before returning, so the pruning seed is saved.
+      * The thread gives way to adding blocks, and is throttled by
+      * --prune-blockchain-rate. Does nothing if it is already running.
+      *
+      * @param pruning_seed the seed to use to prune the chain (0 for default, highly recommended)
+      *
+      * @return false if the first step failed
+      */
+     bool start_background_pruning(uint32_t pruning_seed);
+
+     /**
+      * @brief the body of the background pruning thread
+      */
+     void background_pruning();
+
      /**
       * @copydoc miner::on_block_chain_update
       *
@@ -1087,6 +1171,27 @@ namespace cryptonote
       */
      bool check_disk_space();
 
+     /**
+      * @brief grows the database ahead of need, so block sync rarely has to wait for it
+      *
+      * @return true on success, false otherwise
+      */
+     bool resize_db_ahead();
+
+     /**
+      * @brief writes the txpool to disk, if the database keeps it in memory
+      *
+      * @return true on success, false otherwise
+      */
+     bool store_txpool();
+
+     /**
+      * @brief gets the RandomX dataset for the next seed ready ahead of the switch, on a synchronized node with a dataset cache
+      *
+      * @return true
+      */
+     bool prepare_next_rx_dataset();
+
      /**
       * @brief checks block rate, and warns if it's too slow
       *
@@ -1123,7 +1228,10 @@ namespace cryptonote
      epee::math_helper::once_a_time_seconds<60*60*2, true> m_fork_moaner; //!< interval for checking HardFork status
      epee::math_helper::once_a_time_seconds<60*60*12, true> m_check_updates_interval; //!< interval for checking for new versions
      epee::math_helper::once_a_time_seconds<60*10, true> m_check_disk_space_interval; //!< interval for checking for disk space
+     epee::math_helper::once_a_time_seconds<60, true> m_db_resize_interval; //!< interval for growing the database ahead of need
+     epee::math_helper::once_a_time_seconds<60, true> m_rx_prepare_interval; //!< interval for checking whether the next RandomX dataset can be prepared
      epee::math_helper::once_a_time_seconds<90, false> m_block_rate_interval; //!< interval for checking block rate
+     epee::math_helper::once_a_time_seconds<60*10, false> m_txpool_store_interval; //!< interval for writing an in-memory txpool to disk
      epee::math_helper::once_a_time_seconds<60*60*5, true> m_blockchain_pruning_interval; //!< interval for incremental blockchain pruning
      epee::math_helper::once_a_time_seconds<60*60*24*7, false> m_diff_recalc_interval; //!< interval for recalculating difficulties
 
@@ -1149,6 +1257,18 @@ namespace cryptonote
      std::unordered_set<crypto::hash> bad_semantics_txes[2];
      boost::mutex bad_semantics_txes_lock;
 
+     std::unordered_set<crypto::hash> m_rct_semantics_verified_txes; //!< txes of the incoming blocks with verified RCT semantics, guarded by m_incoming_tx_lock
+
+     bool m_pipeline_block_import = false; //!< whether to verify the next queued span while the current one is added
+     boost::thread m_rct_lookahead_thread; //!< verifies the RCT semantics of the next queued span
+     std::vector<block_complete_entry> m_rct_lookahead_blocks; //!< the span being verified ahead, guarded by m_incoming_tx_lock
+     std::unordered_set<crypto::hash> m_rct_lookahead_verified_txes; //!< txes of that span with verified RCT semantics, only valid once the thread is joined
+
+     boost::thread m_pruning_thread; //!< prunes the blockchain in the background
+     boost::thread m_compaction_thread; //!< compacts the blockchain database in the background
+     boost::mutex m_pruning_mutex; //!< serializes starting the pruning and compaction threads
+     uint64_t m_prune_blockchain_rate = 0; //!< most kB of prunable data pruned per second in the background, 0 for no limit
+
      enum {
        UPDATES_DISABLED,
        UPDATES_NOTIFY,
@@ -35,6 +35,7 @@
 using namespace epee;
 
 #include "common/apply_permutation.h"
+#include "common/perf_timer.h"
 #include "cryptonote_tx_utils.h"
 #include "cryptonote_config.h"
 #include "blockchain.h"
@@ -732,4 +733,52 @@ namespace cryptonote
     get_block_longhash(pbc, b, p, height, seed_hash, miners);
     return p;
   }
+
+  void get_block_longhashes(const Blockchain *pbc, const epee::span<const block> &blocks, uint64_t height, std::vector<crypto::hash> &res, std::vector<uint64_t> *elapsed_us)
+  {
+    res.resize(blocks.size());
+    if (elapsed_us)
+      elapsed_us->resize(blocks.size());
+
+    // blocks which can't go through rx_slow_hash_batch: pre RandomX, the 202612 workaround, genesis
+    const auto batchable = [&](size_t i) {
+      return pbc != NULL && blocks[i].major_version >= RX_BLOCK_VERSION && height + i != 202612;
+    };
+
+    std::vector<blobdata> blobs;
+    std::vector<const void*> data;
+    std::vector<size_t> lengths;
+    size_t i = 0;
+    while (i < blocks.size())
+    {
+      if (!batchable(i))
+      {
+        const uint64_t start = tools::get_tick_count();
+        get_block_longhash(pbc, blocks[i], res[i], height + i, NULL);
+        if (elapsed_us)
+          (*elapsed_us)[i] = tools::ticks_to_ns(tools::get_tick_count() - start) / 1000;
+        ++i;
+        continue;
+      }
+
+      // gather the run of blocks with the same seed
+      const uint64_t seed_height = rx_seedheight(height + i);
+      const crypto::hash seed_hash = pbc->get_pending_block_id_by_height(seed_height);
+      size_t end = i;
+      blobs.clear();
+      while (end < blocks.size() && batchable(end) && rx_seedheight(height + end) == seed_height)
+        blobs.push_back(get_block_hashing_blob(blocks[end++]));
+      data.resize(blobs.size());
+      lengths.resize(blobs.size());
+      for (size_t n = 0; n < blobs.size(); ++n)
+      {
+        data[n] = blobs[n].data();
+        lengths[n] = blobs[n].size();
+      }
+
+      static_assert(sizeof(crypto::hash) == HASH_SIZE, "Unexpected hash size");
+      rx_slow_hash_batch(seed_hash.data, blobs.size(), data.data(), lengths.data(), reinterpret_cast<char*>(&res[i]), elapsed_us ? &(*elapsed_us)[i] : NULL);
+      i = end;
+    }
+  }
 }
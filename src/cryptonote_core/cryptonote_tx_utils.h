@@ -148,6 +148,15 @@ namespace cryptonote
   bool get_block_longhash(const Blockchain *pb, const blobdata& bd, crypto::hash& res, const uint64_t height, const int major_version, const crypto::hash *seed_hash, const int miners = 0);
   bool get_block_longhash(const Blockchain *pb, const block& b, crypto::hash& res, const uint64_t height, const crypto::hash *seed_hash = nullptr, const int miners = 0);
   crypto::hash get_block_longhash(const Blockchain *pb, const block& b, const uint64_t height, const crypto::hash *seed_hash = nullptr, const int miners = 0);
+  /**
+   * @brief computes the PoW hashes of consecutive blocks starting at height
+   *
+   * RandomX blocks sharing a seed are hashed in one rx_slow_hash_batch call, using VMs that
+   * outlive the call instead of per thread ones.
+   *
+   * @param elapsed_us if not null, return-by-reference the time spent hashing each block
+   */
+  void get_block_longhashes(const Blockchain *pb, const epee::span<const block> &blocks, uint64_t height, std::vector<crypto::hash> &res, std::vector<uint64_t> *elapsed_us = nullptr);
   void get_altblock_longhash(const block& b, crypto::hash& res, const crypto::hash& seed_hash);
 
 }
@@ -0,0 +1,107 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "misc_log_ex.h"
+#include "cryptonote_core/fee_histogram.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "txpool"
+
+namespace cryptonote
+{
+
+fee_histogram::fee_histogram()
+{
+    clear();
+}
+
+size_t fee_histogram::get_bin_index(uint64_t fee, uint64_t weight)
+{
+    if (weight == 0 || fee < weight)
+        return 0;
+    const double doublings = std::log2(fee / (double)weight);
+    const size_t index = 1 + (size_t)(doublings * FEE_HISTOGRAM_BINS_PER_DOUBLING);
+    return std::min(index, FEE_HISTOGRAM_BINS - 1);
+}
+
+uint64_t fee_histogram::get_bin_min_fee_per_byte(size_t index)
+{
+    if (index == 0)
+        return 0;
+    return (uint64_t)std::ceil(std::exp2((index - 1) / (double)FEE_HISTOGRAM_BINS_PER_DOUBLING));
+}
+
+void fee_histogram::add(uint64_t fee, uint64_t weight)
+{
+    bin &b = m_bins[get_bin_index(fee, weight)];
+    ++b.count;
+    b.weight += weight;
+    b.fee += fee;
+    ++m_count;
+    m_weight += weight;
+}
+
+void fee_histogram::remove(uint64_t fee, uint64_t weight)
+{
+    bin &b = m_bins[get_bin_index(fee, weight)];
+    if (b.count == 0 || b.weight < weight || b.fee < fee)
+    {
+        MERROR("Underflow in fee histogram");
+        return;
+    }
+    --b.count;
+    b.weight -= weight;
+    b.fee -= fee;
+    --m_count;
+    m_weight -= weight;
+}
+
+void fee_histogram::clear()
+{
+    m_bins.fill(bin{0, 0, 0});
+    m_count = 0;
+    m_weight = 0;
+}
+
+uint64_t fee_histogram::get_fee_per_byte_for_weight_ahead(uint64_t weight) const
+{
+    uint64_t ahead = 0;
+    for (size_t i = FEE_HISTOGRAM_BINS; i-- > 0; )
+    {
+        ahead += m_bins[i].weight;
+        if (ahead > weight)
+            return get_bin_min_fee_per_byte(std::min(i + 1, FEE_HISTOGRAM_BINS - 1));
+    }
+    return 0;
+}
+
+}
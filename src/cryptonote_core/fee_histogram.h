@@ -0,0 +1,89 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cryptonote
+{
+
+/**
+ * @brief Pool transactions binned by fee per byte, with count, weight and fee totals
+ *
+ * Bins are log scaled, FEE_HISTOGRAM_BINS_PER_DOUBLING of them for each doubling of the
+ * fee per byte, with bin 0 holding everything paying less than one atomic unit per byte.
+ * The owner adds and removes transactions as they enter and leave the pool, so that fee
+ * pressure and eviction cutoffs are answered by walking the bins instead of the pool.
+ * Not thread safe, the owner is expected to lock.
+ */
+class fee_histogram
+{
+public:
+    static constexpr const size_t FEE_HISTOGRAM_BINS_PER_DOUBLING = 4;
+    static constexpr const size_t FEE_HISTOGRAM_BINS = 1 + 48 * FEE_HISTOGRAM_BINS_PER_DOUBLING;
+
+    struct bin
+    {
+        uint64_t count;
+        uint64_t weight;
+        uint64_t fee;
+    };
+
+    fee_histogram();
+
+    void add(uint64_t fee, uint64_t weight);
+    void remove(uint64_t fee, uint64_t weight);
+    void clear();
+
+    uint64_t count() const { return m_count; }
+    uint64_t weight() const { return m_weight; }
+    const std::array<bin, FEE_HISTOGRAM_BINS> &bins() const { return m_bins; }
+
+    /**
+     * @brief lowest fee per byte a tx needs to have at most `weight` of the pool ahead of it
+     *
+     * Resolution is one bin, so this is the lower bound of the first bin above the ones
+     * holding `weight` worth of higher paying transactions. Returns 0 if the whole pool
+     * weighs no more than `weight`.
+     */
+    uint64_t get_fee_per_byte_for_weight_ahead(uint64_t weight) const;
+
+    static size_t get_bin_index(uint64_t fee, uint64_t weight);
+    static uint64_t get_bin_min_fee_per_byte(size_t index);
+
+private:
+    std::array<bin, FEE_HISTOGRAM_BINS> m_bins;
+    uint64_t m_count;
+    uint64_t m_weight;
+};
+
+}
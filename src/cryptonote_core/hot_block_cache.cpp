@@ -0,0 +1,108 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <boost/thread/lock_guard.hpp>
+
+#include "cryptonote_core/hot_block_cache.h"
+
+namespace cryptonote
+{
+
+hot_block_cache::hot_block_cache(size_t max_size):
+    m_max_size(max_size),
+    m_size(0),
+    m_hits(0),
+    m_misses(0)
+{
+}
+
+void hot_block_cache::set_max_size(size_t max_size)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_max_size = max_size;
+    while (m_size > m_max_size && !m_lru.empty())
+        erase(m_entries.find(m_lru.back()));
+}
+
+hot_block_cache::entry_ptr hot_block_cache::get(uint64_t height, bool pruned)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    const auto it = m_entries.find(key_t(height, pruned));
+    if (it == m_entries.end())
+    {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return it->second.e;
+}
+
+void hot_block_cache::put(uint64_t height, bool pruned, entry_ptr e)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (!e || e->size > m_max_size)
+        return;
+
+    const key_t key(height, pruned);
+    const auto it = m_entries.find(key);
+    if (it != m_entries.end())
+        erase(it);
+    while (m_size + e->size > m_max_size && !m_lru.empty())
+        erase(m_entries.find(m_lru.back()));
+
+    m_lru.push_front(key);
+    m_size += e->size;
+    m_entries.emplace(key, slot{std::move(e), m_lru.begin()});
+}
+
+void hot_block_cache::invalidate(uint64_t height)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_entries.lower_bound(key_t(height, false));
+    while (it != m_entries.end())
+        erase(it++);
+}
+
+void hot_block_cache::clear()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_size = 0;
+}
+
+void hot_block_cache::erase(std::map<key_t, slot>::iterator it)
+{
+    m_size -= it->second.e->size;
+    m_lru.erase(it->second.lru);
+    m_entries.erase(it);
+}
+
+} // namespace cryptonote
@@ -0,0 +1,115 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+
+namespace cryptonote
+{
+
+// Modifying these values should not affect consensus. You can adjust them for performance needs
+// (see --block-cache-size)
+static constexpr const size_t HOT_BLOCK_CACHE_SIZE = 64 * 1024 * 1024;
+static constexpr const uint64_t HOT_BLOCK_CACHE_DEPTH = 1000;
+
+/**
+ * @brief Byte bounded LRU of recent blocks as returned by BlockchainDB::get_blocks_from
+ *
+ * Wallets and syncing peers keep asking for the same few blocks near the top of the chain.
+ * Each entry holds one height's block blob, miner tx hash and (pruned or full) tx blobs,
+ * so that serving it again costs a copy instead of a round of database reads, decompression
+ * and parsing. Entries are immutable and shared, and are keyed by height: the owner must call
+ * invalidate() whenever the chain is rewound, or a different block may be served for a height.
+ */
+class hot_block_cache
+{
+public:
+    struct entry
+    {
+        cryptonote::blobdata block;
+        crypto::hash miner_tx_hash;
+        std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
+        size_t size; //!< block and tx blob bytes, as counted against FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE
+    };
+    typedef std::shared_ptr<const entry> entry_ptr;
+
+    explicit hot_block_cache(size_t max_size = HOT_BLOCK_CACHE_SIZE);
+
+    void set_max_size(size_t max_size);
+    size_t get_max_size() const { return m_max_size; }
+
+    /**
+     * @brief returns the cached entry for a height, or null
+     */
+    entry_ptr get(uint64_t height, bool pruned);
+
+    /**
+     * @brief stores an entry, evicting the least recently used ones to stay in budget
+     */
+    void put(uint64_t height, bool pruned, entry_ptr e);
+
+    /**
+     * @brief drops all entries at or above height
+     */
+    void invalidate(uint64_t height);
+
+    void clear();
+
+    uint64_t get_hits() const { return m_hits; }
+    uint64_t get_misses() const { return m_misses; }
+
+private:
+    typedef std::pair<uint64_t, bool> key_t;
+    struct slot
+    {
+        entry_ptr e;
+        std::list<key_t>::iterator lru;
+    };
+
+    void erase(std::map<key_t, slot>::iterator it);
+
+    boost::mutex m_mutex;
+    size_t m_max_size;
+    size_t m_size;
+    std::map<key_t, slot> m_entries;
+    std::list<key_t> m_lru; // most recently used first
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+};
+
+} // namespace cryptonote
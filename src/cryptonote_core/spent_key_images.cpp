@@ -0,0 +1,82 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cryptonote_core/spent_key_images.h"
+
+namespace cryptonote
+{
+
+spent_key_images::spent_key_images(size_t num_stripes):
+    m_stripes(num_stripes ? num_stripes : 1)
+{
+    for (auto &s: m_stripes)
+        s.reset(new stripe());
+}
+
+std::vector<crypto::hash> spent_key_images::get(const crypto::key_image &key_image) const
+{
+    const stripe &s = get_stripe(key_image);
+    std::lock_guard<std::mutex> lock(s.m);
+    const auto it = s.txids.find(key_image);
+    if (it == s.txids.end())
+        return {};
+    return std::vector<crypto::hash>(it->second.begin(), it->second.end());
+}
+
+void spent_key_images::for_each(const std::function<void(const crypto::key_image&, const txid_set&)> &f) const
+{
+    for (const auto &s: m_stripes)
+    {
+        std::lock_guard<std::mutex> lock(s->m);
+        for (const auto &e: s->txids)
+            f(e.first, e.second);
+    }
+}
+
+void spent_key_images::clear()
+{
+    for (auto &s: m_stripes)
+    {
+        std::lock_guard<std::mutex> lock(s->m);
+        s->txids.clear();
+    }
+}
+
+size_t spent_key_images::size() const
+{
+    size_t n = 0;
+    for (const auto &s: m_stripes)
+    {
+        std::lock_guard<std::mutex> lock(s->m);
+        n += s->txids.size();
+    }
+    return n;
+}
+
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+
+/**
+ * @brief Key images spent by pool transactions, with the txids spending each of them
+ *
+ * Entries are spread over independently locked stripes by key image, so that conflict
+ * checks for incoming transactions only lock the stripes of the key images they look at,
+ * and do not need the pool lock. Writers are still expected to hold the pool lock, so that
+ * what is written here stays in step with the pool. Readers of the whole set, such as the
+ * RPC pool queries, hold the pool lock too: for_each is not a snapshot on its own.
+ */
+class spent_key_images
+{
+public:
+    typedef std::unordered_set<crypto::hash> txid_set;
+
+    explicit spent_key_images(size_t num_stripes = 64);
+
+    /**
+     * @brief calls f with the txids spending key_image, under the lock of its stripe
+     *
+     * The set is created empty if the key image is not known yet, and dropped again
+     * if f leaves it empty. f must not call back into this object.
+     */
+    template<typename F>
+    void update(const crypto::key_image &key_image, F f)
+    {
+        stripe &s = get_stripe(key_image);
+        std::lock_guard<std::mutex> lock(s.m);
+        const auto it = s.txids.emplace(key_image, txid_set()).first;
+        f(it->second);
+        if (it->second.empty())
+            s.txids.erase(it);
+    }
+
+    //! returns a copy of the txids spending key_image, empty if none
+    std::vector<crypto::hash> get(const crypto::key_image &key_image) const;
+
+    //! calls f for each key image, one stripe at a time, f must not call back into this object
+    //! stripes are locked in turn, so without the pool lock the key images seen may be from different times
+    void for_each(const std::function<void(const crypto::key_image&, const txid_set&)> &f) const;
+
+    void clear();
+    size_t size() const;
+
+private:
+    struct stripe
+    {
+        mutable std::mutex m;
+        std::unordered_map<crypto::key_image, txid_set> txids;
+    };
+
+    stripe& get_stripe(const crypto::key_image &key_image) const
+    {
+        // key images are uniformly distributed, any of their bytes will do
+        size_t h;
+        static_assert(sizeof(key_image) >= sizeof(h), "key image too small");
+        memcpy(&h, key_image.data + sizeof(key_image) - sizeof(h), sizeof(h));
+        return *m_stripes[h % m_stripes.size()];
+    }
+
+    std::vector<std::unique_ptr<stripe>> m_stripes;
+};
+
+}
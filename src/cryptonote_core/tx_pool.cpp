@@ -45,6 +45,7 @@
 #include "misc_language.h"
 #include "warnings.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "crypto/hash.h"
 #include "crypto/duration.h"
 
@@ -90,6 +91,7 @@ namespace cryptonote
     time_t const MIN_RELAY_TIME = (60 * 5); // only start re-relaying transactions after that many seconds
     time_t const MAX_RELAY_TIME = (60 * 60 * 4); // at most that many seconds between resends
     float const ACCEPT_THRESHOLD = 1.0f;
+    size_t const VALIDATE_BATCH_SIZE = 1024; // txes read, parsed and re-added at a time by validate
 
     //! Max DB check interval for relayable txes
     constexpr const std::chrono::minutes max_relayable_check{2};
@@ -309,6 +311,7 @@ namespace cryptonote
 
           m_blockchain.add_txpool_tx(id, blob, meta);
           add_tx_to_transient_lists(id, fee / (double)(tx_weight ? tx_weight : 1), receive_time);
+          update_template_candidate(id, meta, tx);
           lock.commit();
         }
         catch (const std::exception &e)
@@ -380,6 +383,7 @@ namespace cryptonote
           m_blockchain.remove_txpool_tx(id);
           m_blockchain.add_txpool_tx(id, blob, meta);
           add_tx_to_transient_lists(id, meta.fee / (double)(tx_weight ? tx_weight : 1), receive_time);
+          update_template_candidate(id, meta, tx);
         }
         lock.commit();
       }
@@ -465,43 +469,37 @@ namespace cryptonote
         break;
       try
       {
-        const crypto::hash &txid = it->second;
-        txpool_tx_meta_t meta;
-        if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+        const crypto::hash txid = it->second;
+        const auto candidate_it = m_template_candidates.find(txid);
+        if (candidate_it == m_template_candidates.end())
         {
           static bool warned = false;
           if (!warned)
           {
-            MERROR("Failed to find tx_meta in txpool (will only print once)");
+            MERROR("Failed to find template candidate for txpool tx (will only print once)");
             warned = true;
           }
           --it;
           continue;
         }
+        const template_candidate &candidate = candidate_it->second;
         // don't prune the kept_by_block ones, they're likely added because we're adding a block with those
-        if (meta.kept_by_block)
+        if (candidate.tx_relay == relay_method::block)
         {
           --it;
           continue;
         }
-        cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
-        cryptonote::transaction_prefix tx;
-        if (!parse_and_validate_tx_prefix_from_blob(txblob, tx))
-        {
-          MERROR("Failed to parse tx from txpool");
-          return;
-        }
         // remove first, in case this throws, so key images aren't removed
-        MINFO("Pruning tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
+        MINFO("Pruning tx " << txid << " from txpool: weight: " << candidate.weight << ", fee/byte: " << it->first.first);
         m_blockchain.remove_txpool_tx(txid);
-        reduce_txpool_weight(meta.weight);
-        remove_transaction_keyimages(tx, txid);
-        MINFO("Pruned tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
+        reduce_txpool_weight(candidate.weight);
+        remove_transaction_keyimages(candidate.key_images, txid);
+        MINFO("Pruned tx " << txid << " from txpool: weight: " << candidate.weight << ", fee/byte: " << it->first.first);
 
         auto it_prev = it;
         --it_prev;
 
-        remove_tx_from_transient_lists(it, txid, !meta.matches(relay_category::broadcasted));
+        remove_tx_from_transient_lists(it, txid, !matches_category(candidate.tx_relay, relay_category::broadcasted));
         it = it_prev;
 
         changed = true;
@@ -524,22 +522,24 @@ namespace cryptonote
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, txin, false);
-      std::unordered_set<crypto::hash>& kei_image_set = m_spent_key_images[txin.k_image];
-
-      // Only allow multiple txes per key-image if kept-by-block. Only allow
-      // the same txid if going from local/stem->fluff.
-
-      if (tx_relay != relay_method::block)
-      {
-        const bool one_txid =
-          (kei_image_set.empty() || (kei_image_set.size() == 1 && *(kei_image_set.cbegin()) == id));
-        CHECK_AND_ASSERT_MES(one_txid, false, "internal error: tx_relay=" << unsigned(tx_relay)
-                                           << ", kei_image_set.size()=" << kei_image_set.size() << ENDL << "txin.k_image=" << txin.k_image << ENDL
-                                           << "tx_id=" << id);
-      }
+      bool one_txid = true, inserted = false;
+      size_t kei_image_set_size = 0;
+      m_spent_key_images.update(txin.k_image, [&](spent_key_images::txid_set &kei_image_set) {
+        // Only allow multiple txes per key-image if kept-by-block. Only allow
+        // the same txid if going from local/stem->fluff.
+        kei_image_set_size = kei_image_set.size();
+        if (tx_relay != relay_method::block)
+          one_txid = (kei_image_set.empty() || (kei_image_set.size() == 1 && *(kei_image_set.cbegin()) == id));
+        if (one_txid)
+          inserted = kei_image_set.insert(id).second;
+      });
+
+      CHECK_AND_ASSERT_MES(one_txid, false, "internal error: tx_relay=" << unsigned(tx_relay)
+                                         << ", kei_image_set.size()=" << kei_image_set_size << ENDL << "txin.k_image=" << txin.k_image << ENDL
+                                         << "tx_id=" << id);
 
       const bool new_or_previously_private =
-        kei_image_set.insert(id).second ||
+        inserted ||
         !m_blockchain.txpool_tx_matches_category(id, relay_category::legacy);
       CHECK_AND_ASSERT_MES(new_or_previously_private, false, "internal error: try to insert duplicate iterator in key_image set");
     }
@@ -552,29 +552,30 @@ namespace cryptonote
   //       is treated properly.  Should probably not return early, however.
   bool tx_memory_pool::remove_transaction_keyimages(const transaction_prefix& tx, const crypto::hash &actual_hash)
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-    // ND: Speedup
+    std::vector<crypto::key_image> key_images;
+    key_images.reserve(tx.vin.size());
     for(const txin_v& vi: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(vi, const txin_to_key, txin, false);
-      auto it = m_spent_key_images.find(txin.k_image);
-      CHECK_AND_ASSERT_MES(it != m_spent_key_images.end(), false, "failed to find transaction input in key images. img=" << txin.k_image << ENDL
-                                    << "transaction id = " << actual_hash);
-      std::unordered_set<crypto::hash>& key_image_set =  it->second;
-      CHECK_AND_ASSERT_MES(key_image_set.size(), false, "empty key_image set, img=" << txin.k_image << ENDL
-        << "transaction id = " << actual_hash);
-
-      auto it_in_set = key_image_set.find(actual_hash);
-      CHECK_AND_ASSERT_MES(it_in_set != key_image_set.end(), false, "transaction id not found in key_image set, img=" << txin.k_image << ENDL
+      key_images.push_back(txin.k_image);
+    }
+    return remove_transaction_keyimages(key_images, actual_hash);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::remove_transaction_keyimages(const std::vector<crypto::key_image>& key_images, const crypto::hash &actual_hash)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    // ND: Speedup
+    for(const crypto::key_image& k_image: key_images)
+    {
+      // the set is dropped by update once it is left empty
+      bool found = false;
+      m_spent_key_images.update(k_image, [&](spent_key_images::txid_set &key_image_set) {
+        found = key_image_set.erase(actual_hash) != 0;
+      });
+      CHECK_AND_ASSERT_MES(found, false, "transaction id not found in key_image set, img=" << k_image << ENDL
         << "transaction id = " << actual_hash);
-      key_image_set.erase(it_in_set);
-      if(!key_image_set.size())
-      {
-        //it is now empty hash container for this key_image
-        m_spent_key_images.erase(it);
-      }
-
     }
     ++m_cookie;
     return true;
@@ -754,11 +755,10 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
-    return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
-                       , [&](const sorted_tx_container::value_type& a){
-                         return a.second == id;
-                       }
-    );
+    const auto it = m_template_candidates.find(id);
+    if (it == m_template_candidates.end())
+      return m_txs_by_fee_and_receive_time.end();
+    return it->second.sorted_it;
   }
   //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -932,8 +932,19 @@ namespace cryptonote
           was_just_broadcasted = !already_broadcasted && meta.matches(relay_category::broadcasted);
 
           if (was_just_broadcasted)
+          {
             // Make sure the tx gets re-added with an updated time
             add_tx_to_transient_lists(hash, meta.fee / (double)meta.weight, std::chrono::system_clock::to_time_t(now));
+            // it may now be mined, so templates built before are stale
+            ++m_cookie;
+          }
+          const auto ci = m_template_candidates.find(hash);
+          if (ci != m_template_candidates.end())
+          {
+            remove_from_fee_histograms(ci->second);
+            ci->second.tx_relay = meta.get_relay_method();
+            add_to_fee_histograms(ci->second);
+          }
         }
       }
       catch (const std::exception &e)
@@ -1076,63 +1087,70 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_block_template_backlog(std::vector<tx_block_template_backlog_entry>& backlog, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-
-    std::vector<tx_block_template_backlog_entry> tmp;
-    uint64_t total_weight = 0;
-
-    // First get everything from the mempool, filter it later
-    m_blockchain.for_all_txpool_txes([&tmp, &total_weight](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*){
-      tmp.emplace_back(tx_block_template_backlog_entry{txid, meta.weight, meta.fee});
-      total_weight += meta.weight;
-      return true;
-    }, false, include_sensitive ? relay_category::all : relay_category::broadcasted);
-
     // Limit backlog to 112.5% of current median weight. This is enough to mine a full block with the optimal block reward
     const uint64_t median_weight = m_blockchain.get_current_cumulative_block_weight_median();
     const uint64_t max_backlog_weight = median_weight + (median_weight / 8);
 
-    // If the total weight is too high, choose the best paying transactions
-    if (total_weight > max_backlog_weight)
-      std::stable_sort(tmp.begin(), tmp.end(), [](const auto& a, const auto& b){ return a.fee * b.weight > b.fee * a.weight; });
+    // The cookie is atomic and the tip is read without the blockchain lock:
+    // if either changes just as we compare, we serve a slightly old backlog,
+    // as we would have if the change had come just after building it
+    std::shared_ptr<const backlog_snapshot> snapshot = std::atomic_load(&m_backlog_snapshot);
+    if (snapshot && snapshot->pool_cookie == m_cookie && snapshot->top_id == m_blockchain.get_tail_id()
+        && snapshot->median_weight == median_weight && snapshot->include_sensitive == include_sensitive)
+    {
+      backlog = snapshot->backlog;
+      return;
+    }
 
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    const uint64_t pool_cookie = m_cookie;
+    const crypto::hash top_id = m_blockchain.get_tail_id();
+
+    // The sorted container already has the best paying transactions first
+    const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
     backlog.clear();
     uint64_t w = 0;
 
     std::unordered_set<crypto::key_image> k_images;
 
-    for (const tx_block_template_backlog_entry& e : tmp)
+    LockedTXN lock(m_blockchain.get_db());
+    for (const auto &e: m_txs_by_fee_and_receive_time)
     {
-      try
-      {
-        txpool_tx_meta_t meta;
-        if (!m_blockchain.get_txpool_tx_meta(e.id, meta))
-          continue;
-
-        cryptonote::blobdata txblob;
-        if (!m_blockchain.get_txpool_tx_blob(e.id, txblob, relay_category::all))
-          continue;
-
-        cryptonote::transaction tx;
-        if (is_transaction_ready_to_go(meta, e.id, txblob, tx))
-        {
-          if (have_key_images(k_images, tx))
-            continue;
-          append_key_images(k_images, tx);
+      const auto candidate_it = m_template_candidates.find(e.second);
+      if (candidate_it == m_template_candidates.end())
+        continue;
+      template_candidate &candidate = candidate_it->second;
+      if (candidate.pruned || !matches_category(candidate.tx_relay, category))
+        continue;
+      if (!is_template_candidate_ready(e.second, candidate, top_id))
+        continue;
+      if (std::any_of(candidate.key_images.begin(), candidate.key_images.end(), [&k_images](const crypto::key_image &ki) { return k_images.count(ki) != 0; }))
+        continue;
+      k_images.insert(candidate.key_images.begin(), candidate.key_images.end());
 
-          backlog.push_back(e);
-          w += e.weight;
-          if (w > max_backlog_weight)
-            break;
-        }
-      }
-      catch (const std::exception &e)
-      {
-        MERROR("Failed to check transaction readiness: " << e.what());
-        // continue, not fatal
-      }
+      backlog.push_back(tx_block_template_backlog_entry{e.second, candidate.weight, candidate.fee});
+      w += candidate.weight;
+      if (w > max_backlog_weight)
+        break;
     }
+    lock.commit();
+
+    snapshot = std::make_shared<const backlog_snapshot>(backlog_snapshot{pool_cookie, top_id, median_weight, include_sensitive, backlog});
+    std::atomic_store(&m_backlog_snapshot, snapshot);
+  }
+  //------------------------------------------------------------------
+  fee_histogram tx_memory_pool::get_fee_histogram(bool include_sensitive) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return include_sensitive ? m_fee_histogram : m_broadcasted_fee_histogram;
+  }
+  //------------------------------------------------------------------
+  uint64_t tx_memory_pool::get_fee_per_byte_for_weight_ahead(uint64_t weight) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return m_broadcasted_fee_histogram.get_fee_per_byte_for_weight_ahead(weight);
   }
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct txpool_stats& stats, bool include_sensitive) const
@@ -1262,9 +1280,7 @@ namespace cryptonote
       return true;
     }, true, category);
 
-    for (const key_images_container::value_type& kee : m_spent_key_images) {
-      const crypto::key_image& k_image = kee.first;
-      const std::unordered_set<crypto::hash>& kei_image_set = kee.second;
+    m_spent_key_images.for_each([&](const crypto::key_image& k_image, const spent_key_images::txid_set& kei_image_set) {
       spent_key_image_info ki;
       ki.id_hash = epee::string_tools::pod_to_hex(k_image);
       for (const crypto::hash& tx_id_hash : kei_image_set)
@@ -1276,7 +1292,7 @@ namespace cryptonote
       // Only return key images for which we have at least one tx that we can show for them
       if (!ki.txs_hashes.empty())
         key_image_infos.push_back(std::move(ki));
-    }
+    });
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1313,9 +1329,8 @@ namespace cryptonote
       return true;
     }, true, relay_category::broadcasted);
 
-    for (const key_images_container::value_type& kee : m_spent_key_images) {
+    m_spent_key_images.for_each([&](const crypto::key_image& k_image, const spent_key_images::txid_set& kei_image_set) {
       std::vector<crypto::hash> tx_hashes;
-      const std::unordered_set<crypto::hash>& kei_image_set = kee.second;
       for (const crypto::hash& tx_id_hash : kei_image_set)
       {
         if (m_blockchain.txpool_tx_matches_category(tx_id_hash, relay_category::broadcasted))
@@ -1323,27 +1338,21 @@ namespace cryptonote
       }
 
       if (!tx_hashes.empty())
-        key_image_infos[kee.first] = std::move(tx_hashes);
-    }
+        key_image_infos[k_image] = std::move(tx_hashes);
+    });
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-
+    // no pool lock needed, key images are looked up stripe by stripe
     spent.clear();
 
     for (const auto& image : key_images)
     {
       bool is_spent = false;
-      const auto found = m_spent_key_images.find(image);
-      if (found != m_spent_key_images.end())
-      {
-        for (const crypto::hash& tx_hash : found->second)
-          is_spent |= m_blockchain.txpool_tx_matches_category(tx_hash, relay_category::broadcasted);
-      }
+      for (const crypto::hash& tx_hash : m_spent_key_images.get(image))
+        is_spent |= m_blockchain.txpool_tx_matches_category(tx_hash, relay_category::broadcasted);
       spent.push_back(is_spent);
     }
 
@@ -1375,8 +1384,10 @@ namespace cryptonote
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
+    // Input checks depend on the height, through unlock times, so they all go.
+    // Parsed txes do not depend on the chain, so the ones returned to the pool
+    // from popped blocks are kept till the next block is added.
     m_input_cache.clear();
-    m_parsed_tx_cache.clear();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1389,8 +1400,6 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx, const crypto::hash& txid) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, tokey_in, true);//should never fail
@@ -1402,13 +1411,12 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimg_as_spent(const crypto::key_image& key_im, const crypto::hash& txid) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    const auto found = m_spent_key_images.find(key_im);
-    if (found != m_spent_key_images.end() && !found->second.empty())
+    const std::vector<crypto::hash> txids = m_spent_key_images.get(key_im);
+    if (!txids.empty())
     {
       // If another tx is using the key image, always return as spent.
       // See `insert_key_images`.
-      if (1 < found->second.size() || *(found->second.cbegin()) != txid)
+      if (1 < txids.size() || txids.front() != txid)
         return true;
       return m_blockchain.txpool_tx_matches_category(txid, relay_category::legacy);
     }
@@ -1547,32 +1555,29 @@ namespace cryptonote
     for(size_t i = 0; i!= tx.vin.size(); i++)
     {
       CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, void());
-      const key_images_container::const_iterator it = m_spent_key_images.find(itk.k_image);
-      if (it != m_spent_key_images.end())
+      const std::vector<crypto::hash> txids = m_spent_key_images.get(itk.k_image);
+      for (const crypto::hash &txid: txids)
       {
-        for (const crypto::hash &txid: it->second)
+        txpool_tx_meta_t meta;
+        if (!m_blockchain.get_txpool_tx_meta(txid, meta))
         {
-          txpool_tx_meta_t meta;
-          if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+          MDEBUG("Failed to find tx meta in txpool");
+          // continue, not fatal
+          continue;
+        }
+        if (!meta.double_spend_seen)
+        {
+          MDEBUG("Marking " << txid << " as double spending " << itk.k_image);
+          meta.double_spend_seen = true;
+          changed = true;
+          try
           {
-            MDEBUG("Failed to find tx meta in txpool");
-            // continue, not fatal
-            continue;
+            m_blockchain.update_txpool_tx(txid, meta);
           }
-          if (!meta.double_spend_seen)
+          catch (const std::exception &e)
           {
-            MDEBUG("Marking " << txid << " as double spending " << itk.k_image);
-            meta.double_spend_seen = true;
-            changed = true;
-            try
-            {
-              m_blockchain.update_txpool_tx(txid, meta);
-            }
-            catch (const std::exception &e)
-            {
-              MERROR("Failed to update tx meta: " << e.what());
-              // continue, not fatal
-            }
+            MERROR("Failed to update tx meta: " << e.what());
+            // continue, not fatal
           }
         }
       }
@@ -1620,6 +1625,20 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
+    const uint64_t pool_cookie = m_cookie;
+    const crypto::hash top_id = m_blockchain.get_tail_id();
+    if (m_template_snapshot && m_template_snapshot->pool_cookie == pool_cookie && m_template_snapshot->top_id == top_id
+        && m_template_snapshot->median_weight == median_weight && m_template_snapshot->already_generated_coins == already_generated_coins
+        && m_template_snapshot->version == version)
+    {
+      LOG_PRINT_L2("Reusing block template transaction selection with " << m_template_snapshot->tx_hashes.size() << " txes");
+      bl.tx_hashes.insert(bl.tx_hashes.end(), m_template_snapshot->tx_hashes.begin(), m_template_snapshot->tx_hashes.end());
+      total_weight = m_template_snapshot->total_weight;
+      fee = m_template_snapshot->fee;
+      expected_reward = m_template_snapshot->expected_reward;
+      return true;
+    }
+
     uint64_t best_coinbase = 0, coinbase = 0;
     total_weight = 0;
     fee = 0;
@@ -1636,6 +1655,7 @@ namespace cryptonote
     size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
     std::unordered_set<crypto::key_image> k_images;
+    std::vector<crypto::hash> tx_hashes;
 
     LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
 
@@ -1644,30 +1664,31 @@ namespace cryptonote
     auto sorted_it = m_txs_by_fee_and_receive_time.begin();
     for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
     {
-      txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
+      const auto candidate_it = m_template_candidates.find(sorted_it->second);
+      if (candidate_it == m_template_candidates.end())
       {
         static bool warned = false;
         if (!warned)
-          MERROR("  failed to find tx meta: " << sorted_it->second << " (will only print once)");
+          MERROR("  failed to find template candidate: " << sorted_it->second << " (will only print once)");
         warned = true;
         continue;
       }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase) << ", relay method " << (unsigned)meta.get_relay_method());
+      template_candidate &candidate = candidate_it->second;
+      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << candidate.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase) << ", relay method " << (unsigned)candidate.tx_relay);
 
-      if (!meta.matches(relay_category::legacy) && !(m_mine_stem_txes && meta.get_relay_method() == relay_method::stem))
+      if (!matches_category(candidate.tx_relay, relay_category::legacy) && !(m_mine_stem_txes && candidate.tx_relay == relay_method::stem))
       {
-        LOG_PRINT_L2("  tx relay method is " << (unsigned)meta.get_relay_method());
+        LOG_PRINT_L2("  tx relay method is " << (unsigned)candidate.tx_relay);
         continue;
       }
-      if (meta.pruned)
+      if (candidate.pruned)
       {
         LOG_PRINT_L2("  tx is pruned");
         continue;
       }
 
       // Can not exceed maximum block weight
-      if (max_total_weight < total_weight + meta.weight)
+      if (max_total_weight < total_weight + candidate.weight)
       {
         LOG_PRINT_L2("  would exceed maximum block weight");
         continue;
@@ -1679,12 +1700,12 @@ namespace cryptonote
         // If we're getting lower coinbase tx,
         // stop including more tx
         uint64_t block_reward;
-        if(!get_block_reward(median_weight, total_weight + meta.weight, already_generated_coins, block_reward, version))
+        if(!get_block_reward(median_weight, total_weight + candidate.weight, already_generated_coins, block_reward, version))
         {
           LOG_PRINT_L2("  would exceed maximum block weight");
           continue;
         }
-        coinbase = block_reward + fee + meta.fee;
+        coinbase = block_reward + fee + candidate.fee;
         if (coinbase < template_accept_threshold(best_coinbase))
         {
           LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
@@ -1702,64 +1723,83 @@ namespace cryptonote
         }
       }
 
-      // "local" and "stem" txes are filtered above
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second, relay_category::all);
-
-      cryptonote::transaction tx;
-
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
       // missing key images
-      const cryptonote::txpool_tx_meta_t original_meta = meta;
-      bool ready = false;
-      try
-      {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
-      }
-      catch (const std::exception &e)
-      {
-        MERROR("Failed to check transaction readiness: " << e.what());
-        // continue, not fatal
-      }
-      if (memcmp(&original_meta, &meta, sizeof(meta)))
-      {
-        try
-	{
-	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
-	}
-        catch (const std::exception &e)
-	{
-	  MERROR("Failed to update tx meta: " << e.what());
-	  // continue, not fatal
-	}
-      }
-      if (!ready)
+      if (!is_template_candidate_ready(sorted_it->second, candidate, top_id))
       {
         LOG_PRINT_L2("  not ready to go");
         continue;
       }
-      if (have_key_images(k_images, tx))
+      if (std::any_of(candidate.key_images.begin(), candidate.key_images.end(), [&k_images](const crypto::key_image &ki) { return k_images.count(ki) != 0; }))
       {
         LOG_PRINT_L2("  key images already seen");
         continue;
       }
 
-      bl.tx_hashes.push_back(sorted_it->second);
-      total_weight += meta.weight;
-      fee += meta.fee;
+      tx_hashes.push_back(sorted_it->second);
+      total_weight += candidate.weight;
+      fee += candidate.fee;
       best_coinbase = coinbase;
-      append_key_images(k_images, tx);
+      k_images.insert(candidate.key_images.begin(), candidate.key_images.end());
       LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
     }
     lock.commit();
 
     expected_reward = best_coinbase;
-    LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
+    LOG_PRINT_L2("Block template filled with " << tx_hashes.size() << " txes, weight "
         << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
         << " (including " << print_money(fee) << " in fees)");
+
+    bl.tx_hashes.insert(bl.tx_hashes.end(), tx_hashes.begin(), tx_hashes.end());
+    m_template_snapshot = std::make_shared<const block_template_snapshot>(block_template_snapshot{
+      pool_cookie, top_id, median_weight, already_generated_coins, version, std::move(tx_hashes), total_weight, fee, expected_reward});
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::is_template_candidate_ready(const crypto::hash &txid, template_candidate &candidate, const crypto::hash &top_id) const
+  {
+    // readiness only depends on the chain, so it holds until the tip moves
+    if (candidate.ready_top_id == top_id)
+      return candidate.ready;
+
+    bool ready = false;
+    try
+    {
+      txpool_tx_meta_t meta;
+      if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+      {
+        MERROR("Failed to find tx meta: " << txid);
+        return false;
+      }
+      const cryptonote::txpool_tx_meta_t original_meta = meta;
+      const cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
+      cryptonote::transaction tx;
+      ready = is_transaction_ready_to_go(meta, txid, txblob, tx);
+      if (memcmp(&original_meta, &meta, sizeof(meta)))
+      {
+        try
+        {
+          m_blockchain.update_txpool_tx(txid, meta);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to update tx meta: " << e.what());
+          // continue, not fatal
+        }
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to check transaction readiness: " << e.what());
+      // not fatal, but check again next time
+      return false;
+    }
+    candidate.ready_top_id = top_id;
+    candidate.ready = ready;
+    return ready;
+  }
+  //---------------------------------------------------------------------------------
   size_t tx_memory_pool::validate(uint8_t version)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -1775,49 +1815,110 @@ namespace cryptonote
 
     LockedTXN lock(m_blockchain.get_db());
 
-    struct tx_entry_t
-    {
-      crypto::hash txid;
-      txpool_tx_meta_t meta;
-    };
-
-    // get all txids
-    std::vector<tx_entry_t> txes;
+    // get all txids in one pass, the blobs are read a batch at a time
+    std::vector<std::pair<crypto::hash, txpool_tx_meta_t>> txes;
     m_blockchain.for_all_txpool_txes([&txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
       if (!meta.pruned) // skip pruned txes
-        txes.push_back({txid, meta});
+        txes.emplace_back(txid, meta);
       return true;
     }, false, relay_category::all);
 
-    // take them all out and add them back in, some might fail
+    struct tx_entry_t
+    {
+      cryptonote::blobdata blob;
+      cryptonote::transaction tx;
+      bool parsed;
+    };
+
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+    std::vector<tx_entry_t> entries;
+    std::vector<const transaction*> parsed_txes;
+    std::vector<crypto::hash> seeded_txids;
     size_t added = 0;
-    for (auto &e: txes)
+    for (size_t batch_start = 0; batch_start < txes.size(); batch_start += VALIDATE_BATCH_SIZE)
     {
-      try
+      const size_t batch_size = std::min(txes.size() - batch_start, VALIDATE_BATCH_SIZE);
+      entries.clear();
+      entries.resize(batch_size);
+      for (size_t i = 0; i < batch_size; ++i)
       {
-        size_t weight;
-        uint64_t fee;
-        cryptonote::transaction tx;
-        cryptonote::blobdata blob;
-        bool relayed, do_not_relay, double_spend_seen, pruned;
-        if (!take_tx(e.txid, tx, blob, weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
-          MERROR("Failed to get tx " << e.txid << " from txpool for re-validation");
-
-        cryptonote::tx_verification_context tvc{};
-        relay_method tx_relay = e.meta.get_relay_method();
-        if (!add_tx(tx, e.txid, blob, e.meta.weight, tvc, tx_relay, relayed, version))
-        {
-          MINFO("Failed to re-validate tx " << e.txid << " for v" << (unsigned)version << ", dropped");
+        tx_entry_t &e = entries[i];
+        e.parsed = m_blockchain.get_txpool_tx_blob(txes[batch_start + i].first, e.blob, relay_category::all);
+      }
+
+      // parse them in chunks on the compute threads, rather than one by one in take_tx
+      tools::threadpool::waiter waiter(tpool);
+      const size_t chunk_size = (batch_size + threads - 1) / threads;
+      for (size_t begin = 0; begin < batch_size; begin += chunk_size)
+      {
+        const size_t end = std::min(batch_size, begin + chunk_size);
+        tpool.submit(&waiter, [&entries, &txes, batch_start, begin, end]() {
+          for (size_t i = begin; i < end; ++i)
+          {
+            tx_entry_t &e = entries[i];
+            if (e.parsed)
+              e.parsed = parse_and_validate_tx_from_blob(e.blob, e.tx);
+            if (e.parsed)
+              e.tx.set_hash(txes[batch_start + i].first);
+            cryptonote::blobdata().swap(e.blob);
+          }
+        });
+      }
+      if (!waiter.wait())
+        MERROR("Failed to parse txpool txes for re-validation");
+
+      // verify the ring signatures as a batch, so add_tx finds them in the RCT verification
+      // cache, and take_tx finds the parsed txes rather than parsing them again
+      parsed_txes.clear();
+      seeded_txids.clear();
+      for (size_t i = 0; i < batch_size; ++i)
+      {
+        tx_entry_t &e = entries[i];
+        if (!e.parsed)
           continue;
-        }
-        m_blockchain.update_txpool_tx(e.txid, e.meta);
-        ++added;
+        const crypto::hash &txid = txes[batch_start + i].first;
+        const auto ins = m_parsed_tx_cache.emplace(txid, std::move(e.tx));
+        parsed_txes.push_back(&ins.first->second);
+        if (ins.second)
+          seeded_txids.push_back(txid);
       }
-      catch (const std::exception &e)
+      m_blockchain.prepare_rct_ver_cache(parsed_txes);
+      parsed_txes.clear();
+
+      // take them all out and add them back in, some might fail
+      for (size_t i = batch_start; i < batch_start + batch_size; ++i)
       {
-        MERROR("Failed to re-validate tx from pool");
-        continue;
+        const crypto::hash &txid = txes[i].first;
+        txpool_tx_meta_t &meta = txes[i].second;
+        try
+        {
+          size_t weight;
+          uint64_t fee;
+          cryptonote::transaction tx;
+          cryptonote::blobdata blob;
+          bool relayed, do_not_relay, double_spend_seen, pruned;
+          if (!take_tx(txid, tx, blob, weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
+            MERROR("Failed to get tx " << txid << " from txpool for re-validation");
+
+          cryptonote::tx_verification_context tvc{};
+          relay_method tx_relay = meta.get_relay_method();
+          if (!add_tx(tx, txid, blob, meta.weight, tvc, tx_relay, relayed, version))
+          {
+            MINFO("Failed to re-validate tx " << txid << " for v" << (unsigned)version << ", dropped");
+            continue;
+          }
+          m_blockchain.update_txpool_tx(txid, meta);
+          ++added;
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to re-validate tx from pool");
+          continue;
+        }
       }
+      for (const crypto::hash &txid: seeded_txids)
+        m_parsed_tx_cache.erase(txid);
     }
 
     lock.commit();
@@ -1855,7 +1956,8 @@ namespace cryptonote
         m_txs_by_fee_and_receive_time.erase(sorted_it);
       }
     }
-    m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(fee, receive_time), txid);
+    const auto sorted_it = m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(fee, receive_time), txid).first;
+    m_template_candidates[txid].sorted_it = sorted_it;
 
     // Don't check for "resurrected" txs in case of reorgs i.e. don't check in 'm_removed_txs_by_time'
     // whether we have that txid there and if yes remove it; this results in possible duplicates
@@ -1867,6 +1969,52 @@ namespace cryptonote
     }
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::update_template_candidate(const crypto::hash& txid, const txpool_tx_meta_t& meta, const transaction_prefix& tx)
+  {
+    const auto it = m_template_candidates.find(txid);
+    if (it == m_template_candidates.end())
+    {
+      MERROR("Transaction " << txid << " not found in the sorted txs container");
+      return;
+    }
+    template_candidate &candidate = it->second;
+    remove_from_fee_histograms(candidate);
+    candidate.weight = meta.weight;
+    candidate.fee = meta.fee;
+    candidate.tx_relay = meta.get_relay_method();
+    candidate.pruned = meta.pruned;
+    candidate.key_images.clear();
+    candidate.key_images.reserve(tx.vin.size());
+    for (const auto &in: tx.vin)
+    {
+      if (in.type() == typeid(txin_to_key))
+        candidate.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+    }
+    candidate.ready_top_id = crypto::null_hash;
+    candidate.ready = false;
+    add_to_fee_histograms(candidate);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::add_to_fee_histograms(template_candidate &candidate)
+  {
+    if (candidate.in_fee_histograms)
+      return;
+    m_fee_histogram.add(candidate.fee, candidate.weight);
+    if (matches_category(candidate.tx_relay, relay_category::broadcasted))
+      m_broadcasted_fee_histogram.add(candidate.fee, candidate.weight);
+    candidate.in_fee_histograms = true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_from_fee_histograms(template_candidate &candidate)
+  {
+    if (!candidate.in_fee_histograms)
+      return;
+    m_fee_histogram.remove(candidate.fee, candidate.weight);
+    if (matches_category(candidate.tx_relay, relay_category::broadcasted))
+      m_broadcasted_fee_histogram.remove(candidate.fee, candidate.weight);
+    candidate.in_fee_histograms = false;
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::remove_tx_from_transient_lists(const cryptonote::sorted_tx_container::iterator& sorted_it, const crypto::hash& txid, bool sensitive)
   {
     if (sorted_it == m_txs_by_fee_and_receive_time.end())
@@ -1877,6 +2025,12 @@ namespace cryptonote
     {
       m_txs_by_fee_and_receive_time.erase(sorted_it);
     }
+    const auto candidate_it = m_template_candidates.find(txid);
+    if (candidate_it != m_template_candidates.end())
+    {
+      remove_from_fee_histograms(candidate_it->second);
+      m_template_candidates.erase(candidate_it);
+    }
 
     const std::unordered_map<crypto::hash, time_t>::iterator it = m_added_txs_by_id.find(txid);
     if (it != m_added_txs_by_id.end())
@@ -1935,6 +2089,11 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
+    m_template_candidates.clear();
+    m_fee_histogram.clear();
+    m_broadcasted_fee_histogram.clear();
+    m_template_snapshot.reset();
+    std::atomic_store(&m_backlog_snapshot, std::shared_ptr<const backlog_snapshot>());
     m_added_txs_by_id.clear();
     m_added_txs_start_time = (time_t)0;
     m_removed_txs_by_time.clear();
@@ -1964,6 +2123,7 @@ namespace cryptonote
           return false;
         }
         add_tx_to_transient_lists(txid, meta.fee / (double)meta.weight, meta.receive_time);
+        update_template_candidate(txid, meta, tx);
         m_txpool_weight += meta.weight;
         return true;
       }, true, relay_category::all);
@@ -32,6 +32,7 @@
 #include "include_base_utils.h"
 
 #include <atomic>
+#include <memory>
 #include <set>
 #include <tuple>
 #include <unordered_map>
@@ -47,6 +48,8 @@
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/verification_context.h"
 #include "cryptonote_protocol/enums.h"
+#include "cryptonote_core/fee_histogram.h"
+#include "cryptonote_core/spent_key_images.h"
 #include "blockchain_db/blockchain_db.h"
 #include "crypto/hash.h"
 #include "rpc/core_rpc_server_commands_defs.h"
@@ -235,6 +238,9 @@ namespace cryptonote
      * @param expected_reward return-by-reference the total reward awarded to the miner finding this block, including transaction fees
      * @param version hard fork version to use for consensus rules
      *
+     * The selection is kept as a snapshot and handed out again as long as
+     * the pool cookie, the chain tip and the reward parameters match.
+     *
      * @return true
      */
     bool fill_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward, uint8_t version);
@@ -276,9 +282,27 @@ namespace cryptonote
      * @param backlog return-by-reference that data
      * @param include_sensitive return stempool, anonymity-pool, and unrelayed txes
      *
+     * The result is published as a snapshot, which is served without taking
+     * the pool lock until the pool cookie or the chain tip changes.
      */
     void get_block_template_backlog(std::vector<tx_block_template_backlog_entry>& backlog, bool include_sensitive = false) const;
 
+    /**
+     * @brief get the pool binned by fee per byte
+     *
+     * @param include_sensitive include stempool, anonymity-pool, and unrelayed txes
+     *
+     * @return a copy of the histogram, whose size does not depend on the pool's
+     */
+    fee_histogram get_fee_histogram(bool include_sensitive = false) const;
+
+    /**
+     * @brief lowest fee per byte for a public tx to have at most `weight` of the pool ahead of it
+     *
+     * @return the fee per byte, or 0 if the public pool is not that heavy
+     */
+    uint64_t get_fee_per_byte_for_weight_ahead(uint64_t weight) const;
+
     /**
      * @brief get a summary statistics of all transaction hashes in the pool
      *
@@ -324,6 +348,34 @@ namespace cryptonote
      */
     bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const;
 
+    /**
+     * @brief check if a transaction in the pool has a given spent key image
+     *
+     * @param key_im the spent key image to look for
+     * @param txid hash of the new transaction where `key_im` was seen.
+     *
+     * @return true if the spent key image is present, otherwise false
+     */
+    bool have_tx_keyimg_as_spent(const crypto::key_image& key_im, const crypto::hash& txid) const;
+
+    /**
+     * @brief check if any spent key image in a transaction is in the pool
+     *
+     * Checks if any of the spent key images in a given transaction are present
+     * in any of the transactions in the transaction pool.
+     *
+     * Does not take the pool lock, only the stripes of the key images looked at, so
+     * incoming transactions can be checked for conflicts concurrently.
+     *
+     * @note see tx_pool::have_tx_keyimg_as_spent
+     *
+     * @param tx the transaction to check spent key images of
+     * @param txid hash of `tx`.
+     *
+     * @return true if any spent key images are present in the pool, otherwise false
+     */
+    bool have_tx_keyimges_as_spent(const transaction& tx, const crypto::hash& txid) const;
+
     /**
      * @brief get a specific transaction from the pool
      *
@@ -386,6 +438,11 @@ namespace cryptonote
      * invalid may change.  This function clears those which were received
      * before a version change and no longer conform to requirements.
      *
+     * The txes are processed in bounded batches: each batch is read and
+     * parsed on the compute threads, its ring signatures verified together,
+     * then its txes re-added one by one. The pool lock is held throughout,
+     * and the changes committed in one db txn.
+     *
      * @param version the version the transactions must conform to
      *
      * @return the number of transactions removed
@@ -507,31 +564,6 @@ namespace cryptonote
      */
     bool remove_stuck_transactions();
 
-    /**
-     * @brief check if a transaction in the pool has a given spent key image
-     *
-     * @param key_im the spent key image to look for
-     * @param txid hash of the new transaction where `key_im` was seen.
-     *
-     * @return true if the spent key image is present, otherwise false
-     */
-    bool have_tx_keyimg_as_spent(const crypto::key_image& key_im, const crypto::hash& txid) const;
-
-    /**
-     * @brief check if any spent key image in a transaction is in the pool
-     *
-     * Checks if any of the spent key images in a given transaction are present
-     * in any of the transactions in the transaction pool.
-     *
-     * @note see tx_pool::have_tx_keyimg_as_spent
-     *
-     * @param tx the transaction to check spent key images of
-     * @param txid hash of `tx`.
-     *
-     * @return true if any spent key images are present in the pool, otherwise false
-     */
-    bool have_tx_keyimges_as_spent(const transaction& tx, const crypto::hash& txid) const;
-
     /**
      * @brief forget a transaction's spent key images
      *
@@ -545,6 +577,7 @@ namespace cryptonote
      * @return false if any key images to be removed cannot be found, otherwise true
      */
     bool remove_transaction_keyimages(const transaction_prefix& tx, const crypto::hash &txid);
+    bool remove_transaction_keyimages(const std::vector<crypto::key_image>& key_images, const crypto::hash &txid);
 
     /**
      * @brief check if any of a transaction's spent key images are present in a given set
@@ -592,9 +625,18 @@ namespace cryptonote
     void prune(size_t bytes = 0);
 
     void add_tx_to_transient_lists(const crypto::hash& txid, double fee, time_t receive_time);
+    void update_template_candidate(const crypto::hash& txid, const txpool_tx_meta_t& meta, const transaction_prefix& tx);
     void remove_tx_from_transient_lists(const cryptonote::sorted_tx_container::iterator& sorted_it, const crypto::hash& txid, bool sensitive);
     void track_removed_tx(const crypto::hash& txid, bool sensitive);
 
+#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
+public:
+#endif
+    mutable epee::critical_section m_transactions_lock;  //!< lock for the pool
+#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
+private:
+#endif
+
     //TODO: confirm the below comments and investigate whether or not this
     //      is the desired behavior
     //! map key images to transactions which spent them
@@ -604,18 +646,7 @@ namespace cryptonote
      *  transaction on the assumption that the original will not be in a
      *  block again.
      */
-    typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash>> key_images_container;
-
-#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
-public:
-#endif
-    mutable epee::critical_section m_transactions_lock;  //!< lock for the pool
-#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
-private:
-#endif
-
-    //! container for spent key images from the transactions in the pool
-    key_images_container m_spent_key_images;  
+    spent_key_images m_spent_key_images;
 
     //TODO: this time should be a named constant somewhere, not hard-coded
     //! interval on which to check for stale/"stuck" transactions
@@ -627,6 +658,66 @@ private:
 
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
+    /**
+     * @brief what filling a block template needs to know about a pool tx
+     *
+     * Kept in step with m_txs_by_fee_and_receive_time, so that choosing
+     * transactions does not read the tx meta or parse the blob from the db
+     * unless the chain tip moved since the tx was last checked.
+     */
+    struct template_candidate
+    {
+      sorted_tx_container::iterator sorted_it;
+      size_t weight;
+      uint64_t fee;
+      relay_method tx_relay;
+      bool pruned;
+      std::vector<crypto::key_image> key_images;
+      crypto::hash ready_top_id; //!< the chain tip `ready` was checked against
+      bool ready;
+      bool in_fee_histograms;
+    };
+
+    //! template candidates by txid, also used to find txes in the sorted container
+    mutable std::unordered_map<crypto::hash, template_candidate> m_template_candidates;
+
+    fee_histogram m_fee_histogram; //!< every tx in the pool
+    fee_histogram m_broadcasted_fee_histogram; //!< txes matching relay_category::broadcasted
+
+    void add_to_fee_histograms(template_candidate &candidate);
+    void remove_from_fee_histograms(template_candidate &candidate);
+
+    /**
+     * @brief check (or recall) whether a candidate can go in a block on top of top_id
+     */
+    bool is_template_candidate_ready(const crypto::hash &txid, template_candidate &candidate, const crypto::hash &top_id) const;
+
+    //! transactions chosen by the last fill_block_template, and what they were chosen for
+    struct block_template_snapshot
+    {
+      uint64_t pool_cookie;
+      crypto::hash top_id;
+      size_t median_weight;
+      uint64_t already_generated_coins;
+      uint8_t version;
+      std::vector<crypto::hash> tx_hashes;
+      size_t total_weight;
+      uint64_t fee;
+      uint64_t expected_reward;
+    };
+    std::shared_ptr<const block_template_snapshot> m_template_snapshot;
+
+    //! result of the last get_block_template_backlog, swapped with std::atomic_store
+    struct backlog_snapshot
+    {
+      uint64_t pool_cookie;
+      crypto::hash top_id;
+      uint64_t median_weight;
+      bool include_sensitive;
+      std::vector<tx_block_template_backlog_entry> backlog;
+    };
+    mutable std::shared_ptr<const backlog_snapshot> m_backlog_snapshot;
+
     // Info when transactions entered the pool, accessible by txid
     std::unordered_map<crypto::hash, time_t> m_added_txs_by_id;
 
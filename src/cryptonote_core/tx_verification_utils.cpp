@@ -26,9 +26,14 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <boost/filesystem.hpp>
+
+#include "common/threadpool.h"
 #include "cryptonote_core/blockchain.h"
 #include "cryptonote_core/tx_verification_utils.h"
 #include "ringct/rctSigs.h"
+#include "file_io_utils.h"
+#include "int-util.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "blockchain"
@@ -38,7 +43,7 @@
 using namespace cryptonote;
 
 // Do RCT expansion, then do post-expansion sanity checks, then do full non-semantics verification.
-static bool expand_tx_and_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mix_ring)
+static bool expand_tx_and_check_mix_ring(transaction& tx, const rct::ctkeyM& mix_ring)
 {
     // Pruned transactions can not be expanded and verified because they are missing RCT data
     VER_ASSERT(!tx.pruned, "Pruned transaction will not pass verRctNonSemanticsSimple");
@@ -79,11 +84,126 @@ static bool expand_tx_and_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mi
     }
 
     // Mix ring data is now known to be correctly incorporated into the RCT sig inside tx.
-    return rct::verRctNonSemanticsSimple(rv);
+    return true;
+}
+
+static bool expand_tx_and_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mix_ring)
+{
+    if (!expand_tx_and_check_mix_ring(tx, mix_ring))
+    {
+        return false;
+    }
+
+    return rct::verRctNonSemanticsSimple(tx.rct_signatures);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace cryptonote
+{
+
+static const char RCT_VER_CACHE_MAGIC[8] = {'R', 'C', 'T', 'V', 'E', 'R', 'C', 'A'};
+static constexpr const uint32_t RCT_VER_CACHE_VERSION = 1;
+
+// File layout: magic, version, count, count hashes, then cn_fast_hash of everything before it
+#pragma pack(push, 1)
+struct rct_ver_cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+};
+#pragma pack(pop)
+
+rct_ver_cache_t::rct_ver_cache_t(size_t max_size):
+    ::tools::striped_data_cache<::crypto::hash>(max_size)
+{
+}
+
+bool rct_ver_cache_t::load(const std::string& filename)
+{
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(filename, ec))
+        return true;
+
+    std::string data;
+    if (!epee::file_io_utils::load_file_to_string(filename, data))
+    {
+        MERROR("Failed to read RCT verification cache from " << filename);
+        return false;
+    }
+    rct_ver_cache_header header;
+    if (data.size() < sizeof(header) + sizeof(crypto::hash))
+    {
+        MERROR("RCT verification cache " << filename << " is truncated");
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    header.version = SWAP32LE(header.version);
+    header.count = SWAP32LE(header.count);
+    if (memcmp(header.magic, RCT_VER_CACHE_MAGIC, sizeof(header.magic)) || header.version != RCT_VER_CACHE_VERSION
+        || data.size() != sizeof(header) + (header.count + 1) * (uint64_t)sizeof(crypto::hash))
+    {
+        MERROR("RCT verification cache " << filename << " has an unknown format");
+        return false;
+    }
+    const size_t checksum_offset = data.size() - sizeof(crypto::hash);
+    crypto::hash checksum;
+    crypto::cn_fast_hash(data.data(), checksum_offset, checksum);
+    if (memcmp(&checksum, data.data() + checksum_offset, sizeof(checksum)))
+    {
+        MERROR("RCT verification cache " << filename << " is corrupt");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.count; ++i)
+    {
+        crypto::hash h;
+        memcpy(&h, data.data() + sizeof(header) + i * sizeof(crypto::hash), sizeof(h));
+        add(h);
+    }
+    MINFO("Loaded " << header.count << " RCT verification cache entries from " << filename);
+    return true;
 }
 
-// Create a unique identifier for pair of tx blob + mix ring
-static crypto::hash calc_tx_mixring_hash(const transaction& tx, const rct::ctkeyM& mix_ring)
+bool rct_ver_cache_t::store(const std::string& filename) const
+{
+    std::vector<crypto::hash> hashes;
+    get_all(hashes);
+
+    rct_ver_cache_header header;
+    memcpy(header.magic, RCT_VER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SWAP32LE(RCT_VER_CACHE_VERSION);
+    header.count = SWAP32LE((uint32_t)hashes.size());
+    std::string data;
+    data.reserve(sizeof(header) + (hashes.size() + 1) * sizeof(crypto::hash));
+    data.append((const char*)&header, sizeof(header));
+    data.append((const char*)hashes.data(), hashes.size() * sizeof(crypto::hash));
+    crypto::hash checksum;
+    crypto::cn_fast_hash(data.data(), data.size(), checksum);
+    data.append((const char*)&checksum, sizeof(checksum));
+
+    // write to a temporary file first, so a crash never leaves a half written cache behind
+    boost::system::error_code ec;
+    const std::string tmp_filename = boost::filesystem::unique_path(filename + ".%%%%-%%%%.tmp", ec).string();
+    if (ec || !epee::file_io_utils::save_string_to_file(tmp_filename, data))
+    {
+        MERROR("Failed to write RCT verification cache to " << tmp_filename);
+        return false;
+    }
+    boost::filesystem::rename(tmp_filename, filename, ec);
+    if (ec)
+    {
+        MERROR("Failed to rename " << tmp_filename << " to " << filename << ": " << ec.message());
+        boost::filesystem::remove(tmp_filename, ec);
+        return false;
+    }
+    MINFO("Saved " << hashes.size() << " RCT verification cache entries to " << filename);
+    return true;
+}
+
+crypto::hash calc_tx_mixring_hash(const transaction& tx, const rct::ctkeyM& mix_ring)
 {
     std::stringstream ss;
 
@@ -105,11 +225,6 @@ static crypto::hash calc_tx_mixring_hash(const transaction& tx, const rct::ctkey
     return tx_and_mixring_hash;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-
-namespace cryptonote
-{
-
 bool ver_rct_non_semantics_simple_cached
 (
     transaction& tx,
@@ -164,4 +279,139 @@ bool ver_rct_non_semantics_simple_cached
     return true;
 }
 
+bool ver_rct_non_semantics_simple_batch
+(
+    std::vector<transaction>& txs,
+    const std::vector<rct::ctkeyM>& mix_rings,
+    std::vector<crypto::hash>& verified
+)
+{
+    verified.clear();
+    VER_ASSERT(txs.size() == mix_rings.size(), "Mismatched sizes of txs and mix rings");
+
+    // Expand everything first, then verify all ring signatures in one go
+    std::vector<const rct::rctSig*> rvv;
+    std::vector<size_t> tx_indices;
+    rvv.reserve(txs.size());
+    tx_indices.reserve(txs.size());
+    bool all_valid = true;
+    for (size_t n = 0; n < txs.size(); ++n)
+    {
+        // Same restriction as ver_rct_non_semantics_simple_cached, since the results are keyed the same way
+        const bool untested_tx = txs[n].version > 2 || txs[n].rct_signatures.type > rct::RCTTypeBulletproofPlus;
+        if (untested_tx || !expand_tx_and_check_mix_ring(txs[n], mix_rings[n]))
+        {
+            all_valid = false;
+            continue;
+        }
+        rvv.push_back(&txs[n].rct_signatures);
+        tx_indices.push_back(n);
+    }
+
+    std::deque<bool> results;
+    all_valid &= rct::verRctNonSemanticsSimple(rvv, results);
+    VER_ASSERT(results.size() == rvv.size(), "Unexpected number of verification results");
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const size_t n = tx_indices[i];
+        if (results[i])
+            verified.push_back(calc_tx_mixring_hash(txs[n], mix_rings[n]));
+        else
+            MDEBUG("RCT batch: tx " << get_transaction_hash(txs[n]) << " failed");
+    }
+
+    return all_valid;
+}
+
+bool is_canonical_bulletproof_layout(const std::vector<rct::Bulletproof>& proofs)
+{
+    if (proofs.size() != 1)
+        return false;
+    const size_t sz = proofs[0].V.size();
+    if (sz == 0 || sz > BULLETPROOF_MAX_OUTPUTS)
+        return false;
+    return true;
+}
+
+bool is_canonical_bulletproof_plus_layout(const std::vector<rct::BulletproofPlus>& proofs)
+{
+    if (proofs.size() != 1)
+        return false;
+    const size_t sz = proofs[0].V.size();
+    if (sz == 0 || sz > BULLETPROOF_PLUS_MAX_OUTPUTS)
+        return false;
+    return true;
+}
+
+size_t ver_rct_semantics_blocks
+(
+    const std::vector<block_complete_entry>& blocks_entry,
+    const std::unordered_set<crypto::hash>& already_verified,
+    std::unordered_set<crypto::hash>& verified
+)
+{
+    // pruned txes have no range proofs to verify
+    std::vector<const blobdata*> blobs;
+    for (const block_complete_entry& entry: blocks_entry)
+        for (const tx_blob_entry& tx_blob: entry.txs)
+            if (tx_blob.prunable_hash == crypto::null_hash)
+                blobs.push_back(&tx_blob.blob);
+    if (blobs.empty())
+        return 0;
+
+    std::vector<transaction> txs(blobs.size());
+    std::vector<crypto::hash> tx_hashes(blobs.size());
+    std::deque<bool> parsed(blobs.size());
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t i = 0; i < blobs.size(); ++i)
+        tpool.submit(&waiter, [&, i] { parsed[i] = parse_and_validate_tx_from_blob(*blobs[i], txs[i], tx_hashes[i]); });
+    if (!waiter.wait())
+        return 0;
+
+    // only the range proof carrying types are worth batching, failures to parse
+    // or non canonical layouts are left to handle_incoming_txs to report
+    size_t reused = 0;
+    std::vector<const rct::rctSig*> rvv;
+    std::vector<size_t> rvv_tx_index;
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+        if (!parsed[i] || txs[i].version < 2)
+            continue;
+        if (already_verified.find(tx_hashes[i]) != already_verified.end())
+        {
+            verified.insert(tx_hashes[i]);
+            ++reused;
+            continue;
+        }
+        const rct::rctSig& rv = txs[i].rct_signatures;
+        switch (rv.type)
+        {
+            case rct::RCTTypeBulletproof:
+            case rct::RCTTypeBulletproof2:
+            case rct::RCTTypeCLSAG:
+                if (!is_canonical_bulletproof_layout(rv.p.bulletproofs))
+                    continue;
+                break;
+            case rct::RCTTypeBulletproofPlus:
+                if (!is_canonical_bulletproof_plus_layout(rv.p.bulletproofs_plus))
+                    continue;
+                break;
+            default:
+                continue;
+        }
+        rvv.push_back(&rv);
+        rvv_tx_index.push_back(i);
+    }
+
+    std::deque<bool> results;
+    if (!rct::verRctSemanticsSimple(rvv, results))
+        MDEBUG("Some txes in incoming blocks failed RCT semantics checks, they will be checked one block at a time");
+    for (size_t i = 0; i < rvv.size(); ++i)
+        if (results[i])
+            verified.insert(tx_hashes[rvv_tx_index[i]]);
+    return reused;
+}
+
 } // namespace cryptonote
@@ -28,16 +28,47 @@
 
 #pragma once
 
+#include <unordered_set>
+
 #include "common/data_cache.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
 
 namespace cryptonote
 {
 
 // Modifying this value should not affect consensus. You can adjust it for performance needs
+// (see --rct-ver-cache-size)
 static constexpr const size_t RCT_VER_CACHE_SIZE = 8192;
 
-using rct_ver_cache_t = ::tools::data_cache<::crypto::hash, RCT_VER_CACHE_SIZE>;
+/**
+ * @brief Set of tx+mixring hashes (see calc_tx_mixring_hash) whose RCT signatures verified
+ *
+ * The capacity is set at runtime and the contents can be saved to a file at shutdown and loaded
+ * back on startup, so that transactions verified while in the pool do not need verifying again
+ * when they are mined after a restart.
+ */
+class rct_ver_cache_t: public ::tools::striped_data_cache<::crypto::hash>
+{
+public:
+    explicit rct_ver_cache_t(size_t max_size = RCT_VER_CACHE_SIZE);
+
+    /**
+     * @brief adds the hashes stored in filename by store(), if it exists
+     *
+     * The file is trusted like the rest of the data directory: its hashes skip verification.
+     *
+     * @return false if the file exists but could not be read or is corrupt, true otherwise
+     */
+    bool load(const std::string& filename);
+
+    /**
+     * @brief atomically replaces filename with the current contents of the cache
+     *
+     * @return false on I/O error
+     */
+    bool store(const std::string& filename) const;
+};
 
 /**
  * @brief Cached version of rct::verRctNonSemanticsSimple
@@ -75,4 +106,67 @@ bool ver_rct_non_semantics_simple_cached
     std::uint8_t rct_type_to_cache
 );
 
+/**
+ * @brief Hash of a transaction and the mixring it references, as used to key RCT verification caches
+ *
+ * @param tx transaction, see ver_rct_non_semantics_simple_cached about stale hashes
+ * @param mix_ring mixring referenced by this tx
+ * @return hash unique to this tx+mixring pair
+ */
+crypto::hash calc_tx_mixring_hash(const transaction& tx, const rct::ctkeyM& mix_ring);
+
+/**
+ * @brief Batched, uncached version of rct::verRctNonSemanticsSimple for many transactions
+ *
+ * Every transaction is expanded like in ver_rct_non_semantics_simple_cached, then the ring
+ * signatures of all of them are verified together on the compute threadpool. This keeps all
+ * threads busy when there are many transactions with only one or two inputs each.
+ *
+ * Failures are not attributed to an input: a transaction which fails here should be verified
+ * again on its own (e.g. with ver_rct_non_semantics_simple_cached) to find the bad input.
+ *
+ * @param txs transactions which contain RCT signatures to verify, expanded in place
+ * @param mix_rings mixrings referenced by each tx, same order. THIS DATA MUST BE PREVIOUSLY VALIDATED
+ * @param verified return-by-reference calc_tx_mixring_hash() of each tx which verified
+ * @return true when all transactions verified, false otherwise
+ */
+bool ver_rct_non_semantics_simple_batch
+(
+    std::vector<transaction>& txs,
+    const std::vector<rct::ctkeyM>& mix_rings,
+    std::vector<crypto::hash>& verified
+);
+
+/**
+ * @brief Whether bulletproofs are laid out as one proof over 1 to BULLETPROOF_MAX_OUTPUTS outputs
+ */
+bool is_canonical_bulletproof_layout(const std::vector<rct::Bulletproof>& proofs);
+
+/**
+ * @brief Whether bulletproofs+ are laid out as one proof over 1 to BULLETPROOF_PLUS_MAX_OUTPUTS outputs
+ */
+bool is_canonical_bulletproof_plus_layout(const std::vector<rct::BulletproofPlus>& proofs);
+
+/**
+ * @brief Batch-verifies the RCT semantics of the unpruned transactions in a span of blocks
+ *
+ * Transactions whose hash is in already_verified are not verified again. The hash commits to the
+ * whole transaction, proofs included, so results kept from an earlier pass over a span can only
+ * ever be reused for the very same transactions, even if the span was replaced since.
+ *
+ * Transactions which fail to parse, have a non canonical proof layout or fail verification are
+ * left out, so that they get verified (and reported) one at a time.
+ *
+ * @param blocks_entry blocks as received, with their transaction blobs
+ * @param already_verified hashes of transactions whose RCT semantics verified before
+ * @param verified return-by-reference hashes of the transactions whose RCT semantics verified
+ * @return the number of transactions taken from already_verified
+ */
+size_t ver_rct_semantics_blocks
+(
+    const std::vector<block_complete_entry>& blocks_entry,
+    const std::unordered_set<crypto::hash>& already_verified,
+    std::unordered_set<crypto::hash>& verified
+);
+
 } // namespace cryptonote
@@ -1651,6 +1651,11 @@ namespace cryptonote
 
           MDEBUG(context << "Block process time (" << blocks.size() << " blocks, " << num_txs << " txs): " << block_process_time_full + transactions_process_time_full << " (" << transactions_process_time_full << "/" << block_process_time_full << ") ms");
 
+          // the input checks of this span are done, start on the next one while this one is committed
+          std::vector<cryptonote::block_complete_entry> next_blocks;
+          if (!pblocks.empty() && m_block_queue.get_filled_span(start_height + blocks.size(), next_blocks))
+            m_core.pipeline_next_span(start_height + blocks.size(), std::move(next_blocks));
+
           if (!m_core.cleanup_handle_incoming_blocks())
           {
             LOG_PRINT_CCONTEXT_L0("Failure in cleanup_handle_incoming_blocks");
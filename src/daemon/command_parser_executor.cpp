@@ -982,9 +982,10 @@ bool t_command_parser_executor::prune_blockchain(const std::vector<std::string>&
     std::cout << "Warning: pruning from within peoplecoind will not shrink the database file size." << std::endl;
     std::cout << "Instead, parts of the file will be marked as free, so the file will not grow" << std::endl;
     std::cout << "until that newly free space is used up. If you want a smaller file size now," << std::endl;
-    std::cout << "exit peoplecoind and run peoplecoin-blockchain-prune (you will temporarily need more" << std::endl;
-    std::cout << "disk space for the database conversion though). If you are OK with the database" << std::endl;
-    std::cout << "file keeping the same size, re-run this command with the \"confirm\" parameter." << std::endl;
+    std::cout << "run compact_blockchain once pruning is done, or exit peoplecoind and run" << std::endl;
+    std::cout << "peoplecoin-blockchain-prune (either way you will temporarily need more disk space" << std::endl;
+    std::cout << "for a copy of the database). If you are OK with the database file keeping the" << std::endl;
+    std::cout << "same size, re-run this command with the \"confirm\" parameter." << std::endl;
     return true;
   }
 
@@ -996,6 +997,17 @@ bool t_command_parser_executor::check_blockchain_pruning(const std::vector<std::
   return m_executor.check_blockchain_pruning();
 }
 
+bool t_command_parser_executor::compact_blockchain(const std::vector<std::string>& args)
+{
+  if (!args.empty())
+  {
+    std::cout << "Invalid syntax: No parameters expected. For more details, use the help command." << std::endl;
+    return true;
+  }
+
+  return m_executor.compact_blockchain();
+}
+
 bool t_command_parser_executor::set_bootstrap_daemon(const std::vector<std::string>& args)
 {
   struct parsed_t
@@ -316,13 +316,18 @@ t_command_server::t_command_server(
       "prune_blockchain"
     , std::bind(&t_command_parser_executor::prune_blockchain, &m_parser, p::_1)
     , "prune_blockchain [confirm]"
-    , "Prune the blockchain."
+    , "Prune the blockchain. Pruning carries on in the background, and resumes after a restart."
     );
     m_command_lookup.set_handler(
       "check_blockchain_pruning"
     , std::bind(&t_command_parser_executor::check_blockchain_pruning, &m_parser, p::_1)
     , "Check the blockchain pruning."
     );
+    m_command_lookup.set_handler(
+      "compact_blockchain"
+    , std::bind(&t_command_parser_executor::compact_blockchain, &m_parser, p::_1)
+    , "Rewrite the database into a compacted copy in the background and swap it in, returning free pages to the filesystem."
+    );
     m_command_lookup.set_handler(
       "set_bootstrap_daemon"
     , std::bind(&t_command_parser_executor::set_bootstrap_daemon, &m_parser, p::_1)
@@ -2363,7 +2363,34 @@ bool t_rpc_command_executor::prune_blockchain()
         }
     }
 
-    tools::success_msg_writer() << "Blockchain pruned";
+    tools::success_msg_writer() << "Blockchain pruning started, the rest is done in the background";
+    return true;
+}
+
+bool t_rpc_command_executor::compact_blockchain()
+{
+    cryptonote::COMMAND_RPC_COMPACT_BLOCKCHAIN::request req;
+    cryptonote::COMMAND_RPC_COMPACT_BLOCKCHAIN::response res;
+    std::string fail_message = "Unsuccessful";
+    epee::json_rpc::error error_resp;
+
+    if (m_is_rpc)
+    {
+        if (!m_rpc_client->json_rpc_request(req, res, "compact_blockchain", fail_message.c_str()))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (!m_rpc_server->on_compact_blockchain(req, res, error_resp) || res.status != CORE_RPC_STATUS_OK)
+        {
+            tools::fail_msg_writer() << make_error(fail_message, res.status);
+            return true;
+        }
+    }
+
+    tools::success_msg_writer() << "Blockchain compaction started, the rest is done in the background";
     return true;
 }
 
@@ -160,6 +160,8 @@ public:
 
   bool check_blockchain_pruning();
 
+  bool compact_blockchain();
+
   bool print_net_stats();
 
   bool version();
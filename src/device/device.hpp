@@ -171,6 +171,12 @@ namespace hw {
         virtual bool  sc_secret_add( crypto::secret_key &r, const crypto::secret_key &a, const crypto::secret_key &b) = 0;
         virtual crypto::secret_key  generate_keys(crypto::public_key &pub, crypto::secret_key &sec, const crypto::secret_key& recovery_key = crypto::secret_key(), bool recover = false) = 0;
         virtual bool  generate_key_derivation(const crypto::public_key &pub, const crypto::secret_key &sec, crypto::key_derivation &derivation) = 0;
+        virtual void  generate_key_derivations(const std::vector<crypto::public_key> &pubs, const crypto::secret_key &sec, std::vector<crypto::key_derivation> &derivations, std::vector<uint8_t> &valid) {
+            derivations.resize(pubs.size());
+            valid.resize(pubs.size());
+            for (size_t i = 0; i < pubs.size(); ++i)
+                valid[i] = generate_key_derivation(pubs[i], sec, derivations[i]);
+        }
         virtual bool  conceal_derivation(crypto::key_derivation &derivation, const crypto::public_key &tx_pub_key, const std::vector<crypto::public_key> &additional_tx_pub_keys, const crypto::key_derivation &main_derivation, const std::vector<crypto::key_derivation> &additional_derivations) = 0;
         virtual bool  derivation_to_scalar(const crypto::key_derivation &derivation, const size_t output_index, crypto::ec_scalar &res) = 0;
         virtual bool  derive_secret_key(const crypto::key_derivation &derivation, const std::size_t output_index, const crypto::secret_key &sec,  crypto::secret_key &derived_sec) = 0;
@@ -178,6 +184,12 @@ namespace hw {
         virtual bool  secret_key_to_public_key(const crypto::secret_key &sec, crypto::public_key &pub) = 0;
         virtual bool  generate_key_image(const crypto::public_key &pub, const crypto::secret_key &sec, crypto::key_image &image) = 0;
         virtual bool  derive_view_tag(const crypto::key_derivation &derivation, const std::size_t output_index, crypto::view_tag &view_tag) = 0;
+        virtual bool  derive_view_tags(const crypto::key_derivation &derivation, const std::size_t first_output_index, const std::size_t count, crypto::view_tag *view_tags) {
+            for (size_t i = 0; i < count; ++i)
+                if (!derive_view_tag(derivation, first_output_index + i, view_tags[i]))
+                    return false;
+            return true;
+        }
 
         // alternative prototypes available in libringct
         rct::key scalarmultKey(const rct::key &P, const rct::key &a)
@@ -240,6 +240,10 @@ namespace hw {
             return crypto::wallet::generate_key_derivation(key1, key2, derivation);
         }
 
+        void device_default::generate_key_derivations(const std::vector<crypto::public_key> &pubs, const crypto::secret_key &sec, std::vector<crypto::key_derivation> &derivations, std::vector<uint8_t> &valid) {
+            crypto::wallet::generate_key_derivations(pubs, sec, derivations, valid);
+        }
+
         bool device_default::derivation_to_scalar(const crypto::key_derivation &derivation, const size_t output_index, crypto::ec_scalar &res){
             crypto::derivation_to_scalar(derivation,output_index, res);
             return true;
@@ -268,6 +272,11 @@ namespace hw {
             return true;
         }
 
+        bool device_default::derive_view_tags(const crypto::key_derivation &derivation, const std::size_t first_output_index, const std::size_t count, crypto::view_tag *view_tags) {
+            crypto::derive_view_tags(derivation, first_output_index, count, view_tags);
+            return true;
+        }
+
         bool device_default::conceal_derivation(crypto::key_derivation &derivation, const crypto::public_key &tx_pub_key, const std::vector<crypto::public_key> &additional_tx_pub_keys, const crypto::key_derivation &main_derivation, const std::vector<crypto::key_derivation> &additional_derivations){
             return true;
         }
@@ -38,6 +38,10 @@
 //      in this code, taking on the roles of `H` and `G`, respectively. Read carefully!
 
 #include <stdlib.h>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include "misc_log_ex.h"
@@ -67,8 +71,9 @@ namespace rct
     static constexpr size_t maxN = 64; // maximum number of bits in range
     static constexpr size_t maxM = BULLETPROOF_PLUS_MAX_OUTPUTS; // maximum number of outputs to aggregate into a single proof
 
-    // Cached public generators
-    static ge_p3 Hi_p3[maxN*maxM], Gi_p3[maxN*maxM];
+    // Cached public generators, either computed at startup or mapped from a generator table
+    static ge_p3 Hi_p3_data[maxN*maxM], Gi_p3_data[maxN*maxM];
+    static const ge_p3 *Hi_p3 = Hi_p3_data, *Gi_p3 = Gi_p3_data;
     static std::shared_ptr<straus_cached_data> straus_HiGi_cache;
     static std::shared_ptr<pippenger_cached_data> pippenger_HiGi_cache;
 
@@ -84,6 +89,30 @@ namespace rct
     static rct::key initial_transcript;
 
     static boost::mutex init_mutex;
+    static bool init_done = false;
+
+    // On-disk generator table: a header, then Hi, Gi, the Straus cache and the Pippenger cache,
+    // stored in native layout and mapped read-only so short-lived processes skip generator setup
+    static constexpr const char GENERATOR_TABLE_MAGIC[8] = {'B', 'P', 'P', 'G', 'E', 'N', 'T', 'B'};
+    static constexpr uint32_t GENERATOR_TABLE_VERSION = 1;
+    static constexpr uint32_t GENERATOR_TABLE_ENDIANNESS = 0x01020304;
+    static constexpr const char GENERATOR_TABLE_ENV[] = "MONERO_BPP_GENERATOR_TABLE";
+
+    struct generator_table_header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t endianness;
+        uint32_t ge_p3_size;
+        uint32_t ge_cached_size;
+        uint64_t generators;
+        uint64_t straus_points;
+        uint64_t straus_bytes;
+        uint64_t pippenger_points;
+        uint64_t pippenger_bytes;
+        crypto::hash checksum; // of everything after the header
+    };
+    static std::unique_ptr<boost::interprocess::mapped_region> generator_table_region;
 
     // Use the generator caches to compute a multiscalar multiplication
     static inline rct::key multiexp(const std::vector<MultiexpData> &data, size_t HiGi_size)
@@ -117,47 +146,245 @@ namespace rct
         return generator_p3;
     }
 
+    // Compute the constants that are not part of the generator table
+    static void init_constants()
+    {
+        // Compute 2**64 - 1 for later use in simplifying verification
+        TWO_SIXTY_FOUR_MINUS_ONE = TWO;
+        for (size_t i = 0; i < 6; i++)
+        {
+            sc_mul(TWO_SIXTY_FOUR_MINUS_ONE.bytes, TWO_SIXTY_FOUR_MINUS_ONE.bytes, TWO_SIXTY_FOUR_MINUS_ONE.bytes);
+        }
+        sc_sub(TWO_SIXTY_FOUR_MINUS_ONE.bytes, TWO_SIXTY_FOUR_MINUS_ONE.bytes, ONE.bytes);
+
+        // Generate the initial Fiat-Shamir transcript hash, which is constant across all proofs
+        const std::string domain_separator(config::HASH_KEY_BULLETPROOF_PLUS_TRANSCRIPT);
+        ge_p3 initial_transcript_p3;
+        rct::hash_to_p3(initial_transcript_p3, rct::hash2rct(crypto::cn_fast_hash(domain_separator.data(), domain_separator.size())));
+        ge_p3_tobytes(initial_transcript.bytes, &initial_transcript_p3);
+    }
+
+    static generator_table_header make_generator_table_header()
+    {
+        generator_table_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, GENERATOR_TABLE_MAGIC, sizeof(header.magic));
+        header.version = GENERATOR_TABLE_VERSION;
+        header.endianness = GENERATOR_TABLE_ENDIANNESS;
+        header.ge_p3_size = sizeof(ge_p3);
+        header.ge_cached_size = sizeof(ge_cached);
+        header.generators = maxN*maxM;
+        header.straus_points = STRAUS_SIZE_LIMIT;
+        header.straus_bytes = straus_get_cache_size(straus_HiGi_cache);
+        header.pippenger_points = maxN*maxM*2;
+        header.pippenger_bytes = pippenger_get_cache_size(pippenger_HiGi_cache);
+        return header;
+    }
+
+    // Map a generator table and check it matches this build; if install is set, use it for the generators
+    static bool load_generator_table(const std::string &filename, bool install)
+    {
+        std::unique_ptr<boost::interprocess::mapped_region> region;
+        try
+        {
+            boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+            region.reset(new boost::interprocess::mapped_region(mapping, boost::interprocess::read_only));
+        }
+        catch (const std::exception &e)
+        {
+            MDEBUG("Failed to map generator table " << filename << ": " << e.what());
+            return false;
+        }
+
+        const size_t size = region->get_size();
+        const uint8_t *base = (const uint8_t*)region->get_address();
+        if (size < sizeof(generator_table_header))
+        {
+            MERROR("Generator table " << filename << " is truncated");
+            return false;
+        }
+        generator_table_header header;
+        memcpy(&header, base, sizeof(header));
+        const uint64_t generators_bytes = maxN*maxM*sizeof(ge_p3);
+        if (memcmp(header.magic, GENERATOR_TABLE_MAGIC, sizeof(header.magic)) || header.version != GENERATOR_TABLE_VERSION
+            || header.endianness != GENERATOR_TABLE_ENDIANNESS || header.ge_p3_size != sizeof(ge_p3) || header.ge_cached_size != sizeof(ge_cached)
+            || header.generators != maxN*maxM || header.straus_points != STRAUS_SIZE_LIMIT || header.pippenger_points != maxN*maxM*2
+            || header.pippenger_bytes != maxN*maxM*2*sizeof(ge_cached) || header.straus_bytes % sizeof(ge_cached))
+        {
+            MERROR("Generator table " << filename << " was not built for this version");
+            return false;
+        }
+        if (size != sizeof(header) + 2*generators_bytes + header.straus_bytes + header.pippenger_bytes)
+        {
+            MERROR("Generator table " << filename << " has an unexpected size");
+            return false;
+        }
+
+        const uint8_t *payload = base + sizeof(header);
+        if (crypto::cn_fast_hash(payload, size - sizeof(header)) != header.checksum)
+        {
+            MERROR("Generator table " << filename << " failed its checksum");
+            return false;
+        }
+
+        const ge_p3 *Hi = (const ge_p3*)payload;
+        const ge_p3 *Gi = (const ge_p3*)(payload + generators_bytes);
+        const ge_cached *straus_data = (const ge_cached*)(payload + 2*generators_bytes);
+        const ge_cached *pippenger_data = (const ge_cached*)(payload + 2*generators_bytes + header.straus_bytes);
+
+        // The checksum only guards against corruption, so check that the table holds our generators
+        for (size_t i = 0; i < maxN*maxM; ++i)
+        {
+            rct::key expected, stored;
+            ge_p3 p3 = get_exponent(rct::H, i * 2);
+            ge_p3_tobytes(expected.bytes, &p3);
+            ge_p3_tobytes(stored.bytes, &Hi[i]);
+            if (!(expected == stored))
+            {
+                MERROR("Generator table " << filename << " does not contain the expected generators");
+                return false;
+            }
+            p3 = get_exponent(rct::H, i * 2 + 1);
+            ge_p3_tobytes(expected.bytes, &p3);
+            ge_p3_tobytes(stored.bytes, &Gi[i]);
+            if (!(expected == stored))
+            {
+                MERROR("Generator table " << filename << " does not contain the expected generators");
+                return false;
+            }
+        }
+
+        std::shared_ptr<straus_cached_data> straus_cache;
+        std::shared_ptr<pippenger_cached_data> pippenger_cache;
+        try
+        {
+            straus_cache = straus_init_cache_view(straus_data, header.straus_points, header.straus_bytes);
+            pippenger_cache = pippenger_init_cache_view(pippenger_data, header.pippenger_points, header.pippenger_bytes);
+        }
+        catch (const std::exception &e)
+        {
+            MERROR("Generator table " << filename << " has bad caches: " << e.what());
+            return false;
+        }
+
+        if (install)
+        {
+            Hi_p3 = Hi;
+            Gi_p3 = Gi;
+            straus_HiGi_cache = std::move(straus_cache);
+            pippenger_HiGi_cache = std::move(pippenger_cache);
+            generator_table_region = std::move(region);
+            MINFO("Using Bulletproofs+ generator table " << filename);
+        }
+        return true;
+    }
+
+    // Write the current generators and caches to a generator table, atomically replacing any existing file
+    static bool write_generator_table(const std::string &filename)
+    {
+        generator_table_header header = make_generator_table_header();
+        std::string payload;
+        payload.reserve(2*maxN*maxM*sizeof(ge_p3) + header.straus_bytes + header.pippenger_bytes);
+        payload.append((const char*)Hi_p3, maxN*maxM*sizeof(ge_p3));
+        payload.append((const char*)Gi_p3, maxN*maxM*sizeof(ge_p3));
+        payload.append((const char*)straus_get_cache_data(straus_HiGi_cache), header.straus_bytes);
+        payload.append((const char*)pippenger_get_cache_data(pippenger_HiGi_cache), header.pippenger_bytes);
+        header.checksum = crypto::cn_fast_hash(payload.data(), payload.size());
+
+        const std::string tmp_filename = boost::filesystem::unique_path(filename + ".%%%%-%%%%.tmp").string();
+        {
+            std::ofstream f(tmp_filename, std::ios::binary | std::ios::trunc);
+            f.write((const char*)&header, sizeof(header));
+            f.write(payload.data(), payload.size());
+            if (!f.good())
+            {
+                MERROR("Failed to write generator table " << tmp_filename);
+                return false;
+            }
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmp_filename, filename, ec);
+        if (ec)
+        {
+            MERROR("Failed to rename " << tmp_filename << " to " << filename << ": " << ec.message());
+            return false;
+        }
+        MINFO("Wrote Bulletproofs+ generator table " << filename);
+        return true;
+    }
+
     // Construct public generators
     static void init_exponents()
     {
         boost::lock_guard<boost::mutex> lock(init_mutex);
 
         // Only needs to be done once
-        static bool init_done = false;
         if (init_done)
             return;
 
+        // If a generator table is configured, map it, or build it for the next process
+        const char *table = getenv(GENERATOR_TABLE_ENV);
+        const bool use_table = table && *table;
+        if (use_table && load_generator_table(table, true))
+        {
+            init_constants();
+            init_done = true;
+            return;
+        }
+
         std::vector<MultiexpData> data;
         data.reserve(maxN*maxM*2);
         for (size_t i = 0; i < maxN*maxM; ++i)
         {
-            Hi_p3[i] = get_exponent(rct::H, i * 2);
-            Gi_p3[i] = get_exponent(rct::H, i * 2 + 1);
+            Hi_p3_data[i] = get_exponent(rct::H, i * 2);
+            Gi_p3_data[i] = get_exponent(rct::H, i * 2 + 1);
 
-            data.push_back({rct::zero(), Gi_p3[i]});
-            data.push_back({rct::zero(), Hi_p3[i]});
+            data.push_back({rct::zero(), Gi_p3_data[i]});
+            data.push_back({rct::zero(), Hi_p3_data[i]});
         }
 
         straus_HiGi_cache = straus_init_cache(data, STRAUS_SIZE_LIMIT);
         pippenger_HiGi_cache = pippenger_init_cache(data, 0, PIPPENGER_SIZE_LIMIT);
 
-        // Compute 2**64 - 1 for later use in simplifying verification
-        TWO_SIXTY_FOUR_MINUS_ONE = TWO;
-        for (size_t i = 0; i < 6; i++)
-        {
-            sc_mul(TWO_SIXTY_FOUR_MINUS_ONE.bytes, TWO_SIXTY_FOUR_MINUS_ONE.bytes, TWO_SIXTY_FOUR_MINUS_ONE.bytes);
-        }
-        sc_sub(TWO_SIXTY_FOUR_MINUS_ONE.bytes, TWO_SIXTY_FOUR_MINUS_ONE.bytes, ONE.bytes);
+        init_constants();
 
-        // Generate the initial Fiat-Shamir transcript hash, which is constant across all proofs
-        const std::string domain_separator(config::HASH_KEY_BULLETPROOF_PLUS_TRANSCRIPT);
-        ge_p3 initial_transcript_p3;
-        rct::hash_to_p3(initial_transcript_p3, rct::hash2rct(crypto::cn_fast_hash(domain_separator.data(), domain_separator.size())));
-        ge_p3_tobytes(initial_transcript.bytes, &initial_transcript_p3);
+        if (use_table)
+            write_generator_table(table);
 
         init_done = true;
     }
 
+    bool bulletproof_plus_write_generator_table(const std::string &filename)
+    {
+        init_exponents();
+        boost::lock_guard<boost::mutex> lock(init_mutex);
+        return write_generator_table(filename);
+    }
+
+    bool bulletproof_plus_check_generator_table(const std::string &filename)
+    {
+        return load_generator_table(filename, false);
+    }
+
+    bool bulletproof_plus_use_generator_table(const std::string &filename)
+    {
+        boost::lock_guard<boost::mutex> lock(init_mutex);
+        if (init_done || !load_generator_table(filename, true))
+            return false;
+        init_constants();
+        init_done = true;
+        return true;
+    }
+
+    // Not in the header: swaps the generators under anything using them, so it is only for
+    // the unit tests, which neither prove nor verify while calling it
+    bool bulletproof_plus_reload_generator_table_for_tests(const std::string &filename)
+    {
+        init_exponents();
+        boost::lock_guard<boost::mutex> lock(init_mutex);
+        return load_generator_table(filename, true);
+    }
+
     // Given two scalar arrays, construct a vector pre-commitment:
     //
     // a = (a_0, ..., a_{n-1})
@@ -44,6 +44,13 @@ bool bulletproof_plus_VERIFY(const BulletproofPlus &proof);
 bool bulletproof_plus_VERIFY(const std::vector<const BulletproofPlus*> &proofs);
 bool bulletproof_plus_VERIFY(const std::vector<BulletproofPlus> &proofs);
 
+// Precomputed generator tables. If MONERO_BPP_GENERATOR_TABLE names a file, the generators
+// are mapped from it at first use, or computed and written there if it is missing or stale.
+bool bulletproof_plus_write_generator_table(const std::string &filename);
+bool bulletproof_plus_check_generator_table(const std::string &filename);
+// Fails if the generators are already set up
+bool bulletproof_plus_use_generator_table(const std::string &filename);
+
 }
 
 #endif
@@ -347,8 +347,9 @@ struct straus_cached_data
 #ifdef RAW_MEMORY_BLOCK
   size_t size;
   ge_cached *multiples;
-  straus_cached_data(): size(0), multiples(NULL) {}
-  ~straus_cached_data() { aligned_free(multiples); }
+  bool owned;
+  straus_cached_data(): size(0), multiples(NULL), owned(true) {}
+  ~straus_cached_data() { if (owned) aligned_free(multiples); }
 #else
   std::vector<std::vector<ge_cached>> multiples;
 #endif
@@ -443,6 +444,30 @@ size_t straus_get_cache_size(const std::shared_ptr<straus_cached_data> &cache)
   return sz;
 }
 
+std::shared_ptr<straus_cached_data> straus_init_cache_view(const ge_cached *multiples, size_t N, size_t bytes)
+{
+#ifdef RAW_MEMORY_BLOCK
+  CHECK_AND_ASSERT_THROW_MES(multiples, "Bad cache base data");
+  CHECK_AND_ASSERT_THROW_MES(bytes == N * sizeof(ge_cached) * ((1<<STRAUS_C)-1), "Bad cache size");
+  std::shared_ptr<straus_cached_data> cache(new straus_cached_data());
+  cache->size = N;
+  cache->multiples = const_cast<ge_cached*>(multiples);
+  cache->owned = false;
+  return cache;
+#else
+  CHECK_AND_ASSERT_THROW_MES(false, "Straus cache views need RAW_MEMORY_BLOCK");
+#endif
+}
+
+const ge_cached *straus_get_cache_data(const std::shared_ptr<straus_cached_data> &cache)
+{
+#ifdef RAW_MEMORY_BLOCK
+  return cache->multiples;
+#else
+  CHECK_AND_ASSERT_THROW_MES(false, "Straus cache views need RAW_MEMORY_BLOCK");
+#endif
+}
+
 rct::key straus(const std::vector<MultiexpData> &data, const std::shared_ptr<straus_cached_data> &cache, size_t STEP)
 {
   CHECK_AND_ASSERT_THROW_MES(cache == NULL || cache->size >= data.size(), "Cache is too small");
@@ -575,8 +600,9 @@ struct pippenger_cached_data
 {
   size_t size;
   ge_cached *cached;
-  pippenger_cached_data(): size(0), cached(NULL) {}
-  ~pippenger_cached_data() { aligned_free(cached); }
+  bool owned;
+  pippenger_cached_data(): size(0), cached(NULL), owned(true) {}
+  ~pippenger_cached_data() { if (owned) aligned_free(cached); }
 };
 
 std::shared_ptr<pippenger_cached_data> pippenger_init_cache(const std::vector<MultiexpData> &data, size_t start_offset, size_t N)
@@ -603,6 +629,22 @@ size_t pippenger_get_cache_size(const std::shared_ptr<pippenger_cached_data> &ca
   return cache->size * sizeof(*cache->cached);
 }
 
+std::shared_ptr<pippenger_cached_data> pippenger_init_cache_view(const ge_cached *cached, size_t N, size_t bytes)
+{
+  CHECK_AND_ASSERT_THROW_MES(cached, "Bad cache base data");
+  CHECK_AND_ASSERT_THROW_MES(bytes == N * sizeof(ge_cached), "Bad cache size");
+  std::shared_ptr<pippenger_cached_data> cache(new pippenger_cached_data());
+  cache->size = N;
+  cache->cached = const_cast<ge_cached*>(cached);
+  cache->owned = false;
+  return cache;
+}
+
+const ge_cached *pippenger_get_cache_data(const std::shared_ptr<pippenger_cached_data> &cache)
+{
+  return cache->cached;
+}
+
 rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<pippenger_cached_data> &cache, size_t cache_size, size_t c)
 {
   if (cache != NULL && cache_size == 0)
@@ -366,21 +366,13 @@ namespace rct {
 
     //does a * P where a is a scalar and P is an arbitrary point
     void scalarmultKey(key & aP, const key &P, const key &a) {
-        ge_p3 A;
-        ge_p2 R;
-        CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&A, P.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
-        ge_scalarmult(&R, a.bytes, &A);
-        ge_tobytes(aP.bytes, &R);
+        CHECK_AND_ASSERT_THROW_MES_L1(ge_scalarmult_tobytes(aP.bytes, a.bytes, P.bytes, 0) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
     }
 
     //does a * P where a is a scalar and P is an arbitrary point
     key scalarmultKey(const key & P, const key & a) {
-        ge_p3 A;
-        ge_p2 R;
-        CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&A, P.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
-        ge_scalarmult(&R, a.bytes, &A);
         key aP;
-        ge_tobytes(aP.bytes, &R);
+        CHECK_AND_ASSERT_THROW_MES_L1(ge_scalarmult_tobytes(aP.bytes, a.bytes, P.bytes, 0) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
         return aP;
     }
 
@@ -476,11 +468,7 @@ namespace rct {
     //addKeys2
     //aGbB = aG + bB where a, b are scalars, G is the basepoint and B is a point
     void addKeys2(key &aGbB, const key &a, const key &b, const key & B) {
-        ge_p2 rv;
-        ge_p3 B2;
-        CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&B2, B.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
-        ge_double_scalarmult_base_vartime(&rv, b.bytes, &B2, a.bytes);
-        ge_tobytes(aGbB.bytes, &rv);
+        CHECK_AND_ASSERT_THROW_MES_L1(ge_double_scalarmult_base_vartime_tobytes(aGbB.bytes, b.bytes, B.bytes, a.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
     }
 
     //Does some precomputation to make addKeys3 more efficient
@@ -1702,68 +1702,201 @@ namespace rct {
       return verRctSemanticsSimple(std::vector<const rctSig*>(1, &rv));
     }
 
-    //ver RingCT simple
+    // smallest multiexp size for which get_pippenger_c picks its largest window,
+    // larger batches only amortize the bucket additions a little further
+    static constexpr size_t BATCH_VER_MIN_MULTIEXP_SIZE = 2296;
+
+    // rough number of multiexp terms a range proof batch needs for this rctSig
+    static size_t get_rct_semantics_multiexp_size(const rctSig *rvp)
+    {
+      size_t size = 0;
+      if (!rvp)
+        return size;
+      for (const BulletproofPlus &proof: rvp->p.bulletproofs_plus)
+        size += proof.V.size() + 2 * proof.L.size() + 3;
+      for (const Bulletproof &proof: rvp->p.bulletproofs)
+        size += proof.V.size() + 2 * proof.L.size() + 4;
+      return size;
+    }
+
+    // verifies rvv[begin, end) as one batch. If that fails, splits the range in
+    // halves until the rctSigs which fail on their own are found
+    static void verRctSemanticsSimpleBisect(const std::vector<const rctSig*> & rvv, size_t begin, size_t end, std::deque<bool> & results)
+    {
+      if (begin >= end)
+        return;
+      const bool valid = verRctSemanticsSimple(std::vector<const rctSig*>(rvv.begin() + begin, rvv.begin() + end));
+      if (valid || end - begin == 1)
+      {
+        for (size_t i = begin; i < end; ++i)
+          results[i] = valid;
+        return;
+      }
+      const size_t mid = begin + (end - begin) / 2;
+      verRctSemanticsSimpleBisect(rvv, begin, mid, results);
+      verRctSemanticsSimpleBisect(rvv, mid, end, results);
+    }
+
+    //ver RingCT simple semantics, for large sets of rctSigs
+    //splits rvv into range proof batches which are large enough to use the widest
+    //Pippenger window, verifies them in parallel, and bisects failing batches so
+    //that results gets one flag per rctSig
+    bool verRctSemanticsSimple(const std::vector<const rctSig*> & rvv, std::deque<bool> & results)
+    {
+      results.clear();
+      results.resize(rvv.size(), false);
+      if (rvv.empty())
+        return true;
+
+      tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+      tools::threadpool::waiter waiter(tpool);
+      const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+
+      std::vector<size_t> sizes(rvv.size());
+      size_t total_size = 0;
+      for (size_t n = 0; n < rvv.size(); ++n)
+      {
+        sizes[n] = get_rct_semantics_multiexp_size(rvv[n]);
+        total_size += sizes[n];
+      }
+      const size_t batch_size = std::max(BATCH_VER_MIN_MULTIEXP_SIZE, (total_size + threads - 1) / threads);
+
+      size_t begin = 0, size = 0;
+      for (size_t n = 0; n < rvv.size(); ++n)
+      {
+        size += sizes[n];
+        if (size >= batch_size || n + 1 == rvv.size())
+        {
+          tpool.submit(&waiter, [&, begin, n] { verRctSemanticsSimpleBisect(rvv, begin, n + 1, results); });
+          begin = n + 1;
+          size = 0;
+        }
+      }
+      if (!waiter.wait())
+      {
+        results.assign(rvv.size(), false);
+        return false;
+      }
+
+      for (size_t n = 0; n < results.size(); ++n)
+      {
+        if (!results[n])
+        {
+          LOG_PRINT_L1("RCT semantics check failed for rctSig " << n);
+          return false;
+        }
+      }
+      return true;
+    }
+
+    //ver RingCT simple, batched
     //assumes only post-rct style inputs (at least for max anonymity)
-    bool verRctNonSemanticsSimple(const rctSig & rv) {
+    //the ring signatures of all rctSigs are checked as one set of jobs on the compute threadpool,
+    //so that many small transactions keep all threads busy. results gets one flag per rctSig, so
+    //callers can tell which of them failed
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rvv, std::deque<bool> & results) {
+      results.clear();
+      results.resize(rvv.size(), false);
       try
       {
         PERF_TIMER(verRctNonSemanticsSimple);
 
-        CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeSimpleBulletproof || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus,
-            false, "verRctNonSemanticsSimple called on non simple rctSig");
-        const bool bulletproof = is_rct_bulletproof(rv.type);
-        const bool bulletproof_plus = is_rct_bulletproof_plus(rv.type);
-        // semantics check is early, and mixRing/MGs aren't resolved yet
-        if (bulletproof || bulletproof_plus)
-          CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
-        else
-          CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
-
-        const size_t threads = std::max(rv.outPk.size(), rv.mixRing.size());
-
-        std::deque<bool> results(threads);
         tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
         tools::threadpool::waiter waiter(tpool);
 
-        const keyV &pseudoOuts = bulletproof || bulletproof_plus ? rv.p.pseudoOuts : rv.pseudoOuts;
+        // one message per rctSig, and a flat list of (rctSig, input) pairs to check
+        std::vector<key> messages(rvv.size());
+        std::vector<std::pair<size_t, size_t>> inputs;
+        std::deque<bool> valid(rvv.size(), false);
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          CHECK_AND_ASSERT_MES(rvv[n], false, "rctSig pointer is NULL");
+          const rctSig &rv = *rvv[n];
+          if (!(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeSimpleBulletproof || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus))
+          {
+            LOG_PRINT_L1("verRctNonSemanticsSimple called on non simple rctSig");
+            continue;
+          }
+          const bool bulletproof = is_rct_bulletproof(rv.type);
+          const bool bulletproof_plus = is_rct_bulletproof_plus(rv.type);
+          // semantics check is early, and mixRing/MGs aren't resolved yet
+          const keyV &pseudoOuts = bulletproof || bulletproof_plus ? rv.p.pseudoOuts : rv.pseudoOuts;
+          if (pseudoOuts.size() != rv.mixRing.size())
+          {
+            LOG_PRINT_L1("Mismatched sizes of pseudoOuts and mixRing");
+            continue;
+          }
+          const size_t n_sigs = is_rct_clsag(rv.type) ? rv.p.CLSAGs.size() : rv.p.MGs.size();
+          if (n_sigs != rv.mixRing.size())
+          {
+            LOG_PRINT_L1("Mismatched sizes of signatures and mixRing");
+            continue;
+          }
 
-        const key message = get_pre_mlsag_hash(rv, hw::get_device("default"));
+          try { messages[n] = get_pre_mlsag_hash(rv, hw::get_device("default")); }
+          catch (const std::exception &e)
+          {
+            LOG_PRINT_L1("Error in get_pre_mlsag_hash: " << e.what());
+            continue;
+          }
+
+          valid[n] = true;
+          for (size_t i = 0; i < rv.mixRing.size(); ++i)
+            inputs.push_back(std::make_pair(n, i));
+        }
 
-        results.clear();
-        results.resize(rv.mixRing.size());
-        for (size_t i = 0 ; i < rv.mixRing.size() ; i++) {
-          tpool.submit(&waiter, [&, i] {
+        std::deque<bool> input_results(inputs.size());
+        for (size_t j = 0; j < inputs.size(); ++j) {
+          tpool.submit(&waiter, [&, j] {
+              const rctSig &rv = *rvv[inputs[j].first];
+              const size_t i = inputs[j].second;
+              const keyV &pseudoOuts = is_rct_bulletproof(rv.type) || is_rct_bulletproof_plus(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
               if (is_rct_clsag(rv.type))
-                  results[i] = verRctCLSAGSimple(message, rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
+                  input_results[j] = verRctCLSAGSimple(messages[inputs[j].first], rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
               else
-                  results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
+                  input_results[j] = verRctMGSimple(messages[inputs[j].first], rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
           });
         }
         if (!waiter.wait())
           return false;
 
-        for (size_t i = 0; i < results.size(); ++i) {
-          if (!results[i]) {
-            LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << i);
-            return false;
+        for (size_t j = 0; j < inputs.size(); ++j) {
+          if (!input_results[j]) {
+            LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << inputs[j].second);
+            valid[inputs[j].first] = false;
           }
         }
 
-        return true;
+        bool all_valid = true;
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          results[n] = valid[n];
+          all_valid &= valid[n];
+        }
+        return all_valid;
       }
       // we can get deep throws from ge_frombytes_vartime if input isn't valid
       catch (const std::exception &e)
       {
         LOG_PRINT_L1("Error in verRctNonSemanticsSimple: " << e.what());
+        results.assign(rvv.size(), false);
         return false;
       }
       catch (...)
       {
         LOG_PRINT_L1("Error in verRctNonSemanticsSimple, but not an actual exception");
+        results.assign(rvv.size(), false);
         return false;
       }
     }
 
+    //ver RingCT simple
+    //assumes only post-rct style inputs (at least for max anonymity)
+    bool verRctNonSemanticsSimple(const rctSig & rv) {
+      std::deque<bool> results;
+      return verRctNonSemanticsSimple(std::vector<const rctSig*>(1, &rv), results);
+    }
+
     //RingCT protocol
     //genRct: 
     //   creates an rctSig with all data necessary to verify the rangeProofs and that the signer owns one of the
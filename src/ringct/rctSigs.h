@@ -36,6 +36,7 @@
 #define RCTSIGS_H
 
 #include <cstddef>
+#include <deque>
 #include <vector>
 #include <tuple>
 
@@ -134,7 +135,9 @@ namespace rct {
     static inline bool verRct(const rctSig & rv) { return verRct(rv, true) && verRct(rv, false); }
     bool verRctSemanticsSimple(const rctSig & rv);
     bool verRctSemanticsSimple(const std::vector<const rctSig*> & rv);
+    bool verRctSemanticsSimple(const std::vector<const rctSig*> & rv, std::deque<bool> & results);
     bool verRctNonSemanticsSimple(const rctSig & rv);
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rv, std::deque<bool> & results);
     static inline bool verRctSimple(const rctSig & rv) { return verRctSemanticsSimple(rv) && verRctNonSemanticsSimple(rv); }
     xmr_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, key & mask, hw::device &hwdev);
     xmr_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, hw::device &hwdev);
@@ -806,25 +806,35 @@ namespace cryptonote
     res.blocks.clear();
     res.blocks.reserve(req.heights.size());
     CHECK_PAYMENT_MIN1(req, res, req.heights.size() * COST_PER_BLOCK, false);
+    // copy the stored blobs straight into the response, rather than parsing
+    // them only to serialize them again
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    blobdata scratch;
     for (uint64_t height : req.heights)
     {
       block blk;
+      blobdata block_blob;
       try
       {
-        blk = m_core.get_blockchain_storage().get_db().get_block_from_height(height);
+        // the read txn must not be held while taking the blockchain lock below
+        db_rtxn_guard rtxn_guard(&db);
+        const blobdata_ref blob = db.get_block_blob_view_from_height(height, scratch);
+        if (!parse_and_validate_block_from_blob(blob, blk))
+          throw std::runtime_error("Failed to parse block");
+        block_blob.assign(blob.data(), blob.size());
       }
       catch (...)
       {
         res.status = "Error retrieving block at height " + std::to_string(height);
         return true;
       }
-      std::vector<transaction> txs;
+      std::vector<blobdata> txs;
       std::vector<crypto::hash> missed_txs;
       m_core.get_transactions(blk.tx_hashes, txs, missed_txs);
       res.blocks.resize(res.blocks.size() + 1);
-      res.blocks.back().block = block_to_blob(blk);
+      res.blocks.back().block = std::move(block_blob);
       for (auto& tx : txs)
-        res.blocks.back().txs.push_back({tx_to_blob(tx), crypto::null_hash});
+        res.blocks.back().txs.push_back({std::move(tx), crypto::null_hash});
     }
     res.status = CORE_RPC_STATUS_OK;
     return true;
@@ -2983,6 +2993,20 @@ namespace cryptonote
       res.fee = m_core.get_blockchain_storage().get_dynamic_base_fee_estimate(req.grace_blocks);
     }
     res.quantization_mask = Blockchain::get_fee_quantization_mask();
+
+    // what it takes to get ahead of the public pool within 8/4/2/1 blocks,
+    // never below the matching chain based estimate
+    static const uint64_t pool_fee_blocks[] = {8, 4, 2, 1};
+    const uint64_t median_weight = m_core.get_blockchain_storage().get_current_cumulative_block_weight_median();
+    const size_t n_pool_fees = res.fees.empty() ? 1 : std::min(res.fees.size(), sizeof(pool_fee_blocks) / sizeof(pool_fee_blocks[0]));
+    res.pool_fees.resize(n_pool_fees);
+    for (size_t i = 0; i < n_pool_fees; ++i)
+    {
+      const uint64_t blocks = res.fees.empty() ? 1 : pool_fee_blocks[i];
+      uint64_t pool_fee = m_core.get_txpool_fee_per_byte_for_weight_ahead(blocks * median_weight);
+      pool_fee = (pool_fee + res.quantization_mask - 1) / res.quantization_mask * res.quantization_mask;
+      res.pool_fees[i] = std::max(pool_fee, res.fees.empty() ? res.fee : res.fees[i]);
+    }
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -3306,6 +3330,28 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_txpool_fee_histogram(const COMMAND_RPC_GET_TRANSACTION_POOL_FEE_HISTOGRAM::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_FEE_HISTOGRAM::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_txpool_fee_histogram);
+    bool r;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_FEE_HISTOGRAM>(invoke_http_mode::JON_RPC, "get_txpool_fee_histogram", req, res, r))
+      return r;
+    CHECK_PAYMENT(req, res, COST_PER_TX_POOL_FEE_HISTOGRAM);
+
+    const fee_histogram histogram = m_core.get_txpool_fee_histogram();
+    for (size_t i = 0; i < histogram.bins().size(); ++i)
+    {
+      const fee_histogram::bin &b = histogram.bins()[i];
+      if (b.count)
+        res.bins.push_back({fee_histogram::get_bin_min_fee_per_byte(i), b.count, b.weight, b.fee});
+    }
+    res.txs_total = histogram.count();
+    res.weight_total = histogram.weight();
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(get_output_distribution);
@@ -3432,6 +3478,29 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_compact_blockchain(const COMMAND_RPC_COMPACT_BLOCKCHAIN::request& req, COMMAND_RPC_COMPACT_BLOCKCHAIN::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(compact_blockchain);
+
+    try
+    {
+      if (!m_core.compact_blockchain())
+      {
+        error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+        error_resp.message = "Failed to compact blockchain";
+        return false;
+      }
+    }
+    catch (const std::exception &e)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Failed to compact blockchain";
+      return false;
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_rpc_access_info(const COMMAND_RPC_ACCESS_INFO::request& req, COMMAND_RPC_ACCESS_INFO::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(rpc_access_info);
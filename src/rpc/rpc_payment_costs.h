@@ -36,6 +36,7 @@
 #define COST_PER_KEY_IMAGE 0.01
 #define COST_PER_POOL_HASH 0.01
 #define COST_PER_TX_POOL_STATS 0.2
+#define COST_PER_TX_POOL_FEE_HISTOGRAM 2
 #define COST_PER_BLOCK_HEADER 0.1
 #define COST_PER_GET_INFO 1
 #define COST_PER_OUTPUT_HISTOGRAM 25000
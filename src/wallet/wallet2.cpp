@@ -3175,48 +3175,66 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   hwdev.set_mode(hw::device::TRANSACTION_PARSE);
   const cryptonote::account_keys &keys = m_account.get_keys();
 
-  auto gender = [&](wallet2::is_out_data &iod) {
-    if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
+  // Derive all tx pubkeys in batches rather than per tx, so the device can share work across them
+  std::vector<wallet2::is_out_data*> iods;
+  for (auto &slot: tx_cache_data)
+  {
+    for (auto &iod: slot.primary)
+      iods.push_back(&iod);
+    for (auto &iod: slot.additional)
+      iods.push_back(&iod);
+  }
+
+  auto gender = [&](size_t begin, size_t end) {
+    std::vector<crypto::public_key> pkeys;
+    pkeys.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i)
+      pkeys.push_back(iods[i]->pkey);
+    std::vector<crypto::key_derivation> derivations;
+    std::vector<uint8_t> valid;
+    hwdev.generate_key_derivations(pkeys, keys.m_view_secret_key, derivations, valid);
+    for (size_t i = begin; i < end; ++i)
     {
-      MWARNING("Failed to generate key derivation from tx pubkey, skipping");
-      static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
-      memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
+      wallet2::is_out_data &iod = *iods[i];
+      if (valid[i - begin])
+      {
+        iod.derivation = derivations[i - begin];
+      }
+      else
+      {
+        MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+        static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
+        memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
+      }
     }
+    memwipe(derivations.data(), derivations.size() * sizeof(crypto::key_derivation));
   };
 
-  for (size_t i = 0; i < tx_cache_data.size(); ++i)
+  static const size_t DERIVATION_BATCH_SIZE = 256;
+  for (size_t begin = 0; begin < iods.size(); begin += DERIVATION_BATCH_SIZE)
   {
-    if (tx_cache_data[i].empty())
-      continue;
-    tpool.submit(&waiter, [&gender, &tx_cache_data, i]() {
-      auto &slot = tx_cache_data[i];
-      for (auto &iod: slot.primary)
-        gender(iod);
-      for (auto &iod: slot.additional)
-        gender(iod);
-    }, true);
+    const size_t end = std::min(begin + DERIVATION_BATCH_SIZE, iods.size());
+    tpool.submit(&waiter, [&gender, begin, end]() { gender(begin, end); }, true);
   }
   THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
 
   auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
-    for (size_t k = 0; k < n_vouts; ++k)
-    {
-      const auto &o = tx.vout[k];
-      crypto::public_key output_public_key;
-      if (get_output_public_key(o, output_public_key))
-      {
-        std::vector<crypto::key_derivation> additional_derivations;
-        additional_derivations.reserve(tx_cache_data[txidx].additional.size());
-        for (const auto &iod: tx_cache_data[txidx].additional)
-          additional_derivations.push_back(iod.derivation);
-        for (size_t l = 0; l < tx_cache_data[txidx].primary.size(); ++l)
-        {
-          THROW_WALLET_EXCEPTION_IF(tx_cache_data[txidx].primary[l].received.size() != n_vouts,
-              error::wallet_internal_error, "Unexpected received array size");
-          tx_cache_data[txidx].primary[l].received[k] = is_out_to_acc_precomp(m_subaddresses, output_public_key, tx_cache_data[txidx].primary[l].derivation, additional_derivations, k, hwdev, get_output_view_tag(o));
-          additional_derivations.clear();
-        }
-      }
+    cryptonote::output_scan_data scan_data;
+    get_output_scan_data(tx, n_vouts, scan_data);
+    if (std::find(scan_data.has_key.begin(), scan_data.has_key.end(), 1) == scan_data.has_key.end())
+      return;
+
+    // additional tx pubkeys are only checked along with the first primary derivation
+    std::vector<crypto::key_derivation> additional_derivations;
+    additional_derivations.reserve(tx_cache_data[txidx].additional.size());
+    for (const auto &iod: tx_cache_data[txidx].additional)
+      additional_derivations.push_back(iod.derivation);
+    for (size_t l = 0; l < tx_cache_data[txidx].primary.size(); ++l)
+    {
+      THROW_WALLET_EXCEPTION_IF(tx_cache_data[txidx].primary[l].received.size() != n_vouts,
+          error::wallet_internal_error, "Unexpected received array size");
+      scan_outputs_to_acc(m_subaddresses, scan_data, tx_cache_data[txidx].primary[l].derivation, additional_derivations, hwdev, tx_cache_data[txidx].primary[l].received);
+      additional_derivations.clear();
     }
   };
   struct geniod_params
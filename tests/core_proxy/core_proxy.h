@@ -90,6 +90,7 @@ namespace tests
     bool get_test_drop_download_height() {return true;}
     bool prepare_handle_incoming_blocks(const std::vector<cryptonote::block_complete_entry>  &blocks_entry, std::vector<cryptonote::block> &blocks) { return true; }
     bool cleanup_handle_incoming_blocks(bool force_sync = false) { return true; }
+    void pipeline_next_span(uint64_t start_height, std::vector<cryptonote::block_complete_entry> blocks_entry) {}
     bool update_checkpoints(const bool skip_dns = false) { return true; }
     uint64_t get_target_blockchain_height() const { return 1; }
     size_t get_block_sync_size(uint64_t height) const { return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; }
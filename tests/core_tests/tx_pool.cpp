@@ -635,3 +635,428 @@ bool txpool_stem_loop::generate(std::vector<test_event_entry>& events) const
 
   return true;
 }
+
+bool txpool_validate::generate(std::vector<test_event_entry>& events) const
+{
+  INIT_MEMPOOL_TEST();
+
+  const std::size_t tx_index = events.size();
+  MAKE_TX(events, tx_0, miner_account, bob_account, send_amount, blk_0);
+  MAKE_TX(events, tx_1, miner_account, bob_account, send_amount, blk_0);
+  MAKE_TX(events, tx_2, miner_account, bob_account, send_amount, blk_0);
+
+  // spends tx_0's key image, and gets mined while tx_0 is still in the pool
+  cryptonote::transaction tx_3;
+  {
+    auto events_copy = events;
+    events_copy.erase(events_copy.begin() + tx_index);
+    MAKE_TX(events_copy, tx_temp, miner_account, bob_account, send_amount, blk_0);
+    tx_3 = tx_temp;
+  }
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_keeped_by_block);
+  events.push_back(tx_3);
+  SET_EVENT_VISITOR_SETT(events, 0);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_1, blk_0r, miner_account, std::list<cryptonote::transaction>{tx_3});
+
+  // tx_0 is now a double spend, tx_1 and tx_2 are still good
+  DO_CALLBACK(events, "check_validate");
+
+  return true;
+}
+
+bool txpool_validate::check_validate(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  if (c.get_pool_transactions_count(true) != 3)
+  {
+    MERROR("Expected 3 txes in the pool before validating it, got " << c.get_pool_transactions_count(true));
+    return false;
+  }
+
+  const size_t removed = c.get_pool().validate(c.get_blockchain_storage().get_current_hard_fork_version());
+  if (removed != 1)
+  {
+    MERROR("Expected validate to remove 1 tx, it removed " << removed);
+    return false;
+  }
+
+  std::vector<cryptonote::transaction> txs;
+  if (!c.get_pool_transactions(txs, true) || txs.size() != 2)
+  {
+    MERROR("Expected 2 txes in the pool after validating it, got " << txs.size());
+    return false;
+  }
+  for (const cryptonote::transaction &tx: txs)
+  {
+    if (c.get_blockchain_storage().have_tx_keyimges_as_spent(tx))
+    {
+      MERROR("The double spending tx was kept in the pool");
+      return false;
+    }
+  }
+
+  // what was kept spends nothing already spent, and stays valid
+  if (c.get_pool().validate(c.get_blockchain_storage().get_current_hard_fork_version()) != 0)
+  {
+    MERROR("Validating the pool again removed txes");
+    return false;
+  }
+  return true;
+}
+
+namespace
+{
+  struct template_entry
+  {
+    crypto::hash id;
+    cryptonote::tx_memory_pool::tx_details details;
+    bool ready;
+  };
+
+  //! Broadcasted pool txes in the order templates are filled from, with their readiness on the current tip
+  std::vector<template_entry> get_template_entries(cryptonote::core& c)
+  {
+    std::vector<crypto::hash> txids;
+    c.get_pool_transaction_hashes(txids, false);
+    std::vector<std::pair<crypto::hash, cryptonote::tx_memory_pool::tx_details>> txs;
+    c.get_pool().get_transactions_info(txids, txs, false);
+
+    std::vector<template_entry> entries;
+    for (auto &e: txs)
+    {
+      uint64_t max_used_block_height = 0;
+      crypto::hash max_used_block_id = crypto::null_hash;
+      cryptonote::tx_verification_context tvc{};
+      cryptonote::transaction tx = e.second.tx;
+      const bool ready = c.get_blockchain_storage().check_tx_inputs(tx, max_used_block_height, max_used_block_id, tvc)
+        && !c.get_blockchain_storage().have_tx_keyimges_as_spent(e.second.tx);
+      entries.push_back(template_entry{e.first, std::move(e.second), ready});
+    }
+
+    const auto fee_per_weight = [](const template_entry &e) { return e.details.fee / (double)(e.details.weight ? e.details.weight : 1); };
+    std::sort(entries.begin(), entries.end(), [&fee_per_weight](const template_entry &a, const template_entry &b) {
+      if (fee_per_weight(a) != fee_per_weight(b))
+        return fee_per_weight(a) > fee_per_weight(b);
+      if (a.details.receive_time != b.details.receive_time)
+        return a.details.receive_time < b.details.receive_time;
+      return memcmp(a.id.data, b.id.data, sizeof(a.id.data)) < 0;
+    });
+    return entries;
+  }
+
+  bool has_key_images(const std::unordered_set<crypto::key_image> &k_images, const cryptonote::transaction &tx)
+  {
+    for (const auto &in: tx.vin)
+      if (in.type() == typeid(cryptonote::txin_to_key) && k_images.count(boost::get<cryptonote::txin_to_key>(in).k_image))
+        return true;
+    return false;
+  }
+
+  void add_key_images(std::unordered_set<crypto::key_image> &k_images, const cryptonote::transaction &tx)
+  {
+    for (const auto &in: tx.vin)
+      if (in.type() == typeid(cryptonote::txin_to_key))
+        k_images.insert(boost::get<cryptonote::txin_to_key>(in).k_image);
+  }
+
+  //! The greedy fill as done before template candidates were kept in memory, reading everything from the pool
+  bool reference_fill_block_template(const std::vector<template_entry> &entries, size_t median_weight, uint64_t already_generated_coins, uint8_t version,
+      std::vector<crypto::hash> &tx_hashes, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward)
+  {
+    uint64_t best_coinbase = 0, coinbase = 0;
+    total_weight = 0;
+    fee = 0;
+    if (!cryptonote::get_block_reward(median_weight, total_weight, already_generated_coins, best_coinbase, version))
+      return false;
+
+    const size_t max_total_weight = version >= 5 ? 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE : (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+    std::unordered_set<crypto::key_image> k_images;
+    for (const template_entry &e: entries)
+    {
+      if (max_total_weight < total_weight + e.details.weight)
+        continue;
+      if (version >= 5)
+      {
+        uint64_t block_reward;
+        if (!cryptonote::get_block_reward(median_weight, total_weight + e.details.weight, already_generated_coins, block_reward, version))
+          continue;
+        coinbase = block_reward + fee + e.details.fee;
+        if (coinbase < best_coinbase)
+          continue;
+      }
+      else if (total_weight > median_weight)
+      {
+        break;
+      }
+      if (!e.ready || has_key_images(k_images, e.details.tx))
+        continue;
+
+      tx_hashes.push_back(e.id);
+      total_weight += e.details.weight;
+      fee += e.details.fee;
+      best_coinbase = coinbase;
+      add_key_images(k_images, e.details.tx);
+    }
+    expected_reward = best_coinbase;
+    return true;
+  }
+
+  bool check_fill_block_template(cryptonote::core& c, const std::vector<template_entry> &entries, size_t median_weight, uint64_t already_generated_coins, uint8_t version, std::vector<crypto::hash> *tx_hashes = nullptr)
+  {
+    std::vector<crypto::hash> expected_hashes;
+    size_t expected_weight;
+    uint64_t expected_fee, expected_reward;
+    if (!reference_fill_block_template(entries, median_weight, already_generated_coins, version, expected_hashes, expected_weight, expected_fee, expected_reward))
+    {
+      MERROR("Failed to fill the reference block template");
+      return false;
+    }
+
+    // the second fill is served from the snapshot of the first
+    for (int i = 0; i < 2; ++i)
+    {
+      cryptonote::block bl;
+      size_t total_weight;
+      uint64_t fee, reward;
+      if (!c.get_pool().fill_block_template(bl, median_weight, already_generated_coins, total_weight, fee, reward, version))
+      {
+        MERROR("Failed to fill block template");
+        return false;
+      }
+      if (bl.tx_hashes != expected_hashes || total_weight != expected_weight || fee != expected_fee || reward != expected_reward)
+      {
+        MERROR("Block template with median weight " << median_weight << ", version " << (unsigned)version << " has " << bl.tx_hashes.size()
+            << " txes, weight " << total_weight << ", fee " << fee << ", reward " << reward << ", expected " << expected_hashes.size()
+            << " txes, weight " << expected_weight << ", fee " << expected_fee << ", reward " << expected_reward << " (fill " << i << ")");
+        return false;
+      }
+    }
+    if (tx_hashes)
+      *tx_hashes = std::move(expected_hashes);
+    return true;
+  }
+}
+
+txpool_block_template::txpool_block_template()
+  : txpool_base()
+  , m_saved_median_weight(0)
+  , m_saved_coins(0)
+  , m_saved_version(0)
+{
+  m_template_account.generate();
+  REGISTER_CALLBACK_METHOD(txpool_block_template, check_template);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, relay_hidden_txes);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, remove_pool_tx);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, save_template_args);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, check_tip_change);
+}
+
+bool txpool_block_template::generate(std::vector<test_event_entry>& events) const
+{
+  INIT_MEMPOOL_TEST();
+  GENERATE_ACCOUNT(alice_account);
+
+  MAKE_TX(events, tx_0, miner_account, bob_account, send_amount, blk_0);
+  MAKE_TX(events, tx_1, miner_account, bob_account, send_amount, blk_0);
+  DO_CALLBACK(events, "check_template");
+
+  // added to the pool
+  MAKE_TX(events, tx_2, miner_account, bob_account, send_amount, blk_0);
+  DO_CALLBACK(events, "check_template");
+
+  // kept out of templates until it is broadcasted, with a fee of its own so its place
+  // in the fee order does not depend on when it was relayed
+  cryptonote::transaction tx_3;
+  construct_tx_to_key(events, tx_3, blk_0, miner_account, bob_account, send_amount, TESTS_DEFAULT_FEE * 2, 0);
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_local_relay);
+  events.push_back(tx_3);
+  SET_EVENT_VISITOR_SETT(events, 0);
+  DO_CALLBACK(events, "check_template");
+  DO_CALLBACK(events, "relay_hidden_txes");
+  DO_CALLBACK(events, "check_template");
+
+  // removed from the pool
+  DO_CALLBACK(events, "remove_pool_tx");
+  DO_CALLBACK(events, "check_template");
+
+  // tx_4 spends the coinbase of a block it comes before, so only the tip moving
+  // (60 blocks later, once that coinbase unlocks) can make it ready
+  cryptonote::block blk_1;
+  generator.construct_block(blk_1, blk_0r, alice_account);
+  cryptonote::transaction tx_4;
+  {
+    auto events_copy = events;
+    events_copy.push_back(blk_1);
+    construct_tx_to_key(events_copy, tx_4, blk_1, alice_account, bob_account, send_amount, TESTS_DEFAULT_FEE, 0);
+  }
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_keeped_by_block);
+  events.push_back(tx_4);
+  SET_EVENT_VISITOR_SETT(events, 0);
+  DO_CALLBACK(events, "check_template");
+
+  events.push_back(blk_1);
+  REWIND_BLOCKS_N(events, blk_1r, blk_1, miner_account, CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW - 2);
+  DO_CALLBACK(events, "check_template");
+  DO_CALLBACK(events, "save_template_args");
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1r, miner_account);
+  DO_CALLBACK(events, "check_tip_change");
+  DO_CALLBACK(events, "check_template");
+
+  return true;
+}
+
+bool txpool_block_template::check_template(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  cryptonote::Blockchain &bc = c.get_blockchain_storage();
+  const std::vector<template_entry> entries = get_template_entries(c);
+  const uint64_t height = bc.get_current_blockchain_height();
+  const size_t median_weight = bc.get_current_cumulative_block_weight_limit() / 2;
+  const uint64_t already_generated_coins = bc.get_db().get_block_already_generated_coins(height - 1);
+  const uint8_t version = bc.get_current_hard_fork_version();
+
+  // the medians below the full reward zone limit how many txes fit
+  std::vector<crypto::hash> tx_hashes;
+  if (!check_fill_block_template(c, entries, median_weight, already_generated_coins, version, &tx_hashes))
+    return false;
+  for (size_t small_median: {1000, 1500, 2500})
+  {
+    if (!check_fill_block_template(c, entries, small_median, already_generated_coins, version))
+      return false;
+    if (!check_fill_block_template(c, entries, small_median, already_generated_coins, std::max<uint8_t>(version, 5)))
+      return false;
+  }
+
+  // the backlog has the ready txes in fee order, without key image conflicts
+  std::vector<cryptonote::tx_block_template_backlog_entry> expected_backlog;
+  {
+    const uint64_t backlog_median = bc.get_current_cumulative_block_weight_median();
+    const uint64_t max_backlog_weight = backlog_median + (backlog_median / 8);
+    std::unordered_set<crypto::key_image> k_images;
+    uint64_t w = 0;
+    for (const template_entry &e: entries)
+    {
+      if (!e.ready || has_key_images(k_images, e.details.tx))
+        continue;
+      add_key_images(k_images, e.details.tx);
+      expected_backlog.push_back(cryptonote::tx_block_template_backlog_entry{e.id, e.details.weight, e.details.fee});
+      w += e.details.weight;
+      if (w > max_backlog_weight)
+        break;
+    }
+  }
+  for (int i = 0; i < 2; ++i)
+  {
+    std::vector<cryptonote::tx_block_template_backlog_entry> backlog;
+    c.get_pool().get_block_template_backlog(backlog);
+    const bool same = backlog.size() == expected_backlog.size() && std::equal(backlog.begin(), backlog.end(), expected_backlog.begin(),
+        [](const cryptonote::tx_block_template_backlog_entry &a, const cryptonote::tx_block_template_backlog_entry &b) { return a.id == b.id && a.weight == b.weight && a.fee == b.fee; });
+    if (!same)
+    {
+      MERROR("Block template backlog has " << backlog.size() << " txes, expected " << expected_backlog.size());
+      return false;
+    }
+  }
+
+  // the template, then the same one from the cache, is on the current tip with the current pool
+  cryptonote::block first;
+  for (int i = 0; i < 2; ++i)
+  {
+    cryptonote::block b;
+    cryptonote::difficulty_type diffic;
+    uint64_t template_height, expected_reward, seed_height;
+    crypto::hash seed_hash;
+    if (!c.get_block_template(b, m_template_account.get_keys().m_account_address, diffic, template_height, expected_reward, cryptonote::blobdata(), seed_height, seed_hash))
+    {
+      MERROR("Failed to get block template");
+      return false;
+    }
+    if (b.prev_id != bc.get_tail_id() || template_height != height)
+    {
+      MERROR("Block template is not on the current tip");
+      return false;
+    }
+    if (b.tx_hashes != tx_hashes)
+    {
+      MERROR("Block template has " << b.tx_hashes.size() << " txes, expected " << tx_hashes.size());
+      return false;
+    }
+    if (i == 0)
+      first = b;
+    else if (cryptonote::get_transaction_hash(b.miner_tx) != cryptonote::get_transaction_hash(first.miner_tx))
+    {
+      MERROR("Block template was not served from the cache");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool txpool_block_template::relay_hidden_txes(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  std::vector<crypto::hash> all, broadcasted, hidden;
+  c.get_pool_transaction_hashes(all, true);
+  c.get_pool_transaction_hashes(broadcasted, false);
+  for (const crypto::hash &txid: all)
+    if (std::find(broadcasted.begin(), broadcasted.end(), txid) == broadcasted.end())
+      hidden.push_back(txid);
+  if (hidden.size() != 1)
+  {
+    MERROR("Expected 1 hidden tx in the pool, got " << hidden.size());
+    return false;
+  }
+
+  std::vector<bool> just_broadcasted;
+  c.get_pool().set_relayed(epee::to_span(hidden), cryptonote::relay_method::fluff, just_broadcasted);
+  if (just_broadcasted != std::vector<bool>{true})
+  {
+    MERROR("The hidden tx was not broadcasted");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_block_template::remove_pool_tx(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  std::vector<crypto::hash> txids;
+  c.get_pool_transaction_hashes(txids, false);
+  if (txids.empty())
+  {
+    MERROR("Expected txes in the pool");
+    return false;
+  }
+
+  cryptonote::transaction tx;
+  cryptonote::blobdata txblob;
+  size_t tx_weight;
+  uint64_t fee;
+  bool relayed, do_not_relay, double_spend_seen, pruned;
+  if (!c.get_pool().take_tx(txids.front(), tx, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
+  {
+    MERROR("Failed to take tx " << txids.front() << " from the pool");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_block_template::save_template_args(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  cryptonote::Blockchain &bc = c.get_blockchain_storage();
+  m_saved_median_weight = bc.get_current_cumulative_block_weight_limit() / 2;
+  m_saved_coins = bc.get_db().get_block_already_generated_coins(bc.get_current_blockchain_height() - 1);
+  m_saved_version = bc.get_current_hard_fork_version();
+  return check_fill_block_template(c, get_template_entries(c), m_saved_median_weight, m_saved_coins, m_saved_version, &m_saved_tx_hashes);
+}
+
+bool txpool_block_template::check_tip_change(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  // same pool and same arguments, only the tip moved: the snapshot and the readiness
+  // of the candidates must not be reused
+  std::vector<crypto::hash> tx_hashes;
+  if (!check_fill_block_template(c, get_template_entries(c), m_saved_median_weight, m_saved_coins, m_saved_version, &tx_hashes))
+    return false;
+  if (tx_hashes.size() != m_saved_tx_hashes.size() + 1)
+  {
+    MERROR("Expected the tx unlocked by the new tip in the block template, got " << tx_hashes.size() << " txes, " << m_saved_tx_hashes.size() << " before");
+    return false;
+  }
+  return true;
+}
@@ -136,3 +136,35 @@ struct txpool_stem_loop : txpool_double_spend_base
 
   bool generate(std::vector<test_event_entry>& events) const;
 };
+
+struct txpool_validate : txpool_base
+{
+  txpool_validate() : txpool_base()
+  {
+    REGISTER_CALLBACK_METHOD(txpool_validate, check_validate);
+  }
+
+  bool generate(std::vector<test_event_entry>& events) const;
+  bool check_validate(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
+
+class txpool_block_template : public txpool_base
+{
+  cryptonote::account_base m_template_account;
+  size_t m_saved_median_weight;
+  uint64_t m_saved_coins;
+  uint8_t m_saved_version;
+  std::vector<crypto::hash> m_saved_tx_hashes;
+
+public:
+  txpool_block_template();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  //! Checks the templates built from the pool against the fill used before they were cached
+  bool check_template(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool relay_hidden_txes(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool remove_pool_tx(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool save_template_args(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_tip_change(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
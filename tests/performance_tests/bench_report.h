@@ -0,0 +1,184 @@
+// Copyright (c) 2014-2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/regex.hpp>
+
+// Machine readable results, one per test, so runs can be archived and compared
+// against a stored baseline. All timings are per call, in nanoseconds.
+struct bench_result
+{
+  std::string name;
+  size_t calls;
+  uint64_t min;
+  uint64_t p50;
+  uint64_t p99;
+  double mean;
+};
+
+enum bench_output_format
+{
+  bench_output_text,
+  bench_output_json,
+  bench_output_csv,
+};
+
+inline bool parse_bench_output_format(const std::string &s, bench_output_format &format)
+{
+  if (s == "text")
+    format = bench_output_text;
+  else if (s == "json")
+    format = bench_output_json;
+  else if (s == "csv")
+    format = bench_output_csv;
+  else
+    return false;
+  return true;
+}
+
+inline std::string bench_csv_quote(const std::string &s)
+{
+  std::string quoted = "\"";
+  for (char c: s)
+  {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+inline std::string bench_json_quote(const std::string &s)
+{
+  std::string quoted = "\"";
+  for (char c: s)
+  {
+    if (c == '"' || c == '\\')
+      quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+inline void write_bench_results(std::ostream &os, const std::vector<bench_result> &results, bench_output_format format)
+{
+  if (format == bench_output_csv)
+  {
+    os << "name,calls,min_ns,p50_ns,p99_ns,mean_ns\n";
+    for (const bench_result &r: results)
+      os << bench_csv_quote(r.name) << "," << r.calls << "," << r.min << "," << r.p50 << "," << r.p99 << "," << (uint64_t)r.mean << "\n";
+  }
+  else if (format == bench_output_json)
+  {
+    // one record per line, which keeps the file diffable and lets load_bench_results stay trivial
+    os << "[\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      const bench_result &r = results[i];
+      os << "  {\"name\": " << bench_json_quote(r.name) << ", \"calls\": " << r.calls << ", \"min_ns\": " << r.min
+         << ", \"p50_ns\": " << r.p50 << ", \"p99_ns\": " << r.p99 << ", \"mean_ns\": " << (uint64_t)r.mean << "}"
+         << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "]\n";
+  }
+  else
+  {
+    for (const bench_result &r: results)
+      os << r.name << ": min " << r.min << " ns, p50 " << r.p50 << " ns, p99 " << r.p99 << " ns (" << r.calls << " calls)\n";
+  }
+}
+
+inline bool write_bench_results(const std::string &filename, const std::vector<bench_result> &results, bench_output_format format)
+{
+  std::ofstream f(filename, std::ios_base::out | std::ios_base::trunc);
+  if (!f.is_open())
+    return false;
+  write_bench_results(f, results, format);
+  return f.good();
+}
+
+// Reads back a file written by write_bench_results, in either JSON or CSV format
+inline bool load_bench_results(const std::string &filename, std::map<std::string, bench_result> &results)
+{
+  std::ifstream f(filename);
+  if (!f.is_open())
+    return false;
+
+  static const boost::regex json_line("\\s*\\{\"name\": \"((?:[^\"\\\\]|\\\\.)*)\", \"calls\": (\\d+), \"min_ns\": (\\d+), \"p50_ns\": (\\d+), \"p99_ns\": (\\d+), \"mean_ns\": (\\d+)\\},?\\s*");
+  static const boost::regex csv_line("\"((?:[^\"]|\"\")*)\",(\\d+),(\\d+),(\\d+),(\\d+),(\\d+)\\s*");
+  std::string line;
+  while (std::getline(f, line))
+  {
+    boost::smatch match;
+    bool json = boost::regex_match(line, match, json_line);
+    if (!json && !boost::regex_match(line, match, csv_line))
+      continue;
+    bench_result r;
+    r.name = match[1];
+    r.name = boost::regex_replace(r.name, boost::regex(json ? "\\\\(.)" : "\"\""), json ? "$1" : "\"");
+    r.calls = std::stoull(match[2]);
+    r.min = std::stoull(match[3]);
+    r.p50 = std::stoull(match[4]);
+    r.p99 = std::stoull(match[5]);
+    r.mean = std::stoull(match[6]);
+    results[r.name] = r;
+  }
+  return true;
+}
+
+// Compares median timings to the baseline, and reports tests which got slower by more
+// than threshold percent. Returns the number of regressions found.
+inline size_t check_bench_regressions(std::ostream &os, const std::vector<bench_result> &results, const std::map<std::string, bench_result> &baseline, double threshold)
+{
+  size_t regressions = 0;
+  for (const bench_result &r: results)
+  {
+    const auto i = baseline.find(r.name);
+    if (i == baseline.end() || i->second.p50 == 0)
+      continue;
+    const double change = 100. * ((double)r.p50 - (double)i->second.p50) / i->second.p50;
+    if (change > threshold)
+    {
+      os << "REGRESSION: " << r.name << ": median " << r.p50 << " ns, baseline " << i->second.p50 << " ns (+" << change << "%)\n";
+      ++regressions;
+    }
+  }
+  return regressions;
+}
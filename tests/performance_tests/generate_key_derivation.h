@@ -32,6 +32,7 @@
 
 #include "crypto/crypto.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "ringct/rctOps.h"
 
 #include "single_tx_test_base.h"
 
@@ -47,3 +48,31 @@ public:
     return true;
   }
 };
+
+template<size_t batch_size>
+class test_generate_key_derivations : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 1000 / batch_size + 10;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+    m_tx_pub_keys.resize(batch_size);
+    for (auto &pkey: m_tx_pub_keys)
+      pkey = rct::rct2pk(rct::pkGen());
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<crypto::key_derivation> recv_derivations;
+    std::vector<uint8_t> valid;
+    crypto::generate_key_derivations(m_tx_pub_keys, m_bob.get_keys().m_view_secret_key, recv_derivations, valid);
+    return true;
+  }
+
+private:
+  std::vector<crypto::public_key> m_tx_pub_keys;
+};
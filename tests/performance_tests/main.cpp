@@ -52,6 +52,7 @@
 #include "signature.h"
 #include "is_out_to_acc.h"
 #include "out_can_be_to_acc.h"
+#include "scan_outputs.h"
 #include "subaddress_expand.h"
 #include "sc_reduce32.h"
 #include "sc_check.h"
@@ -65,9 +66,16 @@
 #include "multiexp.h"
 #include "sig_mlsag.h"
 #include "sig_clsag.h"
+#include "tree_hash.h"
 
 namespace po = boost::program_options;
 
+// The crypto-bench suite: the primitives wallet scanning and block verification spend their time in
+static const char *crypto_bench_filter =
+  "test_generate_key_derivations?(<.*>)?|test_derive_view_tag|test_scan_outputs<.*>|"
+  "test_sig_clsag(_sign)?<.*>|test_(aggregated_)?bulletproof_plus<.*>|test_multiexp<.*>|"
+  "test_cn_fast_hash<.*>|test_tree_hash<.*>";
+
 int main(int argc, char** argv)
 {
   TRY_ENTRY();
@@ -83,11 +91,21 @@ int main(int argc, char** argv)
   const command_line::arg_descriptor<bool> arg_stats = { "stats", "Including statistics (min/median)", false };
   const command_line::arg_descriptor<unsigned> arg_loop_multiplier = { "loop-multiplier", "Run for that many times more loops", 1 };
   const command_line::arg_descriptor<std::string> arg_timings_database = { "timings-database", "Keep timings history in a file" };
+  const command_line::arg_descriptor<bool> arg_crypto_bench = { "crypto-bench", "Run the crypto primitives suite (unless a filter is given)", false };
+  const command_line::arg_descriptor<std::string> arg_output_format = { "output-format", "Results summary format: text, json or csv", "text" };
+  const command_line::arg_descriptor<std::string> arg_output_file = { "output-file", "Write the results summary to a file rather than stdout" };
+  const command_line::arg_descriptor<std::string> arg_baseline = { "baseline", "Compare results against a summary written by a previous run" };
+  const command_line::arg_descriptor<double> arg_regression_threshold = { "regression-threshold", "Median slowdown, in percent, flagged as a regression", 10.0 };
   command_line::add_arg(desc_options, arg_filter);
   command_line::add_arg(desc_options, arg_verbose);
   command_line::add_arg(desc_options, arg_stats);
   command_line::add_arg(desc_options, arg_loop_multiplier);
   command_line::add_arg(desc_options, arg_timings_database);
+  command_line::add_arg(desc_options, arg_crypto_bench);
+  command_line::add_arg(desc_options, arg_output_format);
+  command_line::add_arg(desc_options, arg_output_file);
+  command_line::add_arg(desc_options, arg_baseline);
+  command_line::add_arg(desc_options, arg_regression_threshold);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -99,13 +117,30 @@ int main(int argc, char** argv)
   if (!r)
     return 1;
 
-  const std::string filter = tools::glob_to_regex(command_line::get_arg(vm, arg_filter));
+  std::string filter = tools::glob_to_regex(command_line::get_arg(vm, arg_filter));
+  if (filter.empty() && command_line::get_arg(vm, arg_crypto_bench))
+    filter = crypto_bench_filter;
   const std::string timings_database = command_line::get_arg(vm, arg_timings_database);
+  bench_output_format output_format;
+  if (!parse_bench_output_format(command_line::get_arg(vm, arg_output_format), output_format))
+  {
+    std::cerr << "Invalid output format: " << command_line::get_arg(vm, arg_output_format) << std::endl;
+    return 1;
+  }
+  const std::string output_file = command_line::get_arg(vm, arg_output_file);
+  const std::string baseline_file = command_line::get_arg(vm, arg_baseline);
+  std::map<std::string, bench_result> baseline;
+  if (!baseline_file.empty() && !load_bench_results(baseline_file, baseline))
+  {
+    std::cerr << "Failed to load baseline from " << baseline_file << std::endl;
+    return 1;
+  }
+  const bool summary = output_format != bench_output_text || !output_file.empty() || !baseline_file.empty();
   Params p;
   if (!timings_database.empty())
     p.td = TimingsDatabase(timings_database);
   p.verbose = command_line::get_arg(vm, arg_verbose);
-  p.stats = command_line::get_arg(vm, arg_stats);
+  p.stats = command_line::get_arg(vm, arg_stats) || summary; // percentiles need per call timings
   p.loop_multiplier = command_line::get_arg(vm, arg_loop_multiplier);
 
   performance_timer timer;
@@ -199,8 +234,14 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, false, true); // no view tag, owned
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, true, false); // use view tag, not owned
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, true, true); // use view tag, owned
+  TEST_PERFORMANCE2(filter, p, test_scan_outputs, 16, false);
+  TEST_PERFORMANCE2(filter, p, test_scan_outputs, 16, true);
+  TEST_PERFORMANCE2(filter, p, test_scan_outputs, 256, false);
+  TEST_PERFORMANCE2(filter, p, test_scan_outputs, 256, true);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image_helper);
   TEST_PERFORMANCE0(filter, p, test_generate_key_derivation);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 16);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 256);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image);
   TEST_PERFORMANCE0(filter, p, test_derive_public_key);
   TEST_PERFORMANCE0(filter, p, test_derive_secret_key);
@@ -222,6 +263,10 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
 
+  TEST_PERFORMANCE1(filter, p, test_tree_hash, 4);
+  TEST_PERFORMANCE1(filter, p, test_tree_hash, 64);
+  TEST_PERFORMANCE1(filter, p, test_tree_hash, 1024);
+
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 4, 2, 2); // MLSAG verification
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 8, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 16, 2, 2);
@@ -237,6 +282,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 128, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 256, 2, 2);
 
+  TEST_PERFORMANCE1(filter, p, test_sig_clsag_sign, 16); // CLSAG signing
+  TEST_PERFORMANCE1(filter, p, test_sig_clsag_sign, 64);
+
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, false);
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, true);
 
@@ -600,6 +648,26 @@ int main(int argc, char** argv)
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
+  if (summary)
+  {
+    if (output_file.empty())
+      write_bench_results(std::cout, p.results, output_format);
+    else if (!write_bench_results(output_file, p.results, output_format))
+    {
+      std::cerr << "Failed to write results to " << output_file << std::endl;
+      return 1;
+    }
+  }
+  if (!baseline_file.empty())
+  {
+    const size_t regressions = check_bench_regressions(std::cout, p.results, baseline, command_line::get_arg(vm, arg_regression_threshold));
+    if (regressions > 0)
+    {
+      std::cout << regressions << " regression(s) against " << baseline_file << std::endl;
+      return 2;
+    }
+  }
+
   return 0;
   CATCH_ENTRY_L0("main", 1);
 }
@@ -38,6 +38,7 @@
 
 #include "misc_language.h"
 #include "stats.h"
+#include "bench_report.h"
 #include "common/perf_timer.h"
 #include "common/timings.h"
 
@@ -73,6 +74,7 @@ struct Params
   bool verbose;
   bool stats;
   unsigned loop_multiplier;
+  std::vector<bench_result> results;
 };
 
 template <typename T>
@@ -156,11 +158,22 @@ private:
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
   int m_elapsed;
-  Params m_params;
+  const Params &m_params;
   std::vector<tools::PerformanceTimer> m_per_call_timers;
   std::unique_ptr<Stats<tools::PerformanceTimer, uint64_t>> m_stats;
 };
 
+// Tests processing several items per call (outputs, inputs...) may define items_per_call and item_name()
+// to have their throughput reported alongside the time per call
+template <typename T>
+auto get_items_per_call(int) -> decltype(T::items_per_call, size_t()) { return T::items_per_call; }
+template <typename T>
+size_t get_items_per_call(long) { return 0; }
+template <typename T>
+auto get_item_name(int) -> decltype(T::item_name(), std::string()) { return T::item_name(); }
+template <typename T>
+std::string get_item_name(long) { return "items"; }
+
 template <typename T>
 void run_test(const std::string &filter, Params &params, const char* test_name)
 {
@@ -210,8 +223,16 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
 
     std::vector<TimingsDatabase::instance> prev_instances = params.td.get(test_name);
     params.td.add(test_name, {time(NULL), runner.get_size(), min, max, mean, med, stddev, npskew, quantiles});
+    if (params.stats)
+      params.results.push_back({test_name, runner.get_size(), runner.get_min(), runner.get_median(), runner.get_quantiles(100)[99], mean});
 
     std::cout << (params.verbose ? "  time per call: " : " ") << time_per_call << " " << unit << "/call" << (params.verbose ? "\n" : "");
+    const size_t items_per_call = get_items_per_call<T>(0);
+    if (items_per_call > 0 && runner.elapsed_time() > 0)
+    {
+      const uint64_t items_per_second = 1000ull * items_per_call * T::loop_count * params.loop_multiplier / runner.elapsed_time();
+      std::cout << (params.verbose ? "  throughput:    " : ", ") << items_per_second << " " << get_item_name<T>(0) << "/s" << (params.verbose ? "\n" : "");
+    }
     if (params.stats)
     {
       uint64_t mins = min / scale;
@@ -0,0 +1,125 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+
+// Scans a tx with n_outputs tagged outputs, one of which belongs to the wallet, and reports
+// throughput in outputs/s.
+// use_kernel: scan with scan_outputs_to_acc rather than is_out_to_acc_precomp on each output
+template<size_t n_outputs, bool use_kernel>
+class test_scan_outputs
+{
+  static_assert(0 < n_outputs, "n_outputs must be greater than 0");
+
+public:
+  static const size_t loop_count = n_outputs >= 64 ? 100 : 1000;
+  static const size_t items_per_call = n_outputs;
+  static const char *item_name() { return "outputs"; }
+
+  bool init()
+  {
+    m_bob.generate();
+    m_subaddresses[m_bob.get_keys().m_account_address.m_spend_public_key] = {0, 0};
+
+    const cryptonote::keypair txkey = cryptonote::keypair::generate(hw::get_device("default"));
+    m_tx_pub_key = txkey.pub;
+    crypto::key_derivation derivation;
+    if (!crypto::generate_key_derivation(m_bob.get_keys().m_account_address.m_view_public_key, txkey.sec, derivation))
+      return false;
+
+    m_owned_index = n_outputs / 2;
+    m_tx.vout.resize(n_outputs);
+    for (size_t i = 0; i < n_outputs; ++i)
+    {
+      crypto::public_key output_public_key;
+      crypto::view_tag view_tag;
+      if (i == m_owned_index)
+      {
+        if (!crypto::derive_public_key(derivation, i, m_bob.get_keys().m_account_address.m_spend_public_key, output_public_key))
+          return false;
+        crypto::derive_view_tag(derivation, i, view_tag);
+      }
+      else
+      {
+        output_public_key = cryptonote::keypair::generate(hw::get_device("default")).pub;
+        view_tag.data = crypto::rand<char>();
+      }
+      cryptonote::set_tx_out(0, output_public_key, true, view_tag, m_tx.vout[i]);
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    hw::device &hwdev = hw::get_device("default");
+    crypto::key_derivation derivation;
+    if (!hwdev.generate_key_derivation(m_tx_pub_key, m_bob.get_keys().m_view_secret_key, derivation))
+      return false;
+
+    const std::vector<crypto::key_derivation> additional_derivations;
+    std::vector<boost::optional<cryptonote::subaddress_receive_info>> received(n_outputs);
+    if (use_kernel)
+    {
+      cryptonote::output_scan_data scan_data;
+      cryptonote::get_output_scan_data(m_tx, n_outputs, scan_data);
+      cryptonote::scan_outputs_to_acc(m_subaddresses, scan_data, derivation, additional_derivations, hwdev, received);
+    }
+    else
+    {
+      for (size_t i = 0; i < n_outputs; ++i)
+      {
+        crypto::public_key output_public_key;
+        if (!cryptonote::get_output_public_key(m_tx.vout[i], output_public_key))
+          return false;
+        received[i] = cryptonote::is_out_to_acc_precomp(m_subaddresses, output_public_key, derivation, additional_derivations, i, hwdev, cryptonote::get_output_view_tag(m_tx.vout[i]));
+      }
+    }
+
+    // only the owned output may match, barring a view tag false positive which still fails the lookup
+    for (size_t i = 0; i < n_outputs; ++i)
+      if (!!received[i] != (i == m_owned_index))
+        return false;
+    return true;
+  }
+
+private:
+  cryptonote::account_base m_bob;
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+  crypto::public_key m_tx_pub_key;
+  cryptonote::transaction m_tx;
+  size_t m_owned_index;
+};
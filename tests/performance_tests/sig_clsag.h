@@ -170,3 +170,45 @@ class test_sig_clsag
         keyV messages;
         std::vector<clsag> sigs;
 };
+
+template<size_t a_N>
+class test_sig_clsag_sign
+{
+    public:
+        static const size_t loop_count = 1000;
+        static const size_t N = a_N;
+
+        bool init()
+        {
+            pubs.resize(N);
+            key temp;
+            for (size_t k = 0; k < N; k++)
+            {
+                skpkGen(temp,pubs[k].dest);
+                skpkGen(temp,pubs[k].mask);
+            }
+
+            // Real input at index 0, with a pseudo output commitment to the same amount
+            skpkGen(sk.dest,pubs[0].dest);
+            sk.mask = skGen();
+            key a = skGen();
+            addKeys2(pubs[0].mask,sk.mask,a,H);
+            s1 = skGen();
+            addKeys2(C_offset,s1,a,H);
+            message = skGen();
+            return true;
+        }
+
+        bool test()
+        {
+            const clsag sig = proveRctCLSAGSimple(message,pubs,sk,s1,C_offset,0,hw::get_device("default"));
+            return !sig.s.empty();
+        }
+
+    private:
+        ctkeyV pubs;
+        ctkey sk;
+        key s1;
+        key C_offset;
+        key message;
+};
@@ -0,0 +1,117 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "blockchain_db/blob_codec.h"
+#include "crypto/crypto.h"
+
+using cryptonote::blob_codec;
+
+namespace
+{
+  // rows of the same kind share most of their layout, as blocks and transactions do
+  std::string make_sample(size_t n)
+  {
+    std::string sample = "sample header, version 1, ";
+    sample += std::to_string(n) + " ";
+    for (size_t i = 0; i < 8; ++i)
+    {
+      sample += "field " + std::to_string(i) + ": ";
+      const crypto::hash h = crypto::rand<crypto::hash>();
+      sample.append(h.data, 4 + n % 8);
+    }
+    return sample;
+  }
+}
+
+TEST(blob_codec, dictionary_round_trip)
+{
+  if (!blob_codec::is_supported(blob_codec::zstd))
+    return;
+
+  std::vector<std::string> samples;
+  for (size_t n = 0; n < 63; ++n)
+    samples.push_back(make_sample(n));
+  ASSERT_TRUE(blob_codec::train_dictionary(samples, 16 * 1024).empty());
+  for (size_t n = 63; n < 512; ++n)
+    samples.push_back(make_sample(n));
+  const std::string dictionary = blob_codec::train_dictionary(samples, 16 * 1024);
+  ASSERT_FALSE(dictionary.empty());
+  ASSERT_LE(dictionary.size(), 16 * 1024);
+
+  blob_codec codec(dictionary, 3);
+  blob_codec plain_codec("", 3);
+  for (size_t n: {0, 100, 1000})
+  {
+    const std::string blob = make_sample(n);
+    std::string compressed, plain_compressed, decompressed;
+    ASSERT_TRUE(codec.compress(blob.data(), blob.size(), compressed));
+    ASSERT_TRUE(plain_codec.compress(blob.data(), blob.size(), plain_compressed));
+    ASSERT_LT(compressed.size(), plain_compressed.size());
+    ASSERT_TRUE(codec.decompress(compressed.data(), compressed.size(), decompressed));
+    ASSERT_EQ(blob, decompressed);
+    ASSERT_TRUE(plain_codec.decompress(plain_compressed.data(), plain_compressed.size(), decompressed));
+    ASSERT_EQ(blob, decompressed);
+
+    // a frame needs the dictionary it was written with
+    ASSERT_FALSE(plain_codec.decompress(compressed.data(), compressed.size(), decompressed));
+  }
+
+  // empty blobs round trip too
+  std::string compressed, decompressed = "x";
+  ASSERT_TRUE(codec.compress("", 0, compressed));
+  ASSERT_TRUE(codec.decompress(compressed.data(), compressed.size(), decompressed));
+  ASSERT_TRUE(decompressed.empty());
+}
+
+TEST(blob_codec, corrupt_input)
+{
+  if (!blob_codec::is_supported(blob_codec::zstd))
+    return;
+
+  blob_codec codec("", 3);
+  const std::string blob = make_sample(42) + make_sample(43);
+  std::string compressed, decompressed;
+  ASSERT_TRUE(codec.compress(blob.data(), blob.size(), compressed));
+
+  // the content checksum catches a flipped bit anywhere past the frame header
+  for (size_t i = 0; i < compressed.size(); ++i)
+  {
+    std::string corrupt = compressed;
+    corrupt[i] ^= 0x10;
+    if (codec.decompress(corrupt.data(), corrupt.size(), decompressed))
+      ASSERT_EQ(blob, decompressed) << "corrupt byte " << i;
+  }
+
+  // truncated, or not a frame at all
+  ASSERT_FALSE(codec.decompress(compressed.data(), compressed.size() - 1, decompressed));
+  ASSERT_FALSE(codec.decompress(compressed.data(), 0, decompressed));
+  ASSERT_FALSE(codec.decompress(blob.data(), blob.size(), decompressed));
+}
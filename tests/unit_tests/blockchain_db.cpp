@@ -39,6 +39,7 @@
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/lmdb/db_lmdb.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
 
 using namespace cryptonote;
 using epee::string_tools::pod_to_hex;
@@ -226,6 +227,62 @@ protected:
   {
     m_prefix = prefix;
   }
+
+  // a made up block with a coinbase and a ring signed spend, enough for the db which does
+  // not validate, so tests can have as many rows as they need
+  std::pair<block, blobdata> make_block(uint64_t height, const crypto::hash &prev_id, uint32_t nonce, std::vector<std::pair<transaction, blobdata>> &txs)
+  {
+    block b;
+    b.major_version = 1;
+    b.minor_version = 0;
+    b.timestamp = 1400000000 + height * DIFFICULTY_TARGET_V1;
+    b.prev_id = prev_id;
+    b.nonce = nonce;
+    txin_gen gen;
+    gen.height = height;
+    b.miner_tx.version = 1;
+    b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    b.miner_tx.vin.push_back(gen);
+    b.miner_tx.vout.push_back({17000000000000, txout_to_key(crypto::rand<crypto::public_key>())});
+    add_tx_pub_key_to_extra(b.miner_tx, crypto::rand<crypto::public_key>());
+
+    transaction tx;
+    tx.version = 1;
+    txin_to_key in;
+    in.amount = 1000000000000;
+    in.key_offsets = {1, 2, 3};
+    in.k_image = crypto::rand<crypto::key_image>();
+    tx.vin.push_back(in);
+    tx.vout.push_back({900000000000, txout_to_key(crypto::rand<crypto::public_key>())});
+    add_tx_pub_key_to_extra(tx, crypto::rand<crypto::public_key>());
+    tx.signatures.resize(1);
+    for (size_t i = 0; i < in.key_offsets.size(); ++i)
+    {
+      crypto::signature sig;
+      memset(&sig.c, 0x40 + i, sizeof(sig.c));
+      sig.r = crypto::rand<crypto::ec_scalar>();
+      tx.signatures[0].push_back(sig);
+    }
+    b.tx_hashes.push_back(get_transaction_hash(tx));
+    txs.clear();
+    txs.push_back(std::make_pair(tx, tx_to_blob(tx)));
+    return std::make_pair(b, block_to_blob(b));
+  }
+
+  // adds made up blocks on top of the chain, and to m_blocks and m_txs
+  void add_blocks(size_t count)
+  {
+    db_wtxn_guard guard(m_db);
+    for (size_t i = 0; i < count; ++i)
+    {
+      const uint64_t height = m_db->height();
+      std::vector<std::pair<transaction, blobdata>> txs;
+      const std::pair<block, blobdata> b = make_block(height, m_db->top_block_hash(), 0, txs);
+      m_db->add_block(b, b.second.size(), b.second.size(), height + 1, 0, txs);
+      m_blocks.push_back(b);
+      m_txs.push_back(txs);
+    }
+  }
 };
 
 using testing::Types;
@@ -341,4 +398,625 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RctOutputIndex)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // a v2 miner tx has its outputs stored as rct outputs
+  std::pair<block, blobdata> blk = this->m_blocks[0];
+  blk.first.miner_tx.version = 2;
+  blk.first.miner_tx.invalidate_hashes();
+  blk.first.invalidate_hashes();
+  blk.second = block_to_blob(blk.first);
+  const size_t n_outs = blk.first.miner_tx.vout.size();
+  ASSERT_GT(n_outs, 1);
+  std::vector<uint64_t> offsets(n_outs);
+  for (size_t i = 0; i < n_outs; ++i)
+    offsets[i] = i;
+  const uint64_t amount = 0;
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_RCT_OUTPUT_INDEX));
+  this->get_filenames();
+  this->init_hard_fork();
+  std::vector<output_data_t> outputs;
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(blk, t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+  ASSERT_EQ(n_outs, this->m_db->get_num_outputs(0));
+  ASSERT_NO_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, outputs));
+  ASSERT_EQ(n_outs, outputs.size());
+  for (size_t i = 0; i < n_outs; ++i)
+  {
+    crypto::public_key pkey;
+    ASSERT_TRUE(get_output_public_key(blk.first.miner_tx.vout[i], pkey));
+    ASSERT_EQ(pkey, outputs[i].pubkey);
+    ASSERT_TRUE(rct::zeroCommit(blk.first.miner_tx.vout[i].amount) == outputs[i].commitment);
+    ASSERT_EQ(0, outputs[i].height);
+    ASSERT_EQ(pkey, this->m_db->get_output_key(0, i).pubkey);
+  }
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // without the index, lookups fall back to output_amounts
+  std::vector<output_data_t> plain_outputs;
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_NO_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, plain_outputs));
+  ASSERT_EQ(outputs.size(), plain_outputs.size());
+  for (size_t i = 0; i < n_outs; ++i)
+    ASSERT_EQ(0, memcmp(&outputs[i], &plain_outputs[i], sizeof(output_data_t)));
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // the index is rebuilt from output_amounts, and kept in sync when popping blocks
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_RCT_OUTPUT_INDEX));
+  std::vector<output_data_t> rebuilt_outputs;
+  ASSERT_NO_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, rebuilt_outputs));
+  ASSERT_EQ(outputs.size(), rebuilt_outputs.size());
+  for (size_t i = 0; i < n_outs; ++i)
+    ASSERT_EQ(0, memcmp(&outputs[i], &rebuilt_outputs[i], sizeof(output_data_t)));
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_EQ(0, this->m_db->get_num_outputs(0));
+  ASSERT_THROW(this->m_db->get_output_key(0, 0), OUTPUT_DNE);
+  ASSERT_NO_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, outputs, true));
+  ASSERT_TRUE(outputs.empty());
+}
+
+TYPED_TEST(BlockchainDBTest, PruneInSteps)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+  const size_t n_txes = this->m_db->get_tx_count();
+  ASSERT_GT(n_txes, 2);
+  ASSERT_FALSE(this->m_db->is_pruning_in_progress());
+
+  // the first step saves the seed, along with where it stopped
+  uint64_t pruned_bytes;
+  ASSERT_FALSE(this->m_db->prune_blockchain_step(0, 1, pruned_bytes));
+  ASSERT_NE(0, this->m_db->get_blockchain_pruning_seed());
+  ASSERT_TRUE(this->m_db->is_pruning_in_progress());
+  const uint32_t pruning_seed = this->m_db->get_blockchain_pruning_seed();
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // and it carries on from there after a restart
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_TRUE(this->m_db->is_pruning_in_progress());
+  size_t steps = 1;
+  while (!this->m_db->prune_blockchain_step(0, 1, pruned_bytes))
+  {
+    ASSERT_EQ(pruning_seed, this->m_db->get_blockchain_pruning_seed());
+    ASSERT_LT(++steps, n_txes);
+  }
+  ASSERT_EQ(n_txes - 1, steps);
+  ASSERT_FALSE(this->m_db->is_pruning_in_progress());
+  ASSERT_TRUE(this->m_db->check_pruning());
+}
+
+TYPED_TEST(BlockchainDBTest, KeyImageFilter)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  std::vector<crypto::key_image> key_images;
+  for (const auto &tx: this->m_txs[0])
+    for (const auto &in: tx.first.vin)
+      key_images.push_back(boost::get<txin_to_key>(in).k_image);
+  ASSERT_FALSE(key_images.empty());
+  std::vector<crypto::key_image> unspent(64);
+  for (auto &ki: unspent)
+    ki = crypto::rand<crypto::key_image>();
+
+  key_image_filter_stats stats;
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_FALSE(this->m_db->get_key_image_filter_stats(stats));
+  ASSERT_NO_THROW(this->m_db->close());
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_KEY_IMAGE_FILTER));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+  for (const auto &ki: unspent)
+    ASSERT_FALSE(this->m_db->has_key_image(ki));
+  ASSERT_TRUE(this->m_db->get_key_image_filter_stats(stats));
+  ASSERT_EQ(key_images.size(), stats.entries);
+  ASSERT_GT(stats.memory_size, 0);
+  ASSERT_EQ(key_images.size() + unspent.size(), stats.lookups);
+  ASSERT_EQ(unspent.size(), stats.negatives + stats.false_positives);
+  ASSERT_GT(stats.negatives, unspent.size() / 2);
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_TRUE(boost::filesystem::exists(tempPath / "key_images.filter"));
+
+  // the saved filter matches the db, and popped key images are ruled out by the db
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_KEY_IMAGE_FILTER));
+  ASSERT_TRUE(this->m_db->get_key_image_filter_stats(stats));
+  ASSERT_EQ(key_images.size(), stats.entries);
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  for (const auto &ki: key_images)
+    ASSERT_FALSE(this->m_db->has_key_image(ki));
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // a filter saved for another chain state is rebuilt from the db
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_KEY_IMAGE_FILTER));
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+  ASSERT_TRUE(this->m_db->get_key_image_filter_stats(stats));
+  ASSERT_EQ(key_images.size(), stats.entries);
+  ASSERT_EQ(key_images.size(), stats.lookups);
+}
+
+TYPED_TEST(BlockchainDBTest, CompressedTables)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  auto check_blobs = [this]()
+  {
+    const size_t count = this->m_blocks.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+      ASSERT_EQ(this->m_blocks[i].second, this->m_db->get_block_blob_from_height(i));
+      for (const auto &tx: this->m_txs[i])
+      {
+        blobdata bd;
+        ASSERT_TRUE(this->m_db->get_tx_blob(get_transaction_hash(tx.first), bd));
+        ASSERT_EQ(tx.second, bd);
+      }
+    }
+    std::vector<std::pair<std::pair<blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, blobdata>>>> blocks;
+    ASSERT_TRUE(this->m_db->get_blocks_from(0, count, count, 1000, 1 << 20, blocks, false, true, false));
+    ASSERT_EQ(count, blocks.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+      ASSERT_EQ(this->m_blocks[i].second, blocks[i].first.first);
+      ASSERT_EQ(this->m_txs[i].size(), blocks[i].second.size());
+      for (size_t j = 0; j < blocks[i].second.size(); ++j)
+        ASSERT_EQ(this->m_txs[i][j].second, blocks[i].second[j].second);
+    }
+  };
+
+  // the views only need a scratch buffer when a row is stored compressed
+  auto is_compressed = [this](uint64_t height)
+  {
+    db_rtxn_guard rtxn_guard(this->m_db);
+    blobdata block_scratch, tx_scratch;
+    blobdata_ref blob;
+    this->m_db->get_block_blob_view_from_height(height, block_scratch);
+    this->m_db->get_prunable_tx_blob_view(get_transaction_hash(this->m_txs[height].front().first), blob, tx_scratch);
+    return !block_scratch.empty() && !tx_scratch.empty();
+  };
+
+  if (!blob_codec::is_supported(blob_codec::zstd))
+    return;
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    for (size_t i = 0; i < 2; ++i)
+      ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[i], t_sizes[i], t_sizes[i], t_diffs[i], t_coins[i], this->m_txs[i]));
+  }
+  // a table is only compressed once there are enough rows to train a dictionary on
+  ASSERT_NO_THROW(this->add_blocks(100));
+  ASSERT_FALSE(is_compressed(2));
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // existing rows are converted, new ones written with the table's codec
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_COMPRESS));
+  ASSERT_TRUE(is_compressed(0));
+  ASSERT_TRUE(is_compressed(2));
+  ASSERT_NO_THROW(this->add_blocks(1));
+  ASSERT_TRUE(is_compressed(this->m_blocks.size() - 1));
+  check_blobs();
+
+  // a row rewritten under the same key reads back as the new one
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  const crypto::hash popped_txid = get_transaction_hash(this->m_txs.back().front().first);
+  this->m_blocks.back() = this->make_block(this->m_blocks.size() - 1, this->m_db->top_block_hash(), 1, this->m_txs.back());
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks.back(), 1000, 1000, this->m_blocks.size(), 0, this->m_txs.back()));
+  }
+  ASSERT_FALSE(this->m_db->tx_exists(popped_txid));
+  check_blobs();
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // the tables stay readable, and compressed, without the flag
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_TRUE(is_compressed(2));
+  check_blobs();
+}
+
+TYPED_TEST(BlockchainDBTest, ResizeAhead)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  db_resize_stats stats;
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  const uint64_t map_size = stats.map_size;
+
+  // a new db has less than the minimum headroom free
+  ASSERT_TRUE(this->m_db->resize_ahead());
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  ASSERT_GT(stats.map_size, map_size);
+  ASSERT_EQ(1, stats.resizes_ahead);
+  ASSERT_LE(stats.resizes_ahead, stats.resizes);
+
+  // and then enough
+  ASSERT_FALSE(this->m_db->resize_ahead());
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_THROW(this->m_db->resize_ahead(), DB_ERROR);
+  }
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  ASSERT_EQ(1, stats.resizes_ahead);
+}
+
+TYPED_TEST(BlockchainDBTest, BlobViews)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // views of rows stored compressed point into the scratch buffer they are decompressed to
+  auto check_views = [this](bool compressed)
+  {
+    db_rtxn_guard rtxn_guard(this->m_db);
+    for (size_t i = 0; i < this->m_blocks.size(); ++i)
+    {
+      blobdata scratch;
+      const blobdata_ref blob = this->m_db->get_block_blob_view_from_height(i, scratch);
+      ASSERT_EQ(this->m_blocks[i].second, std::string(blob.data(), blob.size()));
+      ASSERT_EQ(compressed, !scratch.empty());
+      for (const auto &tx: this->m_txs[i])
+      {
+        const crypto::hash txid = get_transaction_hash(tx.first);
+        blobdata_ref pruned, prunable;
+        blobdata tx_scratch;
+        ASSERT_TRUE(this->m_db->get_pruned_tx_blob_view(txid, pruned));
+        ASSERT_TRUE(this->m_db->get_prunable_tx_blob_view(txid, prunable, tx_scratch));
+        ASSERT_EQ(tx.second, std::string(pruned.data(), pruned.size()) + std::string(prunable.data(), prunable.size()));
+        ASSERT_EQ(compressed, !tx_scratch.empty());
+        if (compressed)
+          ASSERT_EQ(tx_scratch.data(), prunable.data());
+      }
+    }
+    blobdata_ref blob;
+    ASSERT_FALSE(this->m_db->get_pruned_tx_blob_view(crypto::null_hash, blob));
+  };
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+  // enough rows for the tables to be compressed below
+  ASSERT_NO_THROW(this->add_blocks(100));
+  check_views(false);
+
+  // a view would not outlive a txn started just for the lookup
+  blobdata scratch;
+  ASSERT_THROW(this->m_db->get_block_blob_view_from_height(0, scratch), DB_ERROR);
+  ASSERT_NO_THROW(this->m_db->close());
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_COMPRESS));
+  check_views(blob_codec::is_supported(blob_codec::zstd));
+}
+
+TYPED_TEST(BlockchainDBTest, ParallelIterators)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    for (size_t i = 0; i < 2; ++i)
+      ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[i], t_sizes[i], t_sizes[i], t_diffs[i], t_coins[i], this->m_txs[i]));
+  }
+
+  std::vector<crypto::hash> blocks, txes;
+  std::vector<std::pair<uint64_t, uint64_t>> outputs;
+  ASSERT_TRUE(this->m_db->for_blocks_range(0, 1, [&](uint64_t height, const crypto::hash &hash, const block &b) { blocks.push_back(hash); return true; }));
+  ASSERT_TRUE(this->m_db->for_all_transactions([&](const crypto::hash &hash, const transaction &tx) { txes.push_back(hash); return true; }, false));
+  ASSERT_TRUE(this->m_db->for_all_outputs([&](uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx) { outputs.push_back({amount, height}); return true; }));
+  ASSERT_EQ(2, blocks.size());
+  ASSERT_FALSE(txes.empty());
+  ASSERT_FALSE(outputs.empty());
+
+  // concatenating the shards in order gives the sequential order back
+  for (size_t shards: {1, 3, 8})
+  {
+    std::vector<std::vector<crypto::hash>> shard_blocks(shards), shard_txes(shards);
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> shard_outputs(shards);
+    ASSERT_TRUE(this->m_db->for_blocks_range_parallel(0, 1, [&](size_t shard, uint64_t height, const crypto::hash &hash, const block &b) { shard_blocks[shard].push_back(hash); return true; }, shards));
+    ASSERT_TRUE(this->m_db->for_all_transactions_parallel([&](size_t shard, const crypto::hash &hash, const transaction &tx) { shard_txes[shard].push_back(hash); return true; }, false, shards));
+    ASSERT_TRUE(this->m_db->for_all_outputs_parallel([&](size_t shard, uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx) { shard_outputs[shard].push_back({amount, height}); return true; }, shards));
+
+    std::vector<crypto::hash> merged_blocks, merged_txes;
+    std::vector<std::pair<uint64_t, uint64_t>> merged_outputs;
+    for (size_t shard = 0; shard < shards; ++shard)
+    {
+      merged_blocks.insert(merged_blocks.end(), shard_blocks[shard].begin(), shard_blocks[shard].end());
+      merged_txes.insert(merged_txes.end(), shard_txes[shard].begin(), shard_txes[shard].end());
+      merged_outputs.insert(merged_outputs.end(), shard_outputs[shard].begin(), shard_outputs[shard].end());
+    }
+    ASSERT_EQ(blocks, merged_blocks);
+    ASSERT_EQ(txes, merged_txes);
+    ASSERT_EQ(outputs, merged_outputs);
+  }
+
+  // a shard returning false stops them all
+  std::atomic<size_t> calls(0);
+  ASSERT_FALSE(this->m_db->for_all_outputs_parallel([&](size_t shard, uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx) { ++calls; return false; }, 1));
+  ASSERT_EQ(1, calls);
+}
+
+TYPED_TEST(BlockchainDBTest, Compact)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+
+  // changes made after the copy are caught up with before the swap
+  ASSERT_TRUE(this->m_db->compact_copy());
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+    alt_block_data_t data = {};
+    data.height = 1;
+    this->m_db->add_alt_block(get_block_hash(this->m_blocks[1].first), data, blobdata_ref(this->m_blocks[1].second));
+  }
+  ASSERT_NO_THROW(this->m_db->compact_finish());
+  ASSERT_FALSE(boost::filesystem::exists(dirPath + ".compact"));
+
+  ASSERT_EQ(2, this->m_db->height());
+  ASSERT_EQ(get_block_hash(this->m_blocks[1].first), this->m_db->top_block_hash());
+  for (size_t i = 0; i < 2; ++i)
+  {
+    ASSERT_EQ(this->m_blocks[i].second, this->m_db->get_block_blob_from_height(i));
+    for (const auto &tx: this->m_txs[i])
+    {
+      blobdata bd;
+      ASSERT_TRUE(this->m_db->get_tx_blob(get_transaction_hash(tx.first), bd));
+      ASSERT_EQ(tx.second, bd);
+    }
+  }
+  ASSERT_EQ(1, this->m_db->get_alt_block_count());
+
+  // blocks popped after the copy are popped from it too
+  ASSERT_TRUE(this->m_db->compact_copy());
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  this->m_db->drop_alt_blocks();
+  ASSERT_NO_THROW(this->m_db->compact_finish());
+  ASSERT_EQ(1, this->m_db->height());
+  ASSERT_EQ(get_block_hash(this->m_blocks[0].first), this->m_db->top_block_hash());
+  ASSERT_FALSE(this->m_db->tx_exists(get_transaction_hash(this->m_blocks[1].first.miner_tx)));
+  ASSERT_EQ(0, this->m_db->get_alt_block_count());
+}
+
+TYPED_TEST(BlockchainDBTest, CompactWhileResizingAhead)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+
+  // a new db has less than the minimum headroom free
+  ASSERT_TRUE(this->m_db->resize_ahead());
+  db_resize_stats stats;
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  const uint64_t resizes_ahead = stats.resizes_ahead;
+
+  // resize_ahead is called with the blockchain locks held, it must neither
+  // wait on the copy nor hold it off
+  std::atomic<bool> copied(false);
+  bool copy_ok = false;
+  std::thread copier([&]() {
+    try { copy_ok = this->m_db->compact_copy(); }
+    catch (...) {}
+    copied = true;
+  });
+  while (!copied)
+    ASSERT_NO_THROW(this->m_db->resize_ahead());
+  copier.join();
+  ASSERT_TRUE(copy_ok);
+
+  // and it leaves the db alone till the copy is swapped in
+  ASSERT_FALSE(this->m_db->resize_ahead());
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  ASSERT_EQ(resizes_ahead, stats.resizes_ahead);
+
+  ASSERT_NO_THROW(this->m_db->compact_finish());
+  ASSERT_EQ(1, this->m_db->height());
+  ASSERT_EQ(get_block_hash(this->m_blocks[0].first), this->m_db->top_block_hash());
+  ASSERT_NO_THROW(this->m_db->resize_ahead());
+}
+
+TYPED_TEST(BlockchainDBTest, CompactAbortedByResize)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    for (size_t i = 0; i < 2; ++i)
+      ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[i], t_sizes[i], t_sizes[i], t_diffs[i], t_coins[i], this->m_txs[i]));
+  }
+  ASSERT_NO_THROW(this->add_blocks(2000));
+
+  // a resize needed while the copy is written aborts it rather than wait for it,
+  // unless the copy was done first
+  std::atomic<bool> copied(false);
+  bool copy_ok = false, copy_threw = false;
+  std::thread copier([&]() {
+    try { copy_ok = this->m_db->compact_copy(); }
+    catch (...) { copy_threw = true; }
+    copied = true;
+  });
+  while (!copied && !boost::filesystem::exists(boost::filesystem::path(dirPath + ".compact") / CRYPTONOTE_BLOCKCHAINDATA_FILENAME))
+    std::this_thread::yield();
+  db_resize_stats stats;
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  const uint64_t resizes = stats.resizes;
+  this->m_db->set_batch_transactions(true);
+  ASSERT_TRUE(this->m_db->batch_start(1, stats.map_size / 4));
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+  copier.join();
+  ASSERT_FALSE(copy_threw);
+  ASSERT_TRUE(this->m_db->get_resize_stats(stats));
+  ASSERT_EQ(resizes + 1, stats.resizes);
+
+  if (!copy_ok)
+  {
+    ASSERT_FALSE(boost::filesystem::exists(dirPath + ".compact"));
+    ASSERT_THROW(this->m_db->compact_finish(), DB_ERROR);
+    ASSERT_TRUE(this->m_db->compact_copy());
+  }
+  ASSERT_NO_THROW(this->m_db->compact_finish());
+  ASSERT_EQ(this->m_blocks.size(), this->m_db->height());
+  ASSERT_EQ(get_block_hash(this->m_blocks.back().first), this->m_db->top_block_hash());
+}
+
+TYPED_TEST(BlockchainDBTest, TxpoolInMemory)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_TXPOOL_IN_MEMORY));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  const crypto::hash txid0 = get_transaction_hash(this->m_txs[0][0].first);
+  const crypto::hash txid1 = get_transaction_hash(this->m_blocks[1].first.miner_tx);
+  const blobdata blob1 = tx_to_blob(this->m_blocks[1].first.miner_tx);
+  txpool_tx_meta_t meta = {};
+  meta.weight = this->m_txs[0][0].second.size();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_txpool_tx(txid0, blobdata_ref(this->m_txs[0][0].second), meta));
+    ASSERT_THROW(this->m_db->add_txpool_tx(txid0, blobdata_ref(this->m_txs[0][0].second), meta), DB_ERROR);
+  }
+  ASSERT_EQ(1, this->m_db->get_txpool_tx_count(relay_category::all));
+  ASSERT_TRUE(this->m_db->txpool_has_tx(txid0, relay_category::all));
+  ASSERT_EQ(this->m_txs[0][0].second, this->m_db->get_txpool_tx_blob(txid0, relay_category::all));
+
+  // only the in-memory pool changes until it is stored
+  ASSERT_TRUE(this->m_db->store_txpool());
+  ASSERT_FALSE(this->m_db->store_txpool());
+  meta.relayed = 1;
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->update_txpool_tx(txid0, meta));
+    ASSERT_NO_THROW(this->m_db->add_txpool_tx(txid1, blobdata_ref(blob1), meta));
+  }
+  txpool_tx_meta_t meta_out;
+  ASSERT_TRUE(this->m_db->get_txpool_tx_meta(txid0, meta_out));
+  ASSERT_EQ(1, meta_out.relayed);
+
+  // and is stored on close
+  this->m_db->close();
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_EQ(2, this->m_db->get_txpool_tx_count(relay_category::all));
+  ASSERT_TRUE(this->m_db->get_txpool_tx_meta(txid0, meta_out));
+  ASSERT_EQ(1, meta_out.relayed);
+  ASSERT_FALSE(this->m_db->store_txpool());
+  this->m_db->close();
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_TXPOOL_IN_MEMORY));
+  ASSERT_EQ(2, this->m_db->get_txpool_tx_count(relay_category::all));
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->remove_txpool_tx(txid0));
+  }
+  size_t n = 0;
+  ASSERT_TRUE(this->m_db->for_all_txpool_txes([&](const crypto::hash &txid, const txpool_tx_meta_t&, const cryptonote::blobdata_ref *bd) {
+    ++n;
+    return txid == txid1 && *bd == blob1;
+  }, true, relay_category::all));
+  ASSERT_EQ(1, n);
+  this->m_db->close();
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_EQ(1, this->m_db->get_txpool_tx_count(relay_category::all));
+  ASSERT_FALSE(this->m_db->txpool_has_tx(txid0, relay_category::all));
+}
+
 }  // anonymous namespace
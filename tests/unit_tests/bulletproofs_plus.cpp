@@ -30,6 +30,8 @@
 
 #include "gtest/gtest.h"
 
+#include <boost/filesystem.hpp>
+
 #include "string_tools.h"
 #include "ringct/rctOps.h"
 #include "ringct/rctSigs.h"
@@ -38,6 +40,7 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "device/device.hpp"
 #include "misc_log_ex.h"
+#include "file_io_utils.h"
 
 TEST(bulletproofs_plus, valid_zero)
 {
@@ -167,3 +170,74 @@ TEST(bulletproofs_plus, invalid_torsion)
     proof.B = org_B;
   }
 }
+
+namespace rct
+{
+  // defined in bulletproofs_plus.cc, for tests only
+  bool bulletproof_plus_reload_generator_table_for_tests(const std::string &filename);
+}
+
+TEST(bulletproofs_plus, generator_table)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  const std::string filename = path.string();
+  ASSERT_FALSE(rct::bulletproof_plus_check_generator_table(filename));
+  ASSERT_TRUE(rct::bulletproof_plus_write_generator_table(filename));
+  ASSERT_TRUE(rct::bulletproof_plus_check_generator_table(filename));
+
+  std::string data;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(filename, data));
+
+  // flip a bit in the caches
+  std::string corrupt = data;
+  corrupt[corrupt.size() - 100] ^= 1;
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(filename, corrupt));
+  ASSERT_FALSE(rct::bulletproof_plus_check_generator_table(filename));
+
+  // truncated
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(filename, data.substr(0, data.size() - 1)));
+  ASSERT_FALSE(rct::bulletproof_plus_check_generator_table(filename));
+
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(filename, data));
+  ASSERT_TRUE(rct::bulletproof_plus_check_generator_table(filename));
+
+  // the generators are already set up by now
+  ASSERT_FALSE(rct::bulletproof_plus_use_generator_table(filename));
+  boost::filesystem::remove(path);
+}
+
+TEST(bulletproofs_plus, generator_table_round_trip)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  const boost::filesystem::path rewritten_path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(rct::bulletproof_plus_write_generator_table(path.string()));
+
+  // proofs built with the computed generators
+  std::vector<rct::BulletproofPlus> proofs;
+  proofs.push_back(bulletproof_plus_PROVE(crypto::rand<uint64_t>(), rct::skGen()));
+  proofs.push_back(bulletproof_plus_PROVE(std::vector<uint64_t>{crypto::rand<uint64_t>(), crypto::rand<uint64_t>(), 0}, rct::keyV{rct::skGen(), rct::skGen(), rct::skGen()}));
+
+  ASSERT_FALSE(rct::bulletproof_plus_use_generator_table(path.string()));
+  ASSERT_TRUE(rct::bulletproof_plus_reload_generator_table_for_tests(path.string()));
+
+  // the mapped generators and caches are the ones they were written from
+  ASSERT_TRUE(rct::bulletproof_plus_write_generator_table(rewritten_path.string()));
+  std::string data, rewritten_data;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(path.string(), data));
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(rewritten_path.string(), rewritten_data));
+  ASSERT_TRUE(data == rewritten_data);
+
+  // and proofs verify the same either way
+  for (const rct::BulletproofPlus &proof: proofs)
+    ASSERT_TRUE(rct::bulletproof_plus_VERIFY(proof));
+  proofs.push_back(bulletproof_plus_PROVE(std::vector<uint64_t>{crypto::rand<uint64_t>(), crypto::rand<uint64_t>()}, rct::keyV{rct::skGen(), rct::skGen()}));
+  ASSERT_TRUE(rct::bulletproof_plus_VERIFY(proofs));
+
+  rct::BulletproofPlus bad_proof = proofs.back();
+  bad_proof.r1 = rct::skGen();
+  ASSERT_FALSE(rct::bulletproof_plus_VERIFY(bad_proof));
+
+  boost::system::error_code ec;
+  boost::filesystem::remove(path, ec);
+  boost::filesystem::remove(rewritten_path, ec);
+}
@@ -33,7 +33,9 @@
 #include <string>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/merge_mining.h"
+#include "ringct/rctOps.h"
 
 namespace
 {
@@ -51,6 +53,49 @@ namespace
   template<typename T> void *addressof(T &t) { return &t; }
   template<> void *addressof(crypto::secret_key &k) { return addressof(unwrap(unwrap(k))); }
 
+  bool ref10_scalarmult(rct::key &r, const rct::key &a, const rct::key &P, bool mul8)
+  {
+    ge_p3 A;
+    ge_p2 R;
+    ge_p1p1 t;
+    if (ge_frombytes_vartime(&A, P.bytes) != 0)
+      return false;
+    ge_scalarmult(&R, a.bytes, &A);
+    if (mul8)
+    {
+      ge_mul8(&t, &R);
+      ge_p1p1_to_p2(&R, &t);
+    }
+    ge_tobytes(r.bytes, &R);
+    return true;
+  }
+
+  bool ref10_double_scalarmult_base_vartime(rct::key &r, const rct::key &a, const rct::key &P, const rct::key &b)
+  {
+    ge_p3 A;
+    ge_p2 R;
+    if (ge_frombytes_vartime(&A, P.bytes) != 0)
+      return false;
+    ge_double_scalarmult_base_vartime(&R, a.bytes, &A, b.bytes);
+    ge_tobytes(r.bytes, &R);
+    return true;
+  }
+
+  rct::key random_bytes()
+  {
+    rct::key k;
+    crypto::generate_random_bytes_thread_safe(sizeof(k.bytes), k.bytes);
+    return k;
+  }
+
+  crypto::key_derivation random_derivation()
+  {
+    crypto::key_derivation d;
+    const rct::key k = rct::pkGen();
+    memcpy(&d, k.bytes, sizeof(d));
+    return d;
+  }
+
   template<typename T>
   bool is_formatted()
   {
@@ -312,3 +357,146 @@ TEST(Crypto, tree_branch)
     }
   }
 }
+
+TEST(Crypto, generate_key_derivations)
+{
+  const crypto::secret_key view_sec = rct::rct2sk(rct::skGen());
+  std::vector<crypto::public_key> pubs;
+  for (int n = 0; n < 40; ++n)
+    pubs.push_back(rct::rct2pk(n % 7 == 3 ? random_bytes() : rct::pkGen()));
+  pubs.push_back(rct::rct2pk(rct::identity()));
+
+  std::vector<crypto::key_derivation> derivations;
+  std::vector<uint8_t> valid;
+  crypto::generate_key_derivations(pubs, view_sec, derivations, valid);
+  ASSERT_EQ(pubs.size(), derivations.size());
+  ASSERT_EQ(pubs.size(), valid.size());
+  for (size_t i = 0; i < pubs.size(); ++i)
+  {
+    crypto::key_derivation expected;
+    const bool ok = crypto::generate_key_derivation(pubs[i], view_sec, expected);
+    ASSERT_EQ(ok, !!valid[i]);
+    if (ok)
+      ASSERT_EQ(0, memcmp(&expected, &derivations[i], sizeof(expected)));
+  }
+
+  crypto::generate_key_derivations({}, view_sec, derivations, valid);
+  ASSERT_TRUE(derivations.empty());
+}
+
+TEST(Crypto, derive_view_tags)
+{
+  const crypto::key_derivation derivation = random_derivation();
+  for (size_t first: {0, 1, 127, 128, 16383, 16384})
+  {
+    std::vector<crypto::view_tag> view_tags(300);
+    crypto::derive_view_tags(derivation, first, view_tags.size(), view_tags.data());
+    for (size_t i = 0; i < view_tags.size(); ++i)
+    {
+      crypto::view_tag expected;
+      crypto::derive_view_tag(derivation, first + i, expected);
+      ASSERT_TRUE(expected == view_tags[i]);
+    }
+  }
+}
+
+TEST(Crypto, scan_outputs_to_acc)
+{
+  hw::device &hwdev = hw::get_device("default");
+  cryptonote::account_base acc;
+  acc.generate();
+  const cryptonote::account_public_address &addr = acc.get_keys().m_account_address;
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+  subaddresses[addr.m_spend_public_key] = {0, 0};
+
+  for (const bool use_view_tags: {false, true})
+  {
+    for (const bool use_additional: {false, true})
+    {
+      const size_t n_outs = 40;
+      const crypto::key_derivation derivation = random_derivation();
+      std::vector<crypto::key_derivation> additional_derivations;
+      if (use_additional)
+        for (size_t i = 0; i < n_outs - 1; ++i) // one short, as a malformed tx could be
+          additional_derivations.push_back(random_derivation());
+
+      cryptonote::transaction tx;
+      tx.vout.resize(n_outs);
+      for (size_t i = 0; i < n_outs; ++i)
+      {
+        const crypto::key_derivation &d = use_additional && i % 3 == 1 ? additional_derivations[i] : derivation;
+        crypto::public_key pk = rct::rct2pk(rct::pkGen());
+        crypto::view_tag view_tag;
+        crypto::derive_view_tag(d, i, view_tag);
+        if (i % 3 != 2)
+          ASSERT_TRUE(crypto::derive_public_key(d, i, addr.m_spend_public_key, pk));
+        if (i % 5 == 4)
+          view_tag.data ^= 1;
+        cryptonote::set_tx_out(0, pk, use_view_tags, view_tag, tx.vout[i]);
+      }
+
+      cryptonote::output_scan_data scan_data;
+      cryptonote::get_output_scan_data(tx, n_outs, scan_data);
+      ASSERT_EQ(use_view_tags, scan_data.all_view_tags);
+      std::vector<boost::optional<cryptonote::subaddress_receive_info>> received(n_outs);
+      cryptonote::scan_outputs_to_acc(subaddresses, scan_data, derivation, additional_derivations, hwdev, received);
+      size_t n_received = 0;
+      for (size_t i = 0; i < n_outs; ++i)
+      {
+        crypto::public_key pk;
+        ASSERT_TRUE(cryptonote::get_output_public_key(tx.vout[i], pk));
+        const auto expected = cryptonote::is_out_to_acc_precomp(subaddresses, pk, derivation, additional_derivations, i, hwdev, cryptonote::get_output_view_tag(tx.vout[i]));
+        ASSERT_EQ(!!expected, !!received[i]);
+        if (expected)
+        {
+          ++n_received;
+          ASSERT_EQ(0, memcmp(&expected->derivation, &received[i]->derivation, sizeof(crypto::key_derivation)));
+        }
+      }
+      ASSERT_GT(n_received, 0);
+    }
+  }
+}
+
+TEST(Crypto, tobytes_backend)
+{
+  std::vector<rct::key> points{rct::identity(), rct::G, rct::H};
+  std::vector<rct::key> scalars{rct::zero(), rct::identity(), rct::curveOrder()};
+  rct::key bad_identity = rct::zero(); // x = 0 with the sign bit set
+  bad_identity.bytes[0] = 1;
+  bad_identity.bytes[31] = 0x80;
+  points.push_back(bad_identity);
+  rct::key ff;
+  memset(ff.bytes, 0xff, sizeof(ff.bytes));
+  points.push_back(ff);
+  scalars.push_back(ff);
+  for (int n = 0; n < 64; ++n)
+  {
+    points.push_back(rct::pkGen());
+    points.push_back(random_bytes());
+    scalars.push_back(rct::skGen());
+    scalars.push_back(random_bytes());
+  }
+
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    for (size_t j = 0; j < scalars.size(); j += 1 + i % 5)
+    {
+      const rct::key &P = points[i];
+      const rct::key &a = scalars[j];
+      const rct::key &b = scalars[(i + j) % scalars.size()];
+      rct::key expected, actual;
+      for (int mul8 = 0; mul8 < 2; ++mul8)
+      {
+        const bool ok = ref10_scalarmult(expected, a, P, mul8);
+        ASSERT_EQ(ok, ge_scalarmult_tobytes(actual.bytes, a.bytes, P.bytes, mul8) == 0);
+        if (ok)
+          ASSERT_EQ(expected, actual);
+      }
+      const bool ok = ref10_double_scalarmult_base_vartime(expected, a, P, b);
+      ASSERT_EQ(ok, ge_double_scalarmult_base_vartime_tobytes(actual.bytes, a.bytes, P.bytes, b.bytes) == 0);
+      if (ok)
+        ASSERT_EQ(expected, actual);
+    }
+  }
+}
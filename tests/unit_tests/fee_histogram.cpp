@@ -0,0 +1,98 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <limits>
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/fee_histogram.h"
+
+TEST(fee_histogram, bins)
+{
+  ASSERT_EQ(0, cryptonote::fee_histogram::get_bin_index(0, 1000));
+  ASSERT_EQ(0, cryptonote::fee_histogram::get_bin_index(999, 1000));
+  ASSERT_EQ(0, cryptonote::fee_histogram::get_bin_index(1000, 0));
+  ASSERT_EQ(1, cryptonote::fee_histogram::get_bin_index(1000, 1000));
+  ASSERT_EQ(1 + cryptonote::fee_histogram::FEE_HISTOGRAM_BINS_PER_DOUBLING, cryptonote::fee_histogram::get_bin_index(2000, 1000));
+  ASSERT_EQ(cryptonote::fee_histogram::FEE_HISTOGRAM_BINS - 1, cryptonote::fee_histogram::get_bin_index(std::numeric_limits<uint64_t>::max(), 1));
+
+  for (size_t i = 1; i < cryptonote::fee_histogram::FEE_HISTOGRAM_BINS; ++i)
+  {
+    const uint64_t fee_per_byte = cryptonote::fee_histogram::get_bin_min_fee_per_byte(i);
+    ASSERT_LE(cryptonote::fee_histogram::get_bin_min_fee_per_byte(i - 1), fee_per_byte);
+    ASSERT_GE(cryptonote::fee_histogram::get_bin_index(fee_per_byte * 1000, 1000), i);
+  }
+}
+
+TEST(fee_histogram, add_remove)
+{
+  cryptonote::fee_histogram histogram;
+  histogram.add(20000 * 1500, 1500);
+  histogram.add(20000 * 2000, 2000);
+  histogram.add(80000 * 3000, 3000);
+  ASSERT_EQ(3, histogram.count());
+  ASSERT_EQ(6500, histogram.weight());
+
+  const auto &low = histogram.bins()[cryptonote::fee_histogram::get_bin_index(20000, 1)];
+  ASSERT_EQ(2, low.count);
+  ASSERT_EQ(3500, low.weight);
+  ASSERT_EQ(20000 * 3500, low.fee);
+
+  histogram.remove(20000 * 2000, 2000);
+  ASSERT_EQ(2, histogram.count());
+  ASSERT_EQ(4500, histogram.weight());
+  ASSERT_EQ(1, low.count);
+
+  // removing something that was never added does not underflow
+  histogram.remove(1000 * 100, 100);
+  ASSERT_EQ(2, histogram.count());
+
+  histogram.clear();
+  ASSERT_EQ(0, histogram.count());
+  ASSERT_EQ(0, histogram.weight());
+}
+
+TEST(fee_histogram, weight_ahead)
+{
+  cryptonote::fee_histogram histogram;
+  ASSERT_EQ(0, histogram.get_fee_per_byte_for_weight_ahead(0));
+
+  histogram.add(20000ull * 100000, 100000);
+  histogram.add(80000ull * 100000, 100000);
+  ASSERT_EQ(0, histogram.get_fee_per_byte_for_weight_ahead(200000));
+
+  // room for one of them: must beat the cheaper one
+  const uint64_t one = histogram.get_fee_per_byte_for_weight_ahead(150000);
+  ASSERT_GT(one, 20000);
+  ASSERT_LE(one, 80000);
+
+  // room for neither: must beat the dearer one
+  const uint64_t none = histogram.get_fee_per_byte_for_weight_ahead(50000);
+  ASSERT_GT(none, 80000);
+}
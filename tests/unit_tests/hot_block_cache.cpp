@@ -0,0 +1,103 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/hot_block_cache.h"
+
+namespace
+{
+  cryptonote::hot_block_cache::entry_ptr make_entry(size_t size)
+  {
+    std::shared_ptr<cryptonote::hot_block_cache::entry> e = std::make_shared<cryptonote::hot_block_cache::entry>();
+    e->block.assign(size, 'b');
+    e->miner_tx_hash = crypto::null_hash;
+    e->size = size;
+    return e;
+  }
+}
+
+TEST(hot_block_cache, get_put)
+{
+  cryptonote::hot_block_cache cache(1000);
+  ASSERT_EQ(nullptr, cache.get(10, true));
+  cache.put(10, true, make_entry(100));
+  ASSERT_NE(nullptr, cache.get(10, true));
+  ASSERT_EQ(nullptr, cache.get(10, false));
+  ASSERT_EQ(1, cache.get_hits());
+  ASSERT_EQ(2, cache.get_misses());
+}
+
+TEST(hot_block_cache, budget)
+{
+  cryptonote::hot_block_cache cache(300);
+  cache.put(1, true, make_entry(100));
+  cache.put(2, true, make_entry(100));
+  cache.put(3, true, make_entry(100));
+  ASSERT_NE(nullptr, cache.get(1, true));
+  cache.put(4, true, make_entry(100));
+  ASSERT_NE(nullptr, cache.get(1, true));
+  ASSERT_EQ(nullptr, cache.get(2, true));
+  ASSERT_NE(nullptr, cache.get(3, true));
+  ASSERT_NE(nullptr, cache.get(4, true));
+
+  cache.put(5, true, make_entry(301));
+  ASSERT_EQ(nullptr, cache.get(5, true));
+
+  cache.set_max_size(100);
+  ASSERT_NE(nullptr, cache.get(4, true));
+  ASSERT_EQ(nullptr, cache.get(3, true));
+  ASSERT_EQ(nullptr, cache.get(1, true));
+
+  cache.set_max_size(0);
+  ASSERT_EQ(nullptr, cache.get(4, true));
+}
+
+TEST(hot_block_cache, invalidate)
+{
+  cryptonote::hot_block_cache cache(1000);
+  for (uint64_t h = 0; h < 5; ++h)
+  {
+    cache.put(h, true, make_entry(10));
+    cache.put(h, false, make_entry(20));
+  }
+  const cryptonote::hot_block_cache::entry_ptr kept = cache.get(3, false);
+  cache.invalidate(3);
+  for (uint64_t h = 0; h < 5; ++h)
+  {
+    ASSERT_EQ(h < 3, cache.get(h, true) != nullptr);
+    ASSERT_EQ(h < 3, cache.get(h, false) != nullptr);
+  }
+  ASSERT_EQ(20, kept->block.size());
+
+  cache.put(3, true, make_entry(10));
+  ASSERT_NE(nullptr, cache.get(3, true));
+  cache.clear();
+  ASSERT_EQ(nullptr, cache.get(0, true));
+}
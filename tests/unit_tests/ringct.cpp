@@ -524,7 +524,7 @@ static rct::rctSig make_sample_rct_sig(int n_inputs, const uint64_t input_amount
     return genRct(rct::zero(), sc, pc, destinations, amounts, amount_keys, 3, rct_config, hw::get_device("default"));
 }
 
-static rct::rctSig make_sample_simple_rct_sig(int n_inputs, const uint64_t input_amounts[], int n_outputs, const uint64_t output_amounts[], uint64_t fee)
+static rct::rctSig make_sample_simple_rct_sig(int n_inputs, const uint64_t input_amounts[], int n_outputs, const uint64_t output_amounts[], uint64_t fee, const rct::RCTConfig &rct_config = { RangeProofBorromean, 0 })
 {
     ctkeyV sc, pc;
     ctkey sctmp, pctmp;
@@ -547,7 +547,6 @@ static rct::rctSig make_sample_simple_rct_sig(int n_inputs, const uint64_t input
         destinations.push_back(Pk);
     }
 
-    const rct::RCTConfig rct_config { RangeProofBorromean, 0 };
     return genRctSimple(rct::zero(), sc, pc, destinations, inamounts, outamounts, amount_keys, fee, 3, rct_config, hw::get_device("default"));
 }
 
@@ -1268,3 +1267,31 @@ TEST(ringct, aggregated)
 
   ASSERT_TRUE(verRctSemanticsSimple(sp));
 }
+
+TEST(ringct, aggregated_bisect)
+{
+  static const size_t N_PROOFS = 8;
+  std::vector<rctSig> s(N_PROOFS);
+  std::vector<const rctSig*> sp(N_PROOFS);
+
+  for (size_t n = 0; n < N_PROOFS; ++n)
+  {
+    static const uint64_t inputs[] = {1000, 1000};
+    static const uint64_t outputs[] = {500, 1500};
+    s[n] = make_sample_simple_rct_sig(NELTS(inputs), inputs, NELTS(outputs), outputs, 0, { RangeProofPaddedBulletproof, 4 });
+    sp[n] = &s[n];
+  }
+
+  std::deque<bool> results;
+  ASSERT_TRUE(verRctSemanticsSimple(sp, results));
+  ASSERT_EQ(N_PROOFS, results.size());
+  for (size_t n = 0; n < N_PROOFS; ++n)
+    ASSERT_TRUE(results[n]);
+
+  s[3].p.bulletproofs_plus[0].A = s[4].p.bulletproofs_plus[0].A;
+  s[6].p.bulletproofs_plus[0].B = s[0].p.bulletproofs_plus[0].B;
+  ASSERT_FALSE(verRctSemanticsSimple(sp, results));
+  ASSERT_EQ(N_PROOFS, results.size());
+  for (size_t n = 0; n < N_PROOFS; ++n)
+    ASSERT_EQ(n != 3 && n != 6, results[n]);
+}
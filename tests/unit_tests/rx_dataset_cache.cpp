@@ -0,0 +1,176 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "crypto/hash.h"
+#include "string_tools.h"
+
+#ifndef _WIN32
+namespace
+{
+  // computing a dataset takes minutes, more on few cores
+  const auto DATASET_TIMEOUT = std::chrono::minutes(60);
+
+  crypto::hash make_seed(char c)
+  {
+    crypto::hash seed;
+    memset(seed.data, c, sizeof(seed.data));
+    return seed;
+  }
+
+  std::string dataset_file(const boost::filesystem::path &dir, const crypto::hash &seed)
+  {
+    return (dir / ("rx-dataset-" + epee::string_tools::pod_to_hex(seed) + ".bin")).string();
+  }
+
+  template<typename F>
+  bool wait_for(F f)
+  {
+    const auto deadline = std::chrono::steady_clock::now() + DATASET_TIMEOUT;
+    while (!f())
+    {
+      if (std::chrono::steady_clock::now() > deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return true;
+  }
+
+  // recomputing takes long enough for the mtime to tell a rewritten file apart
+  std::pair<ino_t, time_t> file_id(const std::string &filename)
+  {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+      return {0, 0};
+    return {st.st_ino, st.st_mtime};
+  }
+}
+
+// Needs two full datasets in memory (over 4 GB) and a good while of CPU, so it only runs
+// when MONERO_RANDOMX_FULL_MEM is set. The dataset cache directory is latched on first
+// use, so run it on its own (--gtest_filter=rx_dataset_cache.*)
+TEST(rx_dataset_cache, prepared_dataset_handoff)
+{
+  if (!getenv("MONERO_RANDOMX_FULL_MEM"))
+    return;
+
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("rx-dataset-cache-%%%%-%%%%");
+  ASSERT_TRUE(boost::filesystem::create_directory(dir));
+  setenv("MONERO_RANDOMX_DATASET_CACHE", dir.string().c_str(), 1);
+
+  const crypto::hash seed_a = make_seed(0x0a), seed_b = make_seed(0x0b), seed_c = make_seed(0x0c);
+  const std::string file_a = dataset_file(dir, seed_a), file_b = dataset_file(dir, seed_b), file_c = dataset_file(dir, seed_c);
+  const size_t threads = std::thread::hardware_concurrency();
+  static const char data[] = "rx_dataset_cache";
+
+  // the current epoch's dataset is computed and stored
+  crypto::rx_set_main_seedhash(seed_a.data, threads);
+  ASSERT_TRUE(wait_for([&]{ return boost::filesystem::exists(file_a); }));
+
+  // a file left over from an older epoch
+  std::ofstream(file_c) << "stale";
+  ASSERT_TRUE(boost::filesystem::exists(file_c));
+
+  // light mode reference, B isn't the main seed yet
+  crypto::hash expected;
+  crypto::rx_slow_hash(seed_b.data, data, sizeof(data), expected.data);
+
+  // the next epoch's dataset is prepared in the background
+  crypto::rx_prepare_next_seedhash(seed_b.data, threads);
+  ASSERT_TRUE(wait_for([&]{ return boost::filesystem::exists(file_b); }));
+  const std::pair<ino_t, time_t> prepared = file_id(file_b);
+  ASSERT_NE(prepared.first, 0);
+
+  // switching to B loads the prepared file and prunes the others
+  crypto::rx_set_main_seedhash(seed_b.data, threads);
+  ASSERT_TRUE(wait_for([&]{ return !boost::filesystem::exists(file_a) && !boost::filesystem::exists(file_c); }));
+
+  // a dataset that failed to load would have been recomputed and written to a new file
+  ASSERT_TRUE(file_id(file_b) == prepared);
+
+  crypto::hash hash;
+  crypto::rx_slow_hash(seed_b.data, data, sizeof(data), hash.data);
+  ASSERT_EQ(hash, expected);
+
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(dir, ec);
+}
+#endif
+
+TEST(rx_dataset_cache, file_validation)
+{
+  // a few items stand in for the full dataset, the checks don't depend on its size
+  const uint64_t item_count = 16;
+  const size_t item_size = 64;
+  std::vector<char> header(crypto::rx_dataset_file_header_size());
+  std::vector<char> data(item_count * item_size);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i * 31;
+  crypto::hash seed, other_seed;
+  memset(seed.data, 0x0a, sizeof(seed.data));
+  memset(other_seed.data, 0x0b, sizeof(other_seed.data));
+
+  crypto::rx_make_dataset_file_header(seed.data, data.data(), item_count, header.data());
+  ASSERT_TRUE(crypto::rx_check_dataset_file(header.data(), data.data(), item_count, seed.data));
+
+  // a different seed or size
+  ASSERT_FALSE(crypto::rx_check_dataset_file(header.data(), data.data(), item_count, other_seed.data));
+  ASSERT_FALSE(crypto::rx_check_dataset_file(header.data(), data.data(), item_count - 1, seed.data));
+
+  // a single flipped bit anywhere in the payload
+  for (size_t offset: {(size_t)0, data.size() / 2, data.size() - 1})
+  {
+    data[offset] ^= 1;
+    ASSERT_FALSE(crypto::rx_check_dataset_file(header.data(), data.data(), item_count, seed.data));
+    data[offset] ^= 1;
+  }
+
+  // a damaged header
+  for (size_t offset = 0; offset < header.size(); ++offset)
+  {
+    header[offset] ^= 1;
+    ASSERT_FALSE(crypto::rx_check_dataset_file(header.data(), data.data(), item_count, seed.data));
+    header[offset] ^= 1;
+  }
+  ASSERT_TRUE(crypto::rx_check_dataset_file(header.data(), data.data(), item_count, seed.data));
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/spent_key_images.h"
+
+TEST(spent_key_images, update_get)
+{
+  cryptonote::spent_key_images key_images(4);
+  const crypto::key_image ki = crypto::rand<crypto::key_image>();
+  const crypto::hash txid0 = crypto::rand<crypto::hash>(), txid1 = crypto::rand<crypto::hash>();
+
+  ASSERT_TRUE(key_images.get(ki).empty());
+  key_images.update(ki, [&](cryptonote::spent_key_images::txid_set &txids) { txids.insert(txid0); });
+  key_images.update(ki, [&](cryptonote::spent_key_images::txid_set &txids) { txids.insert(txid1); });
+  ASSERT_EQ(1, key_images.size());
+  std::vector<crypto::hash> txids = key_images.get(ki);
+  ASSERT_EQ(2, txids.size());
+  ASSERT_TRUE(std::find(txids.begin(), txids.end(), txid0) != txids.end());
+  ASSERT_TRUE(std::find(txids.begin(), txids.end(), txid1) != txids.end());
+
+  key_images.update(ki, [&](cryptonote::spent_key_images::txid_set &txids) { txids.erase(txid0); });
+  ASSERT_EQ(std::vector<crypto::hash>{txid1}, key_images.get(ki));
+
+  // entries left empty are dropped, including ones only looked at
+  key_images.update(ki, [&](cryptonote::spent_key_images::txid_set &txids) { txids.erase(txid1); });
+  key_images.update(crypto::rand<crypto::key_image>(), [](cryptonote::spent_key_images::txid_set &txids) {});
+  ASSERT_EQ(0, key_images.size());
+}
+
+TEST(spent_key_images, concurrent)
+{
+  static constexpr const size_t THREADS = 4, KEY_IMAGES = 1000;
+  cryptonote::spent_key_images key_images;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&key_images]() {
+      for (size_t i = 0; i < KEY_IMAGES; ++i)
+      {
+        const crypto::hash txid = crypto::rand<crypto::hash>();
+        key_images.update(crypto::rand<crypto::key_image>(), [&](cryptonote::spent_key_images::txid_set &txids) { txids.insert(txid); });
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  ASSERT_EQ(THREADS * KEY_IMAGES, key_images.size());
+
+  size_t n = 0;
+  key_images.for_each([&](const crypto::key_image &ki, const cryptonote::spent_key_images::txid_set &txids) { n += txids.size(); });
+  ASSERT_EQ(THREADS * KEY_IMAGES, n);
+
+  key_images.clear();
+  ASSERT_EQ(0, key_images.size());
+}
@@ -424,3 +424,198 @@ TEST(verRctNonSemanticsSimple, expand_transaction_2_failures)
     EXPAND_TRANSACTION_2_FAILURES_SUBTEST(rct_signatures.mixRing[0][15].dest[31]++)
     EXPAND_TRANSACTION_2_FAILURES_SUBTEST(rct_signatures.mixRing[0][15].mask[31]++)
 }
+
+TEST(verRctNonSemanticsSimple, batch)
+{
+    const cryptonote::transaction tx = expand_transaction_from_bin_file_and_pubkeys
+        (tx1_file_name, tx1_input_pubkeys);
+
+    rct::ctkeyM bad_mixring = tx1_input_pubkeys;
+    bad_mixring[0][3].dest[0]++;
+
+    std::vector<cryptonote::transaction> txs(3, tx);
+    const std::vector<rct::ctkeyM> mix_rings{tx1_input_pubkeys, bad_mixring, tx1_input_pubkeys};
+    std::vector<crypto::hash> verified;
+
+    EXPECT_FALSE(cryptonote::ver_rct_non_semantics_simple_batch(txs, mix_rings, verified));
+    ASSERT_EQ(2, verified.size());
+    const crypto::hash expected_hash = cryptonote::calc_tx_mixring_hash(tx, tx1_input_pubkeys);
+    EXPECT_EQ(expected_hash, verified[0]);
+    EXPECT_EQ(expected_hash, verified[1]);
+
+    txs.erase(txs.begin() + 1);
+    const std::vector<rct::ctkeyM> good_mix_rings(2, tx1_input_pubkeys);
+    EXPECT_TRUE(cryptonote::ver_rct_non_semantics_simple_batch(txs, good_mix_rings, verified));
+    EXPECT_EQ(2, verified.size());
+
+    std::deque<bool> results;
+    EXPECT_TRUE(rct::verRctNonSemanticsSimple(std::vector<const rct::rctSig*>{&txs[0].rct_signatures, &txs[1].rct_signatures}, results));
+    ASSERT_EQ(2, results.size());
+    EXPECT_TRUE(results[0] && results[1]);
+}
+
+TEST(verRctNonSemanticsSimple, cache_eviction)
+{
+    cryptonote::rct_ver_cache_t cache(64);
+    EXPECT_EQ(64, cache.max_size());
+
+    std::vector<crypto::hash> hashes(1000);
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        hashes[i] = crypto::rand<crypto::hash>();
+        cache.add(hashes[i]);
+        EXPECT_TRUE(cache.has(hashes[i]));
+    }
+    EXPECT_LE(cache.size(), cache.max_size());
+    EXPECT_TRUE(cache.has(hashes.back()));
+    EXPECT_FALSE(cache.has(hashes.front()));
+
+    cache.set_max_size(0);
+    cache.add(hashes[0]);
+    EXPECT_FALSE(cache.has(hashes[0]));
+    EXPECT_EQ(0, cache.size());
+}
+
+TEST(verRctNonSemanticsSimple, cache_persistence)
+{
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    const std::string filename = path.string();
+
+    // a missing file is not an error
+    cryptonote::rct_ver_cache_t cache(256);
+    EXPECT_TRUE(cache.load(filename));
+    EXPECT_EQ(0, cache.size());
+
+    std::vector<crypto::hash> hashes(300);
+    for (auto &h: hashes)
+    {
+        h = crypto::rand<crypto::hash>();
+        cache.add(h);
+    }
+    ASSERT_TRUE(cache.store(filename));
+
+    cryptonote::rct_ver_cache_t loaded(256);
+    ASSERT_TRUE(loaded.load(filename));
+    EXPECT_EQ(cache.size(), loaded.size());
+    for (const auto &h: hashes)
+        EXPECT_EQ(cache.has(h), loaded.has(h));
+
+    std::string data;
+    ASSERT_TRUE(epee::file_io_utils::load_file_to_string(filename, data));
+    data[data.size() / 2] ^= 1;
+    ASSERT_TRUE(epee::file_io_utils::save_string_to_file(filename, data));
+    cryptonote::rct_ver_cache_t corrupt(256);
+    EXPECT_FALSE(corrupt.load(filename));
+    EXPECT_EQ(0, corrupt.size());
+
+    boost::filesystem::remove(path);
+}
+
+namespace
+{
+static std::vector<cryptonote::block_complete_entry> make_span(const std::string& tx_blob)
+{
+    cryptonote::block_complete_entry entry;
+    entry.txs.push_back(cryptonote::tx_blob_entry(tx_blob));
+    return {entry};
+}
+
+// A two input, two output BP+ tx with freshly generated proofs
+static std::string make_tx_blob()
+{
+    rct::ctkeyV sc, pc;
+    rct::ctkey sctmp, pctmp;
+    std::vector<rct::xmr_amount> inamounts = {6000, 7000}, outamounts = {500, 12000};
+    rct::keyV destinations, amount_keys;
+    rct::key Sk, Pk;
+    for (const rct::xmr_amount amount: inamounts)
+    {
+        std::tie(sctmp, pctmp) = rct::ctskpkGen(amount);
+        sc.push_back(sctmp);
+        pc.push_back(pctmp);
+    }
+    for (size_t n = 0; n < outamounts.size(); ++n)
+    {
+        amount_keys.push_back(rct::hash_to_scalar(rct::zero()));
+        rct::skpkGen(Sk, Pk);
+        destinations.push_back(Pk);
+    }
+
+    cryptonote::transaction tx;
+    tx.version = 2;
+    for (size_t n = 0; n < inamounts.size(); ++n)
+    {
+        cryptonote::txin_to_key in;
+        in.key_offsets = {1, 1, 1, 1};
+        in.k_image = crypto::rand<crypto::key_image>();
+        tx.vin.push_back(in);
+    }
+    for (const rct::key& dest: destinations)
+        tx.vout.push_back({0, cryptonote::txout_to_key(rct::rct2pk(dest))});
+    const rct::RCTConfig rct_config{rct::RangeProofPaddedBulletproof, 4};
+    tx.rct_signatures = rct::genRctSimple(rct::zero(), sc, pc, destinations, inamounts, outamounts, amount_keys, 500, 3, rct_config, hw::get_device("default"));
+    return cryptonote::tx_to_blob(tx);
+}
+
+// Same tx with its last pseudo output commitment changed, so its amounts no longer balance
+static std::string corrupt_tx_blob(std::string tx_blob)
+{
+    tx_blob.back() ^= 1;
+    return tx_blob;
+}
+} // anonymous namespace
+
+TEST(verRctSemanticsBlocks, lookahead_matches_direct)
+{
+    const std::string tx_blob = make_tx_blob();
+    cryptonote::transaction tx;
+    crypto::hash tx_hash;
+    ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash));
+    const std::vector<cryptonote::block_complete_entry> span = make_span(tx_blob);
+
+    // without a lookahead
+    std::unordered_set<crypto::hash> direct;
+    EXPECT_EQ(0, cryptonote::ver_rct_semantics_blocks(span, {}, direct));
+    EXPECT_EQ(std::unordered_set<crypto::hash>{tx_hash}, direct);
+
+    // the lookahead's pass over the span, then the span being added reusing it
+    std::unordered_set<crypto::hash> lookahead, pipelined;
+    cryptonote::ver_rct_semantics_blocks(span, {}, lookahead);
+    EXPECT_EQ(1, cryptonote::ver_rct_semantics_blocks(span, lookahead, pipelined));
+    EXPECT_EQ(direct, pipelined);
+
+    // pruned txes have no proofs to verify
+    std::vector<cryptonote::block_complete_entry> pruned_span = span;
+    pruned_span[0].txs[0].prunable_hash = crypto::rand<crypto::hash>();
+    std::unordered_set<crypto::hash> pruned;
+    EXPECT_EQ(0, cryptonote::ver_rct_semantics_blocks(pruned_span, lookahead, pruned));
+    EXPECT_TRUE(pruned.empty());
+}
+
+TEST(verRctSemanticsBlocks, replaced_span_not_trusted)
+{
+    const std::string tx_blob = make_tx_blob();
+    const std::string bad_tx_blob = corrupt_tx_blob(tx_blob);
+    cryptonote::transaction tx;
+    crypto::hash tx_hash, bad_tx_hash;
+    ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash));
+    ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(bad_tx_blob, tx, bad_tx_hash));
+    ASSERT_NE(tx_hash, bad_tx_hash);
+
+    std::unordered_set<crypto::hash> bad_direct;
+    cryptonote::ver_rct_semantics_blocks(make_span(bad_tx_blob), {}, bad_direct);
+    EXPECT_TRUE(bad_direct.empty());
+
+    // the span was verified ahead, then replaced by one with a bad tx in its place
+    std::unordered_set<crypto::hash> lookahead, verified;
+    cryptonote::ver_rct_semantics_blocks(make_span(tx_blob), {}, lookahead);
+    EXPECT_EQ(0, cryptonote::ver_rct_semantics_blocks(make_span(bad_tx_blob), lookahead, verified));
+    EXPECT_EQ(bad_direct, verified);
+
+    // and the other way around, the good tx gets verified on its own
+    lookahead.clear();
+    verified.clear();
+    cryptonote::ver_rct_semantics_blocks(make_span(bad_tx_blob), {}, lookahead);
+    EXPECT_EQ(0, cryptonote::ver_rct_semantics_blocks(make_span(tx_blob), lookahead, verified));
+    EXPECT_EQ(std::unordered_set<crypto::hash>{tx_hash}, verified);
+}
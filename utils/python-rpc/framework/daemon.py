@@ -568,6 +568,17 @@ class Daemon(object):
         }
         return self.rpc.send_json_rpc_request(get_txpool_backlog)
 
+    def get_txpool_fee_histogram(self, client = ""):
+        get_txpool_fee_histogram = {
+            'method': 'get_txpool_fee_histogram',
+            'params': {
+                'client': client,
+            },
+            'jsonrpc': '2.0',
+            'id': '0'
+        }
+        return self.rpc.send_json_rpc_request(get_txpool_fee_histogram)
+
     def prune_blockchain(self, check = False):
         prune_blockchain = {
             'method': 'prune_blockchain',